@@ -187,6 +187,76 @@ virAdmServerPtr virAdmConnectLookupServer(virAdmConnectPtr conn,
 
 # define VIR_THREADPOOL_JOB_QUEUE_DEPTH "jobQueueDepth"
 
+/**
+ * VIR_THREADPOOL_EVENT_LOOPS:
+ * Macro for the threadpool eventLoops attribute: represents the number of
+ * dedicated event loop threads client connections are spread across, as
+ * VIR_TYPED_PARAM_UINT. Zero means all clients are served from the main
+ * event loop.
+ *
+ * NOTE: This attribute is read-only and any attempt to set it will be denied
+ * by daemon
+ */
+
+# define VIR_THREADPOOL_EVENT_LOOPS "eventLoops"
+
+/**
+ * VIR_THREADPOOL_EVENT_LOOP_PREFIX:
+ * Prefix of the per event loop threadpool attributes. For every dedicated
+ * event loop thread, numbered from 0, the attribute
+ * "eventLoop.<num>.busy" reports the percentage of time the thread spent
+ * handling events rather than waiting for them since it was started, as
+ * VIR_TYPED_PARAM_UINT.
+ *
+ * NOTE: These attributes are read-only and any attempt to set them will be
+ * denied by daemon
+ */
+
+# define VIR_THREADPOOL_EVENT_LOOP_PREFIX "eventLoop."
+
+/**
+ * VIR_THREADPOOL_EVENT_LOOP_SUFFIX_BUSY:
+ * Suffix of the per event loop busy attribute, see
+ * VIR_THREADPOOL_EVENT_LOOP_PREFIX.
+ */
+
+# define VIR_THREADPOOL_EVENT_LOOP_SUFFIX_BUSY ".busy"
+
+/**
+ * VIR_THREADPOOL_JOB_QUEUE_LATENCY_BUCKETS:
+ * Macro for the threadpool jobQueueLatencyBuckets attribute: represents the
+ * number of buckets of the histogram of time jobs spent in the queue before
+ * a worker picked them up, as VIR_TYPED_PARAM_UINT.
+ *
+ * NOTE: This attribute is read-only and any attempt to set it will be denied
+ * by daemon
+ */
+
+# define VIR_THREADPOOL_JOB_QUEUE_LATENCY_BUCKETS "jobQueueLatencyBuckets"
+
+/**
+ * VIR_THREADPOOL_JOB_QUEUE_LATENCY_PREFIX:
+ * Prefix of the job queue latency histogram attributes. For every bucket,
+ * numbered from 0, the attribute "jobQueueLatency.<num>.count" reports the
+ * number of jobs which waited that long since the daemon was started, as
+ * VIR_TYPED_PARAM_ULLONG. The buckets cover waits shorter than 100
+ * microseconds, 1, 10 and 100 milliseconds, 1 second, and everything
+ * longer, in this order.
+ *
+ * NOTE: These attributes are read-only and any attempt to set them will be
+ * denied by daemon
+ */
+
+# define VIR_THREADPOOL_JOB_QUEUE_LATENCY_PREFIX "jobQueueLatency."
+
+/**
+ * VIR_THREADPOOL_JOB_QUEUE_LATENCY_SUFFIX_COUNT:
+ * Suffix of the per bucket count attribute, see
+ * VIR_THREADPOOL_JOB_QUEUE_LATENCY_PREFIX.
+ */
+
+# define VIR_THREADPOOL_JOB_QUEUE_LATENCY_SUFFIX_COUNT ".count"
+
 /* Tunables for a server workerpool */
 int virAdmServerGetThreadPoolParameters(virAdmServerPtr srv,
                                         virTypedParameterPtr *params,
@@ -30,6 +30,9 @@ AC_DEFUN([LIBVIRT_CHECK_XDR], [
     ])
     with_xdr="yes"
 
+    dnl xdr_sizeof lets us size large payloads before encoding them
+    AC_CHECK_FUNCS([xdr_sizeof])
+
     dnl Recent glibc requires -I/usr/include/tirpc for <rpc/rpc.h>
     old_CFLAGS=$CFLAGS
     AC_CACHE_CHECK([where to find <rpc/rpc.h>], [lv_cv_xdr_cflags], [
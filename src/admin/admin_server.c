@@ -81,6 +81,13 @@ adminServerGetThreadPoolParameters(virNetServerPtr srv,
     size_t freeWorkers;
     size_t nPrioWorkers;
     size_t jobQueueDepth;
+    size_t neventThreads;
+    g_autofree unsigned long long *busy = NULL;
+    g_autofree unsigned long long *total = NULL;
+    size_t nbuckets;
+    g_autofree unsigned long long *limits = NULL;
+    g_autofree unsigned long long *counts = NULL;
+    size_t i;
     g_autoptr(virTypedParamList) paramlist = g_new0(virTypedParamList, 1);
 
     virCheckFlags(0, -1);
@@ -118,6 +125,41 @@ adminServerGetThreadPoolParameters(virNetServerPtr srv,
                                  "%s", VIR_THREADPOOL_JOB_QUEUE_DEPTH) < 0)
         return -1;
 
+    neventThreads = virNetServerGetEventThreadStats(srv, &busy, &total);
+
+    if (virTypedParamListAddUInt(paramlist, neventThreads,
+                                 "%s", VIR_THREADPOOL_EVENT_LOOPS) < 0)
+        return -1;
+
+    for (i = 0; i < neventThreads; i++) {
+        unsigned int percent = 0;
+
+        if (total[i] > 0)
+            percent = busy[i] * 100 / total[i];
+
+        if (virTypedParamListAddUInt(paramlist, percent,
+                                     VIR_THREADPOOL_EVENT_LOOP_PREFIX "%zu"
+                                     VIR_THREADPOOL_EVENT_LOOP_SUFFIX_BUSY,
+                                     i) < 0)
+            return -1;
+    }
+
+    nbuckets = virNetServerGetJobQueueLatency(srv, &limits, &counts);
+
+    if (virTypedParamListAddUInt(paramlist, nbuckets,
+                                 "%s", VIR_THREADPOOL_JOB_QUEUE_LATENCY_BUCKETS) < 0)
+        return -1;
+
+    /* The bucket limits are fixed and documented rather than reported to
+     * keep the reply within ADMIN_SERVER_THREADPOOL_PARAMETERS_MAX */
+    for (i = 0; i < nbuckets; i++) {
+        if (virTypedParamListAddULLong(paramlist, counts[i],
+                                       VIR_THREADPOOL_JOB_QUEUE_LATENCY_PREFIX "%zu"
+                                       VIR_THREADPOOL_JOB_QUEUE_LATENCY_SUFFIX_COUNT,
+                                       i) < 0)
+            return -1;
+    }
+
     *nparams = virTypedParamListStealParams(paramlist, params);
 
     return 0;
@@ -407,7 +407,7 @@ bhyveDomainSetAutostart(virDomainPtr domain, int autostart)
             }
         }
 
-        vm->autostart = autostart;
+        virDomainObjSetAutostart(vm, autostart);
     }
 
     ret = 0;
@@ -538,7 +538,7 @@ bhyveDomainDefineXMLFlags(virConnectPtr conn, const char *xml, unsigned int flag
                                    0, &oldDef)))
         goto cleanup;
     def = NULL;
-    vm->persistent = 1;
+    virDomainObjSetPersistent(vm, true);
 
     if (virDomainDefSave(vm->newDef ? vm->newDef : vm->def,
                          privconn->xmlopt, BHYVE_CONFIG_DIR) < 0) {
@@ -601,7 +601,7 @@ bhyveDomainUndefineFlags(virDomainPtr domain, unsigned int flags)
                                               VIR_DOMAIN_EVENT_UNDEFINED_REMOVED);
 
     if (virDomainObjIsActive(vm))
-        vm->persistent = 0;
+        virDomainObjSetPersistent(vm, false);
     else
         virDomainObjListRemove(privconn->domains, vm);
 
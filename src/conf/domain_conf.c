@@ -3509,6 +3509,9 @@ void virDomainDefFree(virDomainDefPtr def)
 
     xmlFreeNode(def->metadata);
 
+    for (i = 0; i < VIR_DOMAIN_DEF_XML_CACHE_SIZE; i++)
+        VIR_FREE(def->xmlcache[i].xml);
+
     VIR_FREE(def);
 }
 
@@ -3623,6 +3626,8 @@ void virDomainObjAssignDef(virDomainObjPtr domain,
             domain->def = def;
         }
     }
+
+    virDomainObjSummaryUpdate(domain);
 }
 
 
@@ -3723,6 +3728,9 @@ virDomainObjSetDefTransient(virDomainXMLOptionPtr xmlopt,
                                             parseOpaque, false)))
         return -1;
 
+    /* domain->def is going to become the live definition */
+    virDomainDefBumpGeneration(domain->def);
+
     return 0;
 }
 
@@ -3742,6 +3750,8 @@ virDomainObjRemoveTransientDef(virDomainObjPtr domain)
     domain->def = domain->newDef;
     domain->def->id = -1;
     domain->newDef = NULL;
+    virDomainDefBumpGeneration(domain->def);
+    virDomainObjSummaryUpdate(domain);
 }
 
 
@@ -5881,6 +5891,7 @@ virDomainDefPostParse(virDomainDefPtr def,
     };
 
     def->postParseFailed = false;
+    virDomainDefBumpGeneration(def);
 
     /* call the basic post parse callback */
     if (xmlopt->config.domainPostParseBasicCallback) {
@@ -29695,6 +29706,95 @@ virDomainDefSaveXML(virDomainDefPtr def,
                            xml);
 }
 
+/**
+ * virDomainDefBumpGeneration:
+ * @def: domain definition
+ *
+ * Notes that @def was modified and drops the formatted XML cached for it.
+ * virDomainDefSave does this implicitly, as every change to a persistent
+ * definition has to be saved.
+ */
+void
+virDomainDefBumpGeneration(virDomainDefPtr def)
+{
+    size_t i;
+
+    def->generation++;
+
+    for (i = 0; i < VIR_DOMAIN_DEF_XML_CACHE_SIZE; i++)
+        VIR_FREE(def->xmlcache[i].xml);
+}
+
+
+/**
+ * virDomainDefXMLCacheLookup:
+ * @def: domain definition
+ * @flags: driver specific format flags the XML was cached with
+ *
+ * Returns the XML cached for the current generation of @def and @flags,
+ * or NULL. The string is owned by @def.
+ */
+const char *
+virDomainDefXMLCacheLookup(virDomainDefPtr def,
+                           unsigned int flags)
+{
+    size_t i;
+
+    for (i = 0; i < VIR_DOMAIN_DEF_XML_CACHE_SIZE; i++) {
+        virDomainDefXMLCacheEntry *entry = &def->xmlcache[i];
+
+        if (entry->xml &&
+            entry->generation == def->generation &&
+            entry->flags == flags)
+            return entry->xml;
+    }
+
+    return NULL;
+}
+
+
+/**
+ * virDomainDefXMLCacheStore:
+ * @def: domain definition
+ * @flags: driver specific format flags used to format @xml
+ * @xml: formatted definition
+ *
+ * Caches a copy of @xml for the current generation of @def. Callers must
+ * only cache definitions which are modified only along with a call to
+ * virDomainDefSave or virDomainDefBumpGeneration, i.e. persistent ones.
+ */
+void
+virDomainDefXMLCacheStore(virDomainDefPtr def,
+                          unsigned int flags,
+                          const char *xml)
+{
+    virDomainDefXMLCacheEntry *entry = NULL;
+    size_t i;
+
+    for (i = 0; i < VIR_DOMAIN_DEF_XML_CACHE_SIZE; i++) {
+        if (!def->xmlcache[i].xml ||
+            def->xmlcache[i].flags == flags) {
+            entry = &def->xmlcache[i];
+            break;
+        }
+    }
+
+    /* evict the oldest entry, keeping the rest in insertion order */
+    if (!entry) {
+        VIR_FREE(def->xmlcache[0].xml);
+        memmove(&def->xmlcache[0], &def->xmlcache[1],
+                sizeof(def->xmlcache[0]) * (VIR_DOMAIN_DEF_XML_CACHE_SIZE - 1));
+        entry = &def->xmlcache[VIR_DOMAIN_DEF_XML_CACHE_SIZE - 1];
+        entry->xml = NULL;
+    }
+
+    VIR_FREE(entry->xml);
+    entry->xml = g_strdup(xml);
+    entry->generation = def->generation;
+    entry->flags = flags;
+}
+
+
 int
 virDomainDefSave(virDomainDefPtr def,
                  virDomainXMLOptionPtr xmlopt,
@@ -29702,6 +29802,8 @@ virDomainDefSave(virDomainDefPtr def,
 {
     g_autofree char *xml = NULL;
 
+    virDomainDefBumpGeneration(def);
+
     if (!(xml = virDomainDefFormat(def, xmlopt, VIR_DOMAIN_DEF_FORMAT_SECURE)))
         return -1;
 
@@ -29744,7 +29846,7 @@ virDomainDeleteConfig(const char *configDir,
 
     /* Not fatal if this doesn't work */
     unlink(autostartLink);
-    dom->autostart = 0;
+    virDomainObjSetAutostart(dom, false);
 
     if (unlink(configFile) < 0 &&
         errno != ENOENT) {
@@ -30003,6 +30105,660 @@ virDomainUSBDeviceDefForeach(virDomainDefPtr def,
 }
 
 
+/*
+ * Structural deep copy of a domain definition.
+ *
+ * The copy is meant to be equivalent to formatting @src to XML and
+ * parsing it back with VIR_DOMAIN_DEF_PARSE_INACTIVE, which is what
+ * virDomainDefCopy has always done. That means state which such a
+ * round trip drops (the domain ID, non-user device aliases, disk
+ * indexes, ...) is dropped here as well.
+ *
+ * Only the parts of the definition making up the bulk of common guests
+ * are handled. Everything else has to be unused, which is checked by
+ * virDomainDefDeepCopySupported; otherwise we fall back to the XML
+ * round trip instead of silently losing data.
+ */
+
+static virDomainVirtioOptionsPtr
+virDomainVirtioOptionsCopy(const virDomainVirtioOptions *src)
+{
+    virDomainVirtioOptionsPtr ret;
+
+    if (!src)
+        return NULL;
+
+    ret = g_new0(virDomainVirtioOptions, 1);
+    *ret = *src;
+    return ret;
+}
+
+
+static void
+virDomainDeviceInfoCopyInactive(virDomainDeviceInfoPtr dst,
+                                const virDomainDeviceInfo *src,
+                                virDomainXMLOptionPtr xmlopt)
+{
+    *dst = *src;
+    dst->alias = NULL;
+    dst->romfile = g_strdup(src->romfile);
+    dst->loadparm = g_strdup(src->loadparm);
+
+    /* The inactive parser only keeps user aliases */
+    if (src->alias &&
+        xmlopt->config.features & VIR_DOMAIN_DEF_FEATURE_USER_ALIAS &&
+        virDomainDeviceAliasIsUserAlias(src->alias) &&
+        strspn(src->alias, USER_ALIAS_CHARS) == strlen(src->alias))
+        dst->alias = g_strdup(src->alias);
+
+    /* The PCI connect flags and isolation group aren't formatted, but
+     * parsing recomputes them from the definition during address
+     * assignment, so they're kept as they are */
+}
+
+
+static virDomainDiskDefPtr
+virDomainDiskDefDeepCopy(const virDomainDiskDef *src,
+                         virDomainXMLOptionPtr xmlopt)
+{
+    virDomainDiskDefPtr def;
+    virObjectPtr privateData;
+    virStorageSourcePtr n;
+
+    if (!(def = virDomainDiskDefNew(xmlopt)))
+        return NULL;
+
+    privateData = def->privateData;
+    virObjectUnref(def->src);
+
+    *def = *src;
+    def->privateData = privateData;
+    def->src = NULL;
+    def->dst = g_strdup(src->dst);
+    def->driverName = g_strdup(src->driverName);
+    def->serial = g_strdup(src->serial);
+    def->wwn = g_strdup(src->wwn);
+    def->vendor = g_strdup(src->vendor);
+    def->product = g_strdup(src->product);
+    def->domain_name = g_strdup(src->domain_name);
+    def->blkdeviotune.group_name = g_strdup(src->blkdeviotune.group_name);
+    def->virtio = virDomainVirtioOptionsCopy(src->virtio);
+    virDomainDeviceInfoCopyInactive(&def->info, &src->info, xmlopt);
+
+    /* Block job mirrors are not part of the inactive definition */
+    def->mirror = NULL;
+    def->mirrorState = VIR_DOMAIN_DISK_MIRROR_STATE_NONE;
+    def->mirrorJob = VIR_DOMAIN_BLOCK_JOB_TYPE_UNKNOWN;
+
+    if (!(def->src = virStorageSourceCopy(src->src, true))) {
+        virDomainDiskDefFree(def);
+        return NULL;
+    }
+
+    /* Runtime data which is either only saved in the status XML or not
+     * formatted at all */
+    for (n = def->src; n; n = n->backingStore) {
+        n->id = 0;
+        n->tlsFromConfig = false;
+        VIR_FREE(n->nodeformat);
+        VIR_FREE(n->nodestorage);
+        n->detected = false;
+        VIR_FREE(n->relPath);
+        VIR_FREE(n->backingStoreRaw);
+        n->backingStoreRawFormat = VIR_STORAGE_FILE_NONE;
+        VIR_FREE(n->externalDataStoreRaw);
+        virObjectUnref(n->externalDataStore);
+        n->externalDataStore = NULL;
+        n->capacity = 0;
+        n->allocation = 0;
+        n->physical = 0;
+        n->has_allocation = false;
+        VIR_FREE(n->tlsAlias);
+        VIR_FREE(n->tlsCertdir);
+        n->debug = false;
+        n->debugLevel = 0;
+        n->iomode = 0;
+        n->cachemode = 0;
+        n->discard = 0;
+        n->detect_zeroes = 0;
+        n->floppyimg = false;
+        n->hostcdrom = false;
+        VIR_FREE(n->ssh_user);
+        n->ssh_host_key_check_disabled = false;
+    }
+
+    return def;
+}
+
+
+static virDomainControllerDefPtr
+virDomainControllerDefDeepCopy(const virDomainControllerDef *src,
+                               virDomainXMLOptionPtr xmlopt)
+{
+    virDomainControllerDefPtr def = g_new0(virDomainControllerDef, 1);
+
+    *def = *src;
+    def->virtio = virDomainVirtioOptionsCopy(src->virtio);
+    virDomainDeviceInfoCopyInactive(&def->info, &src->info, xmlopt);
+
+    return def;
+}
+
+
+static bool
+virDomainNetDefDeepCopySupported(const virDomainNetDef *net)
+{
+    switch (net->type) {
+    case VIR_DOMAIN_NET_TYPE_NETWORK:
+        /* Interfaces with an allocated actual device are live only */
+        return !net->data.network.actual;
+
+    case VIR_DOMAIN_NET_TYPE_ETHERNET:
+    case VIR_DOMAIN_NET_TYPE_BRIDGE:
+    case VIR_DOMAIN_NET_TYPE_USER:
+        break;
+
+    case VIR_DOMAIN_NET_TYPE_VHOSTUSER:
+    case VIR_DOMAIN_NET_TYPE_SERVER:
+    case VIR_DOMAIN_NET_TYPE_CLIENT:
+    case VIR_DOMAIN_NET_TYPE_MCAST:
+    case VIR_DOMAIN_NET_TYPE_UDP:
+    case VIR_DOMAIN_NET_TYPE_INTERNAL:
+    case VIR_DOMAIN_NET_TYPE_DIRECT:
+    case VIR_DOMAIN_NET_TYPE_HOSTDEV:
+    case VIR_DOMAIN_NET_TYPE_LAST:
+        return false;
+    }
+
+    return !net->filterparams &&
+        net->hostIP.nips == 0 && net->hostIP.nroutes == 0 &&
+        net->guestIP.nips == 0 && net->guestIP.nroutes == 0;
+}
+
+
+static virDomainNetDefPtr
+virDomainNetDefDeepCopy(const virDomainNetDef *src,
+                        virDomainXMLOptionPtr xmlopt)
+{
+    virDomainNetDefPtr def;
+    virObjectPtr privateData;
+    const char *prefix = xmlopt->config.netPrefix;
+
+    if (!(def = virDomainNetDefNew(xmlopt)))
+        return NULL;
+
+    privateData = def->privateData;
+
+    *def = *src;
+    def->privateData = privateData;
+    def->mac_generated = false;
+    def->modelstr = g_strdup(src->modelstr);
+    def->backend.tap = g_strdup(src->backend.tap);
+    def->backend.vhost = g_strdup(src->backend.vhost);
+    def->teaming.persistent = g_strdup(src->teaming.persistent);
+    def->script = g_strdup(src->script);
+    def->domain_name = g_strdup(src->domain_name);
+    def->ifname = g_strdup(src->ifname);
+    def->ifname_guest_actual = g_strdup(src->ifname_guest_actual);
+    def->ifname_guest = g_strdup(src->ifname_guest);
+    def->filter = g_strdup(src->filter);
+    def->virtio = virDomainVirtioOptionsCopy(src->virtio);
+    def->virtPortProfile = NULL;
+    def->bandwidth = NULL;
+    def->vlan.tag = NULL;
+    def->vlan.nTags = 0;
+    def->coalesce = NULL;
+    virDomainDeviceInfoCopyInactive(&def->info, &src->info, xmlopt);
+
+    switch (def->type) {
+    case VIR_DOMAIN_NET_TYPE_NETWORK:
+        def->data.network.name = g_strdup(src->data.network.name);
+        def->data.network.portgroup = g_strdup(src->data.network.portgroup);
+        /* The port is only recorded in the live definition */
+        memset(def->data.network.portid, 0, VIR_UUID_BUFLEN);
+        break;
+
+    case VIR_DOMAIN_NET_TYPE_BRIDGE:
+        def->data.bridge.brname = g_strdup(src->data.bridge.brname);
+        break;
+
+    default:
+        break;
+    }
+
+    /* Drop auto-generated host side names, like the parser does */
+    if (def->managed_tap != VIR_TRISTATE_BOOL_NO && def->ifname &&
+        (STRPREFIX(def->ifname, VIR_NET_GENERATED_TAP_PREFIX) ||
+         (prefix && STRPREFIX(def->ifname, prefix))))
+        VIR_FREE(def->ifname);
+
+    if (src->coalesce) {
+        def->coalesce = g_new0(virNetDevCoalesce, 1);
+        *def->coalesce = *src->coalesce;
+    }
+
+    if (virNetDevVPortProfileCopy(&def->virtPortProfile, src->virtPortProfile) < 0 ||
+        virNetDevBandwidthCopy(&def->bandwidth, src->bandwidth) < 0 ||
+        virNetDevVlanCopy(&def->vlan, &src->vlan) < 0) {
+        virDomainNetDefFree(def);
+        return NULL;
+    }
+
+    return def;
+}
+
+
+static virDomainInputDefPtr
+virDomainInputDefDeepCopy(const virDomainInputDef *src,
+                          virDomainXMLOptionPtr xmlopt)
+{
+    virDomainInputDefPtr def = g_new0(virDomainInputDef, 1);
+
+    *def = *src;
+    def->source.evdev = g_strdup(src->source.evdev);
+    def->virtio = virDomainVirtioOptionsCopy(src->virtio);
+    virDomainDeviceInfoCopyInactive(&def->info, &src->info, xmlopt);
+
+    return def;
+}
+
+
+static virDomainVideoDefPtr
+virDomainVideoDefDeepCopy(const virDomainVideoDef *src,
+                          virDomainXMLOptionPtr xmlopt)
+{
+    virDomainVideoDefPtr def;
+    virObjectPtr privateData;
+
+    if (!(def = virDomainVideoDefNew(xmlopt)))
+        return NULL;
+
+    privateData = def->privateData;
+
+    *def = *src;
+    def->privateData = privateData;
+    def->accel = NULL;
+    def->res = NULL;
+    def->driver = NULL;
+    def->virtio = virDomainVirtioOptionsCopy(src->virtio);
+    virDomainDeviceInfoCopyInactive(&def->info, &src->info, xmlopt);
+
+    if (src->accel) {
+        def->accel = g_new0(virDomainVideoAccelDef, 1);
+        *def->accel = *src->accel;
+        def->accel->rendernode = g_strdup(src->accel->rendernode);
+    }
+
+    if (src->res) {
+        def->res = g_new0(virDomainVideoResolutionDef, 1);
+        *def->res = *src->res;
+    }
+
+    if (src->driver) {
+        def->driver = g_new0(virDomainVideoDriverDef, 1);
+        *def->driver = *src->driver;
+        def->driver->vhost_user_binary = g_strdup(src->driver->vhost_user_binary);
+    }
+
+    return def;
+}
+
+
+static virDomainMemballoonDefPtr
+virDomainMemballoonDefDeepCopy(const virDomainMemballoonDef *src,
+                               virDomainXMLOptionPtr xmlopt)
+{
+    virDomainMemballoonDefPtr def = g_new0(virDomainMemballoonDef, 1);
+
+    *def = *src;
+    def->virtio = virDomainVirtioOptionsCopy(src->virtio);
+    virDomainDeviceInfoCopyInactive(&def->info, &src->info, xmlopt);
+
+    return def;
+}
+
+
+static virDomainLoaderDefPtr
+virDomainLoaderDefCopy(const virDomainLoaderDef *src)
+{
+    virDomainLoaderDefPtr def;
+
+    if (!src)
+        return NULL;
+
+    def = g_new0(virDomainLoaderDef, 1);
+    *def = *src;
+    def->path = g_strdup(src->path);
+    def->nvram = g_strdup(src->nvram);
+    def->templt = g_strdup(src->templt);
+
+    return def;
+}
+
+
+static int
+virDomainOSDefCopy(virDomainOSDefPtr dst,
+                   const virDomainOSDef *src)
+{
+    size_t n = 0;
+    size_t i;
+
+    *dst = *src;
+    dst->machine = g_strdup(src->machine);
+    dst->init = g_strdup(src->init);
+    dst->initargv = g_strdupv(src->initargv);
+    dst->initenv = NULL;
+    dst->initdir = g_strdup(src->initdir);
+    dst->inituser = g_strdup(src->inituser);
+    dst->initgroup = g_strdup(src->initgroup);
+    dst->kernel = g_strdup(src->kernel);
+    dst->initrd = g_strdup(src->initrd);
+    dst->cmdline = g_strdup(src->cmdline);
+    dst->dtb = g_strdup(src->dtb);
+    dst->root = g_strdup(src->root);
+    dst->slic_table = g_strdup(src->slic_table);
+    dst->loader = virDomainLoaderDefCopy(src->loader);
+    dst->bootloader = g_strdup(src->bootloader);
+    dst->bootloaderArgs = g_strdup(src->bootloaderArgs);
+
+    if (src->initenv) {
+        while (src->initenv[n])
+            n++;
+
+        if (VIR_ALLOC_N(dst->initenv, n + 1) < 0)
+            return -1;
+
+        for (i = 0; i < n; i++) {
+            dst->initenv[i] = g_new0(virDomainOSEnv, 1);
+            dst->initenv[i]->name = g_strdup(src->initenv[i]->name);
+            dst->initenv[i]->value = g_strdup(src->initenv[i]->value);
+        }
+    }
+
+    return 0;
+}
+
+
+static void
+virDomainClockDefCopy(virDomainClockDefPtr dst,
+                      const virDomainClockDef *src)
+{
+    size_t i;
+
+    *dst = *src;
+    dst->ntimers = 0;
+    dst->timers = NULL;
+
+    if (src->offset == VIR_DOMAIN_CLOCK_OFFSET_TIMEZONE)
+        dst->data.timezone = g_strdup(src->data.timezone);
+
+    /* The start time adjustment is a private live value */
+    if (src->offset == VIR_DOMAIN_CLOCK_OFFSET_VARIABLE)
+        dst->data.variable.adjustment0 = 0;
+
+    if (src->ntimers) {
+        dst->timers = g_new0(virDomainTimerDefPtr, src->ntimers);
+        for (i = 0; i < src->ntimers; i++) {
+            dst->timers[i] = g_new0(virDomainTimerDef, 1);
+            *dst->timers[i] = *src->timers[i];
+        }
+        dst->ntimers = src->ntimers;
+    }
+}
+
+
+/*
+ * Tells whether @src only uses the parts of the definition
+ * virDomainDefDeepCopy knows how to copy. @empty is a freshly
+ * allocated definition holding the defaults of the rest. Members added
+ * to virDomainDef have to be either copied or rejected here.
+ */
+static bool
+virDomainDefDeepCopySupported(const virDomainDef *src,
+                              const virDomainDef *empty)
+{
+    size_t i;
+
+    if (src->postParseFailed)
+        return false;
+
+    if (virDomainNumaGetNodeCount(src->numa) > 0 ||
+        !virDomainNumaEquals(src->numa, empty->numa))
+        return false;
+
+    for (i = 0; i < src->nnets; i++) {
+        if (!virDomainNetDefDeepCopySupported(src->nets[i]))
+            return false;
+    }
+
+    if (src->blkio.weight != empty->blkio.weight ||
+        src->blkio.ndevices ||
+        src->niothreadids ||
+        src->nresctrls ||
+        src->idmap.nuidmap ||
+        src->idmap.ngidmap)
+        return false;
+
+    if (src->ngraphics ||
+        src->nfss ||
+        src->nsounds ||
+        src->nhostdevs ||
+        src->nredirdevs ||
+        src->nsmartcards ||
+        src->nserials ||
+        src->nparallels ||
+        src->nchannels ||
+        src->nconsoles ||
+        src->nleases ||
+        src->nhubs ||
+        src->nseclabels ||
+        src->nrngs ||
+        src->nshmems ||
+        src->nmems ||
+        src->npanics)
+        return false;
+
+    if (src->watchdog ||
+        src->nvram ||
+        src->tpm ||
+        src->sysinfo ||
+        src->redirfilter ||
+        src->iommu ||
+        src->vsock ||
+        src->namespaceData ||
+        src->keywrap ||
+        src->sev)
+        return false;
+
+    return true;
+}
+
+
+/**
+ * virDomainDefDeepCopy:
+ * @src: definition to copy
+ * @xmlopt: XML parser configuration
+ * @dst: filled with the copy
+ *
+ * Copy @src without going through XML. If @src uses parts of the
+ * definition the structural copy does not support, *@dst is set to NULL
+ * and the caller has to fall back to formatting and parsing it.
+ *
+ * Returns 0 on success (even if @src is unsupported), -1 on error.
+ */
+int
+virDomainDefDeepCopy(const virDomainDef *src,
+                     virDomainXMLOptionPtr xmlopt,
+                     virDomainDefPtr *dst)
+{
+    virDomainDefPtr def;
+    size_t i;
+
+    *dst = NULL;
+
+    if (!(def = virDomainDefNew()))
+        return -1;
+
+    if (!virDomainDefDeepCopySupported(src, def)) {
+        virDomainDefFree(def);
+        return 0;
+    }
+
+    def->virtType = src->virtType;
+    /* Not kept by the inactive parser */
+    def->id = -1;
+    memcpy(def->uuid, src->uuid, VIR_UUID_BUFLEN);
+    memcpy(def->genid, src->genid, VIR_UUID_BUFLEN);
+    def->genidRequested = src->genidRequested;
+    def->name = g_strdup(src->name);
+    def->title = g_strdup(src->title);
+    def->description = g_strdup(src->description);
+
+    def->mem = src->mem;
+    def->mem.hugepages = NULL;
+    def->mem.nhugepages = 0;
+    if (src->mem.nhugepages) {
+        def->mem.hugepages = g_new0(virDomainHugePage, src->mem.nhugepages);
+        for (i = 0; i < src->mem.nhugepages; i++) {
+            def->mem.hugepages[i].size = src->mem.hugepages[i].size;
+            if (src->mem.hugepages[i].nodemask &&
+                !(def->mem.hugepages[i].nodemask =
+                  virBitmapNewCopy(src->mem.hugepages[i].nodemask)))
+                goto error;
+            def->mem.nhugepages++;
+        }
+    }
+
+    if (virDomainDefSetVcpusMax(def, src->maxvcpus, xmlopt) < 0)
+        goto error;
+
+    for (i = 0; i < src->maxvcpus; i++) {
+        virDomainVcpuDefPtr vcpu = def->vcpus[i];
+        virDomainVcpuDefPtr srcvcpu = src->vcpus[i];
+
+        vcpu->online = srcvcpu->online;
+        vcpu->hotpluggable = srcvcpu->hotpluggable;
+        vcpu->order = srcvcpu->order;
+        vcpu->sched = srcvcpu->sched;
+        if (srcvcpu->cpumask &&
+            !(vcpu->cpumask = virBitmapNewCopy(srcvcpu->cpumask)))
+            goto error;
+    }
+
+    def->individualvcpus = src->individualvcpus;
+    def->placement_mode = src->placement_mode;
+    if (src->cpumask &&
+        !(def->cpumask = virBitmapNewCopy(src->cpumask)))
+        goto error;
+
+    def->cputune = src->cputune;
+    def->cputune.emulatorpin = NULL;
+    def->cputune.emulatorsched = NULL;
+    if (src->cputune.emulatorpin &&
+        !(def->cputune.emulatorpin = virBitmapNewCopy(src->cputune.emulatorpin)))
+        goto error;
+    if (src->cputune.emulatorsched) {
+        def->cputune.emulatorsched = g_new0(virDomainThreadSchedParam, 1);
+        *def->cputune.emulatorsched = *src->cputune.emulatorsched;
+    }
+
+    if (src->resource) {
+        def->resource = g_new0(virDomainResourceDef, 1);
+        def->resource->partition = g_strdup(src->resource->partition);
+    }
+
+    def->onReboot = src->onReboot;
+    def->onPoweroff = src->onPoweroff;
+    def->onCrash = src->onCrash;
+    def->onLockFailure = src->onLockFailure;
+    def->pm = src->pm;
+    def->perf = src->perf;
+
+    if (virDomainOSDefCopy(&def->os, &src->os) < 0)
+        goto error;
+
+    def->emulator = g_strdup(src->emulator);
+
+    memcpy(def->features, src->features, sizeof(def->features));
+    memcpy(def->caps_features, src->caps_features, sizeof(def->caps_features));
+    memcpy(def->hyperv_features, src->hyperv_features, sizeof(def->hyperv_features));
+    memcpy(def->kvm_features, src->kvm_features, sizeof(def->kvm_features));
+    memcpy(def->msrs_features, src->msrs_features, sizeof(def->msrs_features));
+    def->hyperv_spinlocks = src->hyperv_spinlocks;
+    def->hyperv_stimer_direct = src->hyperv_stimer_direct;
+    def->gic_version = src->gic_version;
+    def->hpt_resizing = src->hpt_resizing;
+    def->hpt_maxpagesize = src->hpt_maxpagesize;
+    def->hyperv_vendor_id = g_strdup(src->hyperv_vendor_id);
+    def->apic_eoi = src->apic_eoi;
+    def->tseg_specified = src->tseg_specified;
+    def->tseg_size = src->tseg_size;
+
+    virDomainClockDefCopy(&def->clock, &src->clock);
+
+    if (src->ndisks)
+        def->disks = g_new0(virDomainDiskDefPtr, src->ndisks);
+    for (i = 0; i < src->ndisks; i++) {
+        if (!(def->disks[i] = virDomainDiskDefDeepCopy(src->disks[i], xmlopt)))
+            goto error;
+        def->ndisks++;
+    }
+
+    if (src->ncontrollers)
+        def->controllers = g_new0(virDomainControllerDefPtr, src->ncontrollers);
+    for (i = 0; i < src->ncontrollers; i++) {
+        def->controllers[i] = virDomainControllerDefDeepCopy(src->controllers[i],
+                                                             xmlopt);
+        def->ncontrollers++;
+    }
+
+    if (src->nnets)
+        def->nets = g_new0(virDomainNetDefPtr, src->nnets);
+    for (i = 0; i < src->nnets; i++) {
+        if (!(def->nets[i] = virDomainNetDefDeepCopy(src->nets[i], xmlopt)))
+            goto error;
+        def->nnets++;
+    }
+
+    if (src->ninputs)
+        def->inputs = g_new0(virDomainInputDefPtr, src->ninputs);
+    for (i = 0; i < src->ninputs; i++) {
+        def->inputs[i] = virDomainInputDefDeepCopy(src->inputs[i], xmlopt);
+        def->ninputs++;
+    }
+
+    if (src->nvideos)
+        def->videos = g_new0(virDomainVideoDefPtr, src->nvideos);
+    for (i = 0; i < src->nvideos; i++) {
+        if (!(def->videos[i] = virDomainVideoDefDeepCopy(src->videos[i], xmlopt)))
+            goto error;
+        def->nvideos++;
+    }
+
+    if (src->memballoon)
+        def->memballoon = virDomainMemballoonDefDeepCopy(src->memballoon, xmlopt);
+
+    if (src->cpu &&
+        !(def->cpu = virCPUDefCopy(src->cpu)))
+        goto error;
+
+    def->ns = src->ns;
+
+    if (src->metadata &&
+        !(def->metadata = xmlCopyNode(src->metadata, 1))) {
+        virReportOOMError();
+        goto error;
+    }
+
+    *dst = def;
+    return 0;
+
+ error:
+    virDomainDefFree(def);
+    return -1;
+}
+
+
 /* Copy src into a new definition; with the quality of the copy
  * depending on the migratable flag (false for transitions between
  * persistent and active, true for transitions across save files or
@@ -30018,10 +30774,19 @@ virDomainDefCopy(virDomainDefPtr src,
                                VIR_DOMAIN_DEF_PARSE_SKIP_VALIDATE;
     g_autofree char *xml = NULL;
 
-    if (migratable)
+    if (migratable) {
         format_flags |= VIR_DOMAIN_DEF_FORMAT_INACTIVE | VIR_DOMAIN_DEF_FORMAT_MIGRATABLE;
+    } else {
+        virDomainDefPtr ret;
 
-    /* Easiest to clone via a round-trip through XML.  */
+        if (virDomainDefDeepCopy(src, xmlopt, &ret) < 0)
+            return NULL;
+
+        if (ret)
+            return ret;
+    }
+
+    /* Otherwise clone via a round-trip through XML.  */
     if (!(xml = virDomainDefFormat(src, xmlopt, format_flags)))
         return NULL;
 
@@ -30091,6 +30856,115 @@ virDomainObjSetState(virDomainObjPtr dom, virDomainState state, int reason)
         dom->state.reason = reason;
     else
         dom->state.reason = 0;
+
+    virDomainObjSummaryUpdate(dom);
+}
+
+
+/**
+ * virDomainObjSetID:
+ * @dom: locked domain object
+ * @id: new domain ID, -1 for an inactive domain
+ *
+ * Sets the ID of the current definition of @dom and publishes it in
+ * the lockless summary.
+ */
+void
+virDomainObjSetID(virDomainObjPtr dom, int id)
+{
+    dom->def->id = id;
+    virDomainObjSummaryUpdate(dom);
+}
+
+
+void
+virDomainObjSetPersistent(virDomainObjPtr dom, bool persistent)
+{
+    dom->persistent = persistent;
+    virDomainObjSummaryUpdate(dom);
+}
+
+
+void
+virDomainObjSetAutostart(virDomainObjPtr dom, bool autostart)
+{
+    dom->autostart = autostart;
+    virDomainObjSummaryUpdate(dom);
+}
+
+
+void
+virDomainObjSetManagedSave(virDomainObjPtr dom, bool hasManagedSave)
+{
+    dom->hasManagedSave = hasManagedSave;
+    virDomainObjSummaryUpdate(dom);
+}
+
+
+/**
+ * virDomainObjSummaryUpdate:
+ * @dom: locked domain object
+ *
+ * Refresh the lockless summary of @dom from its current state. Drivers
+ * don't need to call this, the summary is published by
+ * virDomainObjSetState, virDomainObjSetID, the setters of the
+ * persistent, autostart and managed save flags and the functions
+ * replacing the definition of @dom. Since each change is published
+ * right away, the summary is current even while the object lock is
+ * dropped in the middle of an API, e.g. for a monitor call.
+ */
+void
+virDomainObjSummaryUpdate(virDomainObjPtr dom)
+{
+    virDomainObjSummaryPtr summary = &dom->summary;
+    unsigned int seq = summary->seq;
+    unsigned int flags = 0;
+
+    if (dom->persistent)
+        flags |= VIR_DOMAIN_OBJ_SUMMARY_PERSISTENT;
+    if (dom->autostart)
+        flags |= VIR_DOMAIN_OBJ_SUMMARY_AUTOSTART;
+    if (dom->hasManagedSave)
+        flags |= VIR_DOMAIN_OBJ_SUMMARY_MANAGEDSAVE;
+    if (dom->removing)
+        flags |= VIR_DOMAIN_OBJ_SUMMARY_REMOVING;
+
+    g_atomic_int_set(&summary->seq, seq + 1);
+    g_atomic_int_set(&summary->id, dom->def ? dom->def->id : -1);
+    g_atomic_int_set(&summary->state, dom->state.state);
+    g_atomic_int_set(&summary->reason, dom->state.reason);
+    g_atomic_int_set(&summary->flags, flags);
+    if (dom->def)
+        memcpy(summary->uuid, dom->def->uuid, VIR_UUID_BUFLEN);
+    g_atomic_int_set(&summary->seq, seq + 2);
+}
+
+
+/**
+ * virDomainObjSummaryGet:
+ * @dom: domain object, does not need to be locked
+ * @summary: filled with a consistent copy of the summary
+ *
+ * Reads the lockless summary of @dom, retrying if it is being
+ * updated concurrently. The caller must hold a reference on @dom.
+ */
+void
+virDomainObjSummaryGet(virDomainObjPtr dom,
+                       virDomainObjSummaryPtr summary)
+{
+    unsigned int seq;
+
+    do {
+        while ((seq = g_atomic_int_get(&dom->summary.seq)) & 1)
+            g_thread_yield();
+
+        summary->seq = seq;
+        summary->id = g_atomic_int_get(&dom->summary.id);
+        summary->state = g_atomic_int_get(&dom->summary.state);
+        summary->reason = g_atomic_int_get(&dom->summary.reason);
+        summary->flags = g_atomic_int_get(&dom->summary.flags);
+        memcpy(summary->uuid, dom->summary.uuid, VIR_UUID_BUFLEN);
+    } while (g_atomic_int_get(&dom->summary.seq) != seq);
 }
 
 
@@ -2409,6 +2409,15 @@ struct _virDomainVirtioOptions {
  * NB: if adding to this struct, virDomainDefCheckABIStability
  * may well need an update
  */
+#define VIR_DOMAIN_DEF_XML_CACHE_SIZE 4
+
+typedef struct _virDomainDefXMLCacheEntry virDomainDefXMLCacheEntry;
+struct _virDomainDefXMLCacheEntry {
+    unsigned long long generation;
+    unsigned int flags;
+    char *xml;
+};
+
 struct _virDomainDef {
     int virtType; /* enum virDomainVirtType */
     int id;
@@ -2571,6 +2580,11 @@ struct _virDomainDef {
                              callbacks failed for a non-critical reason
                              (was not able to fill in some data) and thus
                              should be re-run before starting */
+
+    /* Bumped by virDomainDefBumpGeneration whenever the definition is
+     * modified, invalidating data cached for it such as @xmlcache */
+    unsigned long long generation;
+    virDomainDefXMLCacheEntry xmlcache[VIR_DOMAIN_DEF_XML_CACHE_SIZE];
 };
 
 
@@ -2610,6 +2624,30 @@ struct _virDomainStateReason {
     int reason;
 };
 
+typedef enum {
+    VIR_DOMAIN_OBJ_SUMMARY_PERSISTENT = (1 << 0),
+    VIR_DOMAIN_OBJ_SUMMARY_AUTOSTART = (1 << 1),
+    VIR_DOMAIN_OBJ_SUMMARY_MANAGEDSAVE = (1 << 2),
+    VIR_DOMAIN_OBJ_SUMMARY_REMOVING = (1 << 3),
+} virDomainObjSummaryFlags;
+
+/* Copy of the commonly listed parts of a domain object which can be
+ * read without taking the object lock. Writers hold the object lock
+ * and bump @seq before and after the update, readers retry whenever
+ * @seq is odd or changed while they were reading. The fields it is
+ * made of must only be changed through the virDomainObjSet* helpers,
+ * which publish the change. */
+typedef struct _virDomainObjSummary virDomainObjSummary;
+typedef virDomainObjSummary *virDomainObjSummaryPtr;
+struct _virDomainObjSummary {
+    unsigned int seq;
+    int id;
+    int state;
+    int reason;
+    unsigned int flags; /* virDomainObjSummaryFlags */
+    unsigned char uuid[VIR_UUID_BUFLEN];
+};
+
 struct _virDomainObj {
     virObjectLockable parent;
     virCond cond;
@@ -2638,6 +2676,8 @@ struct _virDomainObj {
 
     unsigned long long original_memlock; /* Original RLIMIT_MEMLOCK, zero if no
                                           * restore will be required later */
+
+    virDomainObjSummary summary; /* Lockless view used by domain listing */
 };
 
 G_DEFINE_AUTOPTR_CLEANUP_FUNC(virDomainObj, virObjectUnref);
@@ -3002,6 +3042,10 @@ virDomainDefPtr virDomainObjGetOneDefState(virDomainObjPtr vm,
                                            bool *state);
 virDomainDefPtr virDomainObjGetOneDef(virDomainObjPtr vm, unsigned int flags);
 
+int virDomainDefDeepCopy(const virDomainDef *src,
+                         virDomainXMLOptionPtr xmlopt,
+                         virDomainDefPtr *dst)
+    ATTRIBUTE_NONNULL(1) ATTRIBUTE_NONNULL(2) ATTRIBUTE_NONNULL(3);
 virDomainDefPtr virDomainDefCopy(virDomainDefPtr src,
                                  virDomainXMLOptionPtr xmlopt,
                                  void *parseOpaque,
@@ -3326,6 +3370,13 @@ ssize_t virDomainRedirdevDefFind(virDomainDefPtr def,
                                  virDomainRedirdevDefPtr redirdev);
 virDomainRedirdevDefPtr virDomainRedirdevDefRemove(virDomainDefPtr def, size_t idx);
 
+void virDomainDefBumpGeneration(virDomainDefPtr def);
+const char *virDomainDefXMLCacheLookup(virDomainDefPtr def,
+                                       unsigned int flags);
+void virDomainDefXMLCacheStore(virDomainDefPtr def,
+                               unsigned int flags,
+                               const char *xml);
+
 int virDomainDefSave(virDomainDefPtr def,
                      virDomainXMLOptionPtr xmlopt,
                      const char *configDir)
@@ -3397,6 +3448,27 @@ virDomainState
 virDomainObjGetState(virDomainObjPtr obj, int *reason)
         ATTRIBUTE_NONNULL(1);
 
+void
+virDomainObjSetID(virDomainObjPtr obj, int id)
+        ATTRIBUTE_NONNULL(1);
+void
+virDomainObjSetPersistent(virDomainObjPtr obj, bool persistent)
+        ATTRIBUTE_NONNULL(1);
+void
+virDomainObjSetAutostart(virDomainObjPtr obj, bool autostart)
+        ATTRIBUTE_NONNULL(1);
+void
+virDomainObjSetManagedSave(virDomainObjPtr obj, bool hasManagedSave)
+        ATTRIBUTE_NONNULL(1);
+
+void
+virDomainObjSummaryUpdate(virDomainObjPtr obj)
+        ATTRIBUTE_NONNULL(1);
+void
+virDomainObjSummaryGet(virDomainObjPtr obj,
+                       virDomainObjSummaryPtr summary)
+        ATTRIBUTE_NONNULL(1) ATTRIBUTE_NONNULL(2);
+
 virSecurityLabelDefPtr
 virDomainDefGetSecurityLabelDef(virDomainDefPtr def, const char *model);
 
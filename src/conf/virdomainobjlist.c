@@ -31,6 +31,8 @@
 #include "virfile.h"
 #include "virlog.h"
 #include "virstring.h"
+#include "viruuid.h"
+#include "virhashcode.h"
 #include "virdomainsnapshotobjlist.h"
 #include "virdomaincheckpointobjlist.h"
 
@@ -39,19 +41,42 @@
 VIR_LOG_INIT("conf.virdomainobjlist");
 
 static virClassPtr virDomainObjListClass;
+static virClassPtr virDomainObjListSnapshotClass;
 static void virDomainObjListDispose(void *obj);
+static void virDomainObjListSnapshotDispose(void *obj);
+
+
+/* Immutable, reference counted copy of the list membership.
+ * Readers that need to walk every domain take a reference on
+ * the currently published snapshot while holding the read lock
+ * only for as long as it takes to bump the refcount. Any change
+ * to the set of domains drops the published snapshot, the next
+ * reader then builds a new one. */
+typedef struct _virDomainObjListSnapshot virDomainObjListSnapshot;
+typedef virDomainObjListSnapshot *virDomainObjListSnapshotPtr;
+struct _virDomainObjListSnapshot {
+    virObject parent;
+
+    virDomainObjPtr *vms;
+    size_t nvms;
+};
 
 
 struct _virDomainObjList {
     virObjectRWLockable parent;
 
-    /* uuid string -> virDomainObj  mapping
+    /* binary uuid -> virDomainObj mapping
      * for O(1), lockless lookup-by-uuid */
     virHashTable *objs;
 
     /* name -> virDomainObj mapping for O(1),
      * lockless lookup-by-name */
     virHashTable *objsName;
+
+    /* Published snapshot of @objs, NULL if it needs rebuilding.
+     * Cleared with the write lock held, published atomically
+     * with the read lock held. */
+    virDomainObjListSnapshotPtr snapshot;
 };
 
 
@@ -60,11 +85,58 @@ static int virDomainObjListOnceInit(void)
     if (!VIR_CLASS_NEW(virDomainObjList, virClassForObjectRWLockable()))
         return -1;
 
+    if (!VIR_CLASS_NEW(virDomainObjListSnapshot, virClassForObject()))
+        return -1;
+
     return 0;
 }
 
 VIR_ONCE_GLOBAL_INIT(virDomainObjList);
 
+
+static uint32_t
+virDomainObjListUUIDKeyCode(const void *name,
+                            uint32_t seed)
+{
+    return virHashCodeGen(name, VIR_UUID_BUFLEN, seed);
+}
+
+
+static bool
+virDomainObjListUUIDKeyEqual(const void *namea,
+                             const void *nameb)
+{
+    return memcmp(namea, nameb, VIR_UUID_BUFLEN) == 0;
+}
+
+
+static void *
+virDomainObjListUUIDKeyCopy(const void *name)
+{
+    unsigned char *copy = g_new0(unsigned char, VIR_UUID_BUFLEN);
+
+    memcpy(copy, name, VIR_UUID_BUFLEN);
+    return copy;
+}
+
+
+static char *
+virDomainObjListUUIDKeyPrintHuman(const void *name)
+{
+    char *uuidstr = g_new0(char, VIR_UUID_STRING_BUFLEN);
+
+    virUUIDFormat(name, uuidstr);
+    return uuidstr;
+}
+
+
+static void
+virDomainObjListUUIDKeyFree(void *name)
+{
+    VIR_FREE(name);
+}
+
+
 virDomainObjListPtr virDomainObjListNew(void)
 {
     virDomainObjListPtr doms;
@@ -75,7 +147,12 @@ virDomainObjListPtr virDomainObjListNew(void)
     if (!(doms = virObjectRWLockableNew(virDomainObjListClass)))
         return NULL;
 
-    if (!(doms->objs = virHashCreate(50, virObjectFreeHashData)) ||
+    if (!(doms->objs = virHashCreateFull(50, virObjectFreeHashData,
+                                         virDomainObjListUUIDKeyCode,
+                                         virDomainObjListUUIDKeyEqual,
+                                         virDomainObjListUUIDKeyCopy,
+                                         virDomainObjListUUIDKeyPrintHuman,
+                                         virDomainObjListUUIDKeyFree)) ||
         !(doms->objsName = virHashCreate(50, virObjectFreeHashData))) {
         virObjectUnref(doms);
         return NULL;
@@ -89,11 +166,80 @@ static void virDomainObjListDispose(void *obj)
 {
     virDomainObjListPtr doms = obj;
 
+    virObjectUnref(doms->snapshot);
     virHashFree(doms->objs);
     virHashFree(doms->objsName);
 }
 
 
+static void virDomainObjListSnapshotDispose(void *obj)
+{
+    virDomainObjListSnapshotPtr snap = obj;
+
+    virObjectListFreeCount(snap->vms, snap->nvms);
+}
+
+
+static int
+virDomainObjListSnapshotIterator(void *payload,
+                                 const void *name G_GNUC_UNUSED,
+                                 void *opaque)
+{
+    virDomainObjListSnapshotPtr snap = opaque;
+
+    snap->vms[snap->nvms++] = virObjectRef(payload);
+    return 0;
+}
+
+
+/**
+ * virDomainObjListGetSnapshotLocked:
+ * @doms: Domain object list, locked for reading at least
+ *
+ * Returns a reference to the published snapshot of @doms, building
+ * and publishing a new one if there is none yet. Concurrent readers
+ * may race to publish; the loser simply drops its own copy.
+ *
+ * Returns a referenced snapshot or NULL on error.
+ */
+static virDomainObjListSnapshotPtr
+virDomainObjListGetSnapshotLocked(virDomainObjListPtr doms)
+{
+    virDomainObjListSnapshotPtr snap;
+
+    if ((snap = g_atomic_pointer_get(&doms->snapshot)))
+        return virObjectRef(snap);
+
+    if (!(snap = virObjectNew(virDomainObjListSnapshotClass)))
+        return NULL;
+
+    if (VIR_ALLOC_N(snap->vms, virHashSize(doms->objs)) < 0) {
+        virObjectUnref(snap);
+        return NULL;
+    }
+
+    virHashForEach(doms->objs, virDomainObjListSnapshotIterator, snap);
+
+    if (!g_atomic_pointer_compare_and_exchange(&doms->snapshot, NULL, snap)) {
+        virObjectUnref(snap);
+        snap = g_atomic_pointer_get(&doms->snapshot);
+    }
+
+    return virObjectRef(snap);
+}
+
+
+/* The caller must hold the write lock on @doms. */
+static void
+virDomainObjListInvalidateSnapshotLocked(virDomainObjListPtr doms)
+{
+    virDomainObjListSnapshotPtr snap = doms->snapshot;
+
+    g_atomic_pointer_set(&doms->snapshot, NULL);
+    virObjectUnref(snap);
+}
+
+
 static int virDomainObjListSearchID(const void *payload,
                                     const void *name G_GNUC_UNUSED,
                                     const void *data)
@@ -138,11 +284,9 @@ static virDomainObjPtr
 virDomainObjListFindByUUIDLocked(virDomainObjListPtr doms,
                                  const unsigned char *uuid)
 {
-    char uuidstr[VIR_UUID_STRING_BUFLEN];
     virDomainObjPtr obj;
 
-    virUUIDFormat(uuid, uuidstr);
-    obj = virHashLookup(doms->objs, uuidstr);
+    obj = virHashLookup(doms->objs, uuid);
     if (obj) {
         virObjectRef(obj);
         virObjectLock(obj);
@@ -158,6 +302,10 @@ virDomainObjListFindByUUIDLocked(virDomainObjListPtr doms,
  * Lookup the @uuid in the doms->objs hash table and return a
  * locked and ref counted domain object if found. Caller is
  * expected to use the virDomainObjEndAPI when done with the object.
+ *
+ * The list lock is only held while the object is looked up and
+ * referenced; the object itself is locked afterwards so that
+ * lookups never wait for a busy domain with the list lock held.
  */
 virDomainObjPtr
 virDomainObjListFindByUUID(virDomainObjListPtr doms,
@@ -166,10 +314,14 @@ virDomainObjListFindByUUID(virDomainObjListPtr doms,
     virDomainObjPtr obj;
 
     virObjectRWLockRead(doms);
-    obj = virDomainObjListFindByUUIDLocked(doms, uuid);
+    obj = virObjectRef(virHashLookup(doms->objs, uuid));
     virObjectRWUnlock(doms);
 
-    if (obj && obj->removing) {
+    if (!obj)
+        return NULL;
+
+    virObjectLock(obj);
+    if (obj->removing) {
         virObjectUnlock(obj);
         virObjectUnref(obj);
         obj = NULL;
@@ -201,6 +353,9 @@ virDomainObjListFindByNameLocked(virDomainObjListPtr doms,
  * Lookup the @name in the doms->objsName hash table and return a
  * locked and ref counted domain object if found. Caller is expected
  * to use the virDomainObjEndAPI when done with the object.
+ *
+ * As with virDomainObjListFindByUUID the object is locked only
+ * after the list lock has been released.
  */
 virDomainObjPtr
 virDomainObjListFindByName(virDomainObjListPtr doms,
@@ -209,10 +364,14 @@ virDomainObjListFindByName(virDomainObjListPtr doms,
     virDomainObjPtr obj;
 
     virObjectRWLockRead(doms);
-    obj = virDomainObjListFindByNameLocked(doms, name);
+    obj = virObjectRef(virHashLookup(doms->objsName, name));
     virObjectRWUnlock(doms);
 
-    if (obj && obj->removing) {
+    if (!obj)
+        return NULL;
+
+    virObjectLock(obj);
+    if (obj->removing) {
         virObjectUnlock(obj);
         virObjectUnref(obj);
         obj = NULL;
@@ -242,19 +401,21 @@ static int
 virDomainObjListAddObjLocked(virDomainObjListPtr doms,
                              virDomainObjPtr vm)
 {
-    char uuidstr[VIR_UUID_STRING_BUFLEN];
+    /* Lockless readers find the object as soon as it is hashed */
+    virDomainObjSummaryUpdate(vm);
 
-    virUUIDFormat(vm->def->uuid, uuidstr);
-    if (virHashAddEntry(doms->objs, uuidstr, vm) < 0)
+    if (virHashAddEntry(doms->objs, vm->def->uuid, vm) < 0)
         return -1;
     virObjectRef(vm);
 
     if (virHashAddEntry(doms->objsName, vm->def->name, vm) < 0) {
-        virHashRemoveEntry(doms->objs, uuidstr);
+        virHashRemoveEntry(doms->objs, vm->def->uuid);
         return -1;
     }
     virObjectRef(vm);
 
+    virDomainObjListInvalidateSnapshotLocked(doms);
+
     return 0;
 }
 
@@ -376,11 +537,9 @@ void
 virDomainObjListRemoveLocked(virDomainObjListPtr doms,
                              virDomainObjPtr dom)
 {
-    char uuidstr[VIR_UUID_STRING_BUFLEN];
-
-    virUUIDFormat(dom->def->uuid, uuidstr);
+    virDomainObjListInvalidateSnapshotLocked(doms);
 
-    virHashRemoveEntry(doms->objs, uuidstr);
+    virHashRemoveEntry(doms->objs, dom->def->uuid);
     virHashRemoveEntry(doms->objsName, dom->def->name);
 }
 
@@ -403,6 +562,7 @@ virDomainObjListRemove(virDomainObjListPtr doms,
                        virDomainObjPtr dom)
 {
     dom->removing = true;
+    virDomainObjSummaryUpdate(dom);
     virObjectRef(dom);
     virObjectUnlock(dom);
     virObjectRWLockWrite(doms);
@@ -513,7 +673,7 @@ virDomainObjListLoadConfig(virDomainObjListPtr doms,
     if (!(dom = virDomainObjListAddLocked(doms, def, xmlopt, 0, &oldDef)))
         goto error;
 
-    dom->autostart = autostart;
+    virDomainObjSetAutostart(dom, autostart);
 
     if (notify)
         (*notify)(dom, oldDef == NULL, opaque);
@@ -541,7 +701,6 @@ virDomainObjListLoadStatus(virDomainObjListPtr doms,
 {
     char *statusFile = NULL;
     virDomainObjPtr obj = NULL;
-    char uuidstr[VIR_UUID_STRING_BUFLEN];
 
     if ((statusFile = virDomainConfigFile(statusDir, name)) == NULL)
         goto error;
@@ -554,9 +713,7 @@ virDomainObjListLoadStatus(virDomainObjListPtr doms,
                                       VIR_DOMAIN_DEF_PARSE_ALLOW_POST_PARSE_FAIL)))
         goto error;
 
-    virUUIDFormat(obj->def->uuid, uuidstr);
-
-    if (virHashLookup(doms->objs, uuidstr) != NULL) {
+    if (virHashLookup(doms->objs, obj->def->uuid) != NULL) {
         virReportError(VIR_ERR_INTERNAL_ERROR,
                        _("unexpected domain %s already exists"),
                        obj->def->name);
@@ -626,7 +783,7 @@ virDomainObjListLoadAllConfigs(virDomainObjListPtr doms,
                                              opaque);
         if (dom) {
             if (!liveStatus)
-                dom->persistent = 1;
+                virDomainObjSetPersistent(dom, true);
             virDomainObjEndAPI(&dom);
         } else {
             VIR_ERROR(_("Failed to load config for domain '%s'"), entry->d_name);
@@ -639,9 +796,35 @@ virDomainObjListLoadAllConfigs(virDomainObjListPtr doms,
 }
 
 
-struct virDomainObjListData {
+/* ACL filters may look at any part of the definition, so unlike the
+ * rest of the lockless listing they're run on the real definition with
+ * the domain object locked. The object lock is only held for the
+ * duration of the check, which doesn't wait for any job to finish. */
+struct virDomainObjListACLData {
     virDomainObjListACLFilter filter;
     virConnectPtr conn;
+};
+
+
+static bool
+virDomainObjListACLCheck(struct virDomainObjListACLData *acl,
+                         virDomainObjPtr obj)
+{
+    bool ret;
+
+    if (!acl->filter)
+        return true;
+
+    virObjectLock(obj);
+    ret = acl->filter(acl->conn, obj->def);
+    virObjectUnlock(obj);
+
+    return ret;
+}
+
+
+struct virDomainObjListData {
+    struct virDomainObjListACLData acl;
     bool active;
     int count;
 };
@@ -654,19 +837,18 @@ virDomainObjListCount(void *payload,
 {
     virDomainObjPtr obj = payload;
     struct virDomainObjListData *data = opaque;
-    virObjectLock(obj);
-    if (data->filter &&
-        !data->filter(data->conn, obj->def))
-        goto cleanup;
-    if (virDomainObjIsActive(obj)) {
+    virDomainObjSummary summary;
+
+    virDomainObjSummaryGet(obj, &summary);
+    if (!virDomainObjListACLCheck(&data->acl, obj))
+        return 0;
+    if (summary.id != -1) {
         if (data->active)
             data->count++;
     } else {
         if (!data->active)
             data->count++;
     }
- cleanup:
-    virObjectUnlock(obj);
     return 0;
 }
 
@@ -677,17 +859,20 @@ virDomainObjListNumOfDomains(virDomainObjListPtr doms,
                              virDomainObjListACLFilter filter,
                              virConnectPtr conn)
 {
-    struct virDomainObjListData data = { filter, conn, active, 0 };
+    struct virDomainObjListData data = {
+        .acl = { filter, conn },
+        .active = active,
+    };
+
     virObjectRWLockRead(doms);
-    virHashForEach(doms->objs, virDomainObjListCount, &data);
+    virHashForEach(doms->objsName, virDomainObjListCount, &data);
     virObjectRWUnlock(doms);
     return data.count;
 }
 
 
 struct virDomainIDData {
-    virDomainObjListACLFilter filter;
-    virConnectPtr conn;
+    struct virDomainObjListACLData acl;
     int numids;
     int maxids;
     int *ids;
@@ -701,14 +886,13 @@ virDomainObjListCopyActiveIDs(void *payload,
 {
     virDomainObjPtr obj = payload;
     struct virDomainIDData *data = opaque;
-    virObjectLock(obj);
-    if (data->filter &&
-        !data->filter(data->conn, obj->def))
-        goto cleanup;
-    if (virDomainObjIsActive(obj) && data->numids < data->maxids)
-        data->ids[data->numids++] = obj->def->id;
- cleanup:
-    virObjectUnlock(obj);
+    virDomainObjSummary summary;
+
+    virDomainObjSummaryGet(obj, &summary);
+    if (!virDomainObjListACLCheck(&data->acl, obj))
+        return 0;
+    if (summary.id != -1 && data->numids < data->maxids)
+        data->ids[data->numids++] = summary.id;
     return 0;
 }
 
@@ -720,19 +904,21 @@ virDomainObjListGetActiveIDs(virDomainObjListPtr doms,
                              virDomainObjListACLFilter filter,
                              virConnectPtr conn)
 {
-    struct virDomainIDData data = { filter, conn,
-                                    0, maxids, ids };
+    struct virDomainIDData data = {
+        .acl = { filter, conn },
+        .maxids = maxids,
+        .ids = ids,
+    };
+
     virObjectRWLockRead(doms);
-    virHashForEach(doms->objs, virDomainObjListCopyActiveIDs, &data);
+    virHashForEach(doms->objsName, virDomainObjListCopyActiveIDs, &data);
     virObjectRWUnlock(doms);
     return data.numids;
 }
 
 
 struct virDomainNameData {
-    virDomainObjListACLFilter filter;
-    virConnectPtr conn;
-    int oom;
+    struct virDomainObjListACLData acl;
     int numnames;
     int maxnames;
     char **const names;
@@ -741,26 +927,20 @@ struct virDomainNameData {
 
 static int
 virDomainObjListCopyInactiveNames(void *payload,
-                                  const void *name G_GNUC_UNUSED,
+                                  const void *name,
                                   void *opaque)
 {
     virDomainObjPtr obj = payload;
     struct virDomainNameData *data = opaque;
+    virDomainObjSummary summary;
 
-    if (data->oom)
+    virDomainObjSummaryGet(obj, &summary);
+    if (!virDomainObjListACLCheck(&data->acl, obj))
         return 0;
-
-    virObjectLock(obj);
-    if (data->filter &&
-        !data->filter(data->conn, obj->def))
-        goto cleanup;
-    if (!virDomainObjIsActive(obj) && data->numnames < data->maxnames) {
-        data->names[data->numnames] = g_strdup(obj->def->name);
+    if (summary.id == -1 && data->numnames < data->maxnames) {
+        data->names[data->numnames] = g_strdup(name);
         data->numnames++;
     }
-
- cleanup:
-    virObjectUnlock(obj);
     return 0;
 }
 
@@ -772,18 +952,15 @@ virDomainObjListGetInactiveNames(virDomainObjListPtr doms,
                                  virDomainObjListACLFilter filter,
                                  virConnectPtr conn)
 {
-    struct virDomainNameData data = { filter, conn,
-                                      0, 0, maxnames, names };
-    size_t i;
+    struct virDomainNameData data = {
+        .acl = { filter, conn },
+        .maxnames = maxnames,
+        .names = names,
+    };
+
     virObjectRWLockRead(doms);
-    virHashForEach(doms->objs, virDomainObjListCopyInactiveNames, &data);
+    virHashForEach(doms->objsName, virDomainObjListCopyInactiveNames, &data);
     virObjectRWUnlock(doms);
-    if (data.oom) {
-        for (i = 0; i < data.numnames; i++)
-            VIR_FREE(data.names[i]);
-        return -1;
-    }
-
     return data.numnames;
 }
 
@@ -844,30 +1021,36 @@ virDomainObjListForEach(virDomainObjListPtr doms,
 }
 
 
+/* Filters which need the domain object to be locked */
+#define VIR_DOMAIN_OBJ_LIST_FILTERS_LOCKED \
+    (VIR_CONNECT_LIST_DOMAINS_FILTERS_SNAPSHOT | \
+     VIR_CONNECT_LIST_DOMAINS_FILTERS_CHECKPOINT)
+
 #define MATCH(FLAG) (filter & (FLAG))
 static bool
-virDomainObjMatchFilter(virDomainObjPtr vm,
-                        unsigned int filter)
+virDomainObjSummaryMatchFilter(virDomainObjSummaryPtr summary,
+                               unsigned int filter)
 {
+    bool active = summary->id != -1;
+    bool persistent = !!(summary->flags & VIR_DOMAIN_OBJ_SUMMARY_PERSISTENT);
+    bool autostart = !!(summary->flags & VIR_DOMAIN_OBJ_SUMMARY_AUTOSTART);
+    bool managedsave = !!(summary->flags & VIR_DOMAIN_OBJ_SUMMARY_MANAGEDSAVE);
+
     /* filter by active state */
     if (MATCH(VIR_CONNECT_LIST_DOMAINS_FILTERS_ACTIVE) &&
-        !((MATCH(VIR_CONNECT_LIST_DOMAINS_ACTIVE) &&
-           virDomainObjIsActive(vm)) ||
-          (MATCH(VIR_CONNECT_LIST_DOMAINS_INACTIVE) &&
-           !virDomainObjIsActive(vm))))
+        !((MATCH(VIR_CONNECT_LIST_DOMAINS_ACTIVE) && active) ||
+          (MATCH(VIR_CONNECT_LIST_DOMAINS_INACTIVE) && !active)))
         return false;
 
     /* filter by persistence */
     if (MATCH(VIR_CONNECT_LIST_DOMAINS_FILTERS_PERSISTENT) &&
-        !((MATCH(VIR_CONNECT_LIST_DOMAINS_PERSISTENT) &&
-           vm->persistent) ||
-          (MATCH(VIR_CONNECT_LIST_DOMAINS_TRANSIENT) &&
-           !vm->persistent)))
+        !((MATCH(VIR_CONNECT_LIST_DOMAINS_PERSISTENT) && persistent) ||
+          (MATCH(VIR_CONNECT_LIST_DOMAINS_TRANSIENT) && !persistent)))
         return false;
 
     /* filter by domain state */
     if (MATCH(VIR_CONNECT_LIST_DOMAINS_FILTERS_STATE)) {
-        int st = virDomainObjGetState(vm, NULL);
+        int st = summary->state;
         if (!((MATCH(VIR_CONNECT_LIST_DOMAINS_RUNNING) &&
                st == VIR_DOMAIN_RUNNING) ||
               (MATCH(VIR_CONNECT_LIST_DOMAINS_PAUSED) &&
@@ -883,18 +1066,25 @@ virDomainObjMatchFilter(virDomainObjPtr vm,
 
     /* filter by existence of managed save state */
     if (MATCH(VIR_CONNECT_LIST_DOMAINS_FILTERS_MANAGEDSAVE) &&
-        !((MATCH(VIR_CONNECT_LIST_DOMAINS_MANAGEDSAVE) &&
-           vm->hasManagedSave) ||
-          (MATCH(VIR_CONNECT_LIST_DOMAINS_NO_MANAGEDSAVE) &&
-           !vm->hasManagedSave)))
+        !((MATCH(VIR_CONNECT_LIST_DOMAINS_MANAGEDSAVE) && managedsave) ||
+          (MATCH(VIR_CONNECT_LIST_DOMAINS_NO_MANAGEDSAVE) && !managedsave)))
         return false;
 
     /* filter by autostart option */
     if (MATCH(VIR_CONNECT_LIST_DOMAINS_FILTERS_AUTOSTART) &&
-        !((MATCH(VIR_CONNECT_LIST_DOMAINS_AUTOSTART) && vm->autostart) ||
-          (MATCH(VIR_CONNECT_LIST_DOMAINS_NO_AUTOSTART) && !vm->autostart)))
+        !((MATCH(VIR_CONNECT_LIST_DOMAINS_AUTOSTART) && autostart) ||
+          (MATCH(VIR_CONNECT_LIST_DOMAINS_NO_AUTOSTART) && !autostart)))
         return false;
 
+    return true;
+}
+
+
+/* The caller must hold the lock on @vm */
+static bool
+virDomainObjMatchFilterLocked(virDomainObjPtr vm,
+                              unsigned int filter)
+{
     /* filter by snapshot existence */
     if (MATCH(VIR_CONNECT_LIST_DOMAINS_FILTERS_SNAPSHOT)) {
         int nsnap = virDomainSnapshotObjListNum(vm->snapshots, NULL, 0);
@@ -917,24 +1107,6 @@ virDomainObjMatchFilter(virDomainObjPtr vm,
 #undef MATCH
 
 
-struct virDomainListData {
-    virDomainObjPtr *vms;
-    size_t nvms;
-};
-
-
-static int
-virDomainObjListCollectIterator(void *payload,
-                                const void *name G_GNUC_UNUSED,
-                                void *opaque)
-{
-    struct virDomainListData *data = opaque;
-
-    data->vms[data->nvms++] = virObjectRef(payload);
-    return 0;
-}
-
-
 static void
 virDomainObjListFilter(virDomainObjPtr **list,
                        size_t *nvms,
@@ -946,24 +1118,37 @@ virDomainObjListFilter(virDomainObjPtr **list,
 
     while (i < *nvms) {
         virDomainObjPtr vm = (*list)[i];
-
-        virObjectLock(vm);
+        virDomainObjSummary summary;
+        bool want = false;
 
         /* do not list the object if:
          * 1) it's being removed.
-         * 2) connection does not have ACL to see it
-         * 3) it doesn't match the filter
+         * 2) it doesn't match the filter
+         * 3) connection does not have ACL to see it
+         *
+         * The first two are decided from the lockless summary, the
+         * object is only locked if the rest of the checks need it.
          */
-        if (vm->removing ||
-            (filter && !filter(conn, vm->def)) ||
-            !virDomainObjMatchFilter(vm, flags)) {
-            virObjectUnlock(vm);
+        virDomainObjSummaryGet(vm, &summary);
+        if (!(summary.flags & VIR_DOMAIN_OBJ_SUMMARY_REMOVING) &&
+            virDomainObjSummaryMatchFilter(&summary, flags)) {
+            if (filter || (flags & VIR_DOMAIN_OBJ_LIST_FILTERS_LOCKED)) {
+                virObjectLock(vm);
+                want = !vm->removing &&
+                       (!filter || filter(conn, vm->def)) &&
+                       virDomainObjMatchFilterLocked(vm, flags);
+                virObjectUnlock(vm);
+            } else {
+                want = true;
+            }
+        }
+
+        if (!want) {
             virObjectUnref(vm);
             VIR_DELETE_ELEMENT(*list, i, *nvms);
             continue;
         }
 
-        virObjectUnlock(vm);
         i++;
     }
 }
@@ -977,22 +1162,34 @@ virDomainObjListCollect(virDomainObjListPtr domlist,
                         virDomainObjListACLFilter filter,
                         unsigned int flags)
 {
-    struct virDomainListData data = { NULL, 0 };
+    virDomainObjListSnapshotPtr snap;
+    virDomainObjPtr *list = NULL;
+    size_t nlist;
+    size_t i;
 
     virObjectRWLockRead(domlist);
-    sa_assert(domlist->objs);
-    if (VIR_ALLOC_N(data.vms, virHashSize(domlist->objs)) < 0) {
-        virObjectRWUnlock(domlist);
+    snap = virDomainObjListGetSnapshotLocked(domlist);
+    virObjectRWUnlock(domlist);
+
+    if (!snap)
+        return -1;
+
+    /* The snapshot keeps every object alive, so references for the
+     * caller can be taken without holding the list lock. */
+    nlist = snap->nvms;
+    if (VIR_ALLOC_N(list, nlist) < 0) {
+        virObjectUnref(snap);
         return -1;
     }
 
-    virHashForEach(domlist->objs, virDomainObjListCollectIterator, &data);
-    virObjectRWUnlock(domlist);
+    for (i = 0; i < nlist; i++)
+        list[i] = virObjectRef(snap->vms[i]);
+    virObjectUnref(snap);
 
-    virDomainObjListFilter(&data.vms, &data.nvms, conn, filter, flags);
+    virDomainObjListFilter(&list, &nlist, conn, filter, flags);
 
-    *nvms = data.nvms;
-    *vms = data.vms;
+    *nvms = nlist;
+    *vms = list;
 
     return 0;
 }
@@ -1020,13 +1217,12 @@ virDomainObjListConvert(virDomainObjListPtr domlist,
     for (i = 0; i < ndoms; i++) {
         virDomainPtr dom = doms[i];
 
-        virUUIDFormat(dom->uuid, uuidstr);
-
-        if (!(vm = virHashLookup(domlist->objs, uuidstr))) {
+        if (!(vm = virHashLookup(domlist->objs, dom->uuid))) {
             if (skip_missing)
                 continue;
 
             virObjectRWUnlock(domlist);
+            virUUIDFormat(dom->uuid, uuidstr);
             virReportError(VIR_ERR_NO_DOMAIN,
                            _("no domain with matching uuid '%s' (%s)"),
                            uuidstr, dom->name);
@@ -1057,6 +1253,57 @@ virDomainObjListConvert(virDomainObjListPtr domlist,
 }
 
 
+struct virDomainObjListExportEntry {
+    virDomainObjPtr vm;
+    char *name;
+    unsigned char uuid[VIR_UUID_BUFLEN];
+    int id;
+};
+
+struct virDomainObjListExportData {
+    struct virDomainObjListACLData acl;
+    unsigned int flags;
+    struct virDomainObjListExportEntry *entries;
+    size_t nentries;
+};
+
+
+static int
+virDomainObjListExportIterator(void *payload,
+                               const void *name,
+                               void *opaque)
+{
+    virDomainObjPtr vm = payload;
+    struct virDomainObjListExportData *data = opaque;
+    struct virDomainObjListExportEntry *entry;
+    virDomainObjSummary summary;
+
+    virDomainObjSummaryGet(vm, &summary);
+
+    if (summary.flags & VIR_DOMAIN_OBJ_SUMMARY_REMOVING ||
+        !virDomainObjSummaryMatchFilter(&summary, data->flags) ||
+        !virDomainObjListACLCheck(&data->acl, vm))
+        return 0;
+
+    entry = &data->entries[data->nentries++];
+    entry->vm = virObjectRef(vm);
+    entry->name = g_strdup(name);
+    memcpy(entry->uuid, summary.uuid, VIR_UUID_BUFLEN);
+    entry->id = summary.id;
+    return 0;
+}
+
+
+/**
+ * virDomainObjListExport:
+ *
+ * List domains matching @flags. Domain objects are not locked, the
+ * listing is computed from the lockless summary of each domain and
+ * the names held by the list itself, so that a domain busy with a
+ * long running job does not delay the listing. Only the ACL,
+ * snapshot and checkpoint filters still need to lock the matching
+ * domains, briefly.
+ */
 int
 virDomainObjListExport(virDomainObjListPtr domlist,
                        virConnectPtr conn,
@@ -1064,38 +1311,57 @@ virDomainObjListExport(virDomainObjListPtr domlist,
                        virDomainObjListACLFilter filter,
                        unsigned int flags)
 {
-    virDomainObjPtr *vms = NULL;
+    struct virDomainObjListExportData data = {
+        .acl = { filter, conn },
+        .flags = flags,
+    };
     virDomainPtr *doms = NULL;
-    size_t nvms = 0;
+    size_t ndoms = 0;
     size_t i;
     int ret = -1;
 
-    if (virDomainObjListCollect(domlist, conn, &vms, &nvms, filter, flags) < 0)
-        return -1;
 
-    if (domains) {
-        if (VIR_ALLOC_N(doms, nvms + 1) < 0)
-            goto cleanup;
+    virObjectRWLockRead(domlist);
+    data.entries = g_new0(struct virDomainObjListExportEntry,
+                          virHashSize(domlist->objsName));
+    virHashForEach(domlist->objsName, virDomainObjListExportIterator, &data);
+    virObjectRWUnlock(domlist);
 
-        for (i = 0; i < nvms; i++) {
-            virDomainObjPtr vm = vms[i];
+    if (domains)
+        doms = g_new0(virDomainPtr, data.nentries + 1);
 
-            virObjectLock(vm);
-            doms[i] = virGetDomain(conn, vm->def->name, vm->def->uuid, vm->def->id);
-            virObjectUnlock(vm);
+    for (i = 0; i < data.nentries; i++) {
+        struct virDomainObjListExportEntry *entry = &data.entries[i];
 
-            if (!doms[i])
-                goto cleanup;
+        if (flags & VIR_DOMAIN_OBJ_LIST_FILTERS_LOCKED) {
+            bool want;
+
+            virObjectLock(entry->vm);
+            want = virDomainObjMatchFilterLocked(entry->vm, flags);
+            virObjectUnlock(entry->vm);
+
+            if (!want)
+                continue;
         }
 
-        *domains = doms;
-        doms = NULL;
+        if (doms &&
+            !(doms[ndoms] = virGetDomain(conn, entry->name,
+                                         entry->uuid, entry->id)))
+            goto cleanup;
+        ndoms++;
     }
 
-    ret = nvms;
+    if (domains)
+        *domains = g_steal_pointer(&doms);
+
+    ret = ndoms;
 
  cleanup:
+    for (i = 0; i < data.nentries; i++) {
+        virObjectUnref(data.entries[i].vm);
+        VIR_FREE(data.entries[i].name);
+    }
+    VIR_FREE(data.entries);
     virObjectListFree(doms);
-    virObjectListFreeCount(vms, nvms);
     return ret;
 }
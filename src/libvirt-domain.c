@@ -11448,6 +11448,10 @@ virConnectGetDomainCapabilities(virConnectPtr conn,
  *     "state.state" - state of the VM, returned as int from virDomainState enum
  *     "state.reason" - reason for entering given state, returned as int from
  *                      virDomain*Reason enum corresponding to given state.
+ *     "state.events.queued" - number of asynchronous hypervisor events of the
+ *                             domain waiting to be processed by the daemon,
+ *                             as unsigned int. Only reported by drivers
+ *                             which process such events asynchronously.
  *
  * VIR_DOMAIN_STATS_CPU_TOTAL:
  *     Return CPU statistics and usage information. The typed parameter keys
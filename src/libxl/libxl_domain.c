@@ -870,7 +870,7 @@ libxlDomainCleanup(libxlDriverPrivatePtr driver,
     VIR_DEBUG("Preserving lock state '%s'", NULLSTR(priv->lockState));
 
     libxlLoggerCloseFile(cfg->logger, vm->def->id);
-    vm->def->id = -1;
+    virDomainObjSetID(vm, -1);
 
     if (priv->deathW) {
         libxl_evdisable_domain_death(cfg->ctx, priv->deathW);
@@ -1316,7 +1316,7 @@ libxlDomainStart(libxlDriverPrivatePtr driver,
                 VIR_WARN("Failed to remove the managed state %s",
                          managed_save_path);
 
-            vm->hasManagedSave = false;
+            virDomainObjSetManagedSave(vm, false);
         }
         VIR_FREE(managed_save_path);
     }
@@ -1425,7 +1425,7 @@ libxlDomainStart(libxlDriverPrivatePtr driver,
      * The domain has been successfully created with libxl, so it should
      * be cleaned up if there are any subsequent failures.
      */
-    vm->def->id = domid;
+    virDomainObjSetID(vm, domid);
     config_json = libxl_domain_config_to_json(cfg->ctx, &d_config);
 
     libxlLoggerOpenFile(cfg->logger, domid, vm->def->name, config_json);
@@ -1504,7 +1504,7 @@ libxlDomainStart(libxlDriverPrivatePtr driver,
  destroy_dom:
     ret = -1;
     libxlDomainDestroyInternal(driver, vm);
-    vm->def->id = -1;
+    virDomainObjSetID(vm, -1);
     virDomainObjSetState(vm, VIR_DOMAIN_SHUTOFF, VIR_DOMAIN_SHUTOFF_FAILED);
 
  cleanup_dom:
@@ -426,7 +426,7 @@ libxlReconnectDomain(virDomainObjPtr vm,
     }
 
     /* Update domid in case it changed (e.g. reboot) while we were gone? */
-    vm->def->id = d_info.domid;
+    virDomainObjSetID(vm, d_info.domid);
 
     libxlLoggerOpenFile(cfg->logger, vm->def->id, vm->def->name, NULL);
 
@@ -624,7 +624,7 @@ libxlAddDom0(libxlDriverPrivatePtr driver)
         goto cleanup;
     def = NULL;
 
-    vm->persistent = 1;
+    virDomainObjSetPersistent(vm, true);
     virDomainObjSetState(vm, VIR_DOMAIN_RUNNING, VIR_DOMAIN_RUNNING_BOOTED);
     if (virDomainDefSetVcpusMax(vm->def, d_info.vcpu_max_id + 1, driver->xmlopt))
         goto cleanup;
@@ -1547,7 +1547,7 @@ libxlDomainPMWakeup(virDomainPtr dom, unsigned int flags)
 
  destroy_dom:
     libxlDomainDestroyInternal(driver, vm);
-    vm->def->id = -1;
+    virDomainObjSetID(vm, -1);
     virDomainObjSetState(vm, VIR_DOMAIN_SHUTOFF, VIR_DOMAIN_SHUTOFF_FAILED);
     event = virDomainEventLifecycleNewFromObj(vm, VIR_DOMAIN_EVENT_STOPPED,
                                               VIR_DOMAIN_EVENT_STOPPED_FAILED);
@@ -1883,7 +1883,7 @@ libxlDoDomainSave(libxlDriverPrivatePtr driver,
     }
 
     libxlDomainCleanup(driver, vm);
-    vm->hasManagedSave = managed;
+    virDomainObjSetManagedSave(vm, managed);
     ret = 0;
 
  cleanup:
@@ -2175,7 +2175,7 @@ libxlDomainManagedSaveLoad(virDomainObjPtr vm,
     if (!(name = libxlDomainManagedSavePath(driver, vm)))
         goto cleanup;
 
-    vm->hasManagedSave = virFileExists(name);
+    virDomainObjSetManagedSave(vm, virFileExists(name));
 
     ret = 0;
  cleanup:
@@ -2226,7 +2226,7 @@ libxlDomainManagedSaveRemove(virDomainPtr dom, unsigned int flags)
         goto cleanup;
 
     ret = unlink(name);
-    vm->hasManagedSave = false;
+    virDomainObjSetManagedSave(vm, false);
 
  cleanup:
     VIR_FREE(name);
@@ -2875,7 +2875,7 @@ libxlDomainDefineXMLFlags(virConnectPtr conn, const char *xml, unsigned int flag
         goto cleanup;
     def = NULL;
 
-    vm->persistent = 1;
+    virDomainObjSetPersistent(vm, true);
 
     if (virDomainDefSave(vm->newDef ? vm->newDef : vm->def,
                          driver->xmlopt, cfg->configDir) < 0) {
@@ -2956,7 +2956,7 @@ libxlDomainUndefineFlags(virDomainPtr dom,
                                      VIR_DOMAIN_EVENT_UNDEFINED_REMOVED);
 
     if (virDomainObjIsActive(vm))
-        vm->persistent = 0;
+        virDomainObjSetPersistent(vm, false);
     else
         virDomainObjListRemove(driver->domains, vm);
 
@@ -4537,7 +4537,7 @@ libxlDomainSetAutostart(virDomainPtr dom, int autostart)
             }
         }
 
-        vm->autostart = autostart;
+        virDomainObjSetAutostart(vm, autostart);
     }
     ret = 0;
 
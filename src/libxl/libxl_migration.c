@@ -1332,7 +1332,7 @@ libxlDomainMigrationDstFinish(virConnectPtr dconn,
         unsigned int oldPersist = vm->persistent;
         virDomainDefPtr vmdef;
 
-        vm->persistent = 1;
+        virDomainObjSetPersistent(vm, true);
         if (!(vmdef = virDomainObjGetPersistentDef(driver->xmlopt, vm, NULL)))
             goto cleanup;
 
@@ -427,3 +427,146 @@ virLockSpaceProtocolDispatchCreateLockSpace(virNetServerPtr server G_GNUC_UNUSED
     virMutexUnlock(&priv->lock);
     return rv;
 }
+
+
+static int
+virLockSpaceProtocolDispatchAcquireResources(virNetServerPtr server G_GNUC_UNUSED,
+                                             virNetServerClientPtr client,
+                                             virNetMessagePtr msg G_GNUC_UNUSED,
+                                             virNetMessageErrorPtr rerr,
+                                             virLockSpaceProtocolAcquireResourcesArgs *args)
+{
+    int rv = -1;
+    unsigned int flags = args->flags;
+    virLockDaemonClientPtr priv =
+        virNetServerClientGetPrivateData(client);
+    virLockSpacePtr *lockspaces = NULL;
+    const char **names = NULL;
+    unsigned int *newFlags = NULL;
+    size_t nresources = args->resources.resources_len;
+    size_t i;
+
+    virMutexLock(&priv->lock);
+
+    virCheckFlagsGoto(0, cleanup);
+
+    if (priv->restricted) {
+        virReportError(VIR_ERR_OPERATION_DENIED, "%s",
+                       _("lock manager connection has been restricted"));
+        goto cleanup;
+    }
+
+    if (!args->owner.id) {
+        virReportError(VIR_ERR_OPERATION_INVALID, "%s",
+                       _("lock owner details have not been provided"));
+        goto cleanup;
+    }
+
+    if (VIR_ALLOC_N(lockspaces, nresources) < 0 ||
+        VIR_ALLOC_N(names, nresources) < 0 ||
+        VIR_ALLOC_N(newFlags, nresources) < 0)
+        goto cleanup;
+
+    /* Resolve every lockspace up front so that a bad path
+     * does not leave a partially acquired set behind */
+    for (i = 0; i < nresources; i++) {
+        virLockSpaceProtocolResource *res = &args->resources.resources_val[i];
+
+        if (res->flags & ~(VIR_LOCK_SPACE_PROTOCOL_ACQUIRE_RESOURCE_SHARED |
+                           VIR_LOCK_SPACE_PROTOCOL_ACQUIRE_RESOURCE_AUTOCREATE)) {
+            virReportError(VIR_ERR_INVALID_ARG,
+                           _("unsupported flags (0x%x) for resource %s"),
+                           res->flags, res->name);
+            goto cleanup;
+        }
+
+        if (!(lockspaces[i] = virLockDaemonFindLockSpace(lockDaemon, res->path))) {
+            virReportError(VIR_ERR_INTERNAL_ERROR,
+                           _("Lockspace for path %s does not exist"),
+                           res->path);
+            goto cleanup;
+        }
+
+        names[i] = res->name;
+        if (res->flags & VIR_LOCK_SPACE_PROTOCOL_ACQUIRE_RESOURCE_SHARED)
+            newFlags[i] |= VIR_LOCK_SPACE_ACQUIRE_SHARED;
+        if (res->flags & VIR_LOCK_SPACE_PROTOCOL_ACQUIRE_RESOURCE_AUTOCREATE)
+            newFlags[i] |= VIR_LOCK_SPACE_ACQUIRE_AUTOCREATE;
+    }
+
+    if (virLockSpaceAcquireResources(lockspaces, names, newFlags,
+                                     nresources, args->owner.pid) < 0)
+        goto cleanup;
+
+    rv = 0;
+
+ cleanup:
+    if (rv < 0)
+        virNetMessageSaveError(rerr);
+    VIR_FREE(newFlags);
+    VIR_FREE(names);
+    VIR_FREE(lockspaces);
+    virMutexUnlock(&priv->lock);
+    return rv;
+}
+
+
+static int
+virLockSpaceProtocolDispatchReleaseResources(virNetServerPtr server G_GNUC_UNUSED,
+                                             virNetServerClientPtr client,
+                                             virNetMessagePtr msg G_GNUC_UNUSED,
+                                             virNetMessageErrorPtr rerr,
+                                             virLockSpaceProtocolReleaseResourcesArgs *args)
+{
+    int rv = -1;
+    unsigned int flags = args->flags;
+    virLockDaemonClientPtr priv =
+        virNetServerClientGetPrivateData(client);
+    virLockSpacePtr *lockspaces = NULL;
+    const char **names = NULL;
+    size_t nresources = args->resources.resources_len;
+    size_t i;
+
+    virMutexLock(&priv->lock);
+
+    virCheckFlagsGoto(0, cleanup);
+
+    if (priv->restricted) {
+        virReportError(VIR_ERR_OPERATION_DENIED, "%s",
+                       _("lock manager connection has been restricted"));
+        goto cleanup;
+    }
+
+    if (!args->owner.id) {
+        virReportError(VIR_ERR_OPERATION_INVALID, "%s",
+                       _("lock owner details have not been provided"));
+        goto cleanup;
+    }
+
+    if (VIR_ALLOC_N(lockspaces, nresources) < 0 ||
+        VIR_ALLOC_N(names, nresources) < 0)
+        goto cleanup;
+
+    /* A missing lockspace is reported for its resource, the rest of
+     * the batch is still released */
+    for (i = 0; i < nresources; i++) {
+        virLockSpaceProtocolResource *res = &args->resources.resources_val[i];
+
+        lockspaces[i] = virLockDaemonFindLockSpace(lockDaemon, res->path);
+        names[i] = res->name;
+    }
+
+    if (virLockSpaceReleaseResources(lockspaces, names,
+                                     nresources, args->owner.pid) < 0)
+        goto cleanup;
+
+    rv = 0;
+
+ cleanup:
+    if (rv < 0)
+        virNetMessageSaveError(rerr);
+    VIR_FREE(names);
+    VIR_FREE(lockspaces);
+    virMutexUnlock(&priv->lock);
+    return rv;
+}
@@ -34,6 +34,7 @@
 #include "configmake.h"
 #include "virstring.h"
 #include "virutil.h"
+#include "virthread.h"
 
 #include "lock_driver_lockd.h"
 
@@ -76,6 +77,17 @@ struct _virLockManagerLockDaemonDriver {
     char *fileLockSpaceDir;
     char *lvmLockSpaceDir;
     char *scsiLockSpaceDir;
+
+    /* Connection to virtlockd shared by all lock managers of this
+     * process for the batched acquire/release procedures. Calls are
+     * multiplexed over it, so the lock only protects the fields below,
+     * not the calls. */
+    virMutex lock;
+    virNetClientPtr client;
+    virNetClientProgramPtr program;
+    pid_t clientPid;
+    int serial;
+    bool noBatch;
 };
 
 static virLockManagerLockDaemonDriverPtr driver;
@@ -263,23 +275,81 @@ virLockManagerLockDaemonConnect(virLockManagerPtr lock,
 }
 
 
+static void
+virLockManagerLockDaemonSharedConnectionDrop(virNetClientPtr client)
+{
+    virNetClientPtr oldClient = NULL;
+    virNetClientProgramPtr oldProgram = NULL;
+
+    virMutexLock(&driver->lock);
+    if (driver->client && (!client || driver->client == client)) {
+        oldClient = g_steal_pointer(&driver->client);
+        oldProgram = g_steal_pointer(&driver->program);
+    }
+    virMutexUnlock(&driver->lock);
+
+    if (oldClient)
+        virNetClientClose(oldClient);
+    virObjectUnref(oldClient);
+    virObjectUnref(oldProgram);
+}
+
+
+/*
+ * Returns a new reference to the connection shared by the driver,
+ * opening it if needed, or NULL on error. The connection is never
+ * registered to a particular owner, the batched procedures carry
+ * the owner details with each call instead.
+ */
+static virNetClientPtr
+virLockManagerLockDaemonSharedConnection(virNetClientProgramPtr *program)
+{
+    virNetClientPtr client = NULL;
+
+    *program = NULL;
+
+    virMutexLock(&driver->lock);
+
+    if (driver->client && !virNetClientIsOpen(driver->client)) {
+        virObjectUnref(driver->client);
+        virObjectUnref(driver->program);
+        driver->client = NULL;
+        driver->program = NULL;
+    }
+
+    if (!driver->client) {
+        driver->client = virLockManagerLockDaemonConnectionNew(geteuid() == 0,
+                                                               &driver->program);
+        driver->clientPid = getpid();
+    }
+
+    if (driver->client) {
+        client = virObjectRef(driver->client);
+        *program = virObjectRef(driver->program);
+    }
+
+    virMutexUnlock(&driver->lock);
+
+    return client;
+}
+
+
 static int virLockManagerLockDaemonSetupLockspace(const char *path)
 {
     virNetClientPtr client;
     virNetClientProgramPtr program = NULL;
     virLockSpaceProtocolCreateLockSpaceArgs args;
     int rv = -1;
-    int counter = 0;
 
     memset(&args, 0, sizeof(args));
     args.path = (char*)path;
 
-    if (!(client = virLockManagerLockDaemonConnectionNew(geteuid() == 0, &program)))
+    if (!(client = virLockManagerLockDaemonSharedConnection(&program)))
         return -1;
 
     if (virNetClientProgramCall(program,
                                 client,
-                                counter++,
+                                g_atomic_int_add(&driver->serial, 1),
                                 VIR_LOCK_SPACE_PROTOCOL_PROC_CREATE_LOCKSPACE,
                                 0, NULL, NULL, NULL,
                                 (xdrproc_t)xdr_virLockSpaceProtocolCreateLockSpaceArgs, (char*)&args,
@@ -297,7 +367,6 @@ static int virLockManagerLockDaemonSetupLockspace(const char *path)
 
  cleanup:
     virObjectUnref(program);
-    virNetClientClose(client);
     virObjectUnref(client);
     return rv;
 }
@@ -319,6 +388,11 @@ static int virLockManagerLockDaemonInit(unsigned int version,
     if (VIR_ALLOC(driver) < 0)
         return -1;
 
+    if (virMutexInit(&driver->lock) < 0) {
+        VIR_FREE(driver);
+        return -1;
+    }
+
     driver->requireLeaseForDisks = true;
     driver->autoDiskLease = true;
 
@@ -351,6 +425,9 @@ static int virLockManagerLockDaemonDeinit(void)
     if (!driver)
         return 0;
 
+    virLockManagerLockDaemonSharedConnectionDrop(NULL);
+    virMutexDestroy(&driver->lock);
+
     VIR_FREE(driver->scsiLockSpaceDir);
     VIR_FREE(driver->lvmLockSpaceDir);
     VIR_FREE(driver->fileLockSpaceDir);
@@ -597,6 +674,188 @@ static int virLockManagerLockDaemonAddResource(virLockManagerPtr lock,
 }
 
 
+/*
+ * Whether the batched procedures may be used by this process: virtlockd
+ * must know them, and a forked child must not share the connection of
+ * its parent.
+ */
+static bool
+virLockManagerLockDaemonCanBatch(void)
+{
+    bool ret;
+
+    virMutexLock(&driver->lock);
+    ret = !driver->noBatch &&
+        (!driver->client || driver->clientPid == getpid());
+    virMutexUnlock(&driver->lock);
+
+    return ret;
+}
+
+
+/*
+ * Best effort release of a batch whose acquisition failed with the
+ * connection lost, as virtlockd may have granted it before going away.
+ * The connection is never registered, so nothing else would release
+ * the resources. The original error is preserved.
+ */
+static void
+virLockManagerLockDaemonBatchRollback(virLockSpaceProtocolOwner *owner,
+                                      virLockSpaceProtocolResource *resources,
+                                      size_t nresources)
+{
+    virLockSpaceProtocolReleaseResourcesArgs args;
+    virNetClientPtr client = NULL;
+    virNetClientProgramPtr program = NULL;
+    virErrorPtr orig_err;
+    size_t i;
+
+    virErrorPreserveLast(&orig_err);
+
+    for (i = 0; i < nresources; i++)
+        resources[i].flags &=
+            ~(VIR_LOCK_SPACE_PROTOCOL_ACQUIRE_RESOURCE_SHARED |
+              VIR_LOCK_SPACE_PROTOCOL_ACQUIRE_RESOURCE_AUTOCREATE);
+
+    memset(&args, 0, sizeof(args));
+    args.owner = *owner;
+    args.resources.resources_len = nresources;
+    args.resources.resources_val = resources;
+
+    if ((client = virLockManagerLockDaemonSharedConnection(&program)) &&
+        virNetClientProgramCall(program,
+                                client,
+                                g_atomic_int_add(&driver->serial, 1),
+                                VIR_LOCK_SPACE_PROTOCOL_PROC_RELEASE_RESOURCES,
+                                0, NULL, NULL, NULL,
+                                (xdrproc_t)xdr_virLockSpaceProtocolReleaseResourcesArgs, &args,
+                                (xdrproc_t)xdr_void, NULL) < 0)
+        VIR_DEBUG("Unable to roll back batched acquisition");
+
+    virObjectUnref(client);
+    virObjectUnref(program);
+    virErrorRestore(&orig_err);
+}
+
+
+/*
+ * Acquire or release (depending on @procnr) all resources of @lock
+ * in a single call over the shared connection.
+ *
+ * Returns 0 on success, -1 on error, 1 if the batched procedures
+ * cannot be used and the caller should fall back to per resource
+ * calls on a private connection. The fallback is only offered when
+ * virtlockd is known not to have acted on the request, so that the
+ * resources are never acquired or released twice.
+ */
+static int
+virLockManagerLockDaemonBatch(virLockManagerPtr lock,
+                              int procnr)
+{
+    virLockManagerLockDaemonPrivatePtr priv = lock->privateData;
+    virLockSpaceProtocolResource *resources = NULL;
+    virLockSpaceProtocolOwner owner;
+    virNetClientPtr client = NULL;
+    virNetClientProgramPtr program = NULL;
+    size_t i;
+    int rc;
+    int rv = -1;
+
+    if (!virLockManagerLockDaemonCanBatch())
+        return 1;
+
+    if (priv->nresources == 0)
+        return 0;
+
+    if (priv->nresources > VIR_LOCK_SPACE_PROTOCOL_RESOURCES_MAX)
+        return 1;
+
+    if (VIR_ALLOC_N(resources, priv->nresources) < 0)
+        return -1;
+
+    for (i = 0; i < priv->nresources; i++) {
+        resources[i].path = priv->resources[i].lockspace;
+        resources[i].name = priv->resources[i].name;
+        resources[i].flags = priv->resources[i].flags;
+        if (procnr == VIR_LOCK_SPACE_PROTOCOL_PROC_RELEASE_RESOURCES)
+            resources[i].flags &=
+                ~(VIR_LOCK_SPACE_PROTOCOL_ACQUIRE_RESOURCE_SHARED |
+                  VIR_LOCK_SPACE_PROTOCOL_ACQUIRE_RESOURCE_AUTOCREATE);
+    }
+
+    memset(&owner, 0, sizeof(owner));
+    memcpy(owner.uuid, priv->uuid, VIR_UUID_BUFLEN);
+    owner.name = priv->name;
+    owner.id = priv->id;
+    owner.pid = priv->pid;
+
+    if (!(client = virLockManagerLockDaemonSharedConnection(&program)))
+        goto cleanup;
+
+    if (procnr == VIR_LOCK_SPACE_PROTOCOL_PROC_ACQUIRE_RESOURCES) {
+        virLockSpaceProtocolAcquireResourcesArgs args;
+
+        memset(&args, 0, sizeof(args));
+        args.owner = owner;
+        args.resources.resources_len = priv->nresources;
+        args.resources.resources_val = resources;
+
+        rc = virNetClientProgramCall(program,
+                                     client,
+                                     g_atomic_int_add(&driver->serial, 1),
+                                     procnr,
+                                     0, NULL, NULL, NULL,
+                                     (xdrproc_t)xdr_virLockSpaceProtocolAcquireResourcesArgs, &args,
+                                     (xdrproc_t)xdr_void, NULL);
+    } else {
+        virLockSpaceProtocolReleaseResourcesArgs args;
+
+        memset(&args, 0, sizeof(args));
+        args.owner = owner;
+        args.resources.resources_len = priv->nresources;
+        args.resources.resources_val = resources;
+
+        rc = virNetClientProgramCall(program,
+                                     client,
+                                     g_atomic_int_add(&driver->serial, 1),
+                                     procnr,
+                                     0, NULL, NULL, NULL,
+                                     (xdrproc_t)xdr_virLockSpaceProtocolReleaseResourcesArgs, &args,
+                                     (xdrproc_t)xdr_void, NULL);
+    }
+
+    if (rc < 0) {
+        if (!virNetClientIsOpen(client)) {
+            /* The daemon went away and it is unknown whether it acted
+             * on the request. Reconnect on next use, but fail this
+             * call rather than repeat it. */
+            virLockManagerLockDaemonSharedConnectionDrop(client);
+            if (procnr == VIR_LOCK_SPACE_PROTOCOL_PROC_ACQUIRE_RESOURCES)
+                virLockManagerLockDaemonBatchRollback(&owner, resources,
+                                                      priv->nresources);
+        } else if (virGetLastErrorCode() == VIR_ERR_RPC) {
+            /* An older virtlockd which does not know the batched
+             * procedures and rejected the call without acting on it */
+            VIR_DEBUG("Batched lock procedures not supported by virtlockd");
+            virMutexLock(&driver->lock);
+            driver->noBatch = true;
+            virMutexUnlock(&driver->lock);
+            virResetLastError();
+            rv = 1;
+        }
+        goto cleanup;
+    }
+
+    rv = 0;
+
+ cleanup:
+    VIR_FREE(resources);
+    virObjectUnref(client);
+    virObjectUnref(program);
+    return rv;
+}
+
+
 static int virLockManagerLockDaemonAcquire(virLockManagerPtr lock,
                                            const char *state G_GNUC_UNUSED,
                                            unsigned int flags,
@@ -620,6 +879,17 @@ static int virLockManagerLockDaemonAcquire(virLockManagerPtr lock,
         return -1;
     }
 
+    /* Only the lock holder process needs a private, registered,
+     * connection. Everything else is batched over the shared one */
+    if (!fd &&
+        !(flags & (VIR_LOCK_MANAGER_ACQUIRE_REGISTER_ONLY |
+                   VIR_LOCK_MANAGER_ACQUIRE_RESTRICT))) {
+        int rc = virLockManagerLockDaemonBatch(lock,
+                                               VIR_LOCK_SPACE_PROTOCOL_PROC_ACQUIRE_RESOURCES);
+        if (rc <= 0)
+            return rc;
+    }
+
     if (!(client = virLockManagerLockDaemonConnect(lock, &program, &counter)))
         goto cleanup;
 
@@ -681,6 +951,11 @@ static int virLockManagerLockDaemonRelease(virLockManagerPtr lock,
     if (state)
         *state = NULL;
 
+    if ((rv = virLockManagerLockDaemonBatch(lock,
+                                            VIR_LOCK_SPACE_PROTOCOL_PROC_RELEASE_RESOURCES)) <= 0)
+        return rv;
+    rv = -1;
+
     if (!(client = virLockManagerLockDaemonConnect(lock, &program, &counter)))
         goto cleanup;
 
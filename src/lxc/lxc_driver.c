@@ -441,7 +441,7 @@ lxcDomainDefineXMLFlags(virConnectPtr conn, const char *xml, unsigned int flags)
         goto cleanup;
 
     def = NULL;
-    vm->persistent = 1;
+    virDomainObjSetPersistent(vm, true);
 
     if (virDomainDefSave(vm->newDef ? vm->newDef : vm->def,
                          driver->xmlopt, cfg->configDir) < 0) {
@@ -506,7 +506,7 @@ static int lxcDomainUndefineFlags(virDomainPtr dom,
                                      VIR_DOMAIN_EVENT_UNDEFINED_REMOVED);
 
     if (virDomainObjIsActive(vm))
-        vm->persistent = 0;
+        virDomainObjSetPersistent(vm, false);
     else
         virDomainObjListRemove(driver->domains, vm);
 
@@ -2530,7 +2530,7 @@ static int lxcDomainSetAutostart(virDomainPtr dom,
         }
     }
 
-    vm->autostart = autostart;
+    virDomainObjSetAutostart(vm, autostart);
     ret = 0;
 
  endjob:
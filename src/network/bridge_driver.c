@@ -66,6 +66,9 @@
 #include "network_event.h"
 #include "virhook.h"
 #include "virjson.h"
+#include "virconf.h"
+#include "virevent.h"
+#include "virlease.h"
 #include "virnetworkportdef.h"
 #include "virutil.h"
 
@@ -74,13 +77,6 @@
 #define VIR_FROM_THIS VIR_FROM_NETWORK
 #define MAX_BRIDGE_ID 256
 
-/**
- * VIR_NETWORK_DHCP_LEASE_FILE_SIZE_MAX:
- *
- * Macro providing the upper limit on the size of leases file
- */
-#define VIR_NETWORK_DHCP_LEASE_FILE_SIZE_MAX (32 * 1024 * 1024)
-
 #define SYSCTL_PATH "/proc/sys"
 
 VIR_LOG_INIT("network.bridge_driver");
@@ -386,6 +382,35 @@ networkDnsmasqLeaseFileNameCustom(virNetworkDriverStatePtr driver,
 }
 
 
+static void
+networkLeaseDBFree(void *opaque)
+{
+    virObjectUnref(opaque);
+}
+
+
+typedef struct _networkDnsmasqReload networkDnsmasqReload;
+typedef networkDnsmasqReload *networkDnsmasqReloadPtr;
+struct _networkDnsmasqReload {
+    unsigned long long last;    /* when dnsmasq was last reloaded, in ms */
+    int timer;                  /* timer of the pending reload, or -1 */
+};
+
+
+static void
+networkDnsmasqReloadFree(void *opaque)
+{
+    networkDnsmasqReloadPtr reload = opaque;
+
+    if (!reload)
+        return;
+
+    if (reload->timer >= 0)
+        virEventRemoveTimeout(reload->timer);
+    g_free(reload);
+}
+
+
 static char *
 networkDnsmasqConfigFileName(virNetworkDriverStatePtr driver,
                              const char *netname)
@@ -426,6 +451,7 @@ networkRemoveInactive(virNetworkDriverStatePtr driver,
 {
     char *leasefile = NULL;
     char *customleasefile = NULL;
+    char *customleasejournal = NULL;
     char *radvdconfigfile = NULL;
     char *configfile = NULL;
     char *radvdpidbase = NULL;
@@ -448,6 +474,9 @@ networkRemoveInactive(virNetworkDriverStatePtr driver,
     if (!(customleasefile = networkDnsmasqLeaseFileNameCustom(driver, def->bridge)))
         goto cleanup;
 
+    customleasejournal = g_strdup_printf("%s" VIR_LEASE_JOURNAL_SUFFIX,
+                                         customleasefile);
+
     if (!(radvdconfigfile = networkRadvdConfigFileName(driver, def->name)))
         goto cleanup;
 
@@ -467,6 +496,10 @@ networkRemoveInactive(virNetworkDriverStatePtr driver,
     dnsmasqDelete(dctx);
     unlink(leasefile);
     unlink(customleasefile);
+    unlink(customleasejournal);
+    networkDriverLock(driver);
+    virHashRemoveEntry(driver->leaseDBs, customleasefile);
+    networkDriverUnlock(driver);
     unlink(configfile);
 
     /* MAC map manager */
@@ -488,6 +521,7 @@ networkRemoveInactive(virNetworkDriverStatePtr driver,
     VIR_FREE(leasefile);
     VIR_FREE(configfile);
     VIR_FREE(customleasefile);
+    VIR_FREE(customleasejournal);
     VIR_FREE(radvdconfigfile);
     VIR_FREE(radvdpidbase);
     VIR_FREE(statusfile);
@@ -697,6 +731,27 @@ firewalld_dbus_filter_bridge(DBusConnection *connection G_GNUC_UNUSED,
 #endif
 
 
+static int
+networkLoadDriverConfig(virNetworkDriverStatePtr driver,
+                        const char *filename)
+{
+    g_autoptr(virConf) conf = NULL;
+
+    /* Avoid error from non-existent or unreadable file. */
+    if (access(filename, R_OK) == -1)
+        return 0;
+
+    if (!(conf = virConfReadFile(filename, 0)))
+        return -1;
+
+    if (virConfGetValueUInt(conf, "dnsmasq_reload_interval",
+                            &driver->dnsmasqReloadInterval) < 0)
+        return -1;
+
+    return 0;
+}
+
+
 /**
  * networkStateInitialize:
  *
@@ -710,6 +765,7 @@ networkStateInitialize(bool privileged,
 {
     int ret = VIR_DRV_STATE_INIT_ERROR;
     char *configdir = NULL;
+    char *configfile = NULL;
     char *rundir = NULL;
     bool autostart = true;
 #ifdef WITH_FIREWALLD
@@ -747,6 +803,7 @@ networkStateInitialize(bool privileged,
         network_driver->pidDir = g_strdup(RUNSTATEDIR "/libvirt/network");
         network_driver->dnsmasqStateDir = g_strdup(LOCALSTATEDIR "/lib/libvirt/dnsmasq");
         network_driver->radvdStateDir = g_strdup(LOCALSTATEDIR "/lib/libvirt/radvd");
+        configfile = g_strdup(SYSCONFDIR "/libvirt/network.conf");
     } else {
         configdir = virGetUserConfigDirectory();
         rundir = virGetUserRuntimeDirectory();
@@ -757,8 +814,13 @@ networkStateInitialize(bool privileged,
         network_driver->pidDir = g_strdup_printf("%s/network/run", rundir);
         network_driver->dnsmasqStateDir = g_strdup_printf("%s/dnsmasq/lib", rundir);
         network_driver->radvdStateDir = g_strdup_printf("%s/radvd/lib", rundir);
+        configfile = g_strdup_printf("%s/network.conf", configdir);
     }
 
+    network_driver->dnsmasqReloadInterval = 1;
+    if (networkLoadDriverConfig(network_driver, configfile) < 0)
+        goto error;
+
     if (virFileMakePath(network_driver->stateDir) < 0) {
         virReportSystemError(errno,
                              _("cannot create directory %s"),
@@ -777,6 +839,12 @@ networkStateInitialize(bool privileged,
     if (!(network_driver->networks = virNetworkObjListNew()))
         goto error;
 
+    if (!(network_driver->leaseDBs = virHashCreate(10, networkLeaseDBFree)))
+        goto error;
+
+    if (!(network_driver->dnsmasqReloads = virHashCreate(10, networkDnsmasqReloadFree)))
+        goto error;
+
     if (virNetworkObjLoadAllState(network_driver->networks,
                                   network_driver->stateDir,
                                   network_driver->xmlopt) < 0)
@@ -840,6 +908,7 @@ networkStateInitialize(bool privileged,
     ret = VIR_DRV_STATE_INIT_COMPLETE;
  cleanup:
     VIR_FREE(configdir);
+    VIR_FREE(configfile);
     VIR_FREE(rundir);
     return ret;
 
@@ -894,6 +963,9 @@ networkStateCleanup(void)
     /* free inactive networks */
     virObjectUnref(network_driver->networks);
 
+    virHashFree(network_driver->leaseDBs);
+    virHashFree(network_driver->dnsmasqReloads);
+
     if (network_driver->lockFD != -1)
         virPidFileRelease(network_driver->stateDir, "driver",
                           network_driver->lockFD);
@@ -1537,13 +1609,20 @@ networkDnsmasqConfContents(virNetworkObjPtr obj,
     if (networkBuildDnsmasqHostsList(dctx, dns) < 0)
         goto cleanup;
 
+    /* Let dnsmasq pick up hosts added at runtime on its own */
+    dctx->hostsdir = dnsmasqCapsGet(caps, DNSMASQ_CAPS_HOSTSDIR);
+
     /* Even if there are currently no static hosts, if we're
      * listening for DHCP, we should write a 0-length hosts
      * file to allow for runtime additions.
      */
-    if (ipv4def || ipv6def)
+    if (ipv4def || ipv6def) {
         virBufferAsprintf(&configbuf, "dhcp-hostsfile=%s\n",
                           dctx->hostsfile->path);
+        if (dctx->hostsdir)
+            virBufferAsprintf(&configbuf, "dhcp-hostsdir=%s\n",
+                              dctx->hostsfile->dir);
+    }
 
     /* Likewise, always create this file and put it on the
      * commandline, to allow for runtime additions.
@@ -1551,6 +1630,9 @@ networkDnsmasqConfContents(virNetworkObjPtr obj,
     if (wantDNS) {
         virBufferAsprintf(&configbuf, "addn-hosts=%s\n",
                           dctx->addnhostsfile->path);
+        if (dctx->hostsdir)
+            virBufferAsprintf(&configbuf, "hostsdir=%s\n",
+                              dctx->addnhostsfile->dir);
     }
 
     /* Configure DHCP to tell clients about the MTU. */
@@ -1748,10 +1830,110 @@ networkStartDhcpDaemon(virNetworkDriverStatePtr driver,
 }
 
 
+static void
+networkDnsmasqReloadTimeout(int timer,
+                            void *opaque)
+{
+    virNetworkDriverStatePtr driver = networkGetDriver();
+    const char *name = opaque;
+    networkDnsmasqReloadPtr reload;
+    virNetworkObjPtr obj;
+    pid_t dnsmasqPid;
+
+    virEventRemoveTimeout(timer);
+
+    networkDriverLock(driver);
+    if ((reload = virHashLookup(driver->dnsmasqReloads, name)) &&
+        reload->timer == timer) {
+        reload->timer = -1;
+        reload->last = g_get_monotonic_time() / 1000;
+    } else {
+        reload = NULL;
+    }
+    networkDriverUnlock(driver);
+
+    if (!reload ||
+        !(obj = virNetworkObjFindByName(driver->networks, name)))
+        return;
+
+    dnsmasqPid = virNetworkObjGetDnsmasqPid(obj);
+    if (virNetworkObjIsActive(obj) && dnsmasqPid > 0) {
+        VIR_DEBUG("Reloading dnsmasq for network %s", name);
+        ignore_value(dnsmasqReload(dnsmasqPid));
+    }
+
+    virNetworkObjEndAPI(&obj);
+}
+
+
+/* networkScheduleDnsmasqReload:
+ *  Send a SIGHUP to dnsmasq, unless it was reloaded less than
+ *  dnsmasqReloadInterval seconds ago. In that case the SIGHUP is sent
+ *  once the interval is over, covering all changes made in between.
+ *
+ *  Returns 0 on success, -1 on failure.
+ */
+static int
+networkScheduleDnsmasqReload(virNetworkDriverStatePtr driver,
+                             virNetworkObjPtr obj)
+{
+    virNetworkDefPtr def = virNetworkObjGetDef(obj);
+    unsigned long long now = g_get_monotonic_time() / 1000;
+    unsigned long long interval = driver->dnsmasqReloadInterval * 1000ULL;
+    networkDnsmasqReloadPtr reload;
+    char *name = NULL;
+    int ret = -1;
+
+    networkDriverLock(driver);
+
+    if (!(reload = virHashLookup(driver->dnsmasqReloads, def->name))) {
+        reload = g_new0(networkDnsmasqReload, 1);
+        reload->timer = -1;
+        if (virHashAddEntry(driver->dnsmasqReloads, def->name, reload) < 0) {
+            g_free(reload);
+            goto cleanup;
+        }
+    }
+
+    if (reload->timer >= 0) {
+        VIR_DEBUG("dnsmasq reload for network %s already pending", def->name);
+        ret = 0;
+        goto cleanup;
+    }
+
+    if (reload->last + interval > now) {
+        name = g_strdup(def->name);
+        reload->timer = virEventAddTimeout(reload->last + interval - now,
+                                           networkDnsmasqReloadTimeout,
+                                           name, g_free);
+        if (reload->timer >= 0) {
+            VIR_DEBUG("Deferring dnsmasq reload for network %s by %llums",
+                      def->name, reload->last + interval - now);
+            ret = 0;
+            goto cleanup;
+        }
+
+        /* Without an event loop, just reload right away */
+        reload->timer = -1;
+        g_free(name);
+    }
+
+    reload->last = now;
+    ret = dnsmasqReload(virNetworkObjGetDnsmasqPid(obj));
+
+ cleanup:
+    networkDriverUnlock(driver);
+    return ret;
+}
+
+
 /* networkRefreshDhcpDaemon:
  *  Update dnsmasq config files, then send a SIGHUP so that it rereads
  *  them.   This only works for the dhcp-hostsfile and the
- *  addn-hosts file.
+ *  addn-hosts file. Only what changed is written out; hosts which
+ *  were just added are picked up by dnsmasq without a SIGHUP if it
+ *  watches the hosts directories, and SIGHUPs are rate limited by
+ *  networkScheduleDnsmasqReload().
  *
  *  Returns 0 on success, -1 on failure.
  */
@@ -1810,11 +1992,10 @@ networkRefreshDhcpDaemon(virNetworkDriverStatePtr driver,
     if (networkBuildDnsmasqHostsList(dctx, &def->dns) < 0)
         goto cleanup;
 
-    if ((ret = dnsmasqSave(dctx)) < 0)
+    if ((ret = dnsmasqUpdate(dctx)) <= 0)
         goto cleanup;
 
-    dnsmasqPid = virNetworkObjGetDnsmasqPid(obj);
-    ret = kill(dnsmasqPid, SIGHUP);
+    ret = networkScheduleDnsmasqReload(driver, obj);
  cleanup:
     dnsmasqContextFree(dctx);
     return ret;
@@ -2680,6 +2861,11 @@ networkShutdownNetworkVirtual(virNetworkDriverStatePtr driver,
     if (dnsmasqPid > 0)
         kill(dnsmasqPid, SIGTERM);
 
+    /* Forget about any reload that is still pending */
+    networkDriverLock(driver);
+    virHashRemoveEntry(driver->dnsmasqReloads, def->name);
+    networkDriverUnlock(driver);
+
     if (def->mac_specified) {
         char *macTapIfName = networkBridgeDummyNicName(def->bridge);
         if (macTapIfName) {
@@ -4248,17 +4434,16 @@ networkGetDHCPLeases(virNetworkPtr net,
     size_t nleases = 0;
     int rv = -1;
     size_t size = 0;
-    int custom_lease_file_len = 0;
     bool need_results = !!leases;
     long long currtime = 0;
     long long expirytime_tmp = -1;
     bool ipv6 = false;
-    char *lease_entries = NULL;
     char *custom_lease_file = NULL;
     const char *ip_tmp = NULL;
     const char *mac_tmp = NULL;
     virJSONValuePtr lease_tmp = NULL;
-    virJSONValuePtr leases_array = NULL;
+    virJSONValuePtr *leases_array = NULL;
+    virLeaseDBPtr db = NULL;
     virNetworkIPDefPtr ipdef_tmp = NULL;
     virNetworkDHCPLeasePtr lease = NULL;
     virNetworkDHCPLeasePtr *leases_ret = NULL;
@@ -4284,47 +4469,36 @@ networkGetDHCPLeases(virNetworkPtr net,
     /* Retrieve custom leases file location */
     custom_lease_file = networkDnsmasqLeaseFileNameCustom(driver, def->bridge);
 
-    /* Read entire contents */
-    if ((custom_lease_file_len = virFileReadAllQuiet(custom_lease_file,
-                                                     VIR_NETWORK_DHCP_LEASE_FILE_SIZE_MAX,
-                                                     &lease_entries)) < 0) {
-        /* Not all networks are guaranteed to have leases file.
-         * Only those which run dnsmasq. Therefore, if we failed
-         * to read the leases file, don't report error. Return 0
-         * leases instead. */
-        if (errno == ENOENT) {
-            rv = 0;
-        } else {
-            virReportSystemError(errno,
-                                 _("Unable to read leases file: %s"),
-                                 custom_lease_file);
+    /* Leases are cached per leases file and only the changes made by
+     * the leases helper since the last query are read in. Not all
+     * networks are guaranteed to have leases file, only those which run
+     * dnsmasq, a missing file simply yields no leases. The driver lock
+     * only guards the table, each database has a lock of its own so
+     * that queries on different networks don't wait for each other. */
+    networkDriverLock(driver);
+    if (!(db = virHashLookup(driver->leaseDBs, custom_lease_file))) {
+        if (!(db = virLeaseDBNew(custom_lease_file)) ||
+            virHashAddEntry(driver->leaseDBs, custom_lease_file, db) < 0) {
+            virObjectUnref(db);
+            db = NULL;
+            networkDriverUnlock(driver);
+            goto error;
         }
-        goto error;
     }
+    virObjectRef(db);
+    networkDriverUnlock(driver);
 
-    if (custom_lease_file_len) {
-        if (!(leases_array = virJSONValueFromString(lease_entries))) {
-            virReportError(VIR_ERR_INTERNAL_ERROR,
-                           _("invalid json in file: %s"), custom_lease_file);
-            goto error;
-        }
+    virObjectLock(db);
 
-        if (!virJSONValueIsArray(leases_array)) {
-            virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
-                           _("Malformed lease_entries array"));
-            goto error;
-        }
-        size = virJSONValueArraySize(leases_array);
-    }
+    if (virLeaseDBRefresh(db) < 0)
+        goto error;
+
+    leases_array = virLeaseDBGetLeases(db, &size);
 
     currtime = (long long)time(NULL);
 
     for (i = 0; i < size; i++) {
-        if (!(lease_tmp = virJSONValueArrayGet(leases_array, i))) {
-            virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
-                           _("failed to parse json"));
-            goto error;
-        }
+        lease_tmp = leases_array[i];
 
         if (!(mac_tmp = virJSONValueObjectGetString(lease_tmp, "mac-address"))) {
             /* leaseshelper program guarantees that lease will be stored only if
@@ -4412,10 +4586,13 @@ networkGetDHCPLeases(virNetworkPtr net,
     rv = nleases;
 
  cleanup:
+    if (db) {
+        virObjectUnlock(db);
+        virObjectUnref(db);
+    }
     VIR_FREE(lease);
-    VIR_FREE(lease_entries);
     VIR_FREE(custom_lease_file);
-    virJSONValueFree(leases_array);
+    VIR_FREE(leases_array);
 
     virNetworkObjEndAPI(&obj);
 
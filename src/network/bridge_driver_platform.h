@@ -24,6 +24,7 @@
 #include "internal.h"
 #include "virthread.h"
 #include "virdnsmasq.h"
+#include "virhash.h"
 #include "virnetworkobj.h"
 #include "object_event.h"
 
@@ -53,6 +54,15 @@ struct _virNetworkDriverState {
      */
     dnsmasqCapsPtr dnsmasqCaps;
 
+    /* Require lock, custom leases file path -> virLeaseDBPtr */
+    virHashTablePtr leaseDBs;
+
+    /* Immutable value, seconds between dnsmasq reloads */
+    unsigned int dnsmasqReloadInterval;
+
+    /* Require lock, network name -> networkDnsmasqReload */
+    virHashTablePtr dnsmasqReloads;
+
     /* Immutable pointer, self-locking APIs */
     virObjectEventStatePtr networkEventState;
 
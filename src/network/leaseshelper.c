@@ -86,7 +86,6 @@ main(int argc, char **argv)
     char *custom_lease_file = NULL;
     const char *ip = NULL;
     const char *mac = NULL;
-    const char *leases_str = NULL;
     const char *iaid = getenv("DNSMASQ_IAID");
     const char *clientid = getenv("DNSMASQ_CLIENT_ID");
     const char *interface = getenv("DNSMASQ_INTERFACE");
@@ -95,9 +94,9 @@ main(int argc, char **argv)
     int action = -1;
     int pid_file_fd = -1;
     int rv = EXIT_FAILURE;
-    bool delete = false;
     virJSONValuePtr lease_new = NULL;
-    virJSONValuePtr leases_array_new = NULL;
+    virJSONValuePtr leases_array = NULL;
+    virLeaseDBPtr db = NULL;
 
     virSetErrorFunc(NULL, NULL);
     virSetErrorLogPriorityFunc(NULL);
@@ -190,10 +189,14 @@ main(int argc, char **argv)
         if (!lease_new)
             break;
 
-        G_GNUC_FALLTHROUGH;
+        /* The new lease replaces any existing one for the same address */
+        if (virLeaseJournalAppend(custom_lease_file, lease_new) < 0)
+            goto cleanup;
+        break;
+
     case VIR_LEASE_ACTION_DEL:
-        /* Delete the corresponding lease, if it already exists */
-        delete = true;
+        if (virLeaseJournalAppendDelete(custom_lease_file, ip) < 0)
+            goto cleanup;
         break;
 
     case VIR_LEASE_ACTION_INIT:
@@ -201,43 +204,20 @@ main(int argc, char **argv)
         break;
     }
 
-    leases_array_new = virJSONValueNewArray();
-
-    if (virLeaseReadCustomLeaseFile(leases_array_new, custom_lease_file,
-                                    delete ? ip : NULL, &server_duid) < 0)
-        goto cleanup;
-
-    switch ((enum virLeaseActionFlags) action) {
-    case VIR_LEASE_ACTION_INIT:
-        if (virLeasePrintLeases(leases_array_new, server_duid) < 0)
+    /* Fold the journal back into the lease file once it has grown large
+     * enough, and whenever dnsmasq (re)starts anyway */
+    if (action == VIR_LEASE_ACTION_INIT ||
+        virLeaseJournalNeedsCompact(custom_lease_file)) {
+        if (!(db = virLeaseDBNew(custom_lease_file)) ||
+            virLeaseDBRefresh(db) < 0 ||
+            virLeaseDBCompact(db, &server_duid) < 0)
             goto cleanup;
+    }
 
-        break;
-
-    case VIR_LEASE_ACTION_OLD:
-    case VIR_LEASE_ACTION_ADD:
-        if (lease_new && virJSONValueArrayAppend(leases_array_new, lease_new) < 0) {
-            virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
-                           _("failed to create json"));
-            goto cleanup;
-        }
-        lease_new = NULL;
-
-        G_GNUC_FALLTHROUGH;
-    case VIR_LEASE_ACTION_DEL:
-        if (!(leases_str = virJSONValueToString(leases_array_new, true))) {
-            virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
-                           _("empty json array"));
-            goto cleanup;
-        }
-
-        /* Write to file */
-        if (virFileRewriteStr(custom_lease_file, 0644, leases_str) < 0)
+    if (action == VIR_LEASE_ACTION_INIT) {
+        if (!(leases_array = virLeaseDBToArray(db, &server_duid)) ||
+            virLeasePrintLeases(leases_array, server_duid) < 0)
             goto cleanup;
-        break;
-
-    case VIR_LEASE_ACTION_LAST:
-        break;
     }
 
     rv = EXIT_SUCCESS;
@@ -250,7 +230,8 @@ main(int argc, char **argv)
     VIR_FREE(server_duid);
     VIR_FREE(custom_lease_file);
     virJSONValueFree(lease_new);
-    virJSONValueFree(leases_array_new);
+    virJSONValueFree(leases_array);
+    virObjectUnref(db);
 
     return rv;
 }
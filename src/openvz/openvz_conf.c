@@ -592,7 +592,7 @@ int openvzLoadDomains(struct openvz_driver *driver)
             dom->pid = veid;
         }
         /* XXX OpenVZ doesn't appear to have concept of a transient domain */
-        dom->persistent = 1;
+        virDomainObjSetPersistent(dom, true);
 
         virDomainObjEndAPI(&dom);
         dom = NULL;
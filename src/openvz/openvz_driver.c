@@ -582,7 +582,7 @@ openvzDomainShutdownFlags(virDomainPtr dom,
     if (virRun(prog, NULL) < 0)
         goto cleanup;
 
-    vm->def->id = -1;
+    virDomainObjSetID(vm, -1);
     virDomainObjSetState(vm, VIR_DOMAIN_SHUTOFF, VIR_DOMAIN_SHUTOFF_SHUTDOWN);
     dom->id = -1;
     ret = 0;
@@ -870,7 +870,7 @@ openvzDomainDefineXMLFlags(virConnectPtr conn, const char *xml, unsigned int fla
                                    0, NULL)))
         goto cleanup;
     vmdef = NULL;
-    vm->persistent = 1;
+    virDomainObjSetPersistent(vm, true);
 
     if (openvzSetInitialConfig(vm->def) < 0) {
         VIR_ERROR(_("Error creating initial configuration"));
@@ -962,7 +962,7 @@ openvzDomainCreateXML(virConnectPtr conn, const char *xml,
     vmdef = NULL;
     /* All OpenVZ domains seem to be persistent - this is a bit of a violation
      * of this libvirt API which is intended for transient domain creation */
-    vm->persistent = 1;
+    virDomainObjSetPersistent(vm, true);
 
     if (openvzSetInitialConfig(vm->def) < 0) {
         VIR_ERROR(_("Error creating initial configuration"));
@@ -992,7 +992,7 @@ openvzDomainCreateXML(virConnectPtr conn, const char *xml,
         goto cleanup;
 
     vm->pid = strtoI(vm->def->name);
-    vm->def->id = vm->pid;
+    virDomainObjSetID(vm, vm->pid);
     virDomainObjSetState(vm, VIR_DOMAIN_RUNNING, VIR_DOMAIN_RUNNING_BOOTED);
 
     if (virDomainDefGetVcpusMax(vm->def) > 0) {
@@ -1048,7 +1048,7 @@ openvzDomainCreateWithFlags(virDomainPtr dom, unsigned int flags)
         goto cleanup;
 
     vm->pid = strtoI(vm->def->name);
-    vm->def->id = vm->pid;
+    virDomainObjSetID(vm, vm->pid);
     dom->id = vm->pid;
     virDomainObjSetState(vm, VIR_DOMAIN_RUNNING, VIR_DOMAIN_RUNNING_BOOTED);
     ret = 0;
@@ -1088,7 +1088,7 @@ openvzDomainUndefineFlags(virDomainPtr dom,
         goto cleanup;
 
     if (virDomainObjIsActive(vm))
-        vm->persistent = 0;
+        virDomainObjSetPersistent(vm, false);
     else
         virDomainObjListRemove(driver->domains, vm);
 
@@ -2267,7 +2267,7 @@ openvzDomainMigrateFinish3Params(virConnectPtr dconn,
         goto cleanup;
     }
 
-    vm->def->id = strtoI(vm->def->name);
+    virDomainObjSetID(vm, strtoI(vm->def->name));
     virDomainObjSetState(vm, VIR_DOMAIN_RUNNING, VIR_DOMAIN_RUNNING_MIGRATED);
 
     dom = virGetDomain(dconn, vm->def->name, vm->def->uuid, vm->def->id);
@@ -2312,7 +2312,7 @@ openvzDomainMigrateConfirm3Params(virDomainPtr domain,
         goto cleanup;
     }
 
-    vm->def->id = -1;
+    virDomainObjSetID(vm, -1);
 
     VIR_DEBUG("Domain '%s' successfully migrated", vm->def->name);
 
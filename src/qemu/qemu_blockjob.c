@@ -701,6 +701,27 @@ qemuBlockJobRewriteConfigDiskSource(virDomainObjPtr vm,
 }
 
 
+/**
+ * qemuBlockJobInvalidateMetadataCache:
+ * @job: block job data
+ *
+ * The job may have rewritten image headers or changed the backing chain
+ * of any of the images it touched. Drop the cached headers so that
+ * subsequent probes re-read them.
+ */
+static void
+qemuBlockJobInvalidateMetadataCache(qemuBlockJobDataPtr job)
+{
+    if (job->disk) {
+        virStorageFileMetadataCacheInvalidate(job->disk->src);
+        virStorageFileMetadataCacheInvalidate(job->disk->mirror);
+    }
+
+    virStorageFileMetadataCacheInvalidate(job->chain);
+    virStorageFileMetadataCacheInvalidate(job->mirrorChain);
+}
+
+
 static void
 qemuBlockJobEventProcessLegacyCompleted(virQEMUDriverPtr driver,
                                         virDomainObjPtr vm,
@@ -797,6 +818,8 @@ qemuBlockJobEventProcessLegacy(virQEMUDriverPtr driver,
     job->state = job->newstate;
     job->newstate = -1;
 
+    qemuBlockJobInvalidateMetadataCache(job);
+
     /* If we completed a block pull or commit, then update the XML
      * to match.  */
     switch ((virConnectDomainEventBlockJobStatus) job->state) {
@@ -1589,6 +1612,8 @@ qemuBlockJobEventProcessConcluded(qemuBlockJobDataPtr job,
 
     VIR_DEBUG("handling job '%s' state '%d' newstate '%d'", job->name, job->state, job->newstate);
 
+    qemuBlockJobInvalidateMetadataCache(job);
+
     qemuBlockJobEventProcessConcludedTransition(job, driver, vm, asyncJob,
                                                 progressCurrent, progressTotal);
 
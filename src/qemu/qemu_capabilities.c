@@ -658,6 +658,9 @@ struct _virQEMUCaps {
 
     virArch arch;
 
+    /* when the cached data was last successfully validated */
+    unsigned long long lastValidated;
+
     virQEMUDomainCapsCachePtr domCapsCache;
 
     size_t ngicCapabilities;
@@ -3970,6 +3973,11 @@ struct _virQEMUCapsCachePriv {
     /* cache whether /dev/kvm is usable as runUid:runGuid */
     virTristateBool kvmUsable;
     time_t kvmCtime;
+
+    /* minimum time between validations of cached data in milliseconds */
+    unsigned int validateInterval;
+    /* when microcodeVersion was last refreshed */
+    unsigned long long microcodeChecked;
 };
 typedef struct _virQEMUCapsCachePriv virQEMUCapsCachePriv;
 typedef virQEMUCapsCachePriv *virQEMUCapsCachePrivPtr;
@@ -4505,12 +4513,776 @@ virQEMUCapsFormatCache(virQEMUCapsPtr qemuCaps)
 }
 
 
+/*
+ * Binary capabilities cache
+ *
+ * The XML cache is kept as the canonical format, but parsing it for every
+ * emulator on each daemon start is expensive. Therefore a binary copy of
+ * the same data is stored next to it, which can be mapped into memory and
+ * decoded without any XML parsing. The format is host specific (native
+ * byte order) and is tied to the set of capability flags known by the
+ * daemon which wrote it. Whenever the binary copy is missing or does not
+ * match, the XML cache is used instead.
+ *
+ * All values are stored as 32 or 64 bit integers, strings are stored as
+ * their length including the terminating NUL byte (0 for NULL) followed
+ * by the NUL terminated string itself.
+ */
+#define VIR_QEMU_CAPS_CACHE_BIN_MAGIC "LVQCAPS"
+#define VIR_QEMU_CAPS_CACHE_BIN_VERSION 1
+
+typedef struct _virQEMUCapsBinReader virQEMUCapsBinReader;
+typedef virQEMUCapsBinReader *virQEMUCapsBinReaderPtr;
+struct _virQEMUCapsBinReader {
+    const char *filename;
+    const char *data;
+    size_t len;
+    size_t pos;
+};
+
+
+static void
+virQEMUCapsBinPutU32(GByteArray *buf,
+                     uint32_t val)
+{
+    g_byte_array_append(buf, (const guint8 *)&val, sizeof(val));
+}
+
+
+static void
+virQEMUCapsBinPutU64(GByteArray *buf,
+                     uint64_t val)
+{
+    g_byte_array_append(buf, (const guint8 *)&val, sizeof(val));
+}
+
+
+static void
+virQEMUCapsBinPutString(GByteArray *buf,
+                        const char *str)
+{
+    size_t len;
+
+    if (!str) {
+        virQEMUCapsBinPutU32(buf, 0);
+        return;
+    }
+
+    len = strlen(str) + 1;
+    virQEMUCapsBinPutU32(buf, len);
+    g_byte_array_append(buf, (const guint8 *)str, len);
+}
+
+
+static int
+virQEMUCapsBinGet(virQEMUCapsBinReaderPtr reader,
+                  void *val,
+                  size_t size)
+{
+    if (reader->len - reader->pos < size) {
+        virReportError(VIR_ERR_INTERNAL_ERROR,
+                       _("truncated QEMU capabilities cache '%s'"),
+                       reader->filename);
+        return -1;
+    }
+
+    memcpy(val, reader->data + reader->pos, size);
+    reader->pos += size;
+    return 0;
+}
+
+
+static int
+virQEMUCapsBinGetU32(virQEMUCapsBinReaderPtr reader,
+                     uint32_t *val)
+{
+    return virQEMUCapsBinGet(reader, val, sizeof(*val));
+}
+
+
+static int
+virQEMUCapsBinGetU64(virQEMUCapsBinReaderPtr reader,
+                     uint64_t *val)
+{
+    return virQEMUCapsBinGet(reader, val, sizeof(*val));
+}
+
+
+static int
+virQEMUCapsBinGetUInt(virQEMUCapsBinReaderPtr reader,
+                      unsigned int *val)
+{
+    uint32_t v;
+
+    if (virQEMUCapsBinGetU32(reader, &v) < 0)
+        return -1;
+
+    *val = v;
+    return 0;
+}
+
+
+static int
+virQEMUCapsBinGetBool(virQEMUCapsBinReaderPtr reader,
+                      bool *val)
+{
+    uint32_t v;
+
+    if (virQEMUCapsBinGetU32(reader, &v) < 0)
+        return -1;
+
+    *val = !!v;
+    return 0;
+}
+
+
+static int
+virQEMUCapsBinGetString(virQEMUCapsBinReaderPtr reader,
+                        char **str)
+{
+    uint32_t len;
+
+    *str = NULL;
+
+    if (virQEMUCapsBinGetU32(reader, &len) < 0)
+        return -1;
+
+    if (len == 0)
+        return 0;
+
+    if (reader->len - reader->pos < len ||
+        reader->data[reader->pos + len - 1] != '\0') {
+        virReportError(VIR_ERR_INTERNAL_ERROR,
+                       _("malformed string in QEMU capabilities cache '%s'"),
+                       reader->filename);
+        return -1;
+    }
+
+    *str = g_strndup(reader->data + reader->pos, len - 1);
+    reader->pos += len;
+    return 0;
+}
+
+
+static void
+virQEMUCapsFormatBinaryAccel(virQEMUCapsPtr qemuCaps,
+                             GByteArray *buf,
+                             virDomainVirtType type)
+{
+    virQEMUCapsAccelPtr caps = virQEMUCapsGetAccel(qemuCaps, type);
+    qemuMonitorCPUModelInfoPtr model = caps->hostCPU.info;
+    qemuMonitorCPUDefsPtr defs = caps->cpuModels;
+    size_t i;
+    size_t j;
+
+    virQEMUCapsBinPutU32(buf, !!model);
+    if (model) {
+        virQEMUCapsBinPutString(buf, model->name);
+        virQEMUCapsBinPutU32(buf, model->migratability);
+        virQEMUCapsBinPutU32(buf, model->nprops);
+
+        for (i = 0; i < model->nprops; i++) {
+            qemuMonitorCPUPropertyPtr prop = model->props + i;
+
+            virQEMUCapsBinPutString(buf, prop->name);
+            virQEMUCapsBinPutU32(buf, prop->type);
+
+            switch (prop->type) {
+            case QEMU_MONITOR_CPU_PROPERTY_BOOLEAN:
+                virQEMUCapsBinPutU32(buf, prop->value.boolean);
+                break;
+
+            case QEMU_MONITOR_CPU_PROPERTY_STRING:
+                virQEMUCapsBinPutString(buf, prop->value.string);
+                break;
+
+            case QEMU_MONITOR_CPU_PROPERTY_NUMBER:
+                virQEMUCapsBinPutU64(buf, prop->value.number);
+                break;
+
+            case QEMU_MONITOR_CPU_PROPERTY_LAST:
+                break;
+            }
+
+            virQEMUCapsBinPutU32(buf, prop->migratable);
+        }
+    }
+
+    virQEMUCapsBinPutU32(buf, defs ? defs->ncpus : 0);
+    for (i = 0; defs && i < defs->ncpus; i++) {
+        qemuMonitorCPUDefInfoPtr cpu = defs->cpus + i;
+        size_t nblockers = 0;
+
+        if (cpu->blockers)
+            nblockers = virStringListLength((const char * const *)cpu->blockers);
+
+        virQEMUCapsBinPutString(buf, cpu->name);
+        virQEMUCapsBinPutString(buf, cpu->type);
+        virQEMUCapsBinPutU32(buf, cpu->usable);
+        virQEMUCapsBinPutU32(buf, nblockers);
+        for (j = 0; j < nblockers; j++)
+            virQEMUCapsBinPutString(buf, cpu->blockers[j]);
+    }
+
+    virQEMUCapsBinPutU32(buf, caps->nmachineTypes);
+    for (i = 0; i < caps->nmachineTypes; i++) {
+        virQEMUCapsMachineTypePtr machine = caps->machineTypes + i;
+
+        virQEMUCapsBinPutString(buf, machine->name);
+        virQEMUCapsBinPutString(buf, machine->alias);
+        virQEMUCapsBinPutU32(buf, machine->maxCpus);
+        virQEMUCapsBinPutU32(buf, machine->hotplugCpus);
+        virQEMUCapsBinPutU32(buf, machine->qemuDefault);
+        virQEMUCapsBinPutString(buf, machine->defaultCPU);
+    }
+}
+
+
+static GByteArray *
+virQEMUCapsFormatBinaryCache(virQEMUCapsPtr qemuCaps)
+{
+    GByteArray *buf = g_byte_array_new();
+    virSEVCapabilityPtr sev = qemuCaps->sevCapabilities;
+    ssize_t flag = -1;
+    size_t i;
+
+    g_byte_array_append(buf, (const guint8 *)VIR_QEMU_CAPS_CACHE_BIN_MAGIC,
+                        sizeof(VIR_QEMU_CAPS_CACHE_BIN_MAGIC));
+    virQEMUCapsBinPutU32(buf, VIR_QEMU_CAPS_CACHE_BIN_VERSION);
+    virQEMUCapsBinPutU32(buf, QEMU_CAPS_LAST);
+
+    virQEMUCapsBinPutString(buf, qemuCaps->binary);
+    virQEMUCapsBinPutU64(buf, qemuCaps->ctime);
+    virQEMUCapsBinPutU64(buf, qemuCaps->libvirtCtime);
+    virQEMUCapsBinPutU32(buf, qemuCaps->libvirtVersion);
+
+    virQEMUCapsBinPutU32(buf, virBitmapCountBits(qemuCaps->flags));
+    while ((flag = virBitmapNextSetBit(qemuCaps->flags, flag)) >= 0)
+        virQEMUCapsBinPutU32(buf, flag);
+
+    virQEMUCapsBinPutU32(buf, qemuCaps->version);
+    virQEMUCapsBinPutU32(buf, qemuCaps->kvmVersion);
+    virQEMUCapsBinPutU32(buf, qemuCaps->microcodeVersion);
+    virQEMUCapsBinPutString(buf, qemuCaps->package);
+    virQEMUCapsBinPutString(buf, qemuCaps->kernelVersion);
+    virQEMUCapsBinPutU32(buf, qemuCaps->arch);
+
+    virQEMUCapsFormatBinaryAccel(qemuCaps, buf, VIR_DOMAIN_VIRT_KVM);
+    virQEMUCapsFormatBinaryAccel(qemuCaps, buf, VIR_DOMAIN_VIRT_QEMU);
+
+    virQEMUCapsBinPutU32(buf, qemuCaps->ngicCapabilities);
+    for (i = 0; i < qemuCaps->ngicCapabilities; i++) {
+        virQEMUCapsBinPutU32(buf, qemuCaps->gicCapabilities[i].version);
+        virQEMUCapsBinPutU32(buf, qemuCaps->gicCapabilities[i].implementation);
+    }
+
+    virQEMUCapsBinPutU32(buf, !!sev);
+    if (sev) {
+        virQEMUCapsBinPutU32(buf, sev->cbitpos);
+        virQEMUCapsBinPutU32(buf, sev->reduced_phys_bits);
+        virQEMUCapsBinPutString(buf, sev->pdh);
+        virQEMUCapsBinPutString(buf, sev->cert_chain);
+    }
+
+    virQEMUCapsBinPutU32(buf, qemuCaps->kvmSupportsNesting);
+
+    return buf;
+}
+
+
+static int
+virQEMUCapsLoadBinaryHostCPUModelInfo(virQEMUCapsAccelPtr caps,
+                                      virQEMUCapsBinReaderPtr reader)
+{
+    qemuMonitorCPUModelInfoPtr hostCPU = NULL;
+    bool present;
+    uint32_t nprops;
+    int ret = -1;
+    size_t i;
+
+    if (virQEMUCapsBinGetBool(reader, &present) < 0)
+        return -1;
+
+    if (!present)
+        return 0;
+
+    if (VIR_ALLOC(hostCPU) < 0)
+        return -1;
+
+    if (virQEMUCapsBinGetString(reader, &hostCPU->name) < 0 ||
+        virQEMUCapsBinGetBool(reader, &hostCPU->migratability) < 0 ||
+        virQEMUCapsBinGetU32(reader, &nprops) < 0)
+        goto cleanup;
+
+    if (!hostCPU->name || nprops > reader->len) {
+        virReportError(VIR_ERR_INTERNAL_ERROR,
+                       _("malformed host CPU model in QEMU capabilities "
+                         "cache '%s'"), reader->filename);
+        goto cleanup;
+    }
+
+    if (nprops > 0 && VIR_ALLOC_N(hostCPU->props, nprops) < 0)
+        goto cleanup;
+    hostCPU->nprops = nprops;
+
+    for (i = 0; i < nprops; i++) {
+        qemuMonitorCPUPropertyPtr prop = hostCPU->props + i;
+        uint32_t type;
+        uint32_t migratable;
+        uint64_t number;
+
+        if (virQEMUCapsBinGetString(reader, &prop->name) < 0 ||
+            virQEMUCapsBinGetU32(reader, &type) < 0)
+            goto cleanup;
+
+        if (!prop->name || type >= QEMU_MONITOR_CPU_PROPERTY_LAST) {
+            virReportError(VIR_ERR_INTERNAL_ERROR,
+                           _("malformed host CPU model property in QEMU "
+                             "capabilities cache '%s'"), reader->filename);
+            goto cleanup;
+        }
+        prop->type = type;
+
+        switch (prop->type) {
+        case QEMU_MONITOR_CPU_PROPERTY_BOOLEAN:
+            if (virQEMUCapsBinGetBool(reader, &prop->value.boolean) < 0)
+                goto cleanup;
+            break;
+
+        case QEMU_MONITOR_CPU_PROPERTY_STRING:
+            if (virQEMUCapsBinGetString(reader, &prop->value.string) < 0)
+                goto cleanup;
+            if (!prop->value.string) {
+                virReportError(VIR_ERR_INTERNAL_ERROR,
+                               _("invalid string value for '%s' host CPU "
+                                 "model property in QEMU capabilities cache"),
+                               prop->name);
+                goto cleanup;
+            }
+            break;
+
+        case QEMU_MONITOR_CPU_PROPERTY_NUMBER:
+            if (virQEMUCapsBinGetU64(reader, &number) < 0)
+                goto cleanup;
+            prop->value.number = number;
+            break;
+
+        case QEMU_MONITOR_CPU_PROPERTY_LAST:
+            break;
+        }
+
+        if (virQEMUCapsBinGetU32(reader, &migratable) < 0)
+            goto cleanup;
+        if (migratable >= VIR_TRISTATE_BOOL_LAST) {
+            virReportError(VIR_ERR_INTERNAL_ERROR,
+                           _("unknown migratable value for '%s' host "
+                             "CPU model property"),
+                           prop->name);
+            goto cleanup;
+        }
+        prop->migratable = migratable;
+    }
+
+    caps->hostCPU.info = g_steal_pointer(&hostCPU);
+    ret = 0;
+
+ cleanup:
+    qemuMonitorCPUModelInfoFree(hostCPU);
+    return ret;
+}
+
+
+static int
+virQEMUCapsLoadBinaryCPUModels(virQEMUCapsAccelPtr caps,
+                               virQEMUCapsBinReaderPtr reader)
+{
+    g_autoptr(qemuMonitorCPUDefs) defs = NULL;
+    uint32_t ncpus;
+    size_t i;
+
+    if (virQEMUCapsBinGetU32(reader, &ncpus) < 0)
+        return -1;
+
+    if (ncpus == 0)
+        return 0;
+
+    if (ncpus > reader->len) {
+        virReportError(VIR_ERR_INTERNAL_ERROR,
+                       _("malformed CPU models in QEMU capabilities "
+                         "cache '%s'"), reader->filename);
+        return -1;
+    }
+
+    if (!(defs = qemuMonitorCPUDefsNew(ncpus)))
+        return -1;
+
+    for (i = 0; i < ncpus; i++) {
+        qemuMonitorCPUDefInfoPtr cpu = defs->cpus + i;
+        uint32_t usable;
+        uint32_t nblockers;
+        size_t j;
+
+        if (virQEMUCapsBinGetString(reader, &cpu->name) < 0 ||
+            virQEMUCapsBinGetString(reader, &cpu->type) < 0 ||
+            virQEMUCapsBinGetU32(reader, &usable) < 0 ||
+            virQEMUCapsBinGetU32(reader, &nblockers) < 0)
+            return -1;
+
+        if (!cpu->name ||
+            usable >= VIR_DOMCAPS_CPU_USABLE_LAST ||
+            nblockers > reader->len) {
+            virReportError(VIR_ERR_INTERNAL_ERROR,
+                           _("malformed CPU model in QEMU capabilities "
+                             "cache '%s'"), reader->filename);
+            return -1;
+        }
+        cpu->usable = usable;
+
+        if (nblockers == 0)
+            continue;
+
+        if (VIR_ALLOC_N(cpu->blockers, nblockers + 1) < 0)
+            return -1;
+
+        for (j = 0; j < nblockers; j++) {
+            if (virQEMUCapsBinGetString(reader, &cpu->blockers[j]) < 0)
+                return -1;
+
+            if (!cpu->blockers[j]) {
+                virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                               _("missing blocker name in QEMU "
+                                 "capabilities cache"));
+                return -1;
+            }
+        }
+    }
+
+    caps->cpuModels = g_steal_pointer(&defs);
+    return 0;
+}
+
+
+static int
+virQEMUCapsLoadBinaryMachines(virQEMUCapsAccelPtr caps,
+                              virQEMUCapsBinReaderPtr reader)
+{
+    uint32_t nmachines;
+    size_t i;
+
+    if (virQEMUCapsBinGetU32(reader, &nmachines) < 0)
+        return -1;
+
+    if (nmachines == 0)
+        return 0;
+
+    if (nmachines > reader->len) {
+        virReportError(VIR_ERR_INTERNAL_ERROR,
+                       _("malformed machine types in QEMU capabilities "
+                         "cache '%s'"), reader->filename);
+        return -1;
+    }
+
+    if (VIR_ALLOC_N(caps->machineTypes, nmachines) < 0)
+        return -1;
+    caps->nmachineTypes = nmachines;
+
+    for (i = 0; i < nmachines; i++) {
+        virQEMUCapsMachineTypePtr machine = caps->machineTypes + i;
+
+        if (virQEMUCapsBinGetString(reader, &machine->name) < 0 ||
+            virQEMUCapsBinGetString(reader, &machine->alias) < 0 ||
+            virQEMUCapsBinGetUInt(reader, &machine->maxCpus) < 0 ||
+            virQEMUCapsBinGetBool(reader, &machine->hotplugCpus) < 0 ||
+            virQEMUCapsBinGetBool(reader, &machine->qemuDefault) < 0 ||
+            virQEMUCapsBinGetString(reader, &machine->defaultCPU) < 0)
+            return -1;
+
+        if (!machine->name) {
+            virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                           _("missing machine name in QEMU capabilities cache"));
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+
+static int
+virQEMUCapsLoadBinaryAccel(virQEMUCapsPtr qemuCaps,
+                           virQEMUCapsBinReaderPtr reader,
+                           virDomainVirtType type)
+{
+    virQEMUCapsAccelPtr caps = virQEMUCapsGetAccel(qemuCaps, type);
+
+    if (virQEMUCapsLoadBinaryHostCPUModelInfo(caps, reader) < 0 ||
+        virQEMUCapsLoadBinaryCPUModels(caps, reader) < 0 ||
+        virQEMUCapsLoadBinaryMachines(caps, reader) < 0)
+        return -1;
+
+    return 0;
+}
+
+
+static int
+virQEMUCapsLoadBinaryData(virQEMUCapsPtr qemuCaps,
+                          virQEMUCapsBinReaderPtr reader)
+{
+    g_autofree char *binary = NULL;
+    uint64_t ctime;
+    uint64_t libvirtCtime;
+    uint32_t nflags;
+    uint32_t arch;
+    uint32_t ngic;
+    bool sev;
+    size_t i;
+
+    if (virQEMUCapsBinGetString(reader, &binary) < 0)
+        return -1;
+
+    if (STRNEQ_NULLABLE(binary, qemuCaps->binary)) {
+        virReportError(VIR_ERR_INTERNAL_ERROR,
+                       _("Expected caps for '%s' but saw '%s'"),
+                       qemuCaps->binary, NULLSTR(binary));
+        return -1;
+    }
+
+    if (virQEMUCapsBinGetU64(reader, &ctime) < 0 ||
+        virQEMUCapsBinGetU64(reader, &libvirtCtime) < 0 ||
+        virQEMUCapsBinGetUInt(reader, &qemuCaps->libvirtVersion) < 0 ||
+        virQEMUCapsBinGetU32(reader, &nflags) < 0)
+        return -1;
+
+    qemuCaps->ctime = (time_t)ctime;
+    qemuCaps->libvirtCtime = (time_t)libvirtCtime;
+
+    for (i = 0; i < nflags; i++) {
+        uint32_t flag;
+
+        if (virQEMUCapsBinGetU32(reader, &flag) < 0)
+            return -1;
+
+        if (flag >= QEMU_CAPS_LAST) {
+            virReportError(VIR_ERR_INTERNAL_ERROR,
+                           _("Unknown qemu capabilities flag %u"), flag);
+            return -1;
+        }
+        virQEMUCapsSet(qemuCaps, flag);
+    }
+
+    if (virQEMUCapsBinGetUInt(reader, &qemuCaps->version) < 0 ||
+        virQEMUCapsBinGetUInt(reader, &qemuCaps->kvmVersion) < 0 ||
+        virQEMUCapsBinGetUInt(reader, &qemuCaps->microcodeVersion) < 0 ||
+        virQEMUCapsBinGetString(reader, &qemuCaps->package) < 0 ||
+        virQEMUCapsBinGetString(reader, &qemuCaps->kernelVersion) < 0 ||
+        virQEMUCapsBinGetU32(reader, &arch) < 0)
+        return -1;
+
+    if (arch == VIR_ARCH_NONE || arch >= VIR_ARCH_LAST) {
+        virReportError(VIR_ERR_INTERNAL_ERROR,
+                       _("unknown arch %u in QEMU capabilities cache"), arch);
+        return -1;
+    }
+    qemuCaps->arch = arch;
+
+    if (virQEMUCapsLoadBinaryAccel(qemuCaps, reader, VIR_DOMAIN_VIRT_KVM) < 0 ||
+        virQEMUCapsLoadBinaryAccel(qemuCaps, reader, VIR_DOMAIN_VIRT_QEMU) < 0)
+        return -1;
+
+    if (virQEMUCapsBinGetU32(reader, &ngic) < 0)
+        return -1;
+
+    if (ngic > reader->len) {
+        virReportError(VIR_ERR_INTERNAL_ERROR,
+                       _("malformed GIC capabilities in QEMU capabilities "
+                         "cache '%s'"), reader->filename);
+        return -1;
+    }
+
+    if (ngic > 0) {
+        if (VIR_ALLOC_N(qemuCaps->gicCapabilities, ngic) < 0)
+            return -1;
+        qemuCaps->ngicCapabilities = ngic;
+
+        for (i = 0; i < ngic; i++) {
+            virGICCapabilityPtr cap = &qemuCaps->gicCapabilities[i];
+            uint32_t version;
+            uint32_t implementation;
+
+            if (virQEMUCapsBinGetU32(reader, &version) < 0 ||
+                virQEMUCapsBinGetU32(reader, &implementation) < 0)
+                return -1;
+
+            cap->version = version;
+            cap->implementation = implementation;
+        }
+    }
+
+    if (virQEMUCapsBinGetBool(reader, &sev) < 0)
+        return -1;
+
+    if (sev) {
+        g_autoptr(virSEVCapability) sevCaps = NULL;
+
+        if (VIR_ALLOC(sevCaps) < 0)
+            return -1;
+
+        if (virQEMUCapsBinGetUInt(reader, &sevCaps->cbitpos) < 0 ||
+            virQEMUCapsBinGetUInt(reader, &sevCaps->reduced_phys_bits) < 0 ||
+            virQEMUCapsBinGetString(reader, &sevCaps->pdh) < 0 ||
+            virQEMUCapsBinGetString(reader, &sevCaps->cert_chain) < 0)
+            return -1;
+
+        if (!sevCaps->pdh || !sevCaps->cert_chain) {
+            virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                           _("missing SEV information "
+                             "in QEMU capabilities cache"));
+            return -1;
+        }
+
+        qemuCaps->sevCapabilities = g_steal_pointer(&sevCaps);
+    }
+
+    if (virQEMUCapsBinGetBool(reader, &qemuCaps->kvmSupportsNesting) < 0)
+        return -1;
+
+    if (reader->pos != reader->len) {
+        virReportError(VIR_ERR_INTERNAL_ERROR,
+                       _("trailing data in QEMU capabilities cache '%s'"),
+                       reader->filename);
+        return -1;
+    }
+
+    return 0;
+}
+
+
+/**
+ * virQEMUCapsLoadBinaryCache:
+ * @hostArch: host architecture
+ * @qemuCaps: freshly allocated capabilities object to fill
+ * @filename: binary cache file
+ *
+ * Loads capabilities from a binary cache file created by
+ * virQEMUCapsSaveBinaryCache. The file is mapped into memory and decoded
+ * directly.
+ *
+ * Returns 1 if the capabilities were loaded, 0 if @filename does not exist
+ * or was written in a different format and the XML cache should be used
+ * instead, and -1 on error (@qemuCaps may be partially filled in such
+ * case).
+ */
+int
+virQEMUCapsLoadBinaryCache(virArch hostArch,
+                           virQEMUCapsPtr qemuCaps,
+                           const char *filename)
+{
+    g_autoptr(GError) gerr = NULL;
+    GMappedFile *file = NULL;
+    virQEMUCapsBinReader reader = { .filename = filename };
+    char magic[sizeof(VIR_QEMU_CAPS_CACHE_BIN_MAGIC)];
+    uint32_t version;
+    uint32_t ncaps;
+    int ret = -1;
+
+    if (!(file = g_mapped_file_new(filename, FALSE, &gerr))) {
+        if (g_error_matches(gerr, G_FILE_ERROR, G_FILE_ERROR_NOENT)) {
+            VIR_DEBUG("No binary QEMU capabilities cache '%s'", filename);
+            return 0;
+        }
+
+        virReportError(VIR_ERR_INTERNAL_ERROR,
+                       _("Unable to map QEMU capabilities cache: %s"),
+                       gerr->message);
+        return -1;
+    }
+
+    reader.data = g_mapped_file_get_contents(file);
+    reader.len = g_mapped_file_get_length(file);
+
+    if (virQEMUCapsBinGet(&reader, magic, sizeof(magic)) < 0 ||
+        virQEMUCapsBinGetU32(&reader, &version) < 0 ||
+        virQEMUCapsBinGetU32(&reader, &ncaps) < 0)
+        goto cleanup;
+
+    if (memcmp(magic, VIR_QEMU_CAPS_CACHE_BIN_MAGIC, sizeof(magic)) != 0 ||
+        version != VIR_QEMU_CAPS_CACHE_BIN_VERSION ||
+        ncaps != QEMU_CAPS_LAST) {
+        VIR_DEBUG("Binary QEMU capabilities cache '%s' uses a different "
+                  "format (version=%u, flags=%u)", filename, version, ncaps);
+        ret = 0;
+        goto cleanup;
+    }
+
+    if (virQEMUCapsLoadBinaryData(qemuCaps, &reader) < 0)
+        goto cleanup;
+
+    virQEMUCapsInitHostCPUModel(qemuCaps, hostArch, VIR_DOMAIN_VIRT_KVM);
+    virQEMUCapsInitHostCPUModel(qemuCaps, hostArch, VIR_DOMAIN_VIRT_QEMU);
+
+    ret = 1;
+
+ cleanup:
+    g_mapped_file_unref(file);
+    return ret;
+}
+
+
+static int
+virQEMUCapsSaveBinaryCacheHelper(int fd,
+                                 const void *opaque)
+{
+    const GByteArray *buf = opaque;
+
+    if (safewrite(fd, buf->data, buf->len) < 0)
+        return -1;
+
+    return 0;
+}
+
+
+/**
+ * virQEMUCapsSaveBinaryCache:
+ * @qemuCaps: capabilities to store
+ * @filename: binary cache file
+ *
+ * Stores @qemuCaps in the binary cache format into @filename.
+ *
+ * Returns 0 on success, -1 on error.
+ */
+int
+virQEMUCapsSaveBinaryCache(virQEMUCapsPtr qemuCaps,
+                           const char *filename)
+{
+    GByteArray *buf = virQEMUCapsFormatBinaryCache(qemuCaps);
+    int ret;
+
+    ret = virFileRewrite(filename, 0600, virQEMUCapsSaveBinaryCacheHelper, buf);
+
+    g_byte_array_unref(buf);
+    return ret;
+}
+
+
+/* Name of the binary cache stored next to the XML cache @filename */
+static char *
+virQEMUCapsBinaryCacheName(const char *filename)
+{
+    g_autofree char *base = g_strdup(filename);
+
+    virStringStripSuffix(base, ".xml");
+
+    return g_strdup_printf("%s.bin", base);
+}
+
+
 static int
 virQEMUCapsSaveFile(void *data,
                     const char *filename,
                     void *privData G_GNUC_UNUSED)
 {
     virQEMUCapsPtr qemuCaps = data;
+    g_autofree char *binfile = NULL;
     char *xml = NULL;
     int ret = -1;
 
@@ -4523,6 +5295,15 @@ virQEMUCapsSaveFile(void *data,
         goto cleanup;
     }
 
+    /* The binary cache is only an optimization, the XML cache is enough */
+    binfile = virQEMUCapsBinaryCacheName(filename);
+    if (virQEMUCapsSaveBinaryCache(qemuCaps, binfile) < 0) {
+        VIR_WARN("Failed to save binary caps '%s' for '%s': %s",
+                 binfile, qemuCaps->binary, virGetLastErrorMessage());
+        virResetLastError();
+        unlink(binfile);
+    }
+
     VIR_DEBUG("Saved caps '%s' for '%s' with (%lld, %lld)",
               filename, qemuCaps->binary,
               (long long)qemuCaps->ctime,
@@ -4619,11 +5400,9 @@ virQEMUCapsKVMUsable(virQEMUCapsCachePrivPtr priv)
 
 
 static bool
-virQEMUCapsIsValid(void *data,
-                   void *privData)
+virQEMUCapsCheckValid(virQEMUCapsPtr qemuCaps,
+                      virQEMUCapsCachePrivPtr priv)
 {
-    virQEMUCapsPtr qemuCaps = data;
-    virQEMUCapsCachePrivPtr priv = privData;
     bool kvmUsable;
     struct stat sb;
     bool kvmSupportsNesting;
@@ -4719,6 +5498,37 @@ virQEMUCapsIsValid(void *data,
 }
 
 
+/* Monotonic time in milliseconds used for rate limiting cache validation */
+static unsigned long long
+virQEMUCapsCacheNow(void)
+{
+    return g_get_monotonic_time() / 1000;
+}
+
+
+static bool
+virQEMUCapsIsValid(void *data,
+                   void *privData)
+{
+    virQEMUCapsPtr qemuCaps = data;
+    virQEMUCapsCachePrivPtr priv = privData;
+    unsigned long long now = virQEMUCapsCacheNow();
+
+    /* Checking the validity involves several syscalls and is done on
+     * every cache lookup, skip it if it was done recently enough. */
+    if (priv->validateInterval > 0 &&
+        qemuCaps->lastValidated > 0 &&
+        now - qemuCaps->lastValidated < priv->validateInterval)
+        return true;
+
+    if (!virQEMUCapsCheckValid(qemuCaps, priv))
+        return false;
+
+    qemuCaps->lastValidated = now;
+    return true;
+}
+
+
 /**
  * virQEMUCapsInitQMPArch:
  * @qemuCaps: QEMU capabilities
@@ -5211,10 +6021,26 @@ virQEMUCapsLoadFile(const char *filename,
 {
     virQEMUCapsPtr qemuCaps = virQEMUCapsNewBinary(binary);
     virQEMUCapsCachePrivPtr priv = privData;
+    g_autofree char *binfile = virQEMUCapsBinaryCacheName(filename);
+    int rc;
 
     if (!qemuCaps)
         return NULL;
 
+    if ((rc = virQEMUCapsLoadBinaryCache(priv->hostArch, qemuCaps, binfile)) > 0)
+        return qemuCaps;
+
+    if (rc < 0) {
+        VIR_WARN("Failed to load binary caps '%s' for '%s': %s",
+                 binfile, binary, virGetLastErrorMessage());
+        virResetLastError();
+
+        /* Start over, the object may be partially filled */
+        virObjectUnref(qemuCaps);
+        if (!(qemuCaps = virQEMUCapsNewBinary(binary)))
+            return NULL;
+    }
+
     if (virQEMUCapsLoadCache(priv->hostArch, qemuCaps, filename) < 0)
         goto error;
 
@@ -5278,7 +6104,8 @@ virFileCachePtr
 virQEMUCapsCacheNew(const char *libDir,
                     const char *cacheDir,
                     uid_t runUid,
-                    gid_t runGid)
+                    gid_t runGid,
+                    unsigned int validateInterval)
 {
     char *capsCacheDir = NULL;
     virFileCachePtr cache = NULL;
@@ -5301,6 +6128,7 @@ virQEMUCapsCacheNew(const char *libDir,
     priv->runUid = runUid;
     priv->runGid = runGid;
     priv->kvmUsable = VIR_TRISTATE_BOOL_ABSENT;
+    priv->validateInterval = validateInterval;
 
     if (uname(&uts) == 0)
         priv->kernelVersion = g_strdup_printf("%s %s", uts.release, uts.version);
@@ -5316,6 +6144,23 @@ virQEMUCapsCacheNew(const char *libDir,
 }
 
 
+/* Reading the microcode version means parsing /proc/cpuinfo, so it is
+ * refreshed at most once per validation interval. */
+static void
+virQEMUCapsCacheRefreshMicrocode(virQEMUCapsCachePrivPtr priv)
+{
+    unsigned long long now = virQEMUCapsCacheNow();
+
+    if (priv->validateInterval > 0 &&
+        priv->microcodeChecked > 0 &&
+        now - priv->microcodeChecked < priv->validateInterval)
+        return;
+
+    priv->microcodeVersion = virHostCPUGetMicrocodeVersion();
+    priv->microcodeChecked = now;
+}
+
+
 virQEMUCapsPtr
 virQEMUCapsCacheLookup(virFileCachePtr cache,
                        const char *binary)
@@ -5323,7 +6168,7 @@ virQEMUCapsCacheLookup(virFileCachePtr cache,
     virQEMUCapsCachePrivPtr priv = virFileCacheGetPriv(cache);
     virQEMUCapsPtr ret = NULL;
 
-    priv->microcodeVersion = virHostCPUGetMicrocodeVersion();
+    virQEMUCapsCacheRefreshMicrocode(priv);
 
     ret = virFileCacheLookup(cache, binary);
 
@@ -5392,7 +6237,7 @@ virQEMUCapsCacheLookupByArch(virFileCachePtr cache,
     size_t i;
     size_t j;
 
-    priv->microcodeVersion = virHostCPUGetMicrocodeVersion();
+    virQEMUCapsCacheRefreshMicrocode(priv);
 
     for (i = 0; i < G_N_ELEMENTS(binaryFilters); i++) {
         for (j = 0; j < G_N_ELEMENTS(archs); j++) {
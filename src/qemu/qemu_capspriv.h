@@ -44,6 +44,12 @@ int virQEMUCapsLoadCache(virArch hostArch,
                          const char *filename);
 char *virQEMUCapsFormatCache(virQEMUCapsPtr qemuCaps);
 
+int virQEMUCapsLoadBinaryCache(virArch hostArch,
+                               virQEMUCapsPtr qemuCaps,
+                               const char *filename);
+int virQEMUCapsSaveBinaryCache(virQEMUCapsPtr qemuCaps,
+                               const char *filename);
+
 int
 virQEMUCapsInitQMPMonitor(virQEMUCapsPtr qemuCaps,
                           qemuMonitorPtr mon);
@@ -267,12 +267,15 @@ virQEMUDriverConfigPtr virQEMUDriverConfigNew(bool privileged,
     cfg->securityDefaultConfined = true;
     cfg->securityRequireConfined = false;
 
+    cfg->eventWorkers = 4;
+
     cfg->keepAliveInterval = 5;
     cfg->keepAliveCount = 5;
     cfg->seccompSandbox = -1;
 
     cfg->logTimestamp = true;
     cfg->glusterDebugLevel = 4;
+    cfg->capabilityValidateInterval = 1000;
     cfg->stdioLogD = true;
 
     if (!(cfg->namespaces = virBitmapNew(QEMU_DOMAIN_NS_LAST)))
@@ -718,6 +721,13 @@ virQEMUDriverConfigLoadRPCEntry(virQEMUDriverConfigPtr cfg,
 {
     if (virConfGetValueUInt(conf, "max_queued", &cfg->maxQueuedJobs) < 0)
         return -1;
+    if (virConfGetValueUInt(conf, "event_workers", &cfg->eventWorkers) < 0)
+        return -1;
+    if (cfg->eventWorkers == 0) {
+        virReportError(VIR_ERR_CONF_SYNTAX, "%s",
+                       _("event_workers must be greater than 0"));
+        return -1;
+    }
     if (virConfGetValueInt(conf, "keepalive_interval", &cfg->keepAliveInterval) < 0)
         return -1;
     if (virConfGetValueUInt(conf, "keepalive_count", &cfg->keepAliveCount) < 0)
@@ -996,6 +1006,10 @@ virQEMUDriverConfigLoadCapsFiltersEntry(virQEMUDriverConfigPtr cfg,
                                   &cfg->capabilityfilters) < 0)
         return -1;
 
+    if (virConfGetValueUInt(conf, "capability_validate_interval",
+                            &cfg->capabilityValidateInterval) < 0)
+        return -1;
+
     return 0;
 }
 
@@ -172,6 +172,7 @@ struct _virQEMUDriverConfig {
     bool dumpGuestCore;
 
     unsigned int maxQueuedJobs;
+    unsigned int eventWorkers;
 
     char **securityDriverNames;
     bool securityDefaultConfined;
@@ -218,6 +219,7 @@ struct _virQEMUDriverConfig {
     gid_t swtpm_group;
 
     char **capabilityfilters;
+    unsigned int capabilityValidateInterval;
 };
 
 G_DEFINE_AUTOPTR_CLEANUP_FUNC(virQEMUDriverConfig, virObjectUnref);
@@ -119,6 +119,22 @@ VIR_ENUM_IMPL(qemuDomainNamespace,
               "mount",
 );
 
+VIR_ENUM_IMPL(qemuDomainProcessPhase,
+              QEMU_DOMAIN_PROCESS_PHASE_LAST,
+              "init",
+              "prepare-domain",
+              "prepare-host",
+              "launch",
+              "command-line",
+              "spawn",
+              "cgroup",
+              "security-label",
+              "monitor",
+              "refresh-state",
+              "finish-startup",
+              "stop",
+);
+
 
 /**
  * qemuDomainObjFromDomain:
@@ -10579,15 +10595,34 @@ char *qemuDomainFormatXML(virQEMUDriverPtr driver,
     virDomainDefPtr def;
     qemuDomainObjPrivatePtr priv = vm->privateData;
     virCPUDefPtr origCPU = NULL;
+    bool cacheable = false;
+    const char *cached;
+    char *xml;
 
     if ((flags & VIR_DOMAIN_XML_INACTIVE) && vm->newDef) {
         def = vm->newDef;
+        cacheable = true;
     } else {
         def = vm->def;
         origCPU = priv->origCPU;
+        cacheable = vm->persistent && !virDomainObjIsActive(vm);
     }
 
-    return qemuDomainDefFormatXMLInternal(driver, priv->qemuCaps, def, origCPU, flags);
+    /* Only persistent definitions are cached as the live one is updated
+     * in place all the time. The output of UPDATE_CPU and MIGRATABLE
+     * depends on the host and QEMU capabilities too. */
+    if (flags & (VIR_DOMAIN_XML_UPDATE_CPU | VIR_DOMAIN_XML_MIGRATABLE))
+        cacheable = false;
+
+    if (cacheable && (cached = virDomainDefXMLCacheLookup(def, flags)))
+        return g_strdup(cached);
+
+    xml = qemuDomainDefFormatXMLInternal(driver, priv->qemuCaps, def, origCPU, flags);
+
+    if (cacheable && xml)
+        virDomainDefXMLCacheStore(def, flags, xml);
+
+    return xml;
 }
 
 char *
@@ -16339,6 +16374,7 @@ qemuDomainUpdateCPU(virDomainObjPtr vm,
 
     *origCPU = vm->def->cpu;
     vm->def->cpu = cpu;
+    virDomainDefBumpGeneration(vm->def);
 
     return 0;
 }
@@ -16403,6 +16439,7 @@ qemuDomainFixupCPUs(virDomainObjPtr vm,
     if (fixedCPU) {
         virCPUDefFree(vm->def->cpu);
         vm->def->cpu = g_steal_pointer(&fixedCPU);
+        virDomainDefBumpGeneration(vm->def);
     }
 
     if (fixedOrig) {
@@ -16775,6 +16812,45 @@ qemuProcessEventFree(struct qemuProcessEvent *event)
 }
 
 
+/**
+ * qemuProcessEventSubmit:
+ * @driver: qemu driver data
+ * @event: event to process, event->vm must be set and locked
+ *
+ * Queues @event for processing by the driver's worker pool. Events of one
+ * domain are processed one at a time in the order they were submitted,
+ * events of different domains are processed in parallel. The domain is
+ * handed to the pool only when its queue becomes non-empty; the worker
+ * hands it back after each event while more are queued.
+ *
+ * On success @event is consumed, on failure the caller keeps it.
+ *
+ * Returns 0 on success, -1 on failure.
+ */
+int
+qemuProcessEventSubmit(virQEMUDriverPtr driver,
+                       struct qemuProcessEvent *event)
+{
+    virDomainObjPtr vm = event->vm;
+    qemuDomainObjPrivatePtr priv = vm->privateData;
+
+    if (VIR_APPEND_ELEMENT_COPY(priv->events, priv->nevents, event) < 0)
+        return -1;
+
+    if (priv->nevents == 1 &&
+        virThreadPoolSendJob(driver->workerPool, 0, virObjectRef(vm)) < 0) {
+        virObjectUnref(vm);
+        VIR_DELETE_ELEMENT(priv->events, 0, priv->nevents);
+        return -1;
+    }
+
+    VIR_DEBUG("vm=%p name=%s event=%d queued=%zu",
+              vm, vm->def->name, event->eventType, priv->nevents);
+
+    return 0;
+}
+
+
 char *
 qemuDomainGetManagedPRSocketPath(qemuDomainObjPrivatePtr priv)
 {
@@ -256,6 +256,25 @@ VIR_ENUM_DECL(qemuDomainNamespace);
 bool qemuDomainNamespaceEnabled(virDomainObjPtr vm,
                                 qemuDomainNamespace ns);
 
+/* Phases of starting and stopping a domain which are timed */
+typedef enum {
+    QEMU_DOMAIN_PROCESS_PHASE_INIT = 0,       /* incl. capabilities lookup */
+    QEMU_DOMAIN_PROCESS_PHASE_PREPARE_DOMAIN,
+    QEMU_DOMAIN_PROCESS_PHASE_PREPARE_HOST,
+    QEMU_DOMAIN_PROCESS_PHASE_LAUNCH,
+    QEMU_DOMAIN_PROCESS_PHASE_COMMAND_LINE,   /* incl. network interfaces */
+    QEMU_DOMAIN_PROCESS_PHASE_SPAWN,
+    QEMU_DOMAIN_PROCESS_PHASE_CGROUP,
+    QEMU_DOMAIN_PROCESS_PHASE_SECURITY_LABEL,
+    QEMU_DOMAIN_PROCESS_PHASE_MONITOR,        /* incl. QMP negotiation */
+    QEMU_DOMAIN_PROCESS_PHASE_REFRESH_STATE,
+    QEMU_DOMAIN_PROCESS_PHASE_FINISH_STARTUP,
+    QEMU_DOMAIN_PROCESS_PHASE_STOP,
+
+    QEMU_DOMAIN_PROCESS_PHASE_LAST
+} qemuDomainProcessPhase;
+VIR_ENUM_DECL(qemuDomainProcessPhase);
+
 /* Type of domain secret */
 typedef enum {
     VIR_DOMAIN_SECRET_INFO_TYPE_PLAIN = 0,
@@ -310,12 +329,20 @@ struct _qemuDomainObjPrivate {
     unsigned long long monStart;
     int agentTimeout;
 
+    /* duration of the phases of the last start/stop in microseconds */
+    unsigned long long phaseTimes[QEMU_DOMAIN_PROCESS_PHASE_LAST];
+
     qemuAgentPtr agent;
     bool agentError;
 
     bool beingDestroyed;
     char *pidfile;
 
+    /* Events waiting for the worker pool in the order they were received.
+     * The first one is being processed while nevents > 0. */
+    struct qemuProcessEvent **events;
+    size_t nevents;
+
     virDomainPCIAddressSetPtr pciaddrs;
     virDomainUSBAddressSetPtr usbaddrs;
 
@@ -604,6 +631,8 @@ struct qemuProcessEvent {
 };
 
 void qemuProcessEventFree(struct qemuProcessEvent *event);
+int qemuProcessEventSubmit(virQEMUDriverPtr driver,
+                           struct qemuProcessEvent *event);
 
 #define QEMU_TYPE_DOMAIN_LOG_CONTEXT qemu_domain_log_context_get_type()
 G_DECLARE_FINAL_TYPE(qemuDomainLogContext, qemu_domain_log_context, QEMU, DOMAIN_LOG_CONTEXT, GObject);
@@ -898,7 +898,8 @@ qemuStateInitialize(bool privileged,
     qemu_driver->qemuCapsCache = virQEMUCapsCacheNew(cfg->libDir,
                                                      cfg->cacheDir,
                                                      run_uid,
-                                                     run_gid);
+                                                     run_gid,
+                                                     cfg->capabilityValidateInterval);
     if (!qemu_driver->qemuCapsCache)
         goto error;
 
@@ -999,7 +1000,8 @@ qemuStateInitialize(bool privileged,
     /* must be initialized before trying to reconnect to all the
      * running domains since there might occur some QEMU monitor
      * events that will be dispatched to the worker pool */
-    qemu_driver->workerPool = virThreadPoolNewFull(0, 1, 0, qemuProcessEventHandler,
+    qemu_driver->workerPool = virThreadPoolNewFull(0, cfg->eventWorkers, 0,
+                                                   qemuProcessEventHandler,
                                                    "qemu-event", qemu_driver);
     if (!qemu_driver->workerPool)
         goto error;
@@ -3611,7 +3613,7 @@ qemuDomainManagedSave(virDomainPtr dom, unsigned int flags)
     ret = qemuDomainSaveInternal(driver, vm, name, compressed,
                                  compressor, NULL, flags);
     if (ret == 0)
-        vm->hasManagedSave = true;
+        virDomainObjSetManagedSave(vm, true);
 
  cleanup:
     virDomainObjEndAPI(&vm);
@@ -3632,7 +3634,7 @@ qemuDomainManagedSaveLoad(virDomainObjPtr vm,
     if (!(name = qemuDomainManagedSavePath(driver, vm)))
         goto cleanup;
 
-    vm->hasManagedSave = virFileExists(name);
+    virDomainObjSetManagedSave(vm, virFileExists(name));
 
     ret = 0;
  cleanup:
@@ -3688,7 +3690,7 @@ qemuDomainManagedSaveRemove(virDomainPtr dom, unsigned int flags)
         goto cleanup;
     }
 
-    vm->hasManagedSave = false;
+    virDomainObjSetManagedSave(vm, false);
     ret = 0;
 
  cleanup:
@@ -4896,14 +4898,26 @@ processGuestCrashloadedEvent(virQEMUDriverPtr driver,
 
 static void qemuProcessEventHandler(void *data, void *opaque)
 {
-    struct qemuProcessEvent *processEvent = data;
-    virDomainObjPtr vm = processEvent->vm;
+    virDomainObjPtr vm = data;
+    qemuDomainObjPrivatePtr priv = vm->privateData;
+    struct qemuProcessEvent *processEvent;
     virQEMUDriverPtr driver = opaque;
 
-    VIR_DEBUG("vm=%p, event=%d", vm, processEvent->eventType);
-
     virObjectLock(vm);
 
+    if (priv->nevents == 0) {
+        virDomainObjEndAPI(&vm);
+        return;
+    }
+
+    /* The event stays queued while it is processed so that
+     * qemuProcessEventSubmit does not hand the domain to another worker
+     * when one of the handlers below temporarily unlocks it. */
+    processEvent = priv->events[0];
+
+    VIR_DEBUG("vm=%p, event=%d, queued=%zu",
+              vm, processEvent->eventType, priv->nevents);
+
     switch (processEvent->eventType) {
     case QEMU_PROCESS_EVENT_WATCHDOG:
         processWatchdogEvent(driver, vm, processEvent->action);
@@ -4947,8 +4961,30 @@ static void qemuProcessEventHandler(void *data, void *opaque)
         break;
     }
 
-    virDomainObjEndAPI(&vm);
+    VIR_DELETE_ELEMENT(priv->events, 0, priv->nevents);
+    virObjectUnref(processEvent->vm);
     qemuProcessEventFree(processEvent);
+
+    /* Rather than draining the whole queue here put the domain back at the
+     * end of the pool's queue so that a domain with a burst of events does
+     * not hold up the others. */
+    if (priv->nevents > 0 &&
+        virThreadPoolSendJob(driver->workerPool, 0, vm) == 0) {
+        virObjectUnlock(vm);
+        return;
+    }
+
+    /* Either there's nothing left or the pool refused the job, in which
+     * case the pending events are dropped like they would have been had
+     * the pool refused them in the first place. */
+    while (priv->nevents > 0) {
+        processEvent = priv->events[0];
+        VIR_DELETE_ELEMENT(priv->events, 0, priv->nevents);
+        virObjectUnref(processEvent->vm);
+        qemuProcessEventFree(processEvent);
+    }
+
+    virDomainObjEndAPI(&vm);
 }
 
 
@@ -7509,7 +7545,7 @@ qemuDomainObjStart(virConnectPtr conn,
                                      managed_save);
                 return ret;
             }
-            vm->hasManagedSave = false;
+            virDomainObjSetManagedSave(vm, false);
         } else {
             virDomainJobOperation op = priv->job.current->operation;
             priv->job.current->operation = VIR_DOMAIN_JOB_OPERATION_RESTORE;
@@ -7521,7 +7557,7 @@ qemuDomainObjStart(virConnectPtr conn,
                 if (unlink(managed_save) < 0)
                     VIR_WARN("Failed to remove the managed state %s", managed_save);
                 else
-                    vm->hasManagedSave = false;
+                    virDomainObjSetManagedSave(vm, false);
 
                 return ret;
             } else if (ret < 0) {
@@ -7531,7 +7567,7 @@ qemuDomainObjStart(virConnectPtr conn,
             } else {
                 VIR_WARN("Ignoring incomplete managed state %s", managed_save);
                 priv->job.current->operation = op;
-                vm->hasManagedSave = false;
+                virDomainObjSetManagedSave(vm, false);
             }
         }
     }
@@ -7645,7 +7681,7 @@ qemuDomainDefineXMLFlags(virConnectPtr conn,
         goto cleanup;
     def = NULL;
 
-    vm->persistent = 1;
+    virDomainObjSetPersistent(vm, true);
 
     if (virDomainDefSave(vm->newDef ? vm->newDef : vm->def,
                          driver->xmlopt, cfg->configDir) < 0) {
@@ -7661,7 +7697,7 @@ qemuDomainDefineXMLFlags(virConnectPtr conn,
         } else {
             /* Brand new domain. Remove it */
             VIR_INFO("Deleting domain '%s'", vm->def->name);
-            vm->persistent = 0;
+            virDomainObjSetPersistent(vm, false);
             qemuDomainRemoveInactiveJob(driver, vm);
         }
         goto cleanup;
@@ -7815,7 +7851,7 @@ qemuDomainUndefineFlags(virDomainPtr dom,
      * domainDestroy and domainShutdown will take care of removing the
      * domain obj from the hash table.
      */
-    vm->persistent = 0;
+    virDomainObjSetPersistent(vm, false);
     if (!virDomainObjIsActive(vm))
         qemuDomainRemoveInactive(driver, vm);
 
@@ -9250,7 +9286,7 @@ static int qemuDomainSetAutostart(virDomainPtr dom,
             }
         }
 
-        vm->autostart = autostart;
+        virDomainObjSetAutostart(vm, autostart);
 
  endjob:
         qemuDomainObjEndJob(driver, vm);
@@ -20624,18 +20660,35 @@ qemuConnectGetDomainCapabilities(virConnectPtr conn,
 }
 
 
+/* Host wide data gathered once per stats request and shared by all
+ * domains reported on. Any member may be NULL, in which case the
+ * workers query the host themselves. */
+typedef struct _qemuDomainGetStatsHostData qemuDomainGetStatsHostData;
+typedef qemuDomainGetStatsHostData *qemuDomainGetStatsHostDataPtr;
+struct _qemuDomainGetStatsHostData {
+    virNetDevTapStatsTablePtr netstats;
+};
+
+
 static int
 qemuDomainGetStatsState(virQEMUDriverPtr driver G_GNUC_UNUSED,
                         virDomainObjPtr dom,
                         virTypedParamListPtr params,
-                        unsigned int privflags G_GNUC_UNUSED)
+                        unsigned int privflags G_GNUC_UNUSED,
+                        qemuDomainGetStatsHostDataPtr hostdata G_GNUC_UNUSED)
 {
+    qemuDomainObjPrivatePtr priv = dom->privateData;
+
     if (virTypedParamListAddInt(params, dom->state.state, "state.state") < 0)
         return -1;
 
     if (virTypedParamListAddInt(params, dom->state.reason, "state.reason") < 0)
         return -1;
 
+    if (virTypedParamListAddUInt(params, priv->nevents,
+                                 "state.events.queued") < 0)
+        return -1;
+
     return 0;
 }
 
@@ -20957,7 +21010,8 @@ static int
 qemuDomainGetStatsCpu(virQEMUDriverPtr driver,
                       virDomainObjPtr dom,
                       virTypedParamListPtr params,
-                      unsigned int privflags G_GNUC_UNUSED)
+                      unsigned int privflags G_GNUC_UNUSED,
+                      qemuDomainGetStatsHostDataPtr hostdata G_GNUC_UNUSED)
 {
     if (qemuDomainGetStatsCpuCgroup(dom, params) < 0)
         return -1;
@@ -20973,8 +21027,8 @@ static int
 qemuDomainGetStatsMemory(virQEMUDriverPtr driver,
                          virDomainObjPtr dom,
                          virTypedParamListPtr params,
-                         unsigned int privflags G_GNUC_UNUSED)
-
+                         unsigned int privflags G_GNUC_UNUSED,
+                         qemuDomainGetStatsHostDataPtr hostdata G_GNUC_UNUSED)
 {
     return qemuDomainGetStatsMemoryBandwidth(driver, dom, params);
 }
@@ -20984,7 +21038,8 @@ static int
 qemuDomainGetStatsBalloon(virQEMUDriverPtr driver,
                           virDomainObjPtr dom,
                           virTypedParamListPtr params,
-                          unsigned int privflags)
+                          unsigned int privflags,
+                          qemuDomainGetStatsHostDataPtr hostdata G_GNUC_UNUSED)
 {
     virDomainMemoryStatStruct stats[VIR_DOMAIN_MEMORY_STAT_NR];
     int nr_stats;
@@ -21042,7 +21097,8 @@ static int
 qemuDomainGetStatsVcpu(virQEMUDriverPtr driver,
                        virDomainObjPtr dom,
                        virTypedParamListPtr params,
-                       unsigned int privflags)
+                       unsigned int privflags,
+                       qemuDomainGetStatsHostDataPtr hostdata G_GNUC_UNUSED)
 {
     virDomainVcpuDefPtr vcpu;
     qemuDomainVcpuPrivatePtr vcpupriv;
@@ -21126,7 +21182,8 @@ static int
 qemuDomainGetStatsInterface(virQEMUDriverPtr driver G_GNUC_UNUSED,
                             virDomainObjPtr dom,
                             virTypedParamListPtr params,
-                            unsigned int privflags G_GNUC_UNUSED)
+                            unsigned int privflags G_GNUC_UNUSED,
+                            qemuDomainGetStatsHostDataPtr hostdata)
 {
     size_t i;
     struct _virDomainInterfaceStats tmp;
@@ -21158,8 +21215,9 @@ qemuDomainGetStatsInterface(virQEMUDriverPtr driver G_GNUC_UNUSED,
                 continue;
             }
         } else {
-            if (virNetDevTapInterfaceStats(net->ifname, &tmp,
-                                           !virDomainNetTypeSharesHostView(net)) < 0) {
+            if (virNetDevTapStatsTableLookup(hostdata ? hostdata->netstats : NULL,
+                                             net->ifname, &tmp,
+                                             !virDomainNetTypeSharesHostView(net)) < 0) {
                 virResetLastError();
                 continue;
             }
@@ -21465,7 +21523,8 @@ static int
 qemuDomainGetStatsBlock(virQEMUDriverPtr driver,
                         virDomainObjPtr dom,
                         virTypedParamListPtr params,
-                        unsigned int privflags)
+                        unsigned int privflags,
+                        qemuDomainGetStatsHostDataPtr hostdata G_GNUC_UNUSED)
 {
     size_t i;
     int ret = -1;
@@ -21540,7 +21599,8 @@ static int
 qemuDomainGetStatsIOThread(virQEMUDriverPtr driver,
                            virDomainObjPtr dom,
                            virTypedParamListPtr params,
-                           unsigned int privflags)
+                           unsigned int privflags,
+                           qemuDomainGetStatsHostDataPtr hostdata G_GNUC_UNUSED)
 {
     qemuDomainObjPrivatePtr priv = dom->privateData;
     size_t i;
@@ -21616,7 +21676,8 @@ static int
 qemuDomainGetStatsPerf(virQEMUDriverPtr driver G_GNUC_UNUSED,
                        virDomainObjPtr dom,
                        virTypedParamListPtr params,
-                       unsigned int privflags G_GNUC_UNUSED)
+                       unsigned int privflags G_GNUC_UNUSED,
+                       qemuDomainGetStatsHostDataPtr hostdata G_GNUC_UNUSED)
 {
     size_t i;
     qemuDomainObjPrivatePtr priv = dom->privateData;
@@ -21636,7 +21697,8 @@ typedef int
 (*qemuDomainGetStatsFunc)(virQEMUDriverPtr driver,
                           virDomainObjPtr dom,
                           virTypedParamListPtr list,
-                          unsigned int flags);
+                          unsigned int flags,
+                          qemuDomainGetStatsHostDataPtr hostdata);
 
 struct qemuDomainGetStatsWorker {
     qemuDomainGetStatsFunc func;
@@ -21705,7 +21767,8 @@ qemuDomainGetStats(virConnectPtr conn,
                    virDomainObjPtr dom,
                    unsigned int stats,
                    virDomainStatsRecordPtr *record,
-                   unsigned int flags)
+                   unsigned int flags,
+                   qemuDomainGetStatsHostDataPtr hostdata)
 {
     g_autofree virDomainStatsRecordPtr tmp = NULL;
     g_autoptr(virTypedParamList) params = NULL;
@@ -21717,7 +21780,7 @@ qemuDomainGetStats(virConnectPtr conn,
     for (i = 0; qemuDomainGetStatsWorkers[i].func; i++) {
         if (stats & qemuDomainGetStatsWorkers[i].stats) {
             if (qemuDomainGetStatsWorkers[i].func(conn->privateData, dom, params,
-                                                  flags) < 0)
+                                                  flags, hostdata) < 0)
                 return -1;
         }
     }
@@ -21735,6 +21798,10 @@ qemuDomainGetStats(virConnectPtr conn,
 }
 
 
+/* Minimum number of domains a stats request has to cover for
+ * interface statistics to be fetched for all host interfaces at once */
+#define QEMU_DOMAIN_STATS_NET_DUMP_MIN 8
+
 static int
 qemuConnectGetAllDomainStats(virConnectPtr conn,
                              virDomainPtr *doms,
@@ -21749,6 +21816,7 @@ qemuConnectGetAllDomainStats(virConnectPtr conn,
     virDomainObjPtr vm;
     size_t nvms;
     virDomainStatsRecordPtr *tmpstats = NULL;
+    qemuDomainGetStatsHostData hostdata = { 0 };
     bool enforce = !!(flags & VIR_CONNECT_GET_ALL_DOMAINS_STATS_ENFORCE_STATS);
     int nstats = 0;
     size_t i;
@@ -21790,6 +21858,16 @@ qemuConnectGetAllDomainStats(virConnectPtr conn,
     if (qemuDomainGetStatsNeedMonitor(stats))
         privflags |= QEMU_DOMAIN_STATS_HAVE_JOB;
 
+    /* Looking up interfaces one by one is cheap for a few domains, but
+     * for a host full of them fetching statistics of all host
+     * interfaces at once is far cheaper. */
+    if (stats & VIR_DOMAIN_STATS_INTERFACE &&
+        nvms >= QEMU_DOMAIN_STATS_NET_DUMP_MIN &&
+        !(hostdata.netstats = virNetDevTapStatsTableNew())) {
+        VIR_DEBUG("Falling back to per interface statistics");
+        virResetLastError();
+    }
+
     for (i = 0; i < nvms; i++) {
         virDomainStatsRecordPtr tmp = NULL;
         domflags = 0;
@@ -21812,7 +21890,7 @@ qemuConnectGetAllDomainStats(virConnectPtr conn,
 
         if (flags & VIR_CONNECT_GET_ALL_DOMAINS_STATS_BACKING)
             domflags |= QEMU_DOMAIN_STATS_BACKING;
-        if (qemuDomainGetStats(conn, vm, stats, &tmp, domflags) < 0) {
+        if (qemuDomainGetStats(conn, vm, stats, &tmp, domflags, &hostdata) < 0) {
             if (HAVE_JOB(domflags) && vm)
                 qemuDomainObjEndJob(driver, vm);
 
@@ -21838,6 +21916,7 @@ qemuConnectGetAllDomainStats(virConnectPtr conn,
     virErrorPreserveLast(&orig_err);
     virDomainStatsRecordListFree(tmpstats);
     virObjectListFreeCount(vms, nvms);
+    virNetDevTapStatsTableFree(hostdata.netstats);
     virErrorRestore(&orig_err);
 
     return ret;
@@ -2538,7 +2538,7 @@ qemuMigrationDstPrepareAny(virQEMUDriverPtr driver,
     qemuMigrationJobSetPhase(driver, vm, QEMU_MIGRATION_PHASE_PREPARE);
 
     /* Domain starts inactive, even if the domain XML had an id field. */
-    vm->def->id = -1;
+    virDomainObjSetID(vm, -1);
 
     if (flags & VIR_MIGRATE_OFFLINE)
         goto done;
@@ -3126,7 +3126,7 @@ qemuMigrationSrcConfirm(virQEMUDriverPtr driver,
     if (!virDomainObjIsActive(vm)) {
         if (!cancelled && ret == 0 && flags & VIR_MIGRATE_UNDEFINE_SOURCE) {
             virDomainDeleteConfig(cfg->configDir, cfg->autostartDir, vm);
-            vm->persistent = 0;
+            virDomainObjSetPersistent(vm, false);
         }
         qemuDomainRemoveInactiveJob(driver, vm);
     }
@@ -4698,7 +4698,7 @@ qemuMigrationSrcPerformJob(virQEMUDriverPtr driver,
     if (!virDomainObjIsActive(vm) && ret == 0) {
         if (flags & VIR_MIGRATE_UNDEFINE_SOURCE) {
             virDomainDeleteConfig(cfg->configDir, cfg->autostartDir, vm);
-            vm->persistent = 0;
+            virDomainObjSetPersistent(vm, false);
         }
         qemuDomainRemoveInactiveJob(driver, vm);
     }
@@ -4919,7 +4919,7 @@ qemuMigrationDstPersist(virQEMUDriverPtr driver,
     virObjectEventPtr event;
     int ret = -1;
 
-    vm->persistent = 1;
+    virDomainObjSetPersistent(vm, true);
     oldDef = vm->newDef;
     vm->newDef = qemuMigrationCookieGetPersistent(mig);
 
@@ -4947,7 +4947,7 @@ qemuMigrationDstPersist(virQEMUDriverPtr driver,
 
  error:
     virDomainDefFree(vm->newDef);
-    vm->persistent = oldPersist;
+    virDomainObjSetPersistent(vm, oldPersist);
     vm->newDef = oldDef;
     oldDef = NULL;
     goto cleanup;
@@ -798,6 +798,76 @@ qemuMonitorOpen(virDomainObjPtr vm,
 }
 
 
+/**
+ * qemuMonitorPreconnect:
+ * @config: monitor configuration
+ *
+ * Connects to a listening monitor socket that was created by us and
+ * handed over to QEMU. Since the socket is already listening, the
+ * connection is queued by the kernel and accepted by QEMU once it
+ * initializes its chardevs, so no waiting is needed here.
+ *
+ * Returns connected socket on success, -1 on error.
+ */
+int
+qemuMonitorPreconnect(virDomainChrSourceDefPtr config)
+{
+    int fd;
+
+    if (config->type != VIR_DOMAIN_CHR_TYPE_UNIX ||
+        !config->data.nix.listen) {
+        virReportError(VIR_ERR_INTERNAL_ERROR,
+                       _("unable to preconnect monitor type: %s"),
+                       virDomainChrTypeToString(config->type));
+        return -1;
+    }
+
+    if ((fd = qemuMonitorOpenUnix(config->data.nix.path, 0, false, 0)) < 0)
+        return -1;
+
+    /* Don't leak the socket into QEMU, which is yet to be executed */
+    if (virSetCloseExec(fd) < 0) {
+        virReportSystemError(errno, "%s",
+                             _("Unable to set monitor close-on-exec flag"));
+        VIR_FORCE_CLOSE(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+
+/**
+ * qemuMonitorOpenFD:
+ * @vm: domain object
+ * @fd: connected monitor socket, e.g. from qemuMonitorPreconnect
+ * @context: context to run the monitor IO in
+ * @cb: monitor event handles
+ * @opaque: opaque data for @cb
+ *
+ * Like qemuMonitorOpen, but uses an already connected socket. On
+ * success the monitor takes ownership of @fd, on failure the caller
+ * is still responsible for closing it.
+ *
+ * Returns monitor object, NULL on error.
+ */
+qemuMonitorPtr
+qemuMonitorOpenFD(virDomainObjPtr vm,
+                  int fd,
+                  GMainContext *context,
+                  qemuMonitorCallbacksPtr cb,
+                  void *opaque)
+{
+    if (!virDomainObjIsActive(vm)) {
+        virReportError(VIR_ERR_OPERATION_FAILED, "%s",
+                       _("domain is not running"));
+        return NULL;
+    }
+
+    return qemuMonitorOpenInternal(vm, fd, context, cb, opaque);
+}
+
+
 /**
  * qemuMonitorRegister:
  * @mon: QEMU monitor
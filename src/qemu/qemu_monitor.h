@@ -386,6 +386,14 @@ qemuMonitorPtr qemuMonitorOpen(virDomainObjPtr vm,
                                qemuMonitorCallbacksPtr cb,
                                void *opaque)
     ATTRIBUTE_NONNULL(1) ATTRIBUTE_NONNULL(2) ATTRIBUTE_NONNULL(5);
+int qemuMonitorPreconnect(virDomainChrSourceDefPtr config)
+    ATTRIBUTE_NONNULL(1);
+qemuMonitorPtr qemuMonitorOpenFD(virDomainObjPtr vm,
+                                 int fd,
+                                 GMainContext *context,
+                                 qemuMonitorCallbacksPtr cb,
+                                 void *opaque)
+    ATTRIBUTE_NONNULL(1) ATTRIBUTE_NONNULL(3) ATTRIBUTE_NONNULL(4);
 
 void qemuMonitorRegister(qemuMonitorPtr mon)
     ATTRIBUTE_NONNULL(1);
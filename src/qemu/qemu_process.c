@@ -91,11 +91,98 @@
 #include "viridentity.h"
 #include "virthreadjob.h"
 #include "virutil.h"
+#include "virprobe.h"
+
+#ifdef WITH_DTRACE_PROBES
+# include "libvirt_qemu_probes.h"
+#endif
 
 #define VIR_FROM_THIS VIR_FROM_QEMU
 
 VIR_LOG_INIT("qemu.qemu_process");
 
+
+/**
+ * qemuProcessPhaseBegin:
+ * @vm: domain object
+ * @phase: start/stop phase which is about to begin
+ *
+ * Returns the timestamp to be passed to qemuProcessPhaseEnd.
+ */
+static unsigned long long
+qemuProcessPhaseBegin(virDomainObjPtr vm,
+                      qemuDomainProcessPhase phase)
+{
+    PROBE(QEMU_PROCESS_PHASE_BEGIN,
+          "vm=%p name=%s phase=%s",
+          vm, vm->def->name, qemuDomainProcessPhaseTypeToString(phase));
+
+    return g_get_monotonic_time();
+}
+
+
+/**
+ * qemuProcessPhaseEnd:
+ * @vm: domain object
+ * @phase: start/stop phase which has just finished
+ * @start: timestamp returned by qemuProcessPhaseBegin
+ * @ret: return value of the phase
+ *
+ * Records the duration of @phase in the domain private data.
+ */
+static void
+qemuProcessPhaseEnd(virDomainObjPtr vm,
+                    qemuDomainProcessPhase phase,
+                    unsigned long long start,
+                    int ret)
+{
+    qemuDomainObjPrivatePtr priv = vm->privateData;
+    unsigned long long elapsed = g_get_monotonic_time() - start;
+
+    priv->phaseTimes[phase] = elapsed;
+
+    PROBE(QEMU_PROCESS_PHASE_END,
+          "vm=%p name=%s phase=%s elapsed=%llu ret=%d",
+          vm, vm->def->name, qemuDomainProcessPhaseTypeToString(phase),
+          elapsed, ret);
+}
+
+
+/**
+ * qemuProcessPhaseLog:
+ * @driver: qemu driver
+ * @vm: domain object
+ *
+ * Appends the durations of the start phases recorded by the last
+ * qemuProcessStart to the domain log so that slow starts can be
+ * analyzed after the fact.
+ */
+static void
+qemuProcessPhaseLog(virQEMUDriverPtr driver,
+                    virDomainObjPtr vm)
+{
+    qemuDomainObjPrivatePtr priv = vm->privateData;
+    g_auto(virBuffer) buf = VIR_BUFFER_INITIALIZER;
+    g_autofree char *timestamp = NULL;
+    g_autofree char *phases = NULL;
+    size_t i;
+
+    for (i = 0; i < QEMU_DOMAIN_PROCESS_PHASE_STOP; i++) {
+        virBufferAsprintf(&buf, " %s=%lluus",
+                          qemuDomainProcessPhaseTypeToString(i),
+                          priv->phaseTimes[i]);
+    }
+    phases = virBufferContentAndReset(&buf);
+
+    VIR_DEBUG("vm=%p name=%s start phases:%s", vm, vm->def->name, phases);
+
+    if ((timestamp = virTimeStringNow()) != NULL) {
+        qemuDomainLogAppendMessage(driver, vm, "%s: start phases:%s\n",
+                                   timestamp, phases);
+    }
+}
+
+
 /**
  * qemuProcessRemoveDomainStatus
  *
@@ -305,7 +392,7 @@ qemuProcessHandleMonitorEOF(qemuMonitorPtr mon,
     processEvent->eventType = QEMU_PROCESS_EVENT_MONITOR_EOF;
     processEvent->vm = virObjectRef(vm);
 
-    if (virThreadPoolSendJob(driver->workerPool, 0, processEvent) < 0) {
+    if (qemuProcessEventSubmit(driver, processEvent) < 0) {
         ignore_value(virObjectUnref(vm));
         qemuProcessEventFree(processEvent);
         goto cleanup;
@@ -838,7 +925,7 @@ qemuProcessHandleWatchdog(qemuMonitorPtr mon G_GNUC_UNUSED,
              * deleted before handling watchdog event is finished.
              */
             processEvent->vm = virObjectRef(vm);
-            if (virThreadPoolSendJob(driver->workerPool, 0, processEvent) < 0) {
+            if (qemuProcessEventSubmit(driver, processEvent) < 0) {
                 if (!virObjectUnref(vm))
                     vm = NULL;
                 qemuProcessEventFree(processEvent);
@@ -975,7 +1062,7 @@ qemuProcessHandleBlockJob(qemuMonitorPtr mon G_GNUC_UNUSED,
         processEvent->action = type;
         processEvent->status = status;
 
-        if (virThreadPoolSendJob(driver->workerPool, 0, processEvent) < 0) {
+        if (qemuProcessEventSubmit(driver, processEvent) < 0) {
             ignore_value(virObjectUnref(vm));
             goto cleanup;
         }
@@ -1037,7 +1124,7 @@ qemuProcessHandleJobStatusChange(qemuMonitorPtr mon G_GNUC_UNUSED,
         processEvent->vm = virObjectRef(vm);
         processEvent->data = virObjectRef(job);
 
-        if (virThreadPoolSendJob(driver->workerPool, 0, processEvent) < 0) {
+        if (qemuProcessEventSubmit(driver, processEvent) < 0) {
             ignore_value(virObjectUnref(vm));
             goto cleanup;
         }
@@ -1340,7 +1427,7 @@ qemuProcessHandleGuestPanic(qemuMonitorPtr mon G_GNUC_UNUSED,
      */
     processEvent->vm = virObjectRef(vm);
 
-    if (virThreadPoolSendJob(driver->workerPool, 0, processEvent) < 0) {
+    if (qemuProcessEventSubmit(driver, processEvent) < 0) {
         if (!virObjectUnref(vm))
             vm = NULL;
         qemuProcessEventFree(processEvent);
@@ -1381,7 +1468,7 @@ qemuProcessHandleDeviceDeleted(qemuMonitorPtr mon G_GNUC_UNUSED,
     processEvent->data = data;
     processEvent->vm = virObjectRef(vm);
 
-    if (virThreadPoolSendJob(driver->workerPool, 0, processEvent) < 0) {
+    if (qemuProcessEventSubmit(driver, processEvent) < 0) {
         ignore_value(virObjectUnref(vm));
         goto error;
     }
@@ -1552,7 +1639,7 @@ qemuProcessHandleNicRxFilterChanged(qemuMonitorPtr mon G_GNUC_UNUSED,
     processEvent->data = data;
     processEvent->vm = virObjectRef(vm);
 
-    if (virThreadPoolSendJob(driver->workerPool, 0, processEvent) < 0) {
+    if (qemuProcessEventSubmit(driver, processEvent) < 0) {
         ignore_value(virObjectUnref(vm));
         goto error;
     }
@@ -1591,7 +1678,7 @@ qemuProcessHandleSerialChanged(qemuMonitorPtr mon G_GNUC_UNUSED,
     processEvent->action = connected;
     processEvent->vm = virObjectRef(vm);
 
-    if (virThreadPoolSendJob(driver->workerPool, 0, processEvent) < 0) {
+    if (qemuProcessEventSubmit(driver, processEvent) < 0) {
         ignore_value(virObjectUnref(vm));
         goto error;
     }
@@ -1794,7 +1881,7 @@ qemuProcessHandlePRManagerStatusChanged(qemuMonitorPtr mon G_GNUC_UNUSED,
     processEvent->eventType = QEMU_PROCESS_EVENT_PR_DISCONNECT;
     processEvent->vm = virObjectRef(vm);
 
-    if (virThreadPoolSendJob(driver->workerPool, 0, processEvent) < 0) {
+    if (qemuProcessEventSubmit(driver, processEvent) < 0) {
         qemuProcessEventFree(processEvent);
         virObjectUnref(vm);
         goto cleanup;
@@ -1842,7 +1929,7 @@ qemuProcessHandleRdmaGidStatusChanged(qemuMonitorPtr mon G_GNUC_UNUSED,
     processEvent->vm = virObjectRef(vm);
     processEvent->data = g_steal_pointer(&info);
 
-    if (virThreadPoolSendJob(driver->workerPool, 0, processEvent) < 0) {
+    if (qemuProcessEventSubmit(driver, processEvent) < 0) {
         qemuProcessEventFree(processEvent);
         virObjectUnref(vm);
         goto cleanup;
@@ -1871,7 +1958,7 @@ qemuProcessHandleGuestCrashloaded(qemuMonitorPtr mon G_GNUC_UNUSED,
     processEvent->eventType = QEMU_PROCESS_EVENT_GUEST_CRASHLOADED;
     processEvent->vm = virObjectRef(vm);
 
-    if (virThreadPoolSendJob(driver->workerPool, 0, processEvent) < 0) {
+    if (qemuProcessEventSubmit(driver, processEvent) < 0) {
         if (!virObjectUnref(vm))
             vm = NULL;
         qemuProcessEventFree(processEvent);
@@ -1952,9 +2039,22 @@ qemuProcessInitMonitor(virQEMUDriverPtr driver,
 }
 
 
+/**
+ * qemuConnectMonitor:
+ * @driver: qemu driver
+ * @vm: domain object
+ * @asyncJob: async job type
+ * @retry: wait for the monitor socket to show up
+ * @monfd: optional pointer to an already connected monitor socket
+ * @logCtxt: optional domain log context
+ *
+ * If @monfd points to a valid socket it is used instead of connecting
+ * to the monitor socket path. The monitor takes ownership of the
+ * socket on success in which case *@monfd is reset to -1.
+ */
 static int
 qemuConnectMonitor(virQEMUDriverPtr driver, virDomainObjPtr vm, int asyncJob,
-                   bool retry, qemuDomainLogContextPtr logCtxt)
+                   bool retry, int *monfd, qemuDomainLogContextPtr logCtxt)
 {
     qemuDomainObjPrivatePtr priv = vm->privateData;
     qemuMonitorPtr mon = NULL;
@@ -1974,13 +2074,23 @@ qemuConnectMonitor(virQEMUDriverPtr driver, virDomainObjPtr vm, int asyncJob,
 
     ignore_value(virTimeMillisNow(&priv->monStart));
 
-    mon = qemuMonitorOpen(vm,
-                          priv->monConfig,
-                          retry,
-                          timeout,
-                          virEventThreadGetContext(priv->eventThread),
-                          &monitorCallbacks,
-                          driver);
+    if (monfd && *monfd >= 0) {
+        mon = qemuMonitorOpenFD(vm,
+                                *monfd,
+                                virEventThreadGetContext(priv->eventThread),
+                                &monitorCallbacks,
+                                driver);
+        if (mon)
+            *monfd = -1;
+    } else {
+        mon = qemuMonitorOpen(vm,
+                              priv->monConfig,
+                              retry,
+                              timeout,
+                              virEventThreadGetContext(priv->eventThread),
+                              &monitorCallbacks,
+                              driver);
+    }
 
     if (mon && logCtxt) {
         g_object_ref(logCtxt);
@@ -2379,10 +2489,61 @@ qemuProcessRefreshBalloonState(virQEMUDriverPtr driver,
 }
 
 
+/**
+ * qemuProcessPreconnectMonitor:
+ * @driver: qemu driver
+ * @vm: domain object
+ * @monfd: filled with the connected monitor socket
+ *
+ * If QEMU is going to be handed an already listening monitor socket
+ * (see qemuBuildMonitorCommandLine), connect to it before QEMU is even
+ * started. The connection is accepted once QEMU initializes the monitor
+ * and thus no polling for the socket is needed afterwards. If the
+ * socket is not passed to QEMU, *@monfd is left at -1.
+ *
+ * Returns 0 on success, -1 on error.
+ */
+static int
+qemuProcessPreconnectMonitor(virQEMUDriverPtr driver,
+                             virDomainObjPtr vm,
+                             int *monfd)
+{
+    qemuDomainObjPrivatePtr priv = vm->privateData;
+    int fd;
+
+    *monfd = -1;
+
+    if (!priv->qemuCaps ||
+        !virQEMUCapsGet(priv->qemuCaps, QEMU_CAPS_CHARDEV_FD_PASS) ||
+        priv->monConfig->type != VIR_DOMAIN_CHR_TYPE_UNIX ||
+        !priv->monConfig->data.nix.listen)
+        return 0;
+
+    if (qemuSecuritySetDaemonSocketLabel(driver->securityManager, vm->def) < 0)
+        return -1;
+
+    fd = qemuMonitorPreconnect(priv->monConfig);
+
+    if (qemuSecurityClearSocketLabel(driver->securityManager, vm->def) < 0) {
+        VIR_FORCE_CLOSE(fd);
+        return -1;
+    }
+
+    if (fd < 0)
+        return -1;
+
+    VIR_DEBUG("Preconnected monitor of vm=%p name='%s' fd=%d",
+              vm, vm->def->name, fd);
+    *monfd = fd;
+    return 0;
+}
+
+
 static int
 qemuProcessWaitForMonitor(virQEMUDriverPtr driver,
                           virDomainObjPtr vm,
                           int asyncJob,
+                          int *monfd,
                           qemuDomainLogContextPtr logCtxt)
 {
     int ret = -1;
@@ -2394,10 +2555,10 @@ qemuProcessWaitForMonitor(virQEMUDriverPtr driver,
         virQEMUCapsGet(priv->qemuCaps, QEMU_CAPS_CHARDEV_FD_PASS))
         retry = false;
 
-    VIR_DEBUG("Connect monitor to vm=%p name='%s' retry=%d",
-              vm, vm->def->name, retry);
+    VIR_DEBUG("Connect monitor to vm=%p name='%s' retry=%d monfd=%d",
+              vm, vm->def->name, retry, *monfd);
 
-    if (qemuConnectMonitor(driver, vm, asyncJob, retry, logCtxt) < 0)
+    if (qemuConnectMonitor(driver, vm, asyncJob, retry, monfd, logCtxt) < 0)
         goto cleanup;
 
     /* Try to get the pty path mappings again via the monitor. This is much more
@@ -5598,7 +5759,7 @@ qemuProcessInit(virQEMUDriverPtr driver,
             goto cleanup;
         }
     } else {
-        vm->def->id = qemuDriverAllocateID(driver);
+        virDomainObjSetID(vm, qemuDriverAllocateID(driver));
         qemuDomainSetFakeReboot(driver, vm, false);
         virDomainObjSetState(vm, VIR_DOMAIN_PAUSED, VIR_DOMAIN_PAUSED_STARTING_UP);
 
@@ -6691,6 +6852,9 @@ qemuProcessLaunch(virConnectPtr conn,
     g_autoptr(virQEMUDriverConfig) cfg = NULL;
     size_t nnicindexes = 0;
     g_autofree int *nicindexes = NULL;
+    VIR_AUTOCLOSE monfd = -1;
+    unsigned long long phase;
+    int rc;
     size_t i;
 
     VIR_DEBUG("conn=%p driver=%p vm=%p name=%s if=%d asyncJob=%d "
@@ -6749,20 +6913,27 @@ qemuProcessLaunch(virConnectPtr conn,
         goto cleanup;
 
     VIR_DEBUG("Building emulator command line");
-    if (!(cmd = qemuBuildCommandLine(driver,
-                                     qemuDomainLogContextGetManager(logCtxt),
-                                     driver->securityManager,
-                                     vm,
-                                     incoming ? incoming->launchURI : NULL,
-                                     snapshot, vmop,
-                                     false,
-                                     qemuCheckFips(),
-                                     &nnicindexes, &nicindexes)))
+    phase = qemuProcessPhaseBegin(vm, QEMU_DOMAIN_PROCESS_PHASE_COMMAND_LINE);
+    cmd = qemuBuildCommandLine(driver,
+                               qemuDomainLogContextGetManager(logCtxt),
+                               driver->securityManager,
+                               vm,
+                               incoming ? incoming->launchURI : NULL,
+                               snapshot, vmop,
+                               false,
+                               qemuCheckFips(),
+                               &nnicindexes, &nicindexes);
+    qemuProcessPhaseEnd(vm, QEMU_DOMAIN_PROCESS_PHASE_COMMAND_LINE,
+                        phase, cmd ? 0 : -1);
+    if (!cmd)
         goto cleanup;
 
     if (incoming && incoming->fd != -1)
         virCommandPassFD(cmd, incoming->fd, 0);
 
+    if (qemuProcessPreconnectMonitor(driver, vm, &monfd) < 0)
+        goto cleanup;
+
     /* now that we know it is about to start call the hook if present */
     if (qemuProcessStartHook(driver, vm,
                              VIR_HOOK_QEMU_OP_START,
@@ -6804,6 +6975,7 @@ qemuProcessLaunch(virConnectPtr conn,
 
     if (qemuSecurityPreFork(driver->securityManager) < 0)
         goto cleanup;
+    phase = qemuProcessPhaseBegin(vm, QEMU_DOMAIN_PROCESS_PHASE_SPAWN);
     rv = virCommandRun(cmd, NULL);
     qemuSecurityPostFork(driver->securityManager);
 
@@ -6813,6 +6985,7 @@ qemuProcessLaunch(virConnectPtr conn,
             virReportSystemError(-rv,
                                  _("Domain %s didn't show up"),
                                  vm->def->name);
+            qemuProcessPhaseEnd(vm, QEMU_DOMAIN_PROCESS_PHASE_SPAWN, phase, -1);
             goto cleanup;
         }
         VIR_DEBUG("QEMU vm=%p name=%s running with pid=%lld",
@@ -6820,23 +6993,31 @@ qemuProcessLaunch(virConnectPtr conn,
     } else {
         VIR_DEBUG("QEMU vm=%p name=%s failed to spawn",
                   vm, vm->def->name);
+        qemuProcessPhaseEnd(vm, QEMU_DOMAIN_PROCESS_PHASE_SPAWN, phase, -1);
         goto cleanup;
     }
 
     VIR_DEBUG("Writing early domain status to disk");
-    if (virDomainObjSave(vm, driver->xmlopt, cfg->stateDir) < 0)
+    if (virDomainObjSave(vm, driver->xmlopt, cfg->stateDir) < 0) {
+        qemuProcessPhaseEnd(vm, QEMU_DOMAIN_PROCESS_PHASE_SPAWN, phase, -1);
         goto cleanup;
+    }
 
     VIR_DEBUG("Waiting for handshake from child");
     if (virCommandHandshakeWait(cmd) < 0) {
         /* Read errors from child that occurred between fork and exec. */
         qemuProcessReportLogError(logCtxt,
                                   _("Process exited prior to exec"));
+        qemuProcessPhaseEnd(vm, QEMU_DOMAIN_PROCESS_PHASE_SPAWN, phase, -1);
         goto cleanup;
     }
+    qemuProcessPhaseEnd(vm, QEMU_DOMAIN_PROCESS_PHASE_SPAWN, phase, 0);
 
     VIR_DEBUG("Setting up domain cgroup (if required)");
-    if (qemuSetupCgroup(vm, nnicindexes, nicindexes) < 0)
+    phase = qemuProcessPhaseBegin(vm, QEMU_DOMAIN_PROCESS_PHASE_CGROUP);
+    rc = qemuSetupCgroup(vm, nnicindexes, nicindexes);
+    qemuProcessPhaseEnd(vm, QEMU_DOMAIN_PROCESS_PHASE_CGROUP, phase, rc);
+    if (rc < 0)
         goto cleanup;
 
     if (!(priv->perf = virPerfNew()))
@@ -6871,10 +7052,13 @@ qemuProcessLaunch(virConnectPtr conn,
         goto cleanup;
 
     VIR_DEBUG("Setting domain security labels");
-    if (qemuSecuritySetAllLabel(driver,
-                                vm,
-                                incoming ? incoming->path : NULL,
-                                incoming != NULL) < 0)
+    phase = qemuProcessPhaseBegin(vm, QEMU_DOMAIN_PROCESS_PHASE_SECURITY_LABEL);
+    rc = qemuSecuritySetAllLabel(driver,
+                                 vm,
+                                 incoming ? incoming->path : NULL,
+                                 incoming != NULL);
+    qemuProcessPhaseEnd(vm, QEMU_DOMAIN_PROCESS_PHASE_SECURITY_LABEL, phase, rc);
+    if (rc < 0)
         goto cleanup;
 
     /* Security manager labeled all devices, therefore
@@ -6917,7 +7101,10 @@ qemuProcessLaunch(virConnectPtr conn,
         goto cleanup;
 
     VIR_DEBUG("Waiting for monitor to show up");
-    if (qemuProcessWaitForMonitor(driver, vm, asyncJob, logCtxt) < 0)
+    phase = qemuProcessPhaseBegin(vm, QEMU_DOMAIN_PROCESS_PHASE_MONITOR);
+    rc = qemuProcessWaitForMonitor(driver, vm, asyncJob, &monfd, logCtxt);
+    qemuProcessPhaseEnd(vm, QEMU_DOMAIN_PROCESS_PHASE_MONITOR, phase, rc);
+    if (rc < 0)
         goto cleanup;
 
     if (qemuConnectAgent(driver, vm) < 0)
@@ -7108,6 +7295,7 @@ qemuProcessStart(virConnectPtr conn,
     qemuProcessIncomingDefPtr incoming = NULL;
     unsigned int stopFlags;
     bool relabel = false;
+    unsigned long long phase;
     int ret = -1;
     int rv;
 
@@ -7127,8 +7315,13 @@ qemuProcessStart(virConnectPtr conn,
     if (!migrateFrom && !snapshot)
         flags |= VIR_QEMU_PROCESS_START_NEW;
 
-    if (qemuProcessInit(driver, vm, updatedCPU,
-                        asyncJob, !!migrateFrom, flags) < 0)
+    memset(priv->phaseTimes, 0, sizeof(priv->phaseTimes));
+
+    phase = qemuProcessPhaseBegin(vm, QEMU_DOMAIN_PROCESS_PHASE_INIT);
+    rv = qemuProcessInit(driver, vm, updatedCPU,
+                         asyncJob, !!migrateFrom, flags);
+    qemuProcessPhaseEnd(vm, QEMU_DOMAIN_PROCESS_PHASE_INIT, phase, rv);
+    if (rv < 0)
         goto cleanup;
 
     if (migrateFrom) {
@@ -7138,14 +7331,23 @@ qemuProcessStart(virConnectPtr conn,
             goto stop;
     }
 
-    if (qemuProcessPrepareDomain(driver, vm, flags) < 0)
+    phase = qemuProcessPhaseBegin(vm, QEMU_DOMAIN_PROCESS_PHASE_PREPARE_DOMAIN);
+    rv = qemuProcessPrepareDomain(driver, vm, flags);
+    qemuProcessPhaseEnd(vm, QEMU_DOMAIN_PROCESS_PHASE_PREPARE_DOMAIN, phase, rv);
+    if (rv < 0)
         goto stop;
 
-    if (qemuProcessPrepareHost(driver, vm, flags) < 0)
+    phase = qemuProcessPhaseBegin(vm, QEMU_DOMAIN_PROCESS_PHASE_PREPARE_HOST);
+    rv = qemuProcessPrepareHost(driver, vm, flags);
+    qemuProcessPhaseEnd(vm, QEMU_DOMAIN_PROCESS_PHASE_PREPARE_HOST, phase, rv);
+    if (rv < 0)
         goto stop;
 
-    if ((rv = qemuProcessLaunch(conn, driver, vm, asyncJob, incoming,
-                                snapshot, vmop, flags)) < 0) {
+    phase = qemuProcessPhaseBegin(vm, QEMU_DOMAIN_PROCESS_PHASE_LAUNCH);
+    rv = qemuProcessLaunch(conn, driver, vm, asyncJob, incoming,
+                           snapshot, vmop, flags);
+    qemuProcessPhaseEnd(vm, QEMU_DOMAIN_PROCESS_PHASE_LAUNCH, phase, rv);
+    if (rv < 0) {
         if (rv == -2)
             relabel = true;
         goto stop;
@@ -7160,15 +7362,22 @@ qemuProcessStart(virConnectPtr conn,
         /* Refresh state of devices from QEMU. During migration this happens
          * in qemuMigrationDstFinish to ensure that state information is fully
          * transferred. */
-        if (qemuProcessRefreshState(driver, vm, asyncJob) < 0)
+        phase = qemuProcessPhaseBegin(vm, QEMU_DOMAIN_PROCESS_PHASE_REFRESH_STATE);
+        rv = qemuProcessRefreshState(driver, vm, asyncJob);
+        qemuProcessPhaseEnd(vm, QEMU_DOMAIN_PROCESS_PHASE_REFRESH_STATE,
+                            phase, rv);
+        if (rv < 0)
             goto stop;
     }
 
-    if (qemuProcessFinishStartup(driver, vm, asyncJob,
-                                 !(flags & VIR_QEMU_PROCESS_START_PAUSED),
-                                 incoming ?
-                                 VIR_DOMAIN_PAUSED_MIGRATION :
-                                 VIR_DOMAIN_PAUSED_USER) < 0)
+    phase = qemuProcessPhaseBegin(vm, QEMU_DOMAIN_PROCESS_PHASE_FINISH_STARTUP);
+    rv = qemuProcessFinishStartup(driver, vm, asyncJob,
+                                  !(flags & VIR_QEMU_PROCESS_START_PAUSED),
+                                  incoming ?
+                                  VIR_DOMAIN_PAUSED_MIGRATION :
+                                  VIR_DOMAIN_PAUSED_USER);
+    qemuProcessPhaseEnd(vm, QEMU_DOMAIN_PROCESS_PHASE_FINISH_STARTUP, phase, rv);
+    if (rv < 0)
         goto stop;
 
     if (!incoming) {
@@ -7177,6 +7386,8 @@ qemuProcessStart(virConnectPtr conn,
         qemuMonitorSetDomainLog(priv->mon, NULL, NULL, NULL);
     }
 
+    qemuProcessPhaseLog(driver, vm);
+
     ret = 0;
 
  cleanup:
@@ -7319,6 +7530,7 @@ void qemuProcessStop(virQEMUDriverPtr driver,
     g_autofree char *timestamp = NULL;
     g_autoptr(virQEMUDriverConfig) cfg = virQEMUDriverGetConfig(driver);
     g_autoptr(virConnect) conn = NULL;
+    unsigned long long phase;
 
     VIR_DEBUG("Shutting down vm=%p name=%s id=%d pid=%lld, "
               "reason=%s, asyncJob=%s, flags=0x%x",
@@ -7347,6 +7559,8 @@ void qemuProcessStop(virQEMUDriverPtr driver,
         goto endjob;
     }
 
+    phase = qemuProcessPhaseBegin(vm, QEMU_DOMAIN_PROCESS_PHASE_STOP);
+
     qemuProcessBuildDestroyMemoryPaths(driver, vm, NULL, false);
 
     if (!!g_atomic_int_dec_and_test(&driver->nactive) && driver->inhibitCallback)
@@ -7434,7 +7648,7 @@ void qemuProcessStop(virQEMUDriverPtr driver,
 
     qemuExtDevicesStop(driver, vm);
 
-    vm->def->id = -1;
+    virDomainObjSetID(vm, -1);
 
     /* Stop autodestroy in case guest is restarted */
     qemuProcessAutoDestroyRemove(driver, vm);
@@ -7640,6 +7854,8 @@ void qemuProcessStop(virQEMUDriverPtr driver,
 
     virDomainObjRemoveTransientDef(vm);
 
+    qemuProcessPhaseEnd(vm, QEMU_DOMAIN_PROCESS_PHASE_STOP, phase, 0);
+
  endjob:
     if (asyncJob != QEMU_ASYNC_JOB_NONE)
         qemuDomainObjEndJob(driver, vm);
@@ -8010,7 +8226,7 @@ qemuProcessReconnect(void *opaque)
     tryMonReconn = true;
 
     /* XXX check PID liveliness & EXE path */
-    if (qemuConnectMonitor(driver, obj, QEMU_ASYNC_JOB_NONE, retry, NULL) < 0)
+    if (qemuConnectMonitor(driver, obj, QEMU_ASYNC_JOB_NONE, retry, NULL, NULL) < 0)
         goto error;
 
     priv->machineName = qemuDomainGetMachineName(obj);
@@ -1256,6 +1256,11 @@ int main(int argc, char **argv) {
         goto cleanup;
     }
 
+    if (virNetServerSetEventThreads(srv, config->event_loop_threads) < 0) {
+        ret = VIR_DAEMON_ERR_INIT;
+        goto cleanup;
+    }
+
     if (virNetDaemonAddServer(dmn, srv) < 0) {
         ret = VIR_DAEMON_ERR_INIT;
         goto cleanup;
@@ -324,6 +324,15 @@ daemonConfigLoadOptions(struct daemonConfig *data,
     if (virConfGetValueUInt(conf, "prio_workers", &data->prio_workers) < 0)
         return -1;
 
+    if (virConfGetValueUInt(conf, "event_loop_threads", &data->event_loop_threads) < 0)
+        return -1;
+    if (data->event_loop_threads > VIR_NET_SERVER_EVENT_THREADS_MAX) {
+        virReportError(VIR_ERR_INTERNAL_ERROR,
+                       _("'event_loop_threads' must not be greater than %d"),
+                       VIR_NET_SERVER_EVENT_THREADS_MAX);
+        return -1;
+    }
+
     if (virConfGetValueUInt(conf, "max_client_requests", &data->max_client_requests) < 0)
         return -1;
 
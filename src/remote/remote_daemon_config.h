@@ -73,6 +73,8 @@ struct daemonConfig {
 
     unsigned int prio_workers;
 
+    unsigned int event_loop_threads;
+
     unsigned int max_client_requests;
 
     unsigned int log_level;
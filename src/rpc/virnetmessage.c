@@ -29,6 +29,7 @@
 #include "virfile.h"
 #include "virutil.h"
 #include "virstring.h"
+#include "virprobe.h"
 
 #define VIR_FROM_THIS VIR_FROM_RPC
 
@@ -344,12 +345,62 @@ int virNetMessageDecodeNumFDs(virNetMessagePtr msg)
 }
 
 
+/* Accounting of payload encoding, to find out how often a reply did
+ * not fit the buffer it was first encoded into */
+static int virNetMessageEncodeCount;
+static int virNetMessageReencodeCount;
+static int virNetMessageResizeCount;
+
+
+/**
+ * virNetMessageGetEncodeStats:
+ * @encoded: filled with the number of payloads encoded
+ * @reencoded: filled with the number of extra encoding passes
+ * @resized: filled with the number of times a buffer was grown
+ *
+ * Report how many payloads were serialised by this process and how many
+ * times one had to be encoded again because it did not fit the message
+ * buffer.
+ */
+void
+virNetMessageGetEncodeStats(unsigned int *encoded,
+                            unsigned int *reencoded,
+                            unsigned int *resized)
+{
+    *encoded = g_atomic_int_get(&virNetMessageEncodeCount);
+    *reencoded = g_atomic_int_get(&virNetMessageReencodeCount);
+    *resized = g_atomic_int_get(&virNetMessageResizeCount);
+}
+
+
+static int
+virNetMessageResizeBuffer(virNetMessagePtr msg,
+                          size_t len)
+{
+    if (len > VIR_NET_MESSAGE_MAX + VIR_NET_MESSAGE_LEN_MAX) {
+        virReportError(VIR_ERR_RPC, "%s", _("Unable to encode message payload"));
+        return -1;
+    }
+
+    if (VIR_REALLOC_N(msg->buffer, len) < 0)
+        return -1;
+    msg->bufferLength = len;
+
+    g_atomic_int_inc(&virNetMessageResizeCount);
+    VIR_DEBUG("Increased message buffer length = %zu", msg->bufferLength);
+    return 0;
+}
+
+
 int virNetMessageEncodePayload(virNetMessagePtr msg,
                                xdrproc_t filter,
                                void *data)
 {
     XDR xdr;
     unsigned int msglen;
+    size_t passes = 1;
+
+    g_atomic_int_inc(&virNetMessageEncodeCount);
 
     /* Serialise payload of the message. This assumes that
      * virNetMessageEncodeHeader has already been run, so
@@ -357,33 +408,54 @@ int virNetMessageEncodePayload(virNetMessagePtr msg,
     xdrmem_create(&xdr, msg->buffer + msg->bufferOffset,
                   msg->bufferLength - msg->bufferOffset, XDR_ENCODE);
 
-    /* Try to encode the payload. If the buffer is too small increase it. */
+    /* Try to encode the payload. Most payloads fit the initial buffer
+     * so just go for it. If the buffer is too small increase it. */
     while (!(*filter)(&xdr, data, 0)) {
-        unsigned int newlen = msg->bufferLength - VIR_NET_MESSAGE_LEN_MAX;
-        newlen *= 2;
+        size_t newlen;
+#ifdef HAVE_XDR_SIZEOF
+        unsigned long payloadlen;
+
+        /* Work out the exact size the payload needs, so that the
+         * buffer is grown once and the payload encoded only once
+         * more, instead of doubling the buffer until it fits. */
+        if (!(payloadlen = xdr_sizeof(filter, data)) ||
+            payloadlen > VIR_NET_MESSAGE_MAX) {
+            virReportError(VIR_ERR_RPC, "%s", _("Unable to encode message payload"));
+            goto error;
+        }
+        newlen = msg->bufferOffset + payloadlen;
 
-        if (newlen > VIR_NET_MESSAGE_MAX) {
+        if (newlen <= msg->bufferLength) {
+            /* The buffer was big enough, so something else is wrong */
             virReportError(VIR_ERR_RPC, "%s", _("Unable to encode message payload"));
             goto error;
         }
+#else /* !HAVE_XDR_SIZEOF */
+        newlen = (msg->bufferLength - VIR_NET_MESSAGE_LEN_MAX) * 2;
+        newlen += VIR_NET_MESSAGE_LEN_MAX;
+#endif /* !HAVE_XDR_SIZEOF */
 
         xdr_destroy(&xdr);
 
-        msg->bufferLength = newlen + VIR_NET_MESSAGE_LEN_MAX;
-
-        if (VIR_REALLOC_N(msg->buffer, msg->bufferLength) < 0)
-            goto error;
+        if (virNetMessageResizeBuffer(msg, newlen) < 0)
+            return -1;
 
         xdrmem_create(&xdr, msg->buffer + msg->bufferOffset,
                       msg->bufferLength - msg->bufferOffset, XDR_ENCODE);
 
-        VIR_DEBUG("Increased message buffer length = %zu", msg->bufferLength);
+        g_atomic_int_inc(&virNetMessageReencodeCount);
+        passes++;
     }
 
     /* Get the length stored in buffer. */
     msg->bufferOffset += xdr_getpos(&xdr);
     xdr_destroy(&xdr);
 
+    if (passes > 1)
+        PROBE(RPC_MESSAGE_REENCODE,
+              "msg=%p len=%zu passes=%zu",
+              msg, msg->bufferOffset, passes);
+
     /* Re-encode the length word. */
     VIR_DEBUG("Encode length as %zu", msg->bufferOffset);
     xdrmem_create(&xdr, msg->buffer, VIR_NET_MESSAGE_HEADER_XDR_LEN, XDR_ENCODE);
@@ -27,6 +27,7 @@
 #include "virerror.h"
 #include "virthread.h"
 #include "virthreadpool.h"
+#include "vireventthread.h"
 #include "virstring.h"
 #include "virutil.h"
 
@@ -52,6 +53,12 @@ struct _virNetServer {
     /* Immutable pointer, self-locking APIs */
     virThreadPoolPtr workers;
 
+    /* Dedicated event loops client sockets are spread across,
+     * empty if clients are served from the default event loop */
+    size_t neventThreads;
+    virEventThread **eventThreads;
+    size_t nextEventThread;
+
     size_t nservices;
     virNetServerServicePtr *services;
 
@@ -222,7 +229,10 @@ virNetServerDispatchNewMessage(virNetServerClientPtr client,
             priority = virNetServerProgramGetPriority(prog, msg->header.proc);
         }
 
-        if (virThreadPoolSendJob(srv->workers, priority, job) < 0) {
+        /* Jobs are keyed by client so that a client keeping its
+         * nrequests_max calls in flight all the time does not delay
+         * calls of other clients */
+        if (virThreadPoolSendJobFull(srv->workers, priority, client, job) < 0) {
             virObjectUnref(client);
             VIR_FREE(job);
             virObjectUnref(prog);
@@ -288,6 +298,21 @@ int virNetServerAddClient(virNetServerPtr srv,
 {
     virObjectLock(srv);
 
+    /* With dedicated event loops the client may start dispatching
+     * messages as soon as it is initialized, so the dispatcher has
+     * to be in place beforehand. */
+    virNetServerClientSetDispatcher(client,
+                                    virNetServerDispatchNewMessage,
+                                    srv);
+
+    if (srv->neventThreads > 0) {
+        virEventThread *evt = srv->eventThreads[srv->nextEventThread];
+
+        srv->nextEventThread = (srv->nextEventThread + 1) % srv->neventThreads;
+        virNetServerClientSetEventContext(client,
+                                          virEventThreadGetContext(evt));
+    }
+
     if (virNetServerClientInit(client) < 0)
         goto error;
 
@@ -302,10 +327,6 @@ int virNetServerAddClient(virNetServerPtr srv,
 
     virNetServerCheckLimits(srv);
 
-    virNetServerClientSetDispatcher(client,
-                                    virNetServerDispatchNewMessage,
-                                    srv);
-
     virNetServerClientInitKeepAlive(client, srv->keepaliveInterval,
                                     srv->keepaliveCount);
 
@@ -924,6 +945,10 @@ void virNetServerDispose(void *obj)
     for (i = 0; i < srv->nclients; i++)
         virObjectUnref(srv->clients[i]);
     VIR_FREE(srv->clients);
+
+    for (i = 0; i < srv->neventThreads; i++)
+        g_object_unref(srv->eventThreads[i]);
+    VIR_FREE(srv->eventThreads);
 }
 
 void virNetServerClose(virNetServerPtr srv)
@@ -1038,6 +1063,134 @@ virNetServerGetThreadPoolParameters(virNetServerPtr srv,
     return 0;
 }
 
+/**
+ * virNetServerSetEventThreads:
+ * @srv: server object
+ * @nthreads: number of event loop threads
+ *
+ * Start @nthreads dedicated event loop threads and serve the sockets
+ * of newly added clients from them in a round-robin fashion instead
+ * of the default event loop. Listening sockets and timers stay on the
+ * default event loop. Passing zero keeps every client on the default
+ * event loop. Can only be called once, before clients are added.
+ *
+ * Returns 0 on success, -1 on error.
+ */
+int
+virNetServerSetEventThreads(virNetServerPtr srv,
+                            size_t nthreads)
+{
+    size_t i;
+    int ret = -1;
+
+    virObjectLock(srv);
+
+    if (srv->neventThreads > 0) {
+        virReportError(VIR_ERR_OPERATION_INVALID, "%s",
+                       _("event loop threads are already running"));
+        goto cleanup;
+    }
+
+    if (nthreads == 0) {
+        ret = 0;
+        goto cleanup;
+    }
+
+    if (nthreads > VIR_NET_SERVER_EVENT_THREADS_MAX) {
+        virReportError(VIR_ERR_INVALID_ARG,
+                       _("at most %d event loop threads are supported"),
+                       VIR_NET_SERVER_EVENT_THREADS_MAX);
+        goto cleanup;
+    }
+
+    srv->eventThreads = g_new0(virEventThread *, nthreads);
+
+    for (i = 0; i < nthreads; i++) {
+        g_autofree char *name = g_strdup_printf("rpc-evt-%zu", i);
+
+        if (!(srv->eventThreads[i] = virEventThreadNew(name)))
+            goto error;
+        srv->neventThreads++;
+    }
+
+    ret = 0;
+
+ cleanup:
+    virObjectUnlock(srv);
+    return ret;
+
+ error:
+    for (i = 0; i < srv->neventThreads; i++)
+        g_object_unref(srv->eventThreads[i]);
+    VIR_FREE(srv->eventThreads);
+    srv->neventThreads = 0;
+    goto cleanup;
+}
+
+
+/**
+ * virNetServerGetEventThreadStats:
+ * @srv: server object
+ * @busy: filled with busy time per event loop thread, in microseconds
+ * @total: filled with lifetime per event loop thread, in microseconds
+ *
+ * Returns the number of dedicated event loop threads, with @busy and
+ * @total allocated to hold as many elements, or 0 if the server only
+ * uses the default event loop.
+ */
+size_t
+virNetServerGetEventThreadStats(virNetServerPtr srv,
+                                unsigned long long **busy,
+                                unsigned long long **total)
+{
+    size_t i;
+    size_t n;
+
+    *busy = NULL;
+    *total = NULL;
+
+    virObjectLock(srv);
+
+    if ((n = srv->neventThreads) > 0) {
+        *busy = g_new0(unsigned long long, n);
+        *total = g_new0(unsigned long long, n);
+
+        for (i = 0; i < n; i++)
+            virEventThreadGetStats(srv->eventThreads[i],
+                                   &(*busy)[i], &(*total)[i]);
+    }
+
+    virObjectUnlock(srv);
+    return n;
+}
+
+
+/**
+ * virNetServerGetJobQueueLatency:
+ * @srv: server object
+ * @limits: filled with the upper bound of each bucket in microseconds,
+ *          zero for the last, unbounded one
+ * @counts: filled with the number of calls per bucket
+ *
+ * Returns the number of buckets of the histogram of time calls spent
+ * waiting for a worker thread, with @limits and @counts allocated to
+ * hold as many elements.
+ */
+size_t
+virNetServerGetJobQueueLatency(virNetServerPtr srv,
+                               unsigned long long **limits,
+                               unsigned long long **counts)
+{
+    size_t n;
+
+    virObjectLock(srv);
+    n = virThreadPoolGetJobQueueLatency(srv->workers, limits, counts);
+    virObjectUnlock(srv);
+
+    return n;
+}
+
+
 int
 virNetServerSetThreadPoolParameters(virNetServerPtr srv,
                                     long long int minWorkers,
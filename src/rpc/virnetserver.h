@@ -114,6 +114,21 @@ int virNetServerSetThreadPoolParameters(virNetServerPtr srv,
                                         long long int maxWorkers,
                                         long long int prioWorkers);
 
+/* Every event loop thread is reported as a separate threadpool
+ * parameter by the admin interface, which limits their number */
+#define VIR_NET_SERVER_EVENT_THREADS_MAX 16
+
+int virNetServerSetEventThreads(virNetServerPtr srv,
+                                size_t nthreads);
+
+size_t virNetServerGetEventThreadStats(virNetServerPtr srv,
+                                       unsigned long long **busy,
+                                       unsigned long long **total);
+
+size_t virNetServerGetJobQueueLatency(virNetServerPtr srv,
+                                      unsigned long long **limits,
+                                      unsigned long long **counts);
+
 unsigned long long virNetServerNextClientID(virNetServerPtr srv);
 
 virNetServerClientPtr virNetServerGetClient(virNetServerPtr srv,
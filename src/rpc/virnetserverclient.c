@@ -928,6 +928,24 @@ void virNetServerClientSetCloseHook(virNetServerClientPtr client,
 }
 
 
+/**
+ * virNetServerClientSetEventContext:
+ * @client: the client
+ * @context: event loop context to handle the client socket in
+ *
+ * Make the socket I/O of @client run in @context rather than in the
+ * default event loop. Must be called before virNetServerClientInit.
+ */
+void virNetServerClientSetEventContext(virNetServerClientPtr client,
+                                       GMainContext *context)
+{
+    virObjectLock(client);
+    if (client->sock)
+        virNetSocketSetEventContext(client->sock, context);
+    virObjectUnlock(client);
+}
+
+
 void virNetServerClientSetDispatcher(virNetServerClientPtr client,
                                      virNetServerClientDispatchFunc func,
                                      void *opaque)
@@ -1463,6 +1481,7 @@ virNetServerClientDispatchEvent(virNetSocketPtr sock, int events, void *opaque)
 {
     virNetServerClientPtr client = opaque;
     virNetMessagePtr msg = NULL;
+    bool wantClose;
 
     virObjectLock(client);
 
@@ -1493,8 +1512,16 @@ virNetServerClientDispatchEvent(virNetSocketPtr sock, int events, void *opaque)
                   VIR_EVENT_HANDLE_HANGUP))
         client->wantClose = true;
 
+    wantClose = client->wantClose;
+
     virObjectUnlock(client);
 
+    /* Closed clients are reaped by the daemon from the default event
+     * loop; make sure it notices even if this client is served from
+     * a dedicated event loop thread. */
+    if (wantClose)
+        g_main_context_wakeup(NULL);
+
     if (msg)
         virNetServerClientDispatchMessage(client, msg);
 }
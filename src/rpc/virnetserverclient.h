@@ -136,6 +136,9 @@ typedef void (*virNetServerClientCloseFunc)(virNetServerClientPtr client);
 void virNetServerClientSetCloseHook(virNetServerClientPtr client,
                                     virNetServerClientCloseFunc cf);
 
+void virNetServerClientSetEventContext(virNetServerClientPtr client,
+                                       GMainContext *context);
+
 void virNetServerClientSetDispatcher(virNetServerClientPtr client,
                                      virNetServerClientDispatchFunc func,
                                      void *opaque);
@@ -79,6 +79,10 @@ struct _virNetSocket {
     void *opaque;
     virFreeCallback ff;
 
+    /* Dedicated event loop, NULL to use the default one */
+    GMainContext *context;
+    GSource *source;
+
     virSocketAddr localAddr;
     virSocketAddr remoteAddr;
     char *localAddrStrSASL;
@@ -1336,6 +1340,9 @@ void virNetSocketDispose(void *obj)
         sock->watch = -1;
     }
 
+    if (sock->context)
+        g_main_context_unref(sock->context);
+
 #ifndef WIN32
     /* If a server socket, then unlink UNIX path */
     if (sock->unlinkUNIX &&
@@ -2183,6 +2190,142 @@ static void virNetSocketEventFree(void *opaque)
     virObjectUnref(sock);
 }
 
+#ifndef WIN32
+/* Event source used when the socket is bound to a dedicated
+ * event loop. The file descriptor is polled through a unix fd
+ * tag so that the watched events can be changed in place from
+ * any thread. */
+typedef struct _virNetSocketSource virNetSocketSource;
+struct _virNetSocketSource {
+    GSource parent;
+    gpointer tag;
+    virNetSocketPtr sock;
+};
+
+
+static GIOCondition
+virNetSocketEventsToCondition(int events)
+{
+    GIOCondition cond = 0;
+
+    if (events & VIR_EVENT_HANDLE_READABLE)
+        cond |= G_IO_IN;
+    if (events & VIR_EVENT_HANDLE_WRITABLE)
+        cond |= G_IO_OUT;
+    if (events & VIR_EVENT_HANDLE_ERROR)
+        cond |= G_IO_ERR;
+    if (events & VIR_EVENT_HANDLE_HANGUP)
+        cond |= G_IO_HUP;
+
+    return cond;
+}
+
+
+static int
+virNetSocketConditionToEvents(GIOCondition cond)
+{
+    int events = 0;
+
+    if (cond & G_IO_IN)
+        events |= VIR_EVENT_HANDLE_READABLE;
+    if (cond & G_IO_OUT)
+        events |= VIR_EVENT_HANDLE_WRITABLE;
+    if (cond & (G_IO_ERR | G_IO_NVAL))
+        events |= VIR_EVENT_HANDLE_ERROR;
+    if (cond & G_IO_HUP)
+        events |= VIR_EVENT_HANDLE_HANGUP;
+
+    return events;
+}
+
+
+static gboolean
+virNetSocketSourceDispatch(GSource *source,
+                           GSourceFunc callback G_GNUC_UNUSED,
+                           gpointer user_data G_GNUC_UNUSED)
+{
+    virNetSocketSource *ssrc = (virNetSocketSource *)source;
+    GIOCondition cond = 0;
+
+    /* The tag is replaced and freed by virNetSocketSourceSetEvents
+     * from other threads, which hold the socket lock as well. */
+    virObjectLock(ssrc->sock);
+    if (ssrc->tag)
+        cond = g_source_query_unix_fd(source, ssrc->tag);
+    virObjectUnlock(ssrc->sock);
+
+    if (cond)
+        virNetSocketEventHandle(-1, -1,
+                                virNetSocketConditionToEvents(cond),
+                                ssrc->sock);
+
+    return G_SOURCE_CONTINUE;
+}
+
+
+static void
+virNetSocketSourceFinalize(GSource *source)
+{
+    virNetSocketSource *ssrc = (virNetSocketSource *)source;
+
+    virNetSocketEventFree(ssrc->sock);
+}
+
+
+static GSourceFuncs virNetSocketSourceFuncs = {
+    .dispatch = virNetSocketSourceDispatch,
+    .finalize = virNetSocketSourceFinalize,
+};
+
+
+/* The caller must hold the lock on @sock */
+static void
+virNetSocketSourceSetEvents(virNetSocketPtr sock,
+                            int events)
+{
+    virNetSocketSource *ssrc = (virNetSocketSource *)sock->source;
+    GIOCondition cond = virNetSocketEventsToCondition(events);
+
+    /* Without any events the fd must not be polled at all, otherwise
+     * a hung up peer would be reported over and over again. */
+    if (!cond) {
+        if (ssrc->tag)
+            g_source_remove_unix_fd(sock->source, ssrc->tag);
+        ssrc->tag = NULL;
+    } else if (ssrc->tag) {
+        g_source_modify_unix_fd(sock->source, ssrc->tag, cond);
+    } else {
+        ssrc->tag = g_source_add_unix_fd(sock->source, sock->fd, cond);
+    }
+}
+#endif /* !WIN32 */
+
+
+/**
+ * virNetSocketSetEventContext:
+ * @sock: the socket
+ * @context: event loop context to dispatch I/O events in
+ *
+ * Bind the I/O callback of @sock to @context instead of the default
+ * event loop. Must be called before virNetSocketAddIOCallback. The
+ * callback is then invoked from the thread iterating @context.
+ * On platforms lacking unix fd sources this is a no-op.
+ */
+void virNetSocketSetEventContext(virNetSocketPtr sock,
+                                 GMainContext *context)
+{
+    virObjectLock(sock);
+    if (sock->watch >= 0 || sock->source) {
+        VIR_DEBUG("Watch already registered on socket %p", sock);
+    } else {
+        if (sock->context)
+            g_main_context_unref(sock->context);
+        sock->context = context ? g_main_context_ref(context) : NULL;
+    }
+    virObjectUnlock(sock);
+}
+
+
 int virNetSocketAddIOCallback(virNetSocketPtr sock,
                               int events,
                               virNetSocketIOFunc func,
@@ -2193,11 +2336,31 @@ int virNetSocketAddIOCallback(virNetSocketPtr sock,
 
     virObjectRef(sock);
     virObjectLock(sock);
-    if (sock->watch >= 0) {
+    if (sock->watch >= 0 || sock->source) {
         VIR_DEBUG("Watch already registered on socket %p", sock);
         goto cleanup;
     }
 
+#ifndef WIN32
+    if (sock->context) {
+        virNetSocketSource *ssrc;
+
+        ssrc = (virNetSocketSource *)g_source_new(&virNetSocketSourceFuncs,
+                                                  sizeof(*ssrc));
+        ssrc->sock = sock;
+        sock->source = &ssrc->parent;
+        sock->func = func;
+        sock->opaque = opaque;
+        sock->ff = ff;
+
+        virNetSocketSourceSetEvents(sock, events);
+        g_source_attach(sock->source, sock->context);
+
+        ret = 0;
+        goto cleanup;
+    }
+#endif /* !WIN32 */
+
     if ((sock->watch = virEventAddHandle(sock->fd,
                                          events,
                                          virNetSocketEventHandle,
@@ -2223,6 +2386,14 @@ void virNetSocketUpdateIOCallback(virNetSocketPtr sock,
                                   int events)
 {
     virObjectLock(sock);
+#ifndef WIN32
+    if (sock->source) {
+        virNetSocketSourceSetEvents(sock, events);
+        virObjectUnlock(sock);
+        return;
+    }
+#endif /* !WIN32 */
+
     if (sock->watch < 0) {
         VIR_DEBUG("Watch not registered on socket %p", sock);
         virObjectUnlock(sock);
@@ -2238,6 +2409,17 @@ void virNetSocketRemoveIOCallback(virNetSocketPtr sock)
 {
     virObjectLock(sock);
 
+    if (sock->source) {
+        GSource *source = g_steal_pointer(&sock->source);
+
+        /* Finalizing the source calls virNetSocketEventFree which
+         * needs to take the socket lock. */
+        virObjectUnlock(sock);
+        g_source_destroy(source);
+        g_source_unref(source);
+        return;
+    }
+
     if (sock->watch < 0) {
         VIR_DEBUG("Watch not registered on socket %p", sock);
         virObjectUnlock(sock);
@@ -201,6 +201,30 @@ static int virSecurityDACRestoreFileLabelInternal(virSecurityManagerPtr mgr,
                                                   const virStorageSource *src,
                                                   const char *path,
                                                   bool recall);
+static int
+virSecurityDACTransactionRunItem(size_t idx,
+                                 void *opaque)
+{
+    virSecurityDACChownListPtr list = opaque;
+    virSecurityDACChownItemPtr item = list->items[idx];
+    const bool remember = item->remember && list->lock;
+
+    if (!item->restore) {
+        return virSecurityDACSetOwnership(list->manager,
+                                          item->src,
+                                          item->path,
+                                          item->uid,
+                                          item->gid,
+                                          remember);
+    }
+
+    return virSecurityDACRestoreFileLabelInternal(list->manager,
+                                                  item->src,
+                                                  item->path,
+                                                  remember);
+}
+
+
 /**
  * virSecurityDACTransactionRun:
  * @pid: process pid
@@ -208,8 +232,8 @@ static int virSecurityDACRestoreFileLabelInternal(virSecurityManagerPtr mgr,
  *
  * This is the callback that runs in the same namespace as the domain we are
  * relabelling. For given transaction (@opaque) it relabels all the paths on
- * the list. Depending on security manager configuration it might lock paths
- * we will relabel.
+ * the list, distinct paths concurrently. Depending on security manager
+ * configuration it might lock paths we will relabel.
  *
  * Returns: 0 on success
  *         -1 otherwise.
@@ -222,6 +246,8 @@ virSecurityDACTransactionRun(pid_t pid G_GNUC_UNUSED,
     virSecurityManagerMetadataLockStatePtr state;
     const char **paths = NULL;
     size_t npaths = 0;
+    g_autofree const char **itemPaths = NULL;
+    g_autofree bool *done = NULL;
     size_t i;
     int rv = 0;
     int ret = -1;
@@ -243,45 +269,30 @@ virSecurityDACTransactionRun(pid_t pid G_GNUC_UNUSED,
 
         for (i = 0; i < list->nItems; i++) {
             virSecurityDACChownItemPtr item = list->items[i];
-            size_t j;
-
-            for (j = 0; j < state->nfds; j++) {
-                if (STREQ_NULLABLE(item->path, state->paths[j]))
-                    break;
-            }
 
             /* If path wasn't locked, don't try to remember its label. */
-            if (j == state->nfds)
+            if (!virSecurityManagerMetadataLockStateHasPath(state, item->path))
                 item->remember = false;
         }
     }
 
-    for (i = 0; i < list->nItems; i++) {
-        virSecurityDACChownItemPtr item = list->items[i];
-        const bool remember = item->remember && list->lock;
+    itemPaths = g_new0(const char *, list->nItems);
+    done = g_new0(bool, list->nItems);
 
-        if (!item->restore) {
-            rv = virSecurityDACSetOwnership(list->manager,
-                                            item->src,
-                                            item->path,
-                                            item->uid,
-                                            item->gid,
-                                            remember);
-        } else {
-            rv = virSecurityDACRestoreFileLabelInternal(list->manager,
-                                                        item->src,
-                                                        item->path,
-                                                        remember);
-        }
+    for (i = 0; i < list->nItems; i++)
+        itemPaths[i] = list->items[i]->path;
 
-        if (rv < 0)
-            break;
-    }
+    rv = virSecurityRelabelConcurrent(itemPaths, list->nItems,
+                                      virSecurityDACTransactionRunItem,
+                                      list, 0, done);
 
-    for (; rv < 0 && i > 0; i--) {
+    for (i = list->nItems; rv < 0 && i > 0; i--) {
         virSecurityDACChownItemPtr item = list->items[i - 1];
         const bool remember = item->remember && list->lock;
 
+        if (!done[i - 1])
+            continue;
+
         if (!item->restore) {
             virSecurityDACRestoreFileLabelInternal(list->manager,
                                                    item->src,
@@ -595,6 +606,52 @@ virSecurityDACTransactionStart(virSecurityManagerPtr mgr)
     return 0;
 }
 
+/**
+ * virSecurityDACTransactionDetach:
+ * @mgr: security manager
+ * @lock: lock and unlock paths that are relabeled
+ * @cb: filled with the callback performing the transaction
+ * @opaque: filled with the transaction
+ * @freecb: filled with the function freeing the transaction
+ *
+ * Takes the transaction away from the calling thread, so that it can be
+ * performed by a helper shared with other security drivers.
+ *
+ * Returns: 0 on success,
+ *         -1 otherwise.
+ */
+static int
+virSecurityDACTransactionDetach(virSecurityManagerPtr mgr G_GNUC_UNUSED,
+                                bool lock,
+                                virProcessNamespaceCallback *cb,
+                                void **opaque,
+                                virFreeCallback *freecb)
+{
+    virSecurityDACChownListPtr list;
+
+    list = virThreadLocalGet(&chownList);
+    if (!list) {
+        virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                       _("No transaction is set"));
+        return -1;
+    }
+
+    if (virThreadLocalSet(&chownList, NULL) < 0) {
+        virReportSystemError(errno, "%s",
+                             _("Unable to clear thread local variable"));
+        virSecurityDACChownListFree(list);
+        return -1;
+    }
+
+    list->lock = lock;
+
+    *cb = virSecurityDACTransactionRun;
+    *opaque = list;
+    *freecb = virSecurityDACChownListFree;
+    return 0;
+}
+
+
 /**
  * virSecurityDACTransactionCommit:
  * @mgr: security manager
@@ -617,47 +674,29 @@ virSecurityDACTransactionStart(virSecurityManagerPtr mgr)
  *         -1 otherwise.
  */
 static int
-virSecurityDACTransactionCommit(virSecurityManagerPtr mgr G_GNUC_UNUSED,
+virSecurityDACTransactionCommit(virSecurityManagerPtr mgr,
                                 pid_t pid,
                                 bool lock)
 {
-    virSecurityDACChownListPtr list;
+    virProcessNamespaceCallback cb;
+    void *opaque;
+    virFreeCallback freecb;
     int rc;
-    int ret = -1;
-
-    list = virThreadLocalGet(&chownList);
-    if (!list) {
-        virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
-                       _("No transaction is set"));
-        goto cleanup;
-    }
-
-    if (virThreadLocalSet(&chownList, NULL) < 0) {
-        virReportSystemError(errno, "%s",
-                             _("Unable to clear thread local variable"));
-        goto cleanup;
-    }
 
-    list->lock = lock;
+    if (virSecurityDACTransactionDetach(mgr, lock, &cb, &opaque, &freecb) < 0)
+        return -1;
 
     if (pid == -1) {
         if (lock)
-            rc = virProcessRunInFork(virSecurityDACTransactionRun, list);
+            rc = virProcessRunInFork(cb, opaque);
         else
-            rc = virSecurityDACTransactionRun(pid, list);
+            rc = cb(pid, opaque);
     } else {
-        rc = virProcessRunInMountNamespace(pid,
-                                           virSecurityDACTransactionRun,
-                                           list);
+        rc = virProcessRunInMountNamespace(pid, cb, opaque);
     }
 
-    if (rc < 0)
-        goto cleanup;
-
-    ret = 0;
- cleanup:
-    virSecurityDACChownListFree(list);
-    return ret;
+    freecb(opaque);
+    return rc < 0 ? -1 : 0;
 }
 
 /**
@@ -2555,6 +2594,7 @@ virSecurityDriver virSecurityDriverDAC = {
     .transactionStart                   = virSecurityDACTransactionStart,
     .transactionCommit                  = virSecurityDACTransactionCommit,
     .transactionAbort                   = virSecurityDACTransactionAbort,
+    .transactionDetach                  = virSecurityDACTransactionDetach,
 
     .domainSecurityVerify               = virSecurityDACVerify,
 
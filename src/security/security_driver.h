@@ -52,6 +52,11 @@ typedef int (*virSecurityDriverTransactionCommit) (virSecurityManagerPtr mgr,
                                                    pid_t pid,
                                                    bool lock);
 typedef void (*virSecurityDriverTransactionAbort) (virSecurityManagerPtr mgr);
+typedef int (*virSecurityDriverTransactionDetach) (virSecurityManagerPtr mgr,
+                                                   bool lock,
+                                                   virProcessNamespaceCallback *cb,
+                                                   void **opaque,
+                                                   virFreeCallback *freecb);
 
 typedef int (*virSecurityDomainSetDaemonSocketLabel)(virSecurityManagerPtr mgr,
                                                      virDomainDefPtr vm);
@@ -169,6 +174,7 @@ struct _virSecurityDriver {
     virSecurityDriverTransactionStart transactionStart;
     virSecurityDriverTransactionCommit transactionCommit;
     virSecurityDriverTransactionAbort transactionAbort;
+    virSecurityDriverTransactionDetach transactionDetach;
 
     virSecurityDomainSecurityVerify domainSecurityVerify;
 
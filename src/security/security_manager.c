@@ -26,6 +26,7 @@
 #include "security_driver.h"
 #include "security_stack.h"
 #include "security_dac.h"
+#include "security_util.h"
 #include "virerror.h"
 #include "viralloc.h"
 #include "virobject.h"
@@ -318,6 +319,48 @@ virSecurityManagerTransactionAbort(virSecurityManagerPtr mgr)
 }
 
 
+/**
+ * virSecurityManagerTransactionDetach:
+ * @mgr: security manager
+ * @lock: lock and unlock paths that are relabeled
+ * @cb: filled with the callback performing the transaction
+ * @opaque: filled with the data for @cb
+ * @freecb: filled with the function freeing @opaque
+ *
+ * Takes the transaction started in the calling thread away from @mgr
+ * instead of committing it. The caller is then responsible for calling
+ * @cb with @opaque, which allows running transactions of several
+ * managers in a single helper process, and for freeing @opaque with
+ * @freecb afterwards. @cb must be called in the right namespace and,
+ * if @lock is true, in a separate process.
+ *
+ * If the driver does not support detaching transactions, *@cb is set
+ * to NULL and the caller has to use virSecurityManagerTransactionCommit.
+ *
+ * Returns: 0 on success,
+ *         -1 otherwise.
+ */
+int
+virSecurityManagerTransactionDetach(virSecurityManagerPtr mgr,
+                                    bool lock,
+                                    virProcessNamespaceCallback *cb,
+                                    void **opaque,
+                                    virFreeCallback *freecb)
+{
+    int ret = 0;
+
+    *cb = NULL;
+    *opaque = NULL;
+    *freecb = NULL;
+
+    virObjectLock(mgr);
+    if (mgr->drv->transactionDetach)
+        ret = mgr->drv->transactionDetach(mgr, lock, cb, opaque, freecb);
+    virObjectUnlock(mgr);
+    return ret;
+}
+
+
 void *
 virSecurityManagerGetPrivateData(virSecurityManagerPtr mgr)
 {
@@ -1261,9 +1304,35 @@ cmpstringp(const void *p1, const void *p2)
     return strcmp(s1, s2);
 }
 
+typedef struct _virSecurityManagerMetadataLockItem virSecurityManagerMetadataLockItem;
+typedef virSecurityManagerMetadataLockItem *virSecurityManagerMetadataLockItemPtr;
+struct _virSecurityManagerMetadataLockItem {
+    const char *path;
+    dev_t dev;
+    ino_t ino;
+    mode_t mode;
+    bool xattrs;
+    bool locked;
+};
+
+
+static int
+cmpitempathp(const void *p1, const void *p2)
+{
+    const virSecurityManagerMetadataLockItem *i1 = p1;
+    const virSecurityManagerMetadataLockItem *i2 = p2;
+
+    return strcmp(i1->path, i2->path);
+}
+
 #define METADATA_OFFSET 1
 #define METADATA_LEN 1
 
+/* Metadata locks serialize relabelling of shared files across
+ * all daemons using them. Holding them for longer than this is
+ * worth telling the admin about. */
+#define METADATA_HOLD_WARN_MS 5000
+
 /**
  * virSecurityManagerMetadataLock:
  * @mgr: security manager object
@@ -1273,6 +1342,14 @@ cmpstringp(const void *p1, const void *p2)
  * Lock passed @paths for metadata change. The returned state
  * should be passed to virSecurityManagerMetadataUnlock.
  * Passed @paths must not be freed until the corresponding unlock call.
+ * Use virSecurityManagerMetadataLockStateHasPath to learn whether
+ * a path was locked.
+ *
+ * All paths are locked in a single pass in alphabetical order.
+ * A path which is an alias of a file locked under an earlier
+ * name isn't locked again. Paths on a file system that doesn't
+ * support XATTRs are not locked at all as there is no label to
+ * remember on them.
  *
  * NOTE: this function is not thread safe (because of usage of
  * POSIX locks).
@@ -1285,60 +1362,97 @@ virSecurityManagerMetadataLock(virSecurityManagerPtr mgr G_GNUC_UNUSED,
                                const char **paths,
                                size_t npaths)
 {
+    g_autofree virSecurityManagerMetadataLockItemPtr items = NULL;
+    size_t nitems = 0;
     size_t i = 0;
     size_t nfds = 0;
     int *fds = NULL;
     const char **locked_paths = NULL;
+    size_t nlocked = 0;
+    unsigned long long start = g_get_monotonic_time();
     virSecurityManagerMetadataLockStatePtr ret = NULL;
 
     if (VIR_ALLOC_N(fds, npaths) < 0 ||
-        VIR_ALLOC_N(locked_paths, npaths) < 0)
-        return NULL;
+        VIR_ALLOC_N(locked_paths, npaths) < 0 ||
+        VIR_ALLOC_N(items, npaths) < 0)
+        goto cleanup;
+
+    for (i = 0; i < npaths; i++) {
+        struct stat sb;
+
+        if (!paths[i])
+            continue;
+
+        if (stat(paths[i], &sb) < 0)
+            continue;
+
+        if (S_ISDIR(sb.st_mode)) {
+            /* Directories can't be locked */
+            continue;
+        }
+
+        items[nitems].path = paths[i];
+        items[nitems].dev = sb.st_dev;
+        items[nitems].ino = sb.st_ino;
+        items[nitems].mode = sb.st_mode;
+        nitems++;
+    }
 
     /* Sort paths to lock in order to avoid deadlocks with other
      * processes. For instance, if one process wants to lock
      * paths A B and there's another that is trying to lock them
-     * in reversed order a deadlock might occur.  But if we sort
-     * the paths alphabetically then both processes will try lock
-     * paths in the same order and thus no deadlock can occur.
-     * Lastly, it makes searching for duplicate paths below
-     * simpler. */
-    qsort(paths, npaths, sizeof(*paths), cmpstringp);
-
-    for (i = 0; i < npaths; i++) {
-        const char *p = paths[i];
-        struct stat sb;
-        size_t j;
+     * in reversed order a deadlock might occur. But if we sort
+     * the paths alphabetically then all processes will try lock
+     * them in the same order. Unlike device and inode numbers,
+     * paths compare the same on every host sharing the files and
+     * in daemons which don't know about aliases. */
+    qsort(items, nitems, sizeof(*items), cmpitempathp);
+
+    for (i = 0; i < nitems; i++) {
+        virSecurityManagerMetadataLockItemPtr item = &items[i];
+        virSecurityManagerMetadataLockItemPtr alias = NULL;
+        const char *p = item->path;
+        bool probed = false;
         int retries = 10 * 1000;
         int fd;
+        size_t j;
 
-        if (!p)
-            continue;
-
-        /* If there's a duplicate path on the list, skip it over.
-         * Not only we would fail open()-ing it the second time,
-         * we would deadlock with ourselves trying to lock it the
-         * second time. After all, we've locked it when iterating
-         * over it the first time. */
         for (j = 0; j < i; j++) {
-            if (STREQ_NULLABLE(p, paths[j]))
+            if (items[j].dev != item->dev)
+                continue;
+
+            item->xattrs = items[j].xattrs;
+            probed = true;
+
+            if (items[j].ino == item->ino) {
+                alias = &items[j];
                 break;
+            }
         }
 
-        if (i != j)
+        /* If the file was seen under another name already, don't
+         * lock it again. POSIX locks are per process so it would
+         * succeed, but closing the second FD would release the
+         * lock acquired via the first one. */
+        if (alias) {
+            if (alias->locked) {
+                item->locked = true;
+                locked_paths[nlocked++] = p;
+            }
             continue;
+        }
 
-        if (stat(p, &sb) < 0)
-            continue;
+        /* The lock guards XATTRs. Probe the first file on each
+         * file system whether it has any. */
+        if (!probed)
+            item->xattrs = virSecurityXATTRSupported(p) != 0;
 
-        if (S_ISDIR(sb.st_mode)) {
-            /* Directories can't be locked */
+        if (!item->xattrs)
             continue;
-        }
 
         if ((fd = open(p, O_RDWR)) < 0) {
 #ifndef WIN32
-            if (S_ISSOCK(sb.st_mode)) {
+            if (S_ISSOCK(item->mode)) {
                 /* Sockets can be opened only if there exists the
                  * other side that listens. */
                 continue;
@@ -1376,18 +1490,27 @@ virSecurityManagerMetadataLock(virSecurityManagerPtr mgr G_GNUC_UNUSED,
             break;
         } while (1);
 
-        locked_paths[nfds] = p;
+        item->locked = true;
+        locked_paths[nlocked++] = p;
         VIR_APPEND_ELEMENT_COPY_INPLACE(fds, nfds, fd);
     }
 
+    /* Callers look paths up by name. */
+    qsort(locked_paths, nlocked, sizeof(*locked_paths), cmpstringp);
+
     if (VIR_ALLOC(ret) < 0)
         goto cleanup;
 
     ret->paths = g_steal_pointer(&locked_paths);
+    ret->npaths = nlocked;
     ret->fds = g_steal_pointer(&fds);
     ret->nfds = nfds;
+    ret->locked = g_get_monotonic_time();
     nfds = 0;
 
+    VIR_DEBUG("Locked %zu files (%zu paths) for metadata change in %llums",
+              ret->nfds, ret->npaths, (ret->locked - start) / 1000);
+
  cleanup:
     for (i = nfds; i > 0; i--)
         VIR_FORCE_CLOSE(fds[i - 1]);
@@ -1397,32 +1520,62 @@ virSecurityManagerMetadataLock(virSecurityManagerPtr mgr G_GNUC_UNUSED,
 }
 
 
+/**
+ * virSecurityManagerMetadataLockStateHasPath:
+ * @state: metadata lock state
+ * @path: path to look up
+ *
+ * Returns: true if @path was locked by virSecurityManagerMetadataLock,
+ *          false otherwise.
+ */
+bool
+virSecurityManagerMetadataLockStateHasPath(virSecurityManagerMetadataLockStatePtr state,
+                                           const char *path)
+{
+    if (!state || !path)
+        return false;
+
+    return bsearch(&path, state->paths, state->npaths,
+                   sizeof(*state->paths), cmpstringp) != NULL;
+}
+
+
 void
 virSecurityManagerMetadataUnlock(virSecurityManagerPtr mgr G_GNUC_UNUSED,
                                  virSecurityManagerMetadataLockStatePtr *state)
 {
+    unsigned long long held;
     size_t i;
 
-    if (!state)
+    if (!state || !*state)
         return;
 
+    held = (g_get_monotonic_time() - (*state)->locked) / 1000;
+
     for (i = 0; i < (*state)->nfds; i++) {
-        const char *path = (*state)->paths[i];
         int fd = (*state)->fds[i];
 
         /* Technically, unlock is not needed because it will
          * happen on VIR_CLOSE() anyway. But let's play it nice. */
         if (virFileUnlock(fd, METADATA_OFFSET, METADATA_LEN) < 0) {
-            VIR_WARN("Unable to unlock fd %d path %s: %s",
-                     fd, path, g_strerror(errno));
+            VIR_WARN("Unable to unlock fd %d: %s",
+                     fd, g_strerror(errno));
         }
 
         if (VIR_CLOSE(fd) < 0) {
-            VIR_WARN("Unable to close fd %d path %s: %s",
-                     fd, path, g_strerror(errno));
+            VIR_WARN("Unable to close fd %d: %s",
+                     fd, g_strerror(errno));
         }
     }
 
+    if (held >= METADATA_HOLD_WARN_MS) {
+        VIR_WARN("Metadata locks on %zu files were held for %llums",
+                 (*state)->nfds, held);
+    } else {
+        VIR_DEBUG("Metadata locks on %zu files were held for %llums",
+                  (*state)->nfds, held);
+    }
+
     VIR_FREE((*state)->fds);
     VIR_FREE((*state)->paths);
     VIR_FREE(*state);
@@ -23,6 +23,7 @@
 #include "domain_conf.h"
 #include "vircommand.h"
 #include "virstoragefile.h"
+#include "virprocess.h"
 
 typedef struct _virSecurityManager virSecurityManager;
 typedef virSecurityManager *virSecurityManagerPtr;
@@ -77,6 +78,11 @@ int virSecurityManagerTransactionCommit(virSecurityManagerPtr mgr,
                                         pid_t pid,
                                         bool lock);
 void virSecurityManagerTransactionAbort(virSecurityManagerPtr mgr);
+int virSecurityManagerTransactionDetach(virSecurityManagerPtr mgr,
+                                        bool lock,
+                                        virProcessNamespaceCallback *cb,
+                                        void **opaque,
+                                        virFreeCallback *freecb);
 
 void *virSecurityManagerGetPrivateData(virSecurityManagerPtr mgr);
 
@@ -208,9 +214,11 @@ int virSecurityManagerRestoreTPMLabels(virSecurityManagerPtr mgr,
 typedef struct _virSecurityManagerMetadataLockState virSecurityManagerMetadataLockState;
 typedef virSecurityManagerMetadataLockState *virSecurityManagerMetadataLockStatePtr;
 struct _virSecurityManagerMetadataLockState {
-    size_t nfds; /* Captures size of both @fds and @paths */
+    size_t nfds;
     int *fds;
-    const char **paths;
+    size_t npaths;
+    const char **paths; /* Sorted by name, aliases included */
+    unsigned long long locked; /* Monotonic time of acquisition (us) */
 };
 
 
@@ -219,6 +227,10 @@ virSecurityManagerMetadataLock(virSecurityManagerPtr mgr,
                                const char **paths,
                                size_t npaths);
 
+bool
+virSecurityManagerMetadataLockStateHasPath(virSecurityManagerMetadataLockStatePtr state,
+                                           const char *path);
+
 void
 virSecurityManagerMetadataUnlock(virSecurityManagerPtr mgr,
                                  virSecurityManagerMetadataLockStatePtr *state);
@@ -233,6 +233,27 @@ static int virSecuritySELinuxRestoreFileLabel(virSecurityManagerPtr mgr,
                                               bool recall);
 
 
+static int
+virSecuritySELinuxTransactionRunItem(size_t idx,
+                                     void *opaque)
+{
+    virSecuritySELinuxContextListPtr list = opaque;
+    virSecuritySELinuxContextItemPtr item = list->items[idx];
+    const bool remember = item->remember && list->lock;
+
+    if (!item->restore) {
+        return virSecuritySELinuxSetFilecon(list->manager,
+                                            item->path,
+                                            item->tcon,
+                                            remember);
+    }
+
+    return virSecuritySELinuxRestoreFileLabel(list->manager,
+                                              item->path,
+                                              remember);
+}
+
+
 /**
  * virSecuritySELinuxTransactionRun:
  * @pid: process pid
@@ -240,7 +261,9 @@ static int virSecuritySELinuxRestoreFileLabel(virSecurityManagerPtr mgr,
  *
  * This is the callback that runs in the same namespace as the domain we are
  * relabelling. For given transaction (@opaque) it relabels all the paths on
- * the list.
+ * the list, distinct paths concurrently. Restoring labels looks them up
+ * through the shared selabel handle, which is not safe to use from multiple
+ * threads, so transactions doing that are processed sequentially.
  *
  * Returns: 0 on success
  *         -1 otherwise.
@@ -253,6 +276,9 @@ virSecuritySELinuxTransactionRun(pid_t pid G_GNUC_UNUSED,
     virSecurityManagerMetadataLockStatePtr state;
     const char **paths = NULL;
     size_t npaths = 0;
+    g_autofree const char **itemPaths = NULL;
+    g_autofree bool *done = NULL;
+    size_t maxworkers = 0;
     size_t i;
     int rv;
     int ret = -1;
@@ -274,43 +300,33 @@ virSecuritySELinuxTransactionRun(pid_t pid G_GNUC_UNUSED,
 
         for (i = 0; i < list->nItems; i++) {
             virSecuritySELinuxContextItemPtr item = list->items[i];
-            size_t j;
-
-            for (j = 0; j < state->nfds; j++) {
-                if (STREQ_NULLABLE(item->path, state->paths[j]))
-                    break;
-            }
 
             /* If path wasn't locked, don't try to remember its label. */
-            if (j == state->nfds)
+            if (!virSecurityManagerMetadataLockStateHasPath(state, item->path))
                 item->remember = false;
         }
     }
 
-    rv = 0;
-    for (i = 0; i < list->nItems; i++) {
-        virSecuritySELinuxContextItemPtr item = list->items[i];
-        const bool remember = item->remember && list->lock;
-
-        if (!item->restore) {
-            rv = virSecuritySELinuxSetFilecon(list->manager,
-                                              item->path,
-                                              item->tcon,
-                                              remember);
-        } else {
-            rv = virSecuritySELinuxRestoreFileLabel(list->manager,
-                                                    item->path,
-                                                    remember);
-        }
+    itemPaths = g_new0(const char *, list->nItems);
+    done = g_new0(bool, list->nItems);
 
-        if (rv < 0)
-            break;
+    for (i = 0; i < list->nItems; i++) {
+        itemPaths[i] = list->items[i]->path;
+        if (list->items[i]->restore)
+            maxworkers = 1;
     }
 
-    for (; rv < 0 && i > 0; i--) {
+    rv = virSecurityRelabelConcurrent(itemPaths, list->nItems,
+                                      virSecuritySELinuxTransactionRunItem,
+                                      list, maxworkers, done);
+
+    for (i = list->nItems; rv < 0 && i > 0; i--) {
         virSecuritySELinuxContextItemPtr item = list->items[i - 1];
         const bool remember = item->remember && list->lock;
 
+        if (!done[i - 1])
+            continue;
+
         if (!item->restore) {
             virSecuritySELinuxRestoreFileLabel(list->manager,
                                                item->path,
@@ -1117,6 +1133,52 @@ virSecuritySELinuxTransactionStart(virSecurityManagerPtr mgr)
     return 0;
 }
 
+/**
+ * virSecuritySELinuxTransactionDetach:
+ * @mgr: security manager
+ * @lock: lock and unlock paths that are relabeled
+ * @cb: filled with the callback performing the transaction
+ * @opaque: filled with the transaction
+ * @freecb: filled with the function freeing the transaction
+ *
+ * Takes the transaction away from the calling thread, so that it can be
+ * performed by a helper shared with other security drivers.
+ *
+ * Returns: 0 on success,
+ *         -1 otherwise.
+ */
+static int
+virSecuritySELinuxTransactionDetach(virSecurityManagerPtr mgr G_GNUC_UNUSED,
+                                    bool lock,
+                                    virProcessNamespaceCallback *cb,
+                                    void **opaque,
+                                    virFreeCallback *freecb)
+{
+    virSecuritySELinuxContextListPtr list;
+
+    list = virThreadLocalGet(&contextList);
+    if (!list) {
+        virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                       _("No transaction is set"));
+        return -1;
+    }
+
+    if (virThreadLocalSet(&contextList, NULL) < 0) {
+        virReportSystemError(errno, "%s",
+                             _("Unable to clear thread local variable"));
+        virSecuritySELinuxContextListFree(list);
+        return -1;
+    }
+
+    list->lock = lock;
+
+    *cb = virSecuritySELinuxTransactionRun;
+    *opaque = list;
+    *freecb = virSecuritySELinuxContextListFree;
+    return 0;
+}
+
+
 /**
  * virSecuritySELinuxTransactionCommit:
  * @mgr: security manager
@@ -1140,47 +1202,29 @@ virSecuritySELinuxTransactionStart(virSecurityManagerPtr mgr)
  *         -1 otherwise.
  */
 static int
-virSecuritySELinuxTransactionCommit(virSecurityManagerPtr mgr G_GNUC_UNUSED,
+virSecuritySELinuxTransactionCommit(virSecurityManagerPtr mgr,
                                     pid_t pid,
                                     bool lock)
 {
-    virSecuritySELinuxContextListPtr list;
+    virProcessNamespaceCallback cb;
+    void *opaque;
+    virFreeCallback freecb;
     int rc;
-    int ret = -1;
 
-    list = virThreadLocalGet(&contextList);
-    if (!list) {
-        virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
-                       _("No transaction is set"));
+    if (virSecuritySELinuxTransactionDetach(mgr, lock, &cb, &opaque, &freecb) < 0)
         return -1;
-    }
-
-    if (virThreadLocalSet(&contextList, NULL) < 0) {
-        virReportSystemError(errno, "%s",
-                             _("Unable to clear thread local variable"));
-        goto cleanup;
-    }
-
-    list->lock = lock;
 
     if (pid == -1) {
         if (lock)
-            rc = virProcessRunInFork(virSecuritySELinuxTransactionRun, list);
+            rc = virProcessRunInFork(cb, opaque);
         else
-            rc = virSecuritySELinuxTransactionRun(pid, list);
+            rc = cb(pid, opaque);
     } else {
-        rc = virProcessRunInMountNamespace(pid,
-                                           virSecuritySELinuxTransactionRun,
-                                           list);
+        rc = virProcessRunInMountNamespace(pid, cb, opaque);
     }
 
-    if (rc < 0)
-        goto cleanup;
-
-    ret = 0;
- cleanup:
-    virSecuritySELinuxContextListFree(list);
-    return ret;
+    freecb(opaque);
+    return rc < 0 ? -1 : 0;
 }
 
 /**
@@ -3547,6 +3591,7 @@ virSecurityDriver virSecurityDriverSELinux = {
     .transactionStart                   = virSecuritySELinuxTransactionStart,
     .transactionCommit                  = virSecuritySELinuxTransactionCommit,
     .transactionAbort                   = virSecuritySELinuxTransactionAbort,
+    .transactionDetach                  = virSecuritySELinuxTransactionDetach,
 
     .domainSecurityVerify               = virSecuritySELinuxVerify,
 
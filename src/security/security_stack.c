@@ -162,6 +162,43 @@ virSecurityStackTransactionStart(virSecurityManagerPtr mgr)
 }
 
 
+typedef struct _virSecurityStackTransaction virSecurityStackTransaction;
+typedef virSecurityStackTransaction *virSecurityStackTransactionPtr;
+struct _virSecurityStackTransaction {
+    virProcessNamespaceCallback cb;
+    void *opaque;
+    virFreeCallback freecb;
+};
+
+typedef struct _virSecurityStackTransactionList virSecurityStackTransactionList;
+typedef virSecurityStackTransactionList *virSecurityStackTransactionListPtr;
+struct _virSecurityStackTransactionList {
+    virSecurityStackTransactionPtr items;
+    size_t nitems;
+};
+
+
+static int
+virSecurityStackTransactionRun(pid_t pid,
+                               void *opaque)
+{
+    virSecurityStackTransactionListPtr list = opaque;
+    size_t i;
+
+    for (i = 0; i < list->nitems; i++) {
+        if (list->items[i].cb(pid, list->items[i].opaque) < 0)
+            return -1;
+    }
+
+    return 0;
+}
+
+
+/*
+ * Transactions of all nested drivers which support it are detached and
+ * performed by a single helper, instead of each of the drivers forking
+ * into the domain's namespace on their own.
+ */
 static int
 virSecurityStackTransactionCommit(virSecurityManagerPtr mgr,
                                   pid_t pid,
@@ -169,18 +206,62 @@ virSecurityStackTransactionCommit(virSecurityManagerPtr mgr,
 {
     virSecurityStackDataPtr priv = virSecurityManagerGetPrivateData(mgr);
     virSecurityStackItemPtr item = priv->itemsHead;
+    virSecurityStackTransactionList list = { NULL, 0 };
+    size_t nitems = 0;
+    size_t i;
+    int rc = 0;
+    int ret = -1;
+
+    for (; item; item = item->next)
+        nitems++;
+
+    list.items = g_new0(virSecurityStackTransaction, nitems);
+
+    for (item = priv->itemsHead; item; item = item->next) {
+        virSecurityStackTransactionPtr trans = &list.items[list.nitems];
+
+        if (virSecurityManagerTransactionDetach(item->securityManager, lock,
+                                                &trans->cb, &trans->opaque,
+                                                &trans->freecb) < 0)
+            goto rollback;
+
+        if (trans->cb) {
+            list.nitems++;
+            continue;
+        }
 
-    for (; item; item = item->next) {
         if (virSecurityManagerTransactionCommit(item->securityManager, pid, lock) < 0)
             goto rollback;
     }
 
-    return 0;
+    if (list.nitems > 0) {
+        if (pid == -1) {
+            if (lock)
+                rc = virProcessRunInFork(virSecurityStackTransactionRun, &list);
+            else
+                rc = virSecurityStackTransactionRun(pid, &list);
+        } else {
+            rc = virProcessRunInMountNamespace(pid,
+                                               virSecurityStackTransactionRun,
+                                               &list);
+        }
+    }
+
+    if (rc < 0)
+        goto cleanup;
+
+    ret = 0;
+
+ cleanup:
+    for (i = 0; i < list.nitems; i++)
+        list.items[i].freecb(list.items[i].opaque);
+    VIR_FREE(list.items);
+    return ret;
 
  rollback:
-    for (item = item->prev; item; item = item->prev)
+    for (item = item->next; item; item = item->next)
         virSecurityManagerTransactionAbort(item->securityManager);
-    return -1;
+    goto cleanup;
 }
 
 
@@ -18,6 +18,8 @@
 
 #include <config.h>
 
+#include <sys/stat.h>
+
 #include "viralloc.h"
 #include "virfile.h"
 #include "virstring.h"
@@ -25,6 +27,8 @@
 #include "virlog.h"
 #include "viruuid.h"
 #include "virhostuptime.h"
+#include "virhashcode.h"
+#include "virthread.h"
 
 #include "security_util.h"
 
@@ -428,6 +432,44 @@ virSecuritySetRememberedLabel(const char *name,
 }
 
 
+/**
+ * virSecurityXATTRSupported:
+ * @path: file name
+ *
+ * Check whether the file system @path lives on is capable of
+ * storing XATTRs used for label remembering. This is meant as a
+ * cheap probe done once per file system so that callers can skip
+ * locking and remembering on file systems where it can't work
+ * anyway (e.g. NFS).
+ *
+ * Returns: 1 if XATTRs are supported,
+ *          0 if they are not,
+ *         -1 if it couldn't be determined (with errno set).
+ */
+int
+virSecurityXATTRSupported(const char *path G_GNUC_UNUSED)
+{
+#ifdef XATTR_NAMESPACE
+    g_autofree char *value = NULL;
+
+    if (virFileGetXAttrQuiet(path,
+                             XATTR_NAMESPACE ".libvirt.security.probe",
+                             &value) == 0)
+        return 1;
+
+    if (errno == ENODATA)
+        return 1;
+
+    if (errno == ENOSYS || errno == ENOTSUP)
+        return 0;
+
+    return -1;
+#else /* !XATTR_NAMESPACE */
+    return 0;
+#endif /* !XATTR_NAMESPACE */
+}
+
+
 /**
  * virSecurityMoveRememberedLabel:
  * @name: security driver name
@@ -528,3 +570,186 @@ virSecurityMoveRememberedLabel(const char *name,
 
     return 0;
 }
+
+
+/* Upper bound on threads relabelling paths of a single transaction */
+#define VIR_SECURITY_RELABEL_WORKERS 8
+
+/* Transactions smaller than this are not worth spawning threads for */
+#define VIR_SECURITY_RELABEL_CONCURRENT_MIN 4
+
+typedef struct _virSecurityRelabelWorker virSecurityRelabelWorker;
+typedef virSecurityRelabelWorker *virSecurityRelabelWorkerPtr;
+
+typedef struct _virSecurityRelabelData virSecurityRelabelData;
+typedef virSecurityRelabelData *virSecurityRelabelDataPtr;
+
+struct _virSecurityRelabelData {
+    size_t *workerOf;
+    size_t npaths;
+    size_t nworkers;
+    virSecurityRelabelCallback cb;
+    void *opaque;
+    bool *done;
+    int failed;
+};
+
+struct _virSecurityRelabelWorker {
+    virSecurityRelabelDataPtr data;
+    size_t id;
+    virThread thread;
+    virErrorPtr err;
+    size_t failedIdx;
+};
+
+
+/*
+ * Paths referring to the same file, e.g. through symlinks or hard links,
+ * share the remembered label and its reference counter, so they are
+ * assigned by the file rather than by the path. Paths which can't be
+ * resolved are assigned by their name.
+ */
+static size_t
+virSecurityRelabelWorkerFor(const char *path,
+                            size_t nworkers)
+{
+    struct stat sb;
+
+    if (!path)
+        return 0;
+
+    if (stat(path, &sb) == 0) {
+        unsigned long long id[2] = { sb.st_dev, sb.st_ino };
+
+        return virHashCodeGen(id, sizeof(id), 0) % nworkers;
+    }
+
+    return virHashCodeGen(path, strlen(path), 0) % nworkers;
+}
+
+
+static void
+virSecurityRelabelWorkerRun(void *opaque)
+{
+    virSecurityRelabelWorkerPtr worker = opaque;
+    virSecurityRelabelDataPtr data = worker->data;
+    size_t i;
+
+    for (i = 0; i < data->npaths; i++) {
+        if (data->workerOf[i] != worker->id)
+            continue;
+
+        if (g_atomic_int_get(&data->failed))
+            break;
+
+        if (data->cb(i, data->opaque) < 0) {
+            virErrorPreserveLast(&worker->err);
+            worker->failedIdx = i;
+            g_atomic_int_set(&data->failed, 1);
+            break;
+        }
+
+        data->done[i] = true;
+    }
+}
+
+
+/**
+ * virSecurityRelabelConcurrent:
+ * @paths: paths the items of a transaction operate on
+ * @npaths: number of items
+ * @cb: callback relabelling a single item
+ * @opaque: data passed to @cb
+ * @maxworkers: maximum number of threads to use, 0 for the default
+ * @done: array of @npaths elements, filled with which items succeeded
+ *
+ * Calls @cb for each item of a relabel transaction using a bounded
+ * number of threads. Items are distributed by the file their path
+ * refers to, so that all operations on a single file run on one thread
+ * in the order they were queued. No new items are started once one of
+ * them fails.
+ *
+ * Small transactions are processed in the calling thread.
+ *
+ * Returns 0 on success, -1 if any of the callbacks failed, with the
+ * error reported by the failed item that was queued first.
+ */
+int
+virSecurityRelabelConcurrent(const char **paths,
+                             size_t npaths,
+                             virSecurityRelabelCallback cb,
+                             void *opaque,
+                             size_t maxworkers,
+                             bool *done)
+{
+    virSecurityRelabelData data = {
+        .npaths = npaths, .cb = cb,
+        .opaque = opaque, .done = done, .failed = 0,
+    };
+    g_autofree virSecurityRelabelWorkerPtr workers = NULL;
+    g_autofree size_t *workerOf = NULL;
+    virSecurityRelabelWorkerPtr failed = NULL;
+    size_t nstarted = 0;
+    size_t i;
+
+    memset(done, 0, sizeof(*done) * npaths);
+
+    if (maxworkers == 0)
+        maxworkers = VIR_SECURITY_RELABEL_WORKERS;
+    data.nworkers = MIN(npaths, maxworkers);
+
+    if (data.nworkers <= 1 ||
+        npaths < VIR_SECURITY_RELABEL_CONCURRENT_MIN) {
+        for (i = 0; i < npaths; i++) {
+            if (cb(i, opaque) < 0)
+                return -1;
+            done[i] = true;
+        }
+        return 0;
+    }
+
+    workerOf = g_new0(size_t, npaths);
+    for (i = 0; i < npaths; i++)
+        workerOf[i] = virSecurityRelabelWorkerFor(paths[i], data.nworkers);
+    data.workerOf = workerOf;
+
+    workers = g_new0(virSecurityRelabelWorker, data.nworkers);
+
+    for (i = 0; i < data.nworkers; i++) {
+        workers[i].data = &data;
+        workers[i].id = i;
+
+        if (virThreadCreateFull(&workers[i].thread, true,
+                                virSecurityRelabelWorkerRun,
+                                "sec-relabel", false, &workers[i]) < 0)
+            break;
+        nstarted++;
+    }
+
+    /* Whatever the threads we failed to create were supposed to
+     * handle is done here */
+    for (i = nstarted; i < data.nworkers; i++)
+        virSecurityRelabelWorkerRun(&workers[i]);
+
+    for (i = 0; i < nstarted; i++)
+        virThreadJoin(&workers[i].thread);
+
+    if (!g_atomic_int_get(&data.failed))
+        return 0;
+
+    for (i = 0; i < data.nworkers; i++) {
+        if (!workers[i].err)
+            continue;
+
+        if (!failed || workers[i].failedIdx < failed->failedIdx)
+            failed = &workers[i];
+    }
+
+    if (failed)
+        virErrorRestore(&failed->err);
+
+    for (i = 0; i < data.nworkers; i++)
+        virFreeError(workers[i].err);
+
+    return -1;
+}
@@ -32,3 +32,17 @@ int
 virSecurityMoveRememberedLabel(const char *name,
                                const char *src,
                                const char *dst);
+
+int
+virSecurityXATTRSupported(const char *path);
+
+typedef int (*virSecurityRelabelCallback)(size_t idx,
+                                          void *opaque);
+
+int
+virSecurityRelabelConcurrent(const char **paths,
+                             size_t npaths,
+                             virSecurityRelabelCallback cb,
+                             void *opaque,
+                             size_t maxworkers,
+                             bool *done);
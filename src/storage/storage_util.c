@@ -100,6 +100,7 @@ virStorageBackendNamespaceInit(int poolType,
 
 #define READ_BLOCK_SIZE_DEFAULT  (1024 * 1024)
 #define WRITE_BLOCK_SIZE_DEFAULT (4 * 1024)
+#define COPY_RANGE_SIZE_MAX (1024 * 1024 * 1024)
 
 /*
  * Perform the O(1) btrfs clone operation, if possible.
@@ -122,12 +123,127 @@ reflinkCloneFile(int dest_fd G_GNUC_UNUSED,
 #endif
 
 
+#if HAVE_COPY_FILE_RANGE && HAVE_DECL_SEEK_HOLE
+/*
+ * Copy up to @total bytes of @inputfd to @fd with copy_file_range(), which
+ * lets the filesystem share the blocks (reflink on XFS and btrfs) or copy
+ * them on the server (NFS 4.2) instead of moving them through userspace.
+ * Only the data sections of @inputfd are copied so that the time taken
+ * depends on the allocation rather than the capacity. As the blocks may
+ * end up shared, this must only be used if @fd is not meant to be fully
+ * allocated.
+ *
+ * Returns 0 once everything was copied, 1 if the rest has to be copied by
+ * the caller, with @total and the offsets of both files updated to the
+ * first byte not copied yet, and -errno on error.
+ */
+static int
+storageBackendCopyFileRange(virStorageVolDefPtr vol,
+                            virStorageVolDefPtr inputvol,
+                            int inputfd,
+                            int fd,
+                            unsigned long long *total)
+{
+    struct stat st;
+    off_t outstart;
+    off_t pos = 0;
+    off_t end;
+    int ret = 1;
+
+    if (fstat(inputfd, &st) < 0 || !S_ISREG(st.st_mode))
+        return 1;
+
+    if ((outstart = lseek(fd, 0, SEEK_CUR)) < 0)
+        return 1;
+
+    end = MIN(*total, (unsigned long long) st.st_size);
+
+    while (pos < end) {
+        long long len = 0;
+        int inData = 0;
+
+        if (lseek(inputfd, pos, SEEK_SET) < 0 ||
+            virFileInData(inputfd, &inData, &len) < 0) {
+            ret = -errno;
+            virReportSystemError(errno,
+                                 _("cannot find data in file '%s'"),
+                                 inputvol->target.path);
+            goto cleanup;
+        }
+
+        /* Trailing hole */
+        if (len == 0)
+            len = end - pos;
+        len = MIN(len, end - pos);
+
+        if (!inData) {
+            pos += len;
+            continue;
+        }
+
+        while (len > 0) {
+            off_t inoff = pos;
+            off_t outoff = outstart + pos;
+            ssize_t copied;
+
+            copied = copy_file_range(inputfd, &inoff, fd, &outoff,
+                                     MIN(len, COPY_RANGE_SIZE_MAX), 0);
+            if (copied < 0) {
+                if (errno == EINTR)
+                    continue;
+
+                /* Not supported for this pair of files */
+                if (errno == EXDEV || errno == EINVAL || errno == ENOSYS ||
+                    errno == EOPNOTSUPP || errno == EBADF) {
+                    VIR_DEBUG("copy_file_range from '%s' to '%s' failed: %s",
+                              inputvol->target.path, vol->target.path,
+                              g_strerror(errno));
+                    goto cleanup;
+                }
+
+                ret = -errno;
+                virReportSystemError(errno,
+                                     _("failed to copy data from '%s' to '%s'"),
+                                     inputvol->target.path, vol->target.path);
+                goto cleanup;
+            }
+
+            /* The input shrank, let the caller deal with it */
+            if (copied == 0)
+                goto cleanup;
+
+            pos += copied;
+            len -= copied;
+        }
+    }
+
+    VIR_DEBUG("copy_file_range copied %lld bytes from '%s'",
+              (long long) pos, inputvol->target.path);
+    ret = 0;
+
+ cleanup:
+    *total -= pos;
+    if (lseek(inputfd, pos, SEEK_SET) < 0 ||
+        lseek(fd, outstart + pos, SEEK_SET) < 0) {
+        if (ret >= 0) {
+            ret = -errno;
+            virReportSystemError(errno,
+                                 _("cannot seek in file '%s'"),
+                                 vol->target.path);
+        }
+    }
+    return ret;
+}
+#endif /* HAVE_COPY_FILE_RANGE && HAVE_DECL_SEEK_HOLE */
+
+
 static int ATTRIBUTE_NONNULL(2)
 virStorageBackendCopyToFD(virStorageVolDefPtr vol,
                           virStorageVolDefPtr inputvol,
                           int fd,
                           unsigned long long *total,
                           bool want_sparse,
+                          bool share_extents G_GNUC_UNUSED,
                           bool reflink_copy)
 {
     int amtread = -1;
@@ -176,6 +292,19 @@ virStorageBackendCopyToFD(virStorageVolDefPtr vol,
         }
     }
 
+#if HAVE_COPY_FILE_RANGE && HAVE_DECL_SEEK_HOLE
+    if (share_extents) {
+        if ((ret = storageBackendCopyFileRange(vol, inputvol, inputfd, fd,
+                                               total)) < 0)
+            return ret;
+
+        /* Skip the loop below if everything was copied already */
+        if (ret == 0)
+            amtread = 0;
+        ret = 0;
+    }
+#endif
+
     while (amtread != 0) {
         int amtleft;
 
@@ -274,7 +403,7 @@ storageBackendCreateBlockFrom(virStoragePoolObjPtr pool G_GNUC_UNUSED,
 
     if (inputvol) {
         if (virStorageBackendCopyToFD(vol, inputvol, fd, &remain,
-                                      false, reflink_copy) < 0)
+                                      false, false, reflink_copy) < 0)
             return -1;
     }
 
@@ -320,14 +449,17 @@ createRawFile(int fd, virStorageVolDefPtr vol,
               bool reflink_copy)
 {
     bool need_alloc = true;
+    bool sparse = false;
     int ret = 0;
     unsigned long long pos = 0;
 
     /* If the new allocation is lower than the capacity of the original file,
      * the cloned volume will be sparse */
     if (inputvol &&
-        vol->target.allocation < inputvol->target.capacity)
+        vol->target.allocation < inputvol->target.capacity) {
         need_alloc = false;
+        sparse = true;
+    }
 
     /* Seek to the final size, so the capacity is available upfront
      * for progress reporting */
@@ -365,9 +497,12 @@ createRawFile(int fd, virStorageVolDefPtr vol,
         unsigned long long remain = inputvol->target.capacity;
         /* allow zero blocks to be skipped if we've requested sparse
          * allocation (allocation < capacity) or we have already
-         * been able to allocate the required space. */
+         * been able to allocate the required space. Blocks may only
+         * be shared with the original in the former case, the space
+         * allocated above would be given up otherwise. */
         if ((ret = virStorageBackendCopyToFD(vol, inputvol, fd, &remain,
-                                             !need_alloc, reflink_copy)) < 0)
+                                             !need_alloc, sparse,
+                                             reflink_copy)) < 0)
             return ret;
 
         /* If the new allocation is greater than the original capacity,
@@ -2499,59 +2634,251 @@ storageBackendVolZeroSparseFileLocal(const char *path,
 }
 
 
+/*
+ * Try to zero @len bytes at @offset in @fd without writing the zeroes
+ * ourselves. Block devices are asked to zero the range which the kernel
+ * turns into WRITE ZEROES or a discard if the device guarantees discarded
+ * blocks to read back as zeroes. Regular files get the range converted to
+ * unwritten extents, or have it deallocated if the filesystem only
+ * supports punching holes.
+ *
+ * Returns 0 on success, 1 if no such method is available, -1 on error.
+ */
 static int
-storageBackendWipeLocal(const char *path,
-                        int fd,
-                        unsigned long long wipe_len,
-                        size_t writebuf_length,
-                        bool zero_end)
+storageBackendWipeLocalOffload(const char *path,
+                               int fd,
+                               off_t offset,
+                               unsigned long long len)
 {
-    int written = 0;
-    unsigned long long remaining = 0;
-    off_t size;
-    size_t write_size = 0;
-    g_autofree char *writebuf = NULL;
+#ifdef __linux__
+    struct stat st;
 
-    if (VIR_ALLOC_N(writebuf, writebuf_length) < 0)
+    if (len == 0)
+        return 0;
+
+    if (fstat(fd, &st) < 0) {
+        virReportSystemError(errno,
+                             _("Failed to stat storage volume with path '%s'"),
+                             path);
         return -1;
+    }
 
-    if (!zero_end) {
-        if ((size = lseek(fd, 0, SEEK_SET)) < 0) {
+    if (S_ISBLK(st.st_mode)) {
+# ifdef BLKZEROOUT
+        uint64_t range[2] = { offset, len };
+
+        if (ioctl(fd, BLKZEROOUT, range) == 0) {
+            VIR_DEBUG("Zeroed %llu bytes of '%s' with BLKZEROOUT", len, path);
+            return 0;
+        }
+
+        if (errno != ENOTTY && errno != EOPNOTSUPP && errno != EINVAL) {
             virReportSystemError(errno,
-                                 _("Failed to seek to the start in volume "
+                                 _("Failed to zero %llu bytes of block device "
                                    "with path '%s'"),
-                                 path);
+                                 len, path);
             return -1;
         }
-    } else {
-        if ((size = lseek(fd, -wipe_len, SEEK_END)) < 0) {
+# endif /* BLKZEROOUT */
+    } else if (S_ISREG(st.st_mode)) {
+# if HAVE_FALLOCATE - 0
+#  ifdef FALLOC_FL_ZERO_RANGE
+        if (fallocate(fd, FALLOC_FL_ZERO_RANGE | FALLOC_FL_KEEP_SIZE,
+                      offset, len) == 0) {
+            VIR_DEBUG("Zeroed %llu bytes of '%s' with FALLOC_FL_ZERO_RANGE",
+                      len, path);
+            return 0;
+        }
+
+        if (errno != ENOSYS && errno != EOPNOTSUPP) {
             virReportSystemError(errno,
-                                 _("Failed to seek to %llu bytes to the end "
-                                   "in volume with path '%s'"),
-                                 wipe_len, path);
+                                 _("Failed to zero %llu bytes of file '%s'"),
+                                 len, path);
             return -1;
         }
+#  endif /* FALLOC_FL_ZERO_RANGE */
+#  ifdef FALLOC_FL_PUNCH_HOLE
+        if (fallocate(fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
+                      offset, len) == 0) {
+            /* Keep the volume allocated if it was, failing to do so only
+             * makes it sparse */
+            ignore_value(fallocate(fd, FALLOC_FL_KEEP_SIZE, offset, len));
+            VIR_DEBUG("Zeroed %llu bytes of '%s' with FALLOC_FL_PUNCH_HOLE",
+                      len, path);
+            return 0;
+        }
+
+        if (errno != ENOSYS && errno != EOPNOTSUPP) {
+            virReportSystemError(errno,
+                                 _("Failed to punch %llu bytes hole to file '%s'"),
+                                 len, path);
+            return -1;
+        }
+#  endif /* FALLOC_FL_PUNCH_HOLE */
+# endif /* HAVE_FALLOCATE */
     }
+#endif /* __linux__ */
 
-    VIR_DEBUG("wiping start: %zd len: %llu", (ssize_t)size, wipe_len);
+    return 1;
+}
+
+
+#define WIPE_DIRECT_ALIGN (64 * 1024)
+#define WIPE_DIRECT_BUF_SIZE (8 * 1024 * 1024)
+
+/*
+ * Write zeroes to the part of @len bytes at @offset in @path which is
+ * aligned to WIPE_DIRECT_ALIGN through a separate O_DIRECT descriptor,
+ * bypassing the page cache which would otherwise be filled with zeroes
+ * only to be written back again by the final sync.
+ *
+ * Returns the number of bytes written (which may be 0 if the range is too
+ * small or O_DIRECT is not supported) or -1 on error.
+ */
+static long long
+storageBackendWipeLocalDirect(const char *path,
+                              off_t offset,
+                              unsigned long long len)
+{
+#ifdef O_DIRECT
+    VIR_AUTOCLOSE fd = -1;
+    g_autofree void *base = NULL;
+    char *buf = NULL;
+    unsigned long long start = VIR_ROUND_UP(offset, WIPE_DIRECT_ALIGN);
+    unsigned long long end = (offset + len) / WIPE_DIRECT_ALIGN * WIPE_DIRECT_ALIGN;
+    unsigned long long pos;
 
-    remaining = wipe_len;
-    while (remaining > 0) {
+    if (end <= start)
+        return 0;
+
+    if ((fd = open(path, O_WRONLY | O_DIRECT)) < 0) {
+        VIR_DEBUG("Cannot open '%s' with O_DIRECT: %s",
+                  path, g_strerror(errno));
+        return 0;
+    }
+
+# if HAVE_POSIX_MEMALIGN
+    if (posix_memalign(&base, WIPE_DIRECT_ALIGN, WIPE_DIRECT_BUF_SIZE)) {
+        virReportOOMError();
+        return -1;
+    }
+    buf = base;
+    memset(buf, 0, WIPE_DIRECT_BUF_SIZE);
+# else
+    base = g_new0(char, WIPE_DIRECT_BUF_SIZE + WIPE_DIRECT_ALIGN);
+    buf = (char *) VIR_ROUND_UP((intptr_t) base, WIPE_DIRECT_ALIGN);
+# endif
+
+    for (pos = start; pos < end;) {
+        size_t towrite = MIN(end - pos, WIPE_DIRECT_BUF_SIZE);
+        ssize_t written = pwrite(fd, buf, towrite, pos);
 
-        write_size = (writebuf_length < remaining) ? writebuf_length : remaining;
-        written = safewrite(fd, writebuf, write_size);
         if (written < 0) {
+            if (errno == EINTR)
+                continue;
+            /* The first write tells whether the device accepts our
+             * alignment, let the buffered path handle it otherwise */
+            if (errno == EINVAL && pos == start)
+                return 0;
             virReportSystemError(errno,
                                  _("Failed to write %zu bytes to "
                                    "storage volume with path '%s'"),
-                                 write_size, path);
+                                 towrite, path);
+            return -1;
+        }
+
+        pos += written;
+    }
+
+    return end - start;
+#else /* !O_DIRECT */
+    return 0;
+#endif /* !O_DIRECT */
+}
+
+
+static int
+storageBackendWipeLocalWrite(const char *path,
+                             int fd,
+                             off_t offset,
+                             unsigned long long len,
+                             size_t writebuf_length)
+{
+    g_autofree char *writebuf = NULL;
+    unsigned long long direct_start = VIR_ROUND_UP(offset, WIPE_DIRECT_ALIGN);
+    long long direct_len;
+    unsigned long long pos = offset;
+    unsigned long long end = offset + len;
+
+    if ((direct_len = storageBackendWipeLocalDirect(path, offset, len)) < 0)
+        return -1;
+
+    if (VIR_ALLOC_N(writebuf, writebuf_length) < 0)
+        return -1;
+
+    while (pos < end) {
+        size_t write_size;
+        ssize_t written;
+
+        /* Skip over the part written with O_DIRECT */
+        if (direct_len > 0 && pos == direct_start) {
+            pos += direct_len;
+            continue;
+        }
 
+        write_size = MIN(writebuf_length, end - pos);
+        if (direct_len > 0 && pos < direct_start)
+            write_size = MIN(write_size, direct_start - pos);
+
+        if ((written = pwrite(fd, writebuf, write_size, pos)) < 0) {
+            if (errno == EINTR)
+                continue;
+            virReportSystemError(errno,
+                                 _("Failed to write %zu bytes to "
+                                   "storage volume with path '%s'"),
+                                 write_size, path);
             return -1;
         }
 
-        remaining -= written;
+        pos += written;
     }
 
+    return 0;
+}
+
+
+static int
+storageBackendWipeLocal(const char *path,
+                        int fd,
+                        unsigned long long wipe_len,
+                        size_t writebuf_length,
+                        bool zero_end)
+{
+    off_t size;
+    int rc;
+
+    if (!zero_end) {
+        size = 0;
+    } else {
+        if ((size = lseek(fd, -wipe_len, SEEK_END)) < 0) {
+            virReportSystemError(errno,
+                                 _("Failed to seek to %llu bytes to the end "
+                                   "in volume with path '%s'"),
+                                 wipe_len, path);
+            return -1;
+        }
+    }
+
+    VIR_DEBUG("wiping start: %zd len: %llu", (ssize_t)size, wipe_len);
+
+    if ((rc = storageBackendWipeLocalOffload(path, fd, size, wipe_len)) < 0)
+        return -1;
+
+    if (rc > 0 &&
+        storageBackendWipeLocalWrite(path, fd, size, wipe_len,
+                                     writebuf_length) < 0)
+        return -1;
+
     if (virFileDataSync(fd) < 0) {
         virReportSystemError(errno,
                              _("cannot sync data to volume with path '%s'"),
@@ -701,14 +701,14 @@ testDomainStartState(testDriverPtr privconn,
     int ret = -1;
 
     virDomainObjSetState(dom, VIR_DOMAIN_RUNNING, reason);
-    dom->def->id = g_atomic_int_add(&privconn->nextDomID, 1);
+    virDomainObjSetID(dom, g_atomic_int_add(&privconn->nextDomID, 1));
 
     if (virDomainObjSetDefTransient(privconn->xmlopt,
                                     dom, NULL) < 0) {
         goto cleanup;
     }
 
-    dom->hasManagedSave = false;
+    virDomainObjSetManagedSave(dom, false);
     ret = 0;
  cleanup:
     if (ret < 0)
@@ -963,8 +963,8 @@ testParseDomains(testDriverPtr privconn,
             goto error;
 
         nsdata = def->namespaceData;
-        obj->persistent = !nsdata->transient;
-        obj->hasManagedSave = nsdata->hasManagedSave;
+        virDomainObjSetPersistent(obj, !nsdata->transient);
+        virDomainObjSetManagedSave(obj, nsdata->hasManagedSave);
 
         if (nsdata->runstate != VIR_DOMAIN_SHUTOFF) {
             if (testDomainStartState(privconn, obj,
@@ -3986,7 +3986,7 @@ static virDomainPtr testDomainDefineXMLFlags(virConnectPtr conn,
                                     &oldDef)))
         goto cleanup;
     def = NULL;
-    dom->persistent = 1;
+    virDomainObjSetPersistent(dom, true);
 
     event = virDomainEventLifecycleNewFromObj(dom,
                                      VIR_DOMAIN_EVENT_DEFINED,
@@ -4435,10 +4435,10 @@ static int testDomainUndefineFlags(virDomainPtr domain,
     event = virDomainEventLifecycleNewFromObj(privdom,
                                      VIR_DOMAIN_EVENT_UNDEFINED,
                                      VIR_DOMAIN_EVENT_UNDEFINED_REMOVED);
-    privdom->hasManagedSave = false;
+    virDomainObjSetManagedSave(privdom, false);
 
     if (virDomainObjIsActive(privdom))
-        privdom->persistent = 0;
+        virDomainObjSetPersistent(privdom, false);
     else
         virDomainObjListRemove(privconn->domains, privdom);
 
@@ -4630,7 +4630,7 @@ static int testDomainSetAutostart(virDomainPtr domain,
     if (!(privdom = testDomObjFromDomain(domain)))
         return -1;
 
-    privdom->autostart = autostart ? 1 : 0;
+    virDomainObjSetAutostart(privdom, autostart);
 
     virDomainObjEndAPI(&privdom);
     return 0;
@@ -7858,7 +7858,7 @@ testDomainManagedSave(virDomainPtr dom, unsigned int flags)
     event = virDomainEventLifecycleNewFromObj(vm,
                                      VIR_DOMAIN_EVENT_STOPPED,
                                      VIR_DOMAIN_EVENT_STOPPED_SAVED);
-    vm->hasManagedSave = true;
+    virDomainObjSetManagedSave(vm, true);
 
     ret = 0;
  cleanup:
@@ -7896,7 +7896,7 @@ testDomainManagedSaveRemove(virDomainPtr dom, unsigned int flags)
     if (!(vm = testDomObjFromDomain(dom)))
         return -1;
 
-    vm->hasManagedSave = false;
+    virDomainObjSetManagedSave(vm, false);
 
     virDomainObjEndAPI(&vm);
     return 0;
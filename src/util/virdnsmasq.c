@@ -41,6 +41,7 @@
 #include "virlog.h"
 #include "virfile.h"
 #include "virstring.h"
+#include "virhash.h"
 
 #define VIR_FROM_THIS VIR_FROM_NETWORK
 
@@ -48,6 +49,12 @@ VIR_LOG_INIT("util.dnsmasq");
 
 #define DNSMASQ_HOSTSFILE_SUFFIX "hostsfile"
 #define DNSMASQ_ADDNHOSTSFILE_SUFFIX "addnhosts"
+#define DNSMASQ_HOSTSDIR_SUFFIX "hostsdir"
+#define DNSMASQ_ADDNHOSTSDIR_SUFFIX "addnhostsdir"
+
+/* Once a hosts directory holds this many files, they're merged back
+ * into the hosts file */
+#define DNSMASQ_HOSTSDIR_FILES_MAX 64
 
 static void
 dhcphostFree(dnsmasqDhcpHost *host)
@@ -81,6 +88,7 @@ addnhostsFree(dnsmasqAddnHostsfile *addnhostsfile)
     }
 
     VIR_FREE(addnhostsfile->path);
+    VIR_FREE(addnhostsfile->dir);
 
     VIR_FREE(addnhostsfile);
 }
@@ -154,6 +162,13 @@ addnhostsNew(const char *name,
     if (!(addnhostsfile->path = virBufferContentAndReset(&buf)))
         goto error;
 
+    virBufferAsprintf(&buf, "%s", config_dir);
+    virBufferEscapeString(&buf, "/%s", name);
+    virBufferAsprintf(&buf, ".%s", DNSMASQ_ADDNHOSTSDIR_SUFFIX);
+
+    if (!(addnhostsfile->dir = virBufferContentAndReset(&buf)))
+        goto error;
+
     return addnhostsfile;
 
  error:
@@ -283,6 +298,7 @@ hostsfileFree(dnsmasqHostsfile *hostsfile)
     }
 
     VIR_FREE(hostsfile->path);
+    VIR_FREE(hostsfile->dir);
 
     VIR_FREE(hostsfile);
 }
@@ -357,6 +373,13 @@ hostsfileNew(const char *name,
 
     if (!(hostsfile->path = virBufferContentAndReset(&buf)))
         goto error;
+
+    virBufferAsprintf(&buf, "%s", config_dir);
+    virBufferEscapeString(&buf, "/%s", name);
+    virBufferAsprintf(&buf, ".%s", DNSMASQ_HOSTSDIR_SUFFIX);
+
+    if (!(hostsfile->dir = virBufferContentAndReset(&buf)))
+        goto error;
     return hostsfile;
 
  error:
@@ -434,6 +457,269 @@ hostsfileSave(dnsmasqHostsfile *hostsfile)
     return 0;
 }
 
+
+/* Formats the lines of the addn-hosts file, exactly as addnhostsWrite
+ * would write them */
+static char **
+addnhostsLines(dnsmasqAddnHostsfile *addnhostsfile)
+{
+    char **lines = g_new0(char *, addnhostsfile->nhosts + 1);
+    size_t i, j;
+
+    for (i = 0; i < addnhostsfile->nhosts; i++) {
+        virBuffer buf = VIR_BUFFER_INITIALIZER;
+
+        virBufferAsprintf(&buf, "%s\t", addnhostsfile->hosts[i].ip);
+        for (j = 0; j < addnhostsfile->hosts[i].nhostnames; j++)
+            virBufferAsprintf(&buf, "%s\t", addnhostsfile->hosts[i].hostnames[j]);
+
+        lines[i] = virBufferContentAndReset(&buf);
+    }
+
+    return lines;
+}
+
+
+/* Formats the lines of the dhcp-hostsfile, exactly as hostsfileWrite
+ * would write them */
+static char **
+hostsfileLines(dnsmasqHostsfile *hostsfile)
+{
+    char **lines = g_new0(char *, hostsfile->nhosts + 1);
+    size_t i;
+
+    for (i = 0; i < hostsfile->nhosts; i++)
+        lines[i] = g_strdup(hostsfile->hosts[i].host);
+
+    return lines;
+}
+
+
+static int
+hostsLinesAdd(virHashTablePtr set,
+              const char *path)
+{
+    g_autofree char *content = NULL;
+    g_auto(GStrv) lines = NULL;
+    size_t i;
+
+    if (virFileReadAllQuiet(path, 64 * 1024 * 1024, &content) < 0) {
+        if (errno == ENOENT)
+            return 0;
+        virReportSystemError(errno, _("cannot read config file '%s'"), path);
+        return -1;
+    }
+
+    lines = g_strsplit(content, "\n", -1);
+    for (i = 0; lines[i]; i++) {
+        if (*lines[i] &&
+            virHashUpdateEntry(set, lines[i], (void *)1) < 0)
+            return -1;
+    }
+
+    return 0;
+}
+
+
+/* dnsmasq ignores files starting with '.' in the directories it
+ * watches, so that's what is used while writing them out */
+static bool
+hostsDirEntryIgnored(const char *name)
+{
+    return name[0] == '.';
+}
+
+
+/*
+ * Collects the lines of the hosts file at @path and of the files
+ * dnsmasq has read from @dir into @set. The number of files in @dir
+ * and the highest number used to name them are stored in @nfiles and
+ * @last.
+ */
+static int
+hostsDirRead(virHashTablePtr set,
+             const char *path,
+             const char *dir,
+             size_t *nfiles,
+             unsigned long long *last)
+{
+    DIR *dh = NULL;
+    struct dirent *ent;
+    int ret = -1;
+    int rc;
+
+    *nfiles = 0;
+    *last = 0;
+
+    if (hostsLinesAdd(set, path) < 0)
+        return -1;
+
+    if (virDirOpen(&dh, dir) < 0)
+        return -1;
+
+    while ((rc = virDirRead(dh, &ent, dir)) > 0) {
+        g_autofree char *file = NULL;
+        unsigned long long num;
+
+        if (hostsDirEntryIgnored(ent->d_name))
+            continue;
+
+        if (virStrToLong_ull(ent->d_name, NULL, 10, &num) == 0 && num > *last)
+            *last = num;
+
+        file = g_strdup_printf("%s/%s", dir, ent->d_name);
+        if (hostsLinesAdd(set, file) < 0)
+            goto cleanup;
+
+        (*nfiles)++;
+    }
+
+    if (rc < 0)
+        goto cleanup;
+
+    ret = 0;
+ cleanup:
+    VIR_DIR_CLOSE(dh);
+    return ret;
+}
+
+
+static int
+hostsDirClear(const char *dir,
+              bool remove)
+{
+    DIR *dh = NULL;
+    struct dirent *ent;
+    int ret = -1;
+    int rc;
+
+    if ((rc = virDirOpenIfExists(&dh, dir)) <= 0)
+        return rc;
+
+    while ((rc = virDirRead(dh, &ent, dir)) > 0) {
+        g_autofree char *file = g_strdup_printf("%s/%s", dir, ent->d_name);
+
+        if (unlink(file) < 0 && errno != ENOENT) {
+            virReportSystemError(errno, _("cannot remove config file '%s'"),
+                                 file);
+            goto cleanup;
+        }
+    }
+
+    if (rc < 0)
+        goto cleanup;
+
+    if (remove && rmdir(dir) < 0 && errno != ENOENT) {
+        virReportSystemError(errno, _("cannot remove directory '%s'"), dir);
+        goto cleanup;
+    }
+
+    ret = 0;
+ cleanup:
+    VIR_DIR_CLOSE(dh);
+    return ret;
+}
+
+
+static int
+hostsWriteLines(const char *path,
+                char **lines)
+{
+    virBuffer buf = VIR_BUFFER_INITIALIZER;
+    g_autofree char *content = NULL;
+    size_t i;
+
+    for (i = 0; lines[i]; i++)
+        virBufferAsprintf(&buf, "%s\n", lines[i]);
+
+    content = virBufferContentAndReset(&buf);
+
+    return virFileRewriteStr(path, 0644, NULLSTR_EMPTY(content));
+}
+
+
+/*
+ * Brings dnsmasq's view of a hosts file in line with @lines.
+ *
+ * If dnsmasq watches @dir, hosts which were only added are written to
+ * a new file in @dir which dnsmasq reads on its own. Anything else
+ * requires the hosts file to be rewritten and dnsmasq to reread it.
+ *
+ * Returns 1 if dnsmasq has to be told to reload its hosts files, 0 if
+ * it doesn't, -1 on error.
+ */
+static int
+hostsUpdate(const char *path,
+            const char *dir,
+            char **lines)
+{
+    g_autoptr(virHashTable) old = NULL;
+    g_autoptr(virHashTable) new = NULL;
+    g_autofree char **added = NULL;
+    g_autofree char *tmp = NULL;
+    g_autofree char *file = NULL;
+    size_t nadded = 0;
+    size_t nlines = 0;
+    size_t nfiles = 0;
+    unsigned long long last = 0;
+    bool removed = false;
+    bool watched = virFileIsDir(dir);
+    size_t i;
+
+    if (!(old = virHashCreate(32, NULL)) ||
+        !(new = virHashCreate(32, NULL)))
+        return -1;
+
+    if (watched) {
+        if (hostsDirRead(old, path, dir, &nfiles, &last) < 0)
+            return -1;
+    } else if (hostsLinesAdd(old, path) < 0) {
+        return -1;
+    }
+
+    for (nlines = 0; lines[nlines]; nlines++) {
+        if (virHashUpdateEntry(new, lines[nlines], (void *)1) < 0)
+            return -1;
+    }
+
+    added = g_new0(char *, nlines + 1);
+    for (i = 0; i < nlines; i++) {
+        if (!virHashLookup(old, lines[i]))
+            added[nadded++] = lines[i];
+    }
+
+    removed = virHashSize(old) + nadded > virHashSize(new);
+
+    if (!removed && nadded == 0)
+        return 0;
+
+    if (!watched || removed || nfiles >= DNSMASQ_HOSTSDIR_FILES_MAX) {
+        /* dnsmasq already knows about everything in @path and @dir,
+         * so merging them together needs no reload unless something
+         * was removed, in which case dnsmasq has to reread it all */
+        if (hostsWriteLines(path, lines) < 0 ||
+            (watched && hostsDirClear(dir, false) < 0))
+            return -1;
+
+        return removed || !watched ? 1 : 0;
+    }
+
+    tmp = g_strdup_printf("%s/.%llu", dir, last + 1);
+    file = g_strdup_printf("%s/%llu", dir, last + 1);
+
+    if (hostsWriteLines(tmp, added) < 0)
+        return -1;
+
+    if (rename(tmp, file) < 0) {
+        virReportSystemError(errno, _("cannot rename '%s' to '%s'"), tmp, file);
+        unlink(tmp);
+        return -1;
+    }
+
+    return 0;
+}
+
+
 /**
  * dnsmasqContextNew:
  *
@@ -546,8 +832,76 @@ dnsmasqSave(const dnsmasqContext *ctx)
         if (ctx->addnhostsfile)
             ret = addnhostsSave(ctx->addnhostsfile);
     }
+    if (ret < 0)
+        return ret;
 
-    return ret;
+    /* The hosts directories are only there while the dnsmasq reading
+     * the files above watches them, see dnsmasqUpdate() */
+    if (ctx->hostsfile &&
+        hostsDirClear(ctx->hostsfile->dir, !ctx->hostsdir) < 0)
+        return -1;
+    if (ctx->addnhostsfile &&
+        hostsDirClear(ctx->addnhostsfile->dir, !ctx->hostsdir) < 0)
+        return -1;
+
+    if (ctx->hostsdir) {
+        if ((ctx->hostsfile &&
+             g_mkdir_with_parents(ctx->hostsfile->dir, 0755) < 0) ||
+            (ctx->addnhostsfile &&
+             g_mkdir_with_parents(ctx->addnhostsfile->dir, 0755) < 0)) {
+            virReportSystemError(errno, "%s",
+                                 _("cannot create hosts directory"));
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+
+/**
+ * dnsmasqUpdate:
+ * @ctx: pointer to the dnsmasq context for each network
+ *
+ * Updates the hosts files of a running dnsmasq to match the context,
+ * touching only what changed. Hosts which were merely added are
+ * picked up by dnsmasq on its own if it was started watching the hosts
+ * directories.
+ *
+ * Returns 1 if dnsmasq has to be reloaded with dnsmasqReload(), 0 if
+ * not, -1 on error.
+ */
+int
+dnsmasqUpdate(const dnsmasqContext *ctx)
+{
+    g_auto(GStrv) hosts = NULL;
+    g_auto(GStrv) addnhosts = NULL;
+    int reload = 0;
+    int rc;
+
+    if (virFileMakePath(ctx->config_dir) < 0) {
+        virReportSystemError(errno, _("cannot create config directory '%s'"),
+                             ctx->config_dir);
+        return -1;
+    }
+
+    if (ctx->hostsfile) {
+        hosts = hostsfileLines(ctx->hostsfile);
+        if ((rc = hostsUpdate(ctx->hostsfile->path,
+                              ctx->hostsfile->dir, hosts)) < 0)
+            return -1;
+        reload |= rc;
+    }
+
+    if (ctx->addnhostsfile) {
+        addnhosts = addnhostsLines(ctx->addnhostsfile);
+        if ((rc = hostsUpdate(ctx->addnhostsfile->path,
+                              ctx->addnhostsfile->dir, addnhosts)) < 0)
+            return -1;
+        reload |= rc;
+    }
+
+    return reload;
 }
 
 
@@ -562,10 +916,16 @@ dnsmasqDelete(const dnsmasqContext *ctx)
 {
     int ret = 0;
 
-    if (ctx->hostsfile)
+    if (ctx->hostsfile) {
         ret = genericFileDelete(ctx->hostsfile->path);
-    if (ctx->addnhostsfile)
+        if (hostsDirClear(ctx->hostsfile->dir, true) < 0)
+            ret = -1;
+    }
+    if (ctx->addnhostsfile) {
         ret = genericFileDelete(ctx->addnhostsfile->path);
+        if (hostsDirClear(ctx->addnhostsfile->dir, true) < 0)
+            ret = -1;
+    }
 
     return ret;
 }
@@ -666,13 +1026,22 @@ dnsmasqCapsSetFromBuffer(dnsmasqCapsPtr caps, const char *buf)
     if (strstr(buf, "--ra-param"))
         dnsmasqCapsSet(caps, DNSMASQ_CAPS_RA_PARAM);
 
+    /* The hosts directories are watched with inotify, which dnsmasq
+     * only supports on Linux */
+#ifdef __linux__
+    if (strstr(buf, "--dhcp-hostsdir"))
+        dnsmasqCapsSet(caps, DNSMASQ_CAPS_HOSTSDIR);
+#endif
+
     VIR_INFO("dnsmasq version is %d.%d, --bind-dynamic is %spresent, "
-             "SO_BINDTODEVICE is %sin use, --ra-param is %spresent",
+             "SO_BINDTODEVICE is %sin use, --ra-param is %spresent, "
+             "--dhcp-hostsdir is %spresent",
              (int)caps->version / 1000000,
              (int)(caps->version % 1000000) / 1000,
              dnsmasqCapsGet(caps, DNSMASQ_CAPS_BIND_DYNAMIC) ? "" : "NOT ",
              dnsmasqCapsGet(caps, DNSMASQ_CAPS_BINDTODEVICE) ? "" : "NOT ",
-             dnsmasqCapsGet(caps, DNSMASQ_CAPS_RA_PARAM) ? "" : "NOT ");
+             dnsmasqCapsGet(caps, DNSMASQ_CAPS_RA_PARAM) ? "" : "NOT ",
+             dnsmasqCapsGet(caps, DNSMASQ_CAPS_HOSTSDIR) ? "" : "NOT ");
     return 0;
 
  fail:
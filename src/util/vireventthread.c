@@ -24,12 +24,17 @@
 #include "virthread.h"
 #include "virerror.h"
 
+typedef struct _virEventThreadData virEventThreadData;
+
 struct _virEventThread {
     GObject parent;
 
     GThread *thread;
     GMainContext *context;
     GMainLoop *loop;
+
+    /* Owned by the worker thread, valid while @thread is running */
+    virEventThreadData *data;
 };
 
 G_DEFINE_TYPE(virEventThread, vir_event_thread, G_TYPE_OBJECT)
@@ -70,14 +75,23 @@ vir_event_thread_class_init(virEventThreadClass *klass)
 }
 
 
-typedef struct {
+struct _virEventThreadData {
     GCond cond;
     GMutex lock;
     bool running;
 
     GMainContext *context;
     GMainLoop *loop;
-} virEventThreadData;
+
+    /* Loop accounting in microseconds, protected by @lock */
+    gint64 started;
+    gint64 idle;
+};
+
+
+/* Worker data of the event thread the caller runs in, used by the
+ * poll function which has no user data argument of its own. */
+static GPrivate virEventThreadCurrent;
 
 
 static void
@@ -107,18 +121,44 @@ virEventThreadNotify(void *opaque)
 }
 
 
+static gint
+virEventThreadPoll(GPollFD *fds,
+                   guint nfds,
+                   gint timeout)
+{
+    virEventThreadData *data = g_private_get(&virEventThreadCurrent);
+    gint64 start = g_get_monotonic_time();
+    gint ret;
+
+    ret = g_poll(fds, nfds, timeout);
+
+    if (data) {
+        g_mutex_lock(&data->lock);
+        data->idle += g_get_monotonic_time() - start;
+        g_mutex_unlock(&data->lock);
+    }
+
+    return ret;
+}
+
+
 static void *
 virEventThreadWorker(void *opaque)
 {
     virEventThreadData *data = opaque;
     g_autoptr(GSource) running = g_idle_source_new();
 
+    g_private_set(&virEventThreadCurrent, data);
+    data->started = g_get_monotonic_time();
+    g_main_context_set_poll_func(data->context, virEventThreadPoll);
+
     g_source_set_callback(running, virEventThreadNotify, data, NULL);
 
     g_source_attach(running, data->context);
 
     g_main_loop_run(data->loop);
 
+    g_private_set(&virEventThreadCurrent, NULL);
     virEventThreadDataFree(data);
 
     return NULL;
@@ -167,6 +207,8 @@ virEventThreadStart(virEventThread *evt, const char *name)
         g_cond_wait(&data->cond, &data->lock);
     g_mutex_unlock(&data->lock);
 
+    evt->data = data;
+
     return 0;
 }
 
@@ -188,3 +230,40 @@ virEventThreadGetContext(virEventThread *evt)
 {
     return evt->context;
 }
+
+
+/**
+ * virEventThreadGetStats:
+ * @evt: the event thread
+ * @busy: filled with time spent outside of poll(), in microseconds
+ * @total: filled with time since the thread started, in microseconds
+ *
+ * Report how much of its lifetime the event thread spent dispatching
+ * events and running sources rather than waiting for them, which is
+ * a measure of how loaded the loop is.
+ */
+void
+virEventThreadGetStats(virEventThread *evt,
+                       unsigned long long *busy,
+                       unsigned long long *total)
+{
+    virEventThreadData *data = evt->data;
+    gint64 now = g_get_monotonic_time();
+    gint64 elapsed;
+    gint64 idle;
+
+    *busy = 0;
+    *total = 0;
+
+    if (!data)
+        return;
+
+    g_mutex_lock(&data->lock);
+    elapsed = now - data->started;
+    idle = data->idle;
+    g_mutex_unlock(&data->lock);
+
+    *total = elapsed;
+    if (elapsed > idle)
+        *busy = elapsed - idle;
+}
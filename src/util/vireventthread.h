@@ -29,3 +29,7 @@ G_DECLARE_FINAL_TYPE(virEventThread, vir_event_thread, VIR, EVENT_THREAD, GObjec
 virEventThread *virEventThreadNew(const char *name);
 
 GMainContext *virEventThreadGetContext(virEventThread *evt);
+
+void virEventThreadGetStats(virEventThread *evt,
+                            unsigned long long *busy,
+                            unsigned long long *total);
@@ -25,15 +25,22 @@
 #include "virlease.h"
 
 #include <time.h>
+#include <fcntl.h>
+#include <sys/stat.h>
 
 #include "virfile.h"
 #include "virstring.h"
 #include "virerror.h"
 #include "viralloc.h"
 #include "virutil.h"
+#include "virhash.h"
+#include "virlog.h"
+#include "virobject.h"
 
 #define VIR_FROM_THIS VIR_FROM_NETWORK
 
+VIR_LOG_INIT("util.lease");
+
 /**
  * VIR_NETWORK_DHCP_LEASE_FILE_SIZE_MAX:
  *
@@ -41,6 +48,19 @@
  */
 #define VIR_NETWORK_DHCP_LEASE_FILE_SIZE_MAX (32 * 1024 * 1024)
 
+/**
+ * VIR_LEASE_JOURNAL_COMPACT_MIN:
+ *
+ * The journal is folded back into the leases file once it grows past
+ * both this size and the size of the leases file itself, so that the
+ * cost of rewriting the leases file is spread over as many events as
+ * it holds leases.
+ */
+#define VIR_LEASE_JOURNAL_COMPACT_MIN (64 * 1024)
+
+/* Number of times a reader retries when the journal is rotated under it */
+#define VIR_LEASE_DB_REFRESH_RETRIES 3
+
 
 int
 virLeaseReadCustomLeaseFile(virJSONValuePtr leases_array_new,
@@ -259,3 +279,581 @@ virLeaseNew(virJSONValuePtr *lease_ret,
     lease_new = NULL;
     return 0;
 }
+
+
+/*
+ * Lease journal
+ *
+ * Instead of rewriting the whole custom leases file on every event, the
+ * leases helper appends one JSON object per line to a journal kept next
+ * to it (VIR_LEASE_JOURNAL_SUFFIX). A record carrying a "mac-address"
+ * is a complete lease which replaces any older lease for the same
+ * "ip-address"; a record with just an "ip-address" deletes the lease.
+ * Replaying the journal on top of the leases file yields the current
+ * set of leases.
+ *
+ * Compaction writes the replayed set to the leases file and only then
+ * replaces the journal with an empty one, both via rename(). Replaying
+ * a journal again on top of the leases file produced from it is a
+ * no-op, so readers that open the journal before reading the leases
+ * file always see a consistent state, as long as the journal they
+ * opened was not replaced in the meantime.
+ */
+
+static char *
+virLeaseJournalFileName(const char *custom_lease_file)
+{
+    return g_strdup_printf("%s" VIR_LEASE_JOURNAL_SUFFIX, custom_lease_file);
+}
+
+
+/**
+ * virLeaseJournalAppend:
+ * @custom_lease_file: path to the custom leases file
+ * @record: lease, or deletion record
+ *
+ * Appends @record to the journal of @custom_lease_file.
+ *
+ * Returns 0 on success, -1 on error.
+ */
+int
+virLeaseJournalAppend(const char *custom_lease_file,
+                      virJSONValuePtr record)
+{
+    g_autofree char *journal = virLeaseJournalFileName(custom_lease_file);
+    g_autofree char *str = NULL;
+    g_autofree char *line = NULL;
+    int fd = -1;
+
+    if (!(str = virJSONValueToString(record, false)))
+        return -1;
+
+    line = g_strdup_printf("%s\n", str);
+
+    if ((fd = open(journal, O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC,
+                   0644)) < 0) {
+        virReportSystemError(errno, _("cannot open file '%s'"), journal);
+        return -1;
+    }
+
+    /* A single write keeps concurrent readers from seeing half a record
+     * in all but the most pathological cases, and those are skipped */
+    if (safewrite(fd, line, strlen(line)) < 0) {
+        virReportSystemError(errno, _("cannot write to file '%s'"), journal);
+        VIR_FORCE_CLOSE(fd);
+        return -1;
+    }
+
+    if (VIR_CLOSE(fd) < 0) {
+        virReportSystemError(errno, _("cannot save file '%s'"), journal);
+        return -1;
+    }
+
+    return 0;
+}
+
+
+/**
+ * virLeaseJournalAppendDelete:
+ * @custom_lease_file: path to the custom leases file
+ * @ip: address of the lease to delete
+ *
+ * Records deletion of the lease for @ip in the journal of
+ * @custom_lease_file.
+ *
+ * Returns 0 on success, -1 on error.
+ */
+int
+virLeaseJournalAppendDelete(const char *custom_lease_file,
+                            const char *ip)
+{
+    g_autoptr(virJSONValue) record = virJSONValueNewObject();
+
+    if (virJSONValueObjectAppendString(record, "ip-address", ip) < 0)
+        return -1;
+
+    return virLeaseJournalAppend(custom_lease_file, record);
+}
+
+
+/**
+ * virLeaseJournalNeedsCompact:
+ * @custom_lease_file: path to the custom leases file
+ *
+ * Returns true if the journal of @custom_lease_file has grown large
+ * enough to be worth folding into the leases file.
+ */
+bool
+virLeaseJournalNeedsCompact(const char *custom_lease_file)
+{
+    g_autofree char *journal = virLeaseJournalFileName(custom_lease_file);
+    struct stat sb;
+    struct stat jsb;
+
+    if (stat(journal, &jsb) < 0)
+        return false;
+
+    if (stat(custom_lease_file, &sb) < 0)
+        sb.st_size = 0;
+
+    return jsb.st_size > VIR_LEASE_JOURNAL_COMPACT_MIN &&
+           jsb.st_size > sb.st_size;
+}
+
+
+typedef struct _virLeaseDBEntry virLeaseDBEntry;
+typedef virLeaseDBEntry *virLeaseDBEntryPtr;
+struct _virLeaseDBEntry {
+    unsigned long long seq;
+    virJSONValuePtr lease;
+};
+
+struct _virLeaseDB {
+    virObjectLockable parent;
+
+    char *file;
+    char *journal;
+
+    /* ip-address -> virLeaseDBEntryPtr */
+    virHashTablePtr leases;
+    unsigned long long seq;
+
+    /* Identity of the leases file the table was loaded from */
+    bool loaded;
+    struct stat fileStat;
+
+    /* Identity of the journal and how much of it was replayed */
+    dev_t journalDev;
+    ino_t journalIno;
+    off_t journalOffset;
+};
+
+
+static void
+virLeaseDBEntryFree(void *opaque)
+{
+    virLeaseDBEntryPtr entry = opaque;
+
+    if (!entry)
+        return;
+
+    virJSONValueFree(entry->lease);
+    g_free(entry);
+}
+
+
+static virClassPtr virLeaseDBClass;
+
+
+static void
+virLeaseDBDispose(void *obj)
+{
+    virLeaseDBPtr db = obj;
+
+    virHashFree(db->leases);
+    g_free(db->file);
+    g_free(db->journal);
+}
+
+
+static int
+virLeaseDBOnceInit(void)
+{
+    if (!VIR_CLASS_NEW(virLeaseDB, virClassForObjectLockable()))
+        return -1;
+
+    return 0;
+}
+
+VIR_ONCE_GLOBAL_INIT(virLeaseDB);
+
+
+/**
+ * virLeaseDBNew:
+ * @custom_lease_file: path to the custom leases file
+ *
+ * Creates an in-memory view of the leases stored in @custom_lease_file
+ * and its journal. The view is empty until virLeaseDBRefresh() is
+ * called. The database is a lockable object, callers sharing it between
+ * threads must hold its lock across the functions below and for as long
+ * as they use the leases it returned.
+ *
+ * Returns the new database, or NULL on error.
+ */
+virLeaseDBPtr
+virLeaseDBNew(const char *custom_lease_file)
+{
+    g_autoptr(virLeaseDB) db = NULL;
+
+    if (virLeaseDBInitialize() < 0)
+        return NULL;
+
+    if (!(db = virObjectLockableNew(virLeaseDBClass)))
+        return NULL;
+
+    if (!(db->leases = virHashCreate(32, virLeaseDBEntryFree)))
+        return NULL;
+
+    db->file = g_strdup(custom_lease_file);
+    db->journal = virLeaseJournalFileName(custom_lease_file);
+
+    return g_steal_pointer(&db);
+}
+
+
+static int
+virLeaseDBAdd(virLeaseDBPtr db,
+              unsigned long long seq,
+              const char *ip,
+              virJSONValuePtr lease)
+{
+    virLeaseDBEntryPtr entry = g_new0(virLeaseDBEntry, 1);
+
+    entry->seq = seq;
+    entry->lease = lease;
+
+    if (virHashUpdateEntry(db->leases, ip, entry) < 0) {
+        /* Leave @lease to the caller */
+        entry->lease = NULL;
+        virLeaseDBEntryFree(entry);
+        return -1;
+    }
+
+    return 0;
+}
+
+
+static int
+virLeaseDBLoad(virLeaseDBPtr db)
+{
+    g_autoptr(virJSONValue) leases = virJSONValueNewArray();
+    size_t i;
+
+    virHashRemoveAll(db->leases);
+    db->seq = 0;
+
+    if (virLeaseReadCustomLeaseFile(leases, db->file, NULL, NULL) < 0)
+        return -1;
+
+    db->seq = virJSONValueArraySize(leases);
+
+    /* Steal from the back to avoid shifting the array around. Should
+     * an address be listed twice, the later lease wins. */
+    for (i = db->seq; i-- > 0;) {
+        virJSONValuePtr lease = virJSONValueArraySteal(leases, i);
+        const char *ip = virJSONValueObjectGetString(lease, "ip-address");
+
+        if (virHashLookup(db->leases, ip)) {
+            virJSONValueFree(lease);
+            continue;
+        }
+
+        if (virLeaseDBAdd(db, i, ip, lease) < 0) {
+            virJSONValueFree(lease);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+
+static int
+virLeaseDBReplay(virLeaseDBPtr db,
+                 char *records,
+                 size_t len,
+                 size_t *consumed)
+{
+    char *line = records;
+    char *eol;
+
+    *consumed = 0;
+
+    /* Anything after the last newline is a record still being written */
+    while (line < records + len && (eol = memchr(line, '\n', records + len - line))) {
+        g_autoptr(virJSONValue) record = NULL;
+        const char *ip = NULL;
+
+        *eol = '\0';
+
+        if (*line &&
+            (!(record = virJSONValueFromString(line)) ||
+             !(ip = virJSONValueObjectGetString(record, "ip-address")))) {
+            VIR_WARN("Ignoring malformed record in %s: %s", db->journal, line);
+        } else if (record) {
+            if (virJSONValueObjectHasKey(record, "mac-address") == 1) {
+                if (virLeaseDBAdd(db, db->seq++, ip, record) < 0)
+                    return -1;
+                record = NULL;
+            } else {
+                virHashRemoveEntry(db->leases, ip);
+            }
+        }
+
+        line = eol + 1;
+        *consumed = line - records;
+    }
+
+    return 0;
+}
+
+
+static bool
+virLeaseDBFileChanged(const struct stat *a,
+                      const struct stat *b)
+{
+    return a->st_dev != b->st_dev ||
+           a->st_ino != b->st_ino ||
+           a->st_size != b->st_size ||
+           a->st_mtime != b->st_mtime ||
+           a->st_ctime != b->st_ctime;
+}
+
+
+/**
+ * virLeaseDBRefresh:
+ * @db: lease database
+ *
+ * Brings @db up to date with the leases file and its journal. The
+ * leases file is only parsed again if it was replaced, otherwise just
+ * the part of the journal appended since the last refresh is replayed.
+ *
+ * Returns 0 on success, -1 on error.
+ */
+int
+virLeaseDBRefresh(virLeaseDBPtr db)
+{
+    size_t attempt;
+
+    for (attempt = 0; attempt <= VIR_LEASE_DB_REFRESH_RETRIES; attempt++) {
+        VIR_AUTOCLOSE fd = -1;
+        VIR_AUTOCLOSE check = -1;
+        g_autofree char *records = NULL;
+        struct stat sb;
+        struct stat jsb;
+        struct stat csb;
+        size_t consumed;
+        int len;
+
+        /* The journal must be opened before the leases file is read, see
+         * the comment on the journal format above */
+        if ((fd = open(db->journal, O_RDONLY | O_CLOEXEC)) < 0 &&
+            errno != ENOENT) {
+            virReportSystemError(errno, _("cannot open file '%s'"), db->journal);
+            return -1;
+        }
+
+        if (stat(db->file, &sb) < 0) {
+            if (errno != ENOENT) {
+                virReportSystemError(errno, _("cannot stat file '%s'"), db->file);
+                return -1;
+            }
+            memset(&sb, 0, sizeof(sb));
+        }
+
+        if (!db->loaded || virLeaseDBFileChanged(&db->fileStat, &sb)) {
+            db->loaded = false;
+            db->journalOffset = 0;
+            if (sb.st_ino) {
+                if (virLeaseDBLoad(db) < 0)
+                    return -1;
+            } else {
+                virHashRemoveAll(db->leases);
+            }
+            db->fileStat = sb;
+            db->loaded = true;
+        }
+
+        if (fd < 0) {
+            db->journalIno = 0;
+            db->journalOffset = 0;
+            return 0;
+        }
+
+        if (fstat(fd, &jsb) < 0) {
+            virReportSystemError(errno, _("cannot stat file '%s'"), db->journal);
+            return -1;
+        }
+
+        if (jsb.st_dev != db->journalDev ||
+            jsb.st_ino != db->journalIno ||
+            jsb.st_size < db->journalOffset) {
+            db->journalDev = jsb.st_dev;
+            db->journalIno = jsb.st_ino;
+            db->journalOffset = 0;
+        }
+
+        if (lseek(fd, db->journalOffset, SEEK_SET) < 0) {
+            virReportSystemError(errno, _("cannot seek in file '%s'"), db->journal);
+            return -1;
+        }
+
+        if ((len = virFileReadLimFD(fd, VIR_NETWORK_DHCP_LEASE_FILE_SIZE_MAX,
+                                    &records)) < 0) {
+            virReportSystemError(errno, _("cannot read file '%s'"), db->journal);
+            return -1;
+        }
+
+        if (virLeaseDBReplay(db, records, len, &consumed) < 0)
+            return -1;
+        db->journalOffset += consumed;
+
+        /* If the journal was compacted while we were reading, the leases
+         * file we loaded may be newer than the journal we replayed */
+        if ((check = open(db->journal, O_RDONLY | O_CLOEXEC)) >= 0 &&
+            fstat(check, &csb) == 0 &&
+            csb.st_dev == jsb.st_dev && csb.st_ino == jsb.st_ino)
+            return 0;
+
+        VIR_DEBUG("Journal %s was rotated during refresh", db->journal);
+        db->loaded = false;
+    }
+
+    virReportError(VIR_ERR_OPERATION_FAILED,
+                   _("leases in '%s' keep changing while being read"),
+                   db->file);
+    return -1;
+}
+
+
+static int
+virLeaseDBEntryCompare(const void *a,
+                       const void *b)
+{
+    virLeaseDBEntryPtr ea = *(virLeaseDBEntryPtr *)a;
+    virLeaseDBEntryPtr eb = *(virLeaseDBEntryPtr *)b;
+
+    if (ea->seq < eb->seq)
+        return -1;
+    return ea->seq > eb->seq;
+}
+
+
+static int
+virLeaseDBCollect(void *payload,
+                  const void *name G_GNUC_UNUSED,
+                  void *opaque)
+{
+    virLeaseDBEntryPtr **next = opaque;
+
+    *((*next)++) = payload;
+    return 0;
+}
+
+
+/**
+ * virLeaseDBGetLeases:
+ * @db: lease database
+ * @nleases: filled with the number of leases
+ *
+ * Returns the leases in @db, oldest first. The array must be freed by
+ * the caller, the leases it points to belong to @db and are only valid
+ * until the next call to virLeaseDBRefresh().
+ */
+virJSONValuePtr *
+virLeaseDBGetLeases(virLeaseDBPtr db,
+                    size_t *nleases)
+{
+    size_t n = virHashSize(db->leases);
+    g_autofree virLeaseDBEntryPtr *entries = g_new0(virLeaseDBEntryPtr, n + 1);
+    virLeaseDBEntryPtr *next = entries;
+    virJSONValuePtr *leases = g_new0(virJSONValuePtr, n + 1);
+    size_t i;
+
+    virHashForEach(db->leases, virLeaseDBCollect, &next);
+    qsort(entries, n, sizeof(*entries), virLeaseDBEntryCompare);
+
+    for (i = 0; i < n; i++)
+        leases[i] = entries[i]->lease;
+
+    *nleases = n;
+    return leases;
+}
+
+
+/**
+ * virLeaseDBToArray:
+ * @db: lease database
+ * @server_duid: DHCPv6 server DUID
+ *
+ * Returns a copy of the leases in @db as a JSON array in the format of
+ * the custom leases file. If @server_duid is not set, it is filled in
+ * from the first IPv6 lease that has one; IPv6 leases which lack it
+ * get it injected, like in virLeaseReadCustomLeaseFile().
+ */
+virJSONValuePtr
+virLeaseDBToArray(virLeaseDBPtr db,
+                  char **server_duid)
+{
+    g_autoptr(virJSONValue) array = virJSONValueNewArray();
+    g_autofree virJSONValuePtr *leases = NULL;
+    size_t nleases;
+    size_t i;
+
+    leases = virLeaseDBGetLeases(db, &nleases);
+
+    for (i = 0; i < nleases; i++) {
+        const char *ip = virJSONValueObjectGetString(leases[i], "ip-address");
+        const char *duid = virJSONValueObjectGetString(leases[i], "server-duid");
+
+        if (strchr(ip, ':') && duid && !*server_duid)
+            *server_duid = g_strdup(duid);
+    }
+
+    for (i = 0; i < nleases; i++) {
+        g_autoptr(virJSONValue) lease = NULL;
+        const char *ip;
+
+        if (!(lease = virJSONValueCopy(leases[i])))
+            return NULL;
+
+        ip = virJSONValueObjectGetString(lease, "ip-address");
+
+        if (*server_duid && strchr(ip, ':') &&
+            !virJSONValueObjectGetString(lease, "server-duid") &&
+            virJSONValueObjectAppendString(lease, "server-duid", *server_duid) < 0)
+            return NULL;
+
+        if (virJSONValueArrayAppend(array, lease) < 0)
+            return NULL;
+        lease = NULL;
+    }
+
+    return g_steal_pointer(&array);
+}
+
+
+/**
+ * virLeaseDBCompact:
+ * @db: lease database, freshly refreshed
+ * @server_duid: DHCPv6 server DUID, see virLeaseDBToArray()
+ *
+ * Writes the leases in @db to the leases file and starts a new, empty
+ * journal. The caller must be the only writer of the leases file.
+ *
+ * Returns 0 on success, -1 on error.
+ */
+int
+virLeaseDBCompact(virLeaseDBPtr db,
+                  char **server_duid)
+{
+    g_autoptr(virJSONValue) array = NULL;
+    g_autofree char *str = NULL;
+
+    if (!(array = virLeaseDBToArray(db, server_duid)))
+        return -1;
+
+    if (!(str = virJSONValueToString(array, true))) {
+        virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                       _("empty json array"));
+        return -1;
+    }
+
+    if (virFileRewriteStr(db->file, 0644, str) < 0 ||
+        virFileRewriteStr(db->journal, 0644, "") < 0)
+        return -1;
+
+    /* The next refresh will read the new files back in */
+    db->loaded = false;
+    return 0;
+}
@@ -23,6 +23,7 @@
 #pragma once
 
 #include "virjson.h"
+#include "virobject.h"
 
 int virLeaseReadCustomLeaseFile(virJSONValuePtr leases_array_new,
                                 const char *custom_lease_file,
@@ -40,3 +41,31 @@ int virLeaseNew(virJSONValuePtr *lease_ret,
                 const char *hostname,
                 const char *iaid,
                 const char *server_duid);
+
+
+#define VIR_LEASE_JOURNAL_SUFFIX ".journal"
+
+int virLeaseJournalAppend(const char *custom_lease_file,
+                          virJSONValuePtr record);
+
+int virLeaseJournalAppendDelete(const char *custom_lease_file,
+                                const char *ip);
+
+bool virLeaseJournalNeedsCompact(const char *custom_lease_file);
+
+typedef struct _virLeaseDB virLeaseDB;
+typedef virLeaseDB *virLeaseDBPtr;
+
+virLeaseDBPtr virLeaseDBNew(const char *custom_lease_file);
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(virLeaseDB, virObjectUnref);
+
+int virLeaseDBRefresh(virLeaseDBPtr db);
+
+virJSONValuePtr *virLeaseDBGetLeases(virLeaseDBPtr db,
+                                     size_t *nleases);
+
+virJSONValuePtr virLeaseDBToArray(virLeaseDBPtr db,
+                                  char **server_duid);
+
+int virLeaseDBCompact(virLeaseDBPtr db,
+                      char **server_duid);
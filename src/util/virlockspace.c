@@ -684,6 +684,88 @@ int virLockSpaceReleaseResource(virLockSpacePtr lockspace,
 }
 
 
+/*
+ * Acquire @resnames[i] in @lockspaces[i] for all @nresources entries
+ * on behalf of @owner. Either every resource is acquired, or none is:
+ * on failure the resources acquired so far are released again and the
+ * error of the one which failed is reported.
+ */
+int virLockSpaceAcquireResources(virLockSpacePtr *lockspaces,
+                                 const char **resnames,
+                                 const unsigned int *flags,
+                                 size_t nresources,
+                                 pid_t owner)
+{
+    virErrorPtr orig_err;
+    size_t nacquired;
+    size_t i;
+
+    VIR_DEBUG("nresources=%zu owner=%lld",
+              nresources, (unsigned long long)owner);
+
+    for (nacquired = 0; nacquired < nresources; nacquired++) {
+        if (virLockSpaceAcquireResource(lockspaces[nacquired],
+                                        resnames[nacquired],
+                                        owner,
+                                        flags[nacquired]) < 0)
+            break;
+    }
+
+    if (nacquired == nresources)
+        return 0;
+
+    virErrorPreserveLast(&orig_err);
+    for (i = 0; i < nacquired; i++)
+        ignore_value(virLockSpaceReleaseResource(lockspaces[i],
+                                                 resnames[i],
+                                                 owner));
+    virErrorRestore(&orig_err);
+
+    return -1;
+}
+
+
+/*
+ * Release @resnames[i] in @lockspaces[i] for all @nresources entries
+ * on behalf of @owner. A failure to release one resource does not
+ * stop the others from being released; the first error is reported.
+ * A NULL entry in @lockspaces counts as a failure for its resource.
+ */
+int virLockSpaceReleaseResources(virLockSpacePtr *lockspaces,
+                                 const char **resnames,
+                                 size_t nresources,
+                                 pid_t owner)
+{
+    virErrorPtr first_err = NULL;
+    size_t i;
+
+    VIR_DEBUG("nresources=%zu owner=%lld",
+              nresources, (unsigned long long)owner);
+
+    for (i = 0; i < nresources; i++) {
+        if (!lockspaces[i]) {
+            virReportError(VIR_ERR_INTERNAL_ERROR,
+                           _("Lockspace for resource '%s' does not exist"),
+                           resnames[i]);
+        } else if (virLockSpaceReleaseResource(lockspaces[i],
+                                               resnames[i],
+                                               owner) == 0) {
+            continue;
+        }
+
+        if (!first_err)
+            virErrorPreserveLast(&first_err);
+    }
+
+    if (first_err) {
+        virErrorRestore(&first_err);
+        return -1;
+    }
+
+    return 0;
+}
+
+
 struct virLockSpaceRemoveData {
     pid_t owner;
     size_t count;
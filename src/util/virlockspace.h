@@ -55,5 +55,16 @@ int virLockSpaceReleaseResource(virLockSpacePtr lockspace,
                                 const char *resname,
                                 pid_t owner);
 
+int virLockSpaceAcquireResources(virLockSpacePtr *lockspaces,
+                                 const char **resnames,
+                                 const unsigned int *flags,
+                                 size_t nresources,
+                                 pid_t owner);
+
+int virLockSpaceReleaseResources(virLockSpacePtr *lockspaces,
+                                 const char **resnames,
+                                 size_t nresources,
+                                 pid_t owner);
+
 int virLockSpaceReleaseResourcesForOwner(virLockSpacePtr lockspace,
                                          pid_t owner);
@@ -19,15 +19,40 @@
 #include <config.h>
 #include <unistd.h>
 
-#include "virnetdevbandwidth.h"
+#define LIBVIRT_VIRNETDEVBANDWIDTHPRIV_H_ALLOW
+
+#include "virnetdevbandwidthpriv.h"
 #include "vircommand.h"
 #include "viralloc.h"
 #include "virerror.h"
+#include "virfile.h"
+#include "virlog.h"
+#include "virnetdev.h"
+#include "virnetlink.h"
 #include "virstring.h"
+#include "virthread.h"
 #include "virutil.h"
 
+#if defined(__linux__) && defined(HAVE_LIBNL)
+# include <linux/if_ether.h>
+# include <linux/pkt_cls.h>
+# include <linux/pkt_sched.h>
+# include <linux/rtnetlink.h>
+#endif
+
 #define VIR_FROM_THIS VIR_FROM_NONE
 
+VIR_LOG_INIT("util.netdevbandwidth");
+
+/* Program the kernel over rtnetlink rather than by running tc. */
+static bool virNetDevBandwidthUseNetlink = true;
+
+void
+virNetDevBandwidthSetUseNetlink(bool useNetlink)
+{
+    virNetDevBandwidthUseNetlink = useNetlink;
+}
+
 void
 virNetDevBandwidthFree(virNetDevBandwidthPtr def)
 {
@@ -39,9 +64,8 @@ virNetDevBandwidthFree(virNetDevBandwidthPtr def)
     VIR_FREE(def);
 }
 
-static void
-virNetDevBandwidthCmdAddOptimalQuantum(virCommandPtr cmd,
-                                       const virNetDevBandwidthRate *rate)
+static unsigned long long
+virNetDevBandwidthOptimalQuantum(const virNetDevBandwidthRate *rate)
 {
     const unsigned long long mtu = 1500;
     unsigned long long r2q;
@@ -58,10 +82,869 @@ virNetDevBandwidthCmdAddOptimalQuantum(virCommandPtr cmd,
     if (!r2q)
         r2q = 1;
 
+    return r2q;
+}
+
+static void
+virNetDevBandwidthCmdAddOptimalQuantum(virCommandPtr cmd,
+                                       const virNetDevBandwidthRate *rate)
+{
     virCommandAddArg(cmd, "quantum");
-    virCommandAddArgFormat(cmd, "%llu", r2q);
+    virCommandAddArgFormat(cmd, "%llu",
+                           virNetDevBandwidthOptimalQuantum(rate));
+}
+
+/* Largest rate (in kbps) and burst (in kb) that still fit into the
+ * 32 bit fields of the netlink structures. Anything bigger needs the
+ * 64 bit attributes which older kernel headers lack, so it is left
+ * to tc. */
+#define VIR_NETDEV_BANDWIDTH_NETLINK_MAX_RATE (UINT_MAX / 1000)
+#define VIR_NETDEV_BANDWIDTH_NETLINK_MAX_BURST (UINT_MAX / 1024)
+
+#if defined(__linux__) && defined(HAVE_LIBNL)
+
+# define VIR_NETDEV_BANDWIDTH_BATCH_MAX 16
+
+/* The way tc sees the packet scheduler clock, see tc_core_init() in
+ * iproute2. Rates have to be turned into transmission times exactly
+ * the way tc does it, otherwise the resulting kernel state would
+ * depend on which of the two programmed it. */
+static double virNetDevBandwidthTickInUsec;
+static unsigned int virNetDevBandwidthHZ;
+
+static int
+virNetDevBandwidthOnceInit(void)
+{
+    g_autofree char *buf = NULL;
+    unsigned int t2us;
+    unsigned int us2t;
+    unsigned int clockRes;
+    unsigned int hz;
+
+    if (virFileReadAll("/proc/net/psched", 1024, &buf) < 0)
+        return -1;
+
+    if (sscanf(buf, "%08x%08x%08x%08x", &t2us, &us2t, &clockRes, &hz) != 4 ||
+        us2t == 0) {
+        virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                       _("Unable to parse /proc/net/psched"));
+        return -1;
+    }
+
+    if (clockRes == 1000000000)
+        t2us = us2t;
+
+    virNetDevBandwidthTickInUsec = (double)t2us / us2t *
+        ((double)clockRes / 1000000);
+    virNetDevBandwidthHZ = clockRes == 1000000 && hz ? hz : 100;
+
+    VIR_DEBUG("tick_in_usec=%f hz=%u",
+              virNetDevBandwidthTickInUsec, virNetDevBandwidthHZ);
+    return 0;
+}
+
+VIR_ONCE_GLOBAL_INIT(virNetDevBandwidth);
+
+
+static bool
+virNetDevBandwidthNetlinkCanHandle(const virNetDevBandwidthRate *rate)
+{
+    if (!virNetDevBandwidthUseNetlink)
+        return false;
+
+    return !rate ||
+        (rate->average <= VIR_NETDEV_BANDWIDTH_NETLINK_MAX_RATE &&
+         rate->peak <= VIR_NETDEV_BANDWIDTH_NETLINK_MAX_RATE &&
+         rate->floor <= VIR_NETDEV_BANDWIDTH_NETLINK_MAX_RATE &&
+         rate->burst <= VIR_NETDEV_BANDWIDTH_NETLINK_MAX_BURST);
+}
+
+
+/* Time (in scheduler ticks) it takes to send @size bytes at @rate
+ * bytes per second. */
+static unsigned int
+virNetDevBandwidthXmitTime(unsigned long long rate,
+                           unsigned int size)
+{
+    unsigned int usec = 1000000 * ((double)size / (double)rate);
+
+    return usec * virNetDevBandwidthTickInUsec;
+}
+
+
+static void
+virNetDevBandwidthCalcRateTable(struct tc_ratespec *spec,
+                                uint32_t *rtab,
+                                unsigned long long rate,
+                                unsigned int mtu)
+{
+    int cellLog = 0;
+    size_t i;
+
+    while ((mtu >> cellLog) > 255)
+        cellLog++;
+
+    for (i = 0; i < 256; i++)
+        rtab[i] = virNetDevBandwidthXmitTime(rate, (i + 1) << cellLog);
+
+    spec->rate = rate;
+    spec->cell_log = cellLog;
+    spec->cell_align = -1;
+    spec->linklayer = TC_LINKLAYER_ETHERNET;
+}
+
+
+/* The node part of u32 filter handle "800::%u" is parsed by tc as
+ * hexadecimal number. Compute the very same handle so that filters
+ * created by either way can be found. */
+static int
+virNetDevBandwidthFilterHandle(unsigned int id,
+                               uint32_t *handle)
+{
+    unsigned int node = 0;
+    unsigned int shift;
+
+    for (shift = 0; id; id /= 10, shift += 4)
+        node |= (id % 10) << shift;
+
+    if (node > 0xfff)
+        return -1;
+
+    *handle = (0x800 << 20) | node;
+    return 0;
+}
+
+
+typedef struct _virNetDevBandwidthBatch virNetDevBandwidthBatch;
+typedef virNetDevBandwidthBatch *virNetDevBandwidthBatchPtr;
+struct _virNetDevBandwidthBatch {
+    const char *ifname;
+    int ifindex;
+    size_t nmsgs;
+    struct nl_msg *msgs[VIR_NETDEV_BANDWIDTH_BATCH_MAX];
+    bool optional[VIR_NETDEV_BANDWIDTH_BATCH_MAX];
+};
+
+
+static int
+virNetDevBandwidthBatchInit(virNetDevBandwidthBatchPtr batch,
+                            const char *ifname)
+{
+    memset(batch, 0, sizeof(*batch));
+    batch->ifname = ifname;
+
+    if (virNetDevBandwidthInitialize() < 0)
+        return -1;
+
+    return virNetDevGetIndex(ifname, &batch->ifindex);
+}
+
+
+static void
+virNetDevBandwidthBatchClear(virNetDevBandwidthBatchPtr batch)
+{
+    size_t i;
+
+    for (i = 0; i < batch->nmsgs; i++)
+        nlmsg_free(batch->msgs[i]);
+    batch->nmsgs = 0;
+}
+
+
+/**
+ * virNetDevBandwidthBatchAdd:
+ * @batch: batch to append the request to
+ * @type: RTM_* message type
+ * @flags: NLM_F_* flags
+ * @parent: parent of the qdisc/class/filter
+ * @handle: handle of the qdisc/class/filter
+ * @info: priority and protocol of a filter
+ * @kind: qdisc/class/filter type (may be NULL)
+ * @optional: whether a failure of the request is to be ignored
+ *
+ * Returns the new request for the caller to append options to (it
+ * is owned by @batch), or NULL on error.
+ */
+static struct nl_msg *
+virNetDevBandwidthBatchAdd(virNetDevBandwidthBatchPtr batch,
+                           int type,
+                           unsigned int flags,
+                           uint32_t parent,
+                           uint32_t handle,
+                           uint32_t info,
+                           const char *kind,
+                           bool optional)
+{
+    struct tcmsg tcm = {
+        .tcm_family = AF_UNSPEC,
+        .tcm_ifindex = batch->ifindex,
+        .tcm_parent = parent,
+        .tcm_handle = handle,
+        .tcm_info = info,
+    };
+    struct nl_msg *nl_msg;
+
+    if (batch->nmsgs == G_N_ELEMENTS(batch->msgs)) {
+        virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                       _("too many traffic control requests"));
+        return NULL;
+    }
+
+    if (!(nl_msg = nlmsg_alloc_simple(type, flags))) {
+        virReportOOMError();
+        return NULL;
+    }
+
+    batch->msgs[batch->nmsgs] = nl_msg;
+    batch->optional[batch->nmsgs] = optional;
+    batch->nmsgs++;
+
+    if (nlmsg_append(nl_msg, &tcm, sizeof(tcm), NLMSG_ALIGNTO) < 0)
+        goto buffer_too_small;
+
+    if (kind)
+        NETLINK_MSG_PUT(nl_msg, TCA_KIND, strlen(kind) + 1, kind);
+
+    return nl_msg;
+
+ buffer_too_small:
+    virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                   _("allocated netlink buffer is too small"));
+    return NULL;
+}
+
+
+static int
+virNetDevBandwidthBatchRun(virNetDevBandwidthBatchPtr batch)
+{
+    int errors[VIR_NETDEV_BANDWIDTH_BATCH_MAX];
+    size_t i;
+
+    if (batch->nmsgs == 0)
+        return 0;
+
+    VIR_DEBUG("Sending %zu traffic control requests for interface '%s'",
+              batch->nmsgs, batch->ifname);
+
+    if (virNetlinkCommandBatch(batch->msgs, batch->nmsgs, errors) < 0)
+        return -1;
+
+    for (i = 0; i < batch->nmsgs; i++) {
+        struct nlmsghdr *hdr = nlmsg_hdr(batch->msgs[i]);
+        const char *msg;
+
+        if (errors[i] == 0)
+            continue;
+
+        if (batch->optional[i]) {
+            VIR_DEBUG("Ignoring failure of request %zu on interface '%s': %d",
+                      i, batch->ifname, errors[i]);
+            continue;
+        }
+
+        switch (hdr->nlmsg_type) {
+        case RTM_NEWQDISC:
+            msg = _("Unable to add qdisc on interface '%s'");
+            break;
+        case RTM_DELQDISC:
+            msg = _("Unable to delete qdisc on interface '%s'");
+            break;
+        case RTM_NEWTCLASS:
+            if (hdr->nlmsg_flags & NLM_F_CREATE)
+                msg = _("Unable to add class on interface '%s'");
+            else
+                msg = _("Unable to change class on interface '%s'");
+            break;
+        case RTM_DELTCLASS:
+            msg = _("Unable to delete class on interface '%s'");
+            break;
+        case RTM_NEWTFILTER:
+            msg = _("Unable to add filter on interface '%s'");
+            break;
+        case RTM_DELTFILTER:
+            msg = _("Unable to delete filter on interface '%s'");
+            break;
+        default:
+            msg = _("Unable to set traffic control on interface '%s'");
+            break;
+        }
+
+        virReportSystemError(-errors[i], msg, batch->ifname);
+        return -1;
+    }
+
+    return 0;
+}
+
+
+/* Deletes root and ingress qdisc, see virNetDevBandwidthClear. */
+static int
+virNetDevBandwidthBatchAddClear(virNetDevBandwidthBatchPtr batch)
+{
+    if (!virNetDevBandwidthBatchAdd(batch, RTM_DELQDISC, 0,
+                                    TC_H_ROOT, 0, 0, NULL, true) ||
+        !virNetDevBandwidthBatchAdd(batch, RTM_DELQDISC, 0,
+                                    TC_H_INGRESS, TC_H_MAKE(TC_H_INGRESS, 0),
+                                    0, "ingress", true))
+        return -1;
+
+    return 0;
+}
+
+
+/* tc qdisc add dev $ifname root handle 1: htb default $defcls */
+static int
+virNetDevBandwidthBatchAddHTB(virNetDevBandwidthBatchPtr batch,
+                              unsigned int defcls)
+{
+    struct tc_htb_glob glob = {
+        .version = TC_HTB_PROTOVER,
+        .rate2quantum = 10,
+        .defcls = defcls,
+    };
+    struct nlattr *options = NULL;
+    struct nl_msg *nl_msg;
+
+    if (!(nl_msg = virNetDevBandwidthBatchAdd(batch, RTM_NEWQDISC,
+                                              NLM_F_CREATE | NLM_F_EXCL,
+                                              TC_H_ROOT, TC_H_MAKE(1 << 16, 0),
+                                              0, "htb", false)))
+        return -1;
+
+    NETLINK_MSG_NEST_START(nl_msg, options, TCA_OPTIONS);
+    NETLINK_MSG_PUT(nl_msg, TCA_HTB_INIT, sizeof(glob), &glob);
+    NETLINK_MSG_NEST_END(nl_msg, options);
+    return 0;
+
+ buffer_too_small:
+    virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                   _("allocated netlink buffer is too small"));
+    return -1;
+}
+
+
+/**
+ * virNetDevBandwidthBatchAddClass:
+ * @batch: batch to append the request to
+ * @create: whether to create new class or change an existing one
+ * @parent: parent of the class
+ * @classid: ID of the class
+ * @rate: guaranteed rate in kbps
+ * @ceil: maximum rate in kbps (0 means @rate)
+ * @burst: burst size in kb (0 means default)
+ * @quantum: HTB quantum
+ *
+ * tc class add|change dev $ifname parent $parent classid $classid \
+ *    htb rate $rate ceil $ceil burst $burst quantum $quantum
+ *
+ * Returns 0 on success, -1 otherwise.
+ */
+static int
+virNetDevBandwidthBatchAddClass(virNetDevBandwidthBatchPtr batch,
+                                bool create,
+                                uint32_t parent,
+                                uint32_t classid,
+                                unsigned long long rate,
+                                unsigned long long ceil,
+                                unsigned long long burst,
+                                unsigned long long quantum)
+{
+    const unsigned int mtu = 1600;
+    struct tc_htb_opt opt = { .quantum = quantum };
+    uint32_t rtab[256];
+    uint32_t ctab[256];
+    unsigned int buffer;
+    unsigned int cbuffer;
+    struct nlattr *options = NULL;
+    struct nl_msg *nl_msg;
+
+    if (!rate) {
+        virReportError(VIR_ERR_INTERNAL_ERROR,
+                       _("Invalid zero rate of class %x:%x on interface '%s'"),
+                       TC_H_MAJ(classid) >> 16, TC_H_MIN(classid),
+                       batch->ifname);
+        return -1;
+    }
+
+    rate *= 1000;
+    ceil = ceil ? ceil * 1000 : rate;
+    buffer = burst ? burst * 1024 : rate / virNetDevBandwidthHZ + mtu;
+    cbuffer = ceil / virNetDevBandwidthHZ + mtu;
+
+    virNetDevBandwidthCalcRateTable(&opt.rate, rtab, rate, mtu);
+    opt.buffer = virNetDevBandwidthXmitTime(rate, buffer);
+    virNetDevBandwidthCalcRateTable(&opt.ceil, ctab, ceil, mtu);
+    opt.cbuffer = virNetDevBandwidthXmitTime(ceil, cbuffer);
+
+    if (!(nl_msg = virNetDevBandwidthBatchAdd(batch, RTM_NEWTCLASS,
+                                              create ? NLM_F_CREATE | NLM_F_EXCL : 0,
+                                              parent, classid, 0, "htb", false)))
+        return -1;
+
+    NETLINK_MSG_NEST_START(nl_msg, options, TCA_OPTIONS);
+    NETLINK_MSG_PUT(nl_msg, TCA_HTB_PARMS, sizeof(opt), &opt);
+    NETLINK_MSG_PUT(nl_msg, TCA_HTB_RTAB, sizeof(rtab), rtab);
+    NETLINK_MSG_PUT(nl_msg, TCA_HTB_CTAB, sizeof(ctab), ctab);
+    NETLINK_MSG_NEST_END(nl_msg, options);
+    return 0;
+
+ buffer_too_small:
+    virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                   _("allocated netlink buffer is too small"));
+    return -1;
+}
+
+
+/* tc qdisc add dev $ifname parent $parent handle $handle sfq perturb 10 */
+static int
+virNetDevBandwidthBatchAddSFQ(virNetDevBandwidthBatchPtr batch,
+                              uint32_t parent,
+                              uint32_t handle)
+{
+    struct tc_sfq_qopt_v1 opt = { .v0.perturb_period = 10 };
+    struct nl_msg *nl_msg;
+
+    if (!(nl_msg = virNetDevBandwidthBatchAdd(batch, RTM_NEWQDISC,
+                                              NLM_F_CREATE | NLM_F_EXCL,
+                                              parent, handle, 0, "sfq", false)))
+        return -1;
+
+    NETLINK_MSG_PUT(nl_msg, TCA_OPTIONS, sizeof(opt), &opt);
+    return 0;
+
+ buffer_too_small:
+    virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                   _("allocated netlink buffer is too small"));
+    return -1;
+}
+
+
+/* tc filter add dev $ifname parent 1:0 protocol all prio 1 handle 1 \
+ *    fw flowid 1 */
+static int
+virNetDevBandwidthBatchAddFwFilter(virNetDevBandwidthBatchPtr batch)
+{
+    uint32_t classid = 1;
+    struct nlattr *options = NULL;
+    struct nl_msg *nl_msg;
+
+    if (!(nl_msg = virNetDevBandwidthBatchAdd(batch, RTM_NEWTFILTER,
+                                              NLM_F_CREATE | NLM_F_EXCL,
+                                              TC_H_MAKE(1 << 16, 0), 1,
+                                              TC_H_MAKE(1 << 16, htons(ETH_P_ALL)),
+                                              "fw", false)))
+        return -1;
+
+    NETLINK_MSG_NEST_START(nl_msg, options, TCA_OPTIONS);
+    NETLINK_MSG_PUT(nl_msg, TCA_FW_CLASSID, sizeof(classid), &classid);
+    NETLINK_MSG_NEST_END(nl_msg, options);
+    return 0;
+
+ buffer_too_small:
+    virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                   _("allocated netlink buffer is too small"));
+    return -1;
+}
+
+
+/* tc qdisc add dev $ifname ingress
+ * tc filter add dev $ifname parent ffff: protocol all u32 match u32 0 0 \
+ *    police rate $rate burst $burst mtu 64kb drop flowid :1 */
+static int
+virNetDevBandwidthBatchAddPolice(virNetDevBandwidthBatchPtr batch,
+                                 unsigned long long rate,
+                                 unsigned long long burst)
+{
+    const unsigned int mtu = 65536;
+    struct tc_police police = { .action = TC_POLICE_SHOT, .mtu = mtu };
+    uint32_t rtab[256];
+    uint32_t classid = 1;
+    g_autofree struct tc_u32_sel *sel = NULL;
+    size_t sellen = sizeof(*sel) + sizeof(sel->keys[0]);
+    struct nlattr *options = NULL;
+    struct nlattr *policeopts = NULL;
+    struct nl_msg *nl_msg;
+
+    if (!(nl_msg = virNetDevBandwidthBatchAdd(batch, RTM_NEWQDISC,
+                                              NLM_F_CREATE | NLM_F_EXCL,
+                                              TC_H_INGRESS,
+                                              TC_H_MAKE(TC_H_INGRESS, 0),
+                                              0, "ingress", false)))
+        return -1;
+
+    if (nla_put(nl_msg, TCA_OPTIONS, 0, NULL) < 0)
+        goto buffer_too_small;
+
+    /* The only key matches everything */
+    sel = g_malloc0(sellen);
+    sel->flags = TC_U32_TERMINAL;
+    sel->nkeys = 1;
+
+    rate *= 1000;
+    if (rate) {
+        virNetDevBandwidthCalcRateTable(&police.rate, rtab, rate, mtu);
+        police.burst = virNetDevBandwidthXmitTime(rate, burst * 1024);
+    }
+
+    if (!(nl_msg = virNetDevBandwidthBatchAdd(batch, RTM_NEWTFILTER,
+                                              NLM_F_CREATE | NLM_F_EXCL,
+                                              TC_H_MAKE(TC_H_INGRESS, 0), 0,
+                                              TC_H_MAKE(0, htons(ETH_P_ALL)),
+                                              "u32", false)))
+        return -1;
+
+    NETLINK_MSG_NEST_START(nl_msg, options, TCA_OPTIONS);
+    NETLINK_MSG_NEST_START(nl_msg, policeopts, TCA_U32_POLICE);
+    NETLINK_MSG_PUT(nl_msg, TCA_POLICE_TBF, sizeof(police), &police);
+    if (rate)
+        NETLINK_MSG_PUT(nl_msg, TCA_POLICE_RATE, sizeof(rtab), rtab);
+    NETLINK_MSG_NEST_END(nl_msg, policeopts);
+    NETLINK_MSG_PUT(nl_msg, TCA_U32_CLASSID, sizeof(classid), &classid);
+    NETLINK_MSG_PUT(nl_msg, TCA_U32_SEL, sellen, sel);
+    NETLINK_MSG_NEST_END(nl_msg, options);
+    return 0;
+
+ buffer_too_small:
+    virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                   _("allocated netlink buffer is too small"));
+    return -1;
+}
+
+
+/* The netlink counterpart of virNetDevBandwidthManipulateFilter with
+ * @create_new set. */
+static int
+virNetDevBandwidthBatchAddMacFilter(virNetDevBandwidthBatchPtr batch,
+                                    const virMacAddr *ifmac_ptr,
+                                    unsigned int id,
+                                    uint32_t classid)
+{
+    unsigned char ifmac[VIR_MAC_BUFLEN];
+    g_autofree struct tc_u32_sel *sel = NULL;
+    size_t sellen = sizeof(*sel) + 3 * sizeof(sel->keys[0]);
+    struct nlattr *options = NULL;
+    struct nl_msg *nl_msg;
+    uint32_t handle;
+
+    if (virNetDevBandwidthFilterHandle(id, &handle) < 0) {
+        virReportError(VIR_ERR_INTERNAL_ERROR,
+                       _("Invalid filter ID %u"), id);
+        return -1;
+    }
+
+    virMacAddrGetRaw(ifmac_ptr, ifmac);
+
+    /* match u16 0x0800 0xffff at -2
+     * match u32 $mac[2..5] 0xffffffff at -12
+     * match u16 $mac[0..1] 0xffff at -14 */
+    sel = g_malloc0(sellen);
+    sel->flags = TC_U32_TERMINAL;
+    sel->nkeys = 3;
+    sel->keys[0].val = htonl(0x0800);
+    sel->keys[0].mask = htonl(0xffff);
+    sel->keys[0].off = -4;
+    sel->keys[1].val = htonl((uint32_t)ifmac[2] << 24 | ifmac[3] << 16 |
+                             ifmac[4] << 8 | ifmac[5]);
+    sel->keys[1].mask = 0xffffffff;
+    sel->keys[1].off = -12;
+    sel->keys[2].val = htonl(ifmac[0] << 8 | ifmac[1]);
+    sel->keys[2].mask = htonl(0xffff);
+    sel->keys[2].off = -16;
+
+    if (!(nl_msg = virNetDevBandwidthBatchAdd(batch, RTM_NEWTFILTER,
+                                              NLM_F_CREATE | NLM_F_EXCL,
+                                              0, handle,
+                                              TC_H_MAKE(2 << 16, htons(ETH_P_IP)),
+                                              "u32", false)))
+        return -1;
+
+    NETLINK_MSG_NEST_START(nl_msg, options, TCA_OPTIONS);
+    NETLINK_MSG_PUT(nl_msg, TCA_U32_CLASSID, sizeof(classid), &classid);
+    NETLINK_MSG_PUT(nl_msg, TCA_U32_SEL, sellen, sel);
+    NETLINK_MSG_NEST_END(nl_msg, options);
+    return 0;
+
+ buffer_too_small:
+    virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                   _("allocated netlink buffer is too small"));
+    return -1;
+}
+
+
+/* Removing a stale filter is best effort, just like with tc. */
+static int
+virNetDevBandwidthBatchDelMacFilter(virNetDevBandwidthBatchPtr batch,
+                                    unsigned int id)
+{
+    uint32_t handle;
+
+    if (virNetDevBandwidthFilterHandle(id, &handle) < 0)
+        return 0;
+
+    if (!virNetDevBandwidthBatchAdd(batch, RTM_DELTFILTER, 0, 0, handle,
+                                    TC_H_MAKE(2 << 16, 0), "u32", true))
+        return -1;
+
+    return 0;
+}
+
+
+static int
+virNetDevBandwidthNetlinkSet(const char *ifname,
+                             const virNetDevBandwidthRate *rx,
+                             const virNetDevBandwidthRate *tx,
+                             bool hierarchical_class)
+{
+    virNetDevBandwidthBatch batch;
+    int ret = -1;
+
+    if (virNetDevBandwidthBatchInit(&batch, ifname) < 0 ||
+        virNetDevBandwidthBatchAddClear(&batch) < 0)
+        goto cleanup;
+
+    if (tx && tx->average) {
+        uint32_t classid = TC_H_MAKE(1 << 16, hierarchical_class ? 2 : 1);
+        unsigned long long quantum = virNetDevBandwidthOptimalQuantum(tx);
+
+        if (virNetDevBandwidthBatchAddHTB(&batch,
+                                          hierarchical_class ? 2 : 1) < 0)
+            goto cleanup;
+
+        /* See virNetDevBandwidthSet for the layout */
+        if (hierarchical_class &&
+            virNetDevBandwidthBatchAddClass(&batch, true,
+                                            TC_H_MAKE(1 << 16, 0),
+                                            TC_H_MAKE(1 << 16, 1),
+                                            tx->average,
+                                            tx->peak ? tx->peak : tx->average,
+                                            0, quantum) < 0)
+            goto cleanup;
+
+        if (virNetDevBandwidthBatchAddClass(&batch, true,
+                                            TC_H_MAKE(1 << 16,
+                                                      hierarchical_class ? 1 : 0),
+                                            classid, tx->average, tx->peak,
+                                            tx->burst, quantum) < 0 ||
+            virNetDevBandwidthBatchAddSFQ(&batch, classid,
+                                          TC_H_MAKE(2 << 16, 0)) < 0 ||
+            virNetDevBandwidthBatchAddFwFilter(&batch) < 0)
+            goto cleanup;
+    }
+
+    if (rx &&
+        virNetDevBandwidthBatchAddPolice(&batch, rx->average,
+                                         rx->burst ? rx->burst : rx->average) < 0)
+        goto cleanup;
+
+    ret = virNetDevBandwidthBatchRun(&batch);
+
+ cleanup:
+    virNetDevBandwidthBatchClear(&batch);
+    return ret;
+}
+
+
+static int
+virNetDevBandwidthNetlinkClear(const char *ifname)
+{
+    virNetDevBandwidthBatch batch;
+    int ret = -1;
+
+    /* tc failing on a missing interface is ignored too */
+    if (virNetDevExists(ifname) == 0)
+        return 0;
+
+    if (virNetDevBandwidthBatchInit(&batch, ifname) < 0 ||
+        virNetDevBandwidthBatchAddClear(&batch) < 0)
+        goto cleanup;
+
+    ret = virNetDevBandwidthBatchRun(&batch);
+
+ cleanup:
+    virNetDevBandwidthBatchClear(&batch);
+    return ret;
+}
+
+
+static int
+virNetDevBandwidthNetlinkPlug(const char *brname,
+                              unsigned long long ceil,
+                              const virMacAddr *ifmac_ptr,
+                              const virNetDevBandwidth *bandwidth,
+                              unsigned int id)
+{
+    virNetDevBandwidthBatch batch;
+    uint32_t classid = TC_H_MAKE(1 << 16, id);
+    int ret = -1;
+
+    if (virNetDevBandwidthBatchInit(&batch, brname) < 0 ||
+        virNetDevBandwidthBatchAddClass(&batch, true,
+                                        TC_H_MAKE(1 << 16, 1), classid,
+                                        bandwidth->in->floor, ceil, 0,
+                                        virNetDevBandwidthOptimalQuantum(bandwidth->in)) < 0 ||
+        virNetDevBandwidthBatchAddSFQ(&batch, classid,
+                                      TC_H_MAKE(id << 16, 0)) < 0 ||
+        virNetDevBandwidthBatchAddMacFilter(&batch, ifmac_ptr, id,
+                                            classid) < 0)
+        goto cleanup;
+
+    ret = virNetDevBandwidthBatchRun(&batch);
+
+ cleanup:
+    virNetDevBandwidthBatchClear(&batch);
+    return ret;
+}
+
+
+static int
+virNetDevBandwidthNetlinkUnplug(const char *brname,
+                                unsigned int id)
+{
+    virNetDevBandwidthBatch batch;
+    uint32_t classid = TC_H_MAKE(1 << 16, id);
+    int ret = -1;
+
+    if (virNetDevExists(brname) == 0)
+        return 0;
+
+    /* Don't treat errors as fatal, but try to remove as much as
+     * possible */
+    if (virNetDevBandwidthBatchInit(&batch, brname) < 0 ||
+        !virNetDevBandwidthBatchAdd(&batch, RTM_DELQDISC, 0, classid,
+                                    TC_H_MAKE(id << 16, 0), 0, NULL, true) ||
+        virNetDevBandwidthBatchDelMacFilter(&batch, id) < 0 ||
+        !virNetDevBandwidthBatchAdd(&batch, RTM_DELTCLASS, 0, 0, classid,
+                                    0, NULL, true))
+        goto cleanup;
+
+    ret = virNetDevBandwidthBatchRun(&batch);
+
+ cleanup:
+    virNetDevBandwidthBatchClear(&batch);
+    return ret;
+}
+
+
+static int
+virNetDevBandwidthNetlinkUpdateRate(const char *ifname,
+                                    unsigned int id,
+                                    const virNetDevBandwidth *bandwidth,
+                                    unsigned long long new_rate)
+{
+    virNetDevBandwidthBatch batch;
+    int ret = -1;
+
+    if (virNetDevBandwidthBatchInit(&batch, ifname) < 0 ||
+        virNetDevBandwidthBatchAddClass(&batch, false, 0,
+                                        TC_H_MAKE(1 << 16, id), new_rate,
+                                        bandwidth->in->peak ?
+                                        bandwidth->in->peak :
+                                        bandwidth->in->average, 0,
+                                        virNetDevBandwidthOptimalQuantum(bandwidth->in)) < 0)
+        goto cleanup;
+
+    ret = virNetDevBandwidthBatchRun(&batch);
+
+ cleanup:
+    virNetDevBandwidthBatchClear(&batch);
+    return ret;
+}
+
+
+static int
+virNetDevBandwidthNetlinkUpdateFilter(const char *ifname,
+                                      const virMacAddr *ifmac_ptr,
+                                      unsigned int id)
+{
+    virNetDevBandwidthBatch batch;
+    int ret = -1;
+
+    if (virNetDevBandwidthBatchInit(&batch, ifname) < 0 ||
+        virNetDevBandwidthBatchDelMacFilter(&batch, id) < 0 ||
+        virNetDevBandwidthBatchAddMacFilter(&batch, ifmac_ptr, id,
+                                            TC_H_MAKE(1 << 16, id)) < 0)
+        goto cleanup;
+
+    ret = virNetDevBandwidthBatchRun(&batch);
+
+ cleanup:
+    virNetDevBandwidthBatchClear(&batch);
+    return ret;
+}
+
+#else /* !(defined(__linux__) && defined(HAVE_LIBNL)) */
+
+static const char *unsupported = N_("libnl was not available at build time");
+
+static bool
+virNetDevBandwidthNetlinkCanHandle(const virNetDevBandwidthRate *rate G_GNUC_UNUSED)
+{
+    return false;
+}
+
+
+static int
+virNetDevBandwidthNetlinkSet(const char *ifname G_GNUC_UNUSED,
+                             const virNetDevBandwidthRate *rx G_GNUC_UNUSED,
+                             const virNetDevBandwidthRate *tx G_GNUC_UNUSED,
+                             bool hierarchical_class G_GNUC_UNUSED)
+{
+    virReportError(VIR_ERR_INTERNAL_ERROR, "%s", _(unsupported));
+    return -1;
+}
+
+
+static int
+virNetDevBandwidthNetlinkClear(const char *ifname G_GNUC_UNUSED)
+{
+    virReportError(VIR_ERR_INTERNAL_ERROR, "%s", _(unsupported));
+    return -1;
+}
+
+
+static int
+virNetDevBandwidthNetlinkPlug(const char *brname G_GNUC_UNUSED,
+                              unsigned long long ceil G_GNUC_UNUSED,
+                              const virMacAddr *ifmac_ptr G_GNUC_UNUSED,
+                              const virNetDevBandwidth *bandwidth G_GNUC_UNUSED,
+                              unsigned int id G_GNUC_UNUSED)
+{
+    virReportError(VIR_ERR_INTERNAL_ERROR, "%s", _(unsupported));
+    return -1;
 }
 
+
+static int
+virNetDevBandwidthNetlinkUnplug(const char *brname G_GNUC_UNUSED,
+                                unsigned int id G_GNUC_UNUSED)
+{
+    virReportError(VIR_ERR_INTERNAL_ERROR, "%s", _(unsupported));
+    return -1;
+}
+
+
+static int
+virNetDevBandwidthNetlinkUpdateRate(const char *ifname G_GNUC_UNUSED,
+                                    unsigned int id G_GNUC_UNUSED,
+                                    const virNetDevBandwidth *bandwidth G_GNUC_UNUSED,
+                                    unsigned long long new_rate G_GNUC_UNUSED)
+{
+    virReportError(VIR_ERR_INTERNAL_ERROR, "%s", _(unsupported));
+    return -1;
+}
+
+
+static int
+virNetDevBandwidthNetlinkUpdateFilter(const char *ifname G_GNUC_UNUSED,
+                                      const virMacAddr *ifmac_ptr G_GNUC_UNUSED,
+                                      unsigned int id G_GNUC_UNUSED)
+{
+    virReportError(VIR_ERR_INTERNAL_ERROR, "%s", _(unsupported));
+    return -1;
+}
+
+#endif /* !(defined(__linux__) && defined(HAVE_LIBNL)) */
+
 /**
  * virNetDevBandwidthManipulateFilter:
  * @ifname: interface to operate on
@@ -227,6 +1110,10 @@ virNetDevBandwidthSet(const char *ifname,
         tx = bandwidth->out;
     }
 
+    if (virNetDevBandwidthNetlinkCanHandle(rx) &&
+        virNetDevBandwidthNetlinkCanHandle(tx))
+        return virNetDevBandwidthNetlinkSet(ifname, rx, tx, hierarchical_class);
+
     virNetDevBandwidthClear(ifname);
 
     if (tx && tx->average) {
@@ -411,6 +1298,9 @@ virNetDevBandwidthClear(const char *ifname)
     if (!ifname)
        return 0;
 
+    if (virNetDevBandwidthNetlinkCanHandle(NULL))
+        return virNetDevBandwidthNetlinkClear(ifname);
+
     cmd = virCommandNew(TC);
     virCommandAddArgList(cmd, "qdisc", "del", "dev", ifname, "root", NULL);
 
@@ -568,6 +1458,14 @@ virNetDevBandwidthPlug(const char *brname,
         return -1;
     }
 
+    if (virNetDevBandwidthNetlinkCanHandle(net_bandwidth->in) &&
+        virNetDevBandwidthNetlinkCanHandle(bandwidth->in))
+        return virNetDevBandwidthNetlinkPlug(brname,
+                                             net_bandwidth->in->peak ?
+                                             net_bandwidth->in->peak :
+                                             net_bandwidth->in->average,
+                                             ifmac_ptr, bandwidth, id);
+
     class_id = g_strdup_printf("1:%x", id);
     qdisc_id = g_strdup_printf("%x:", id);
     floor = g_strdup_printf("%llukbps", bandwidth->in->floor);
@@ -632,6 +1530,9 @@ virNetDevBandwidthUnplug(const char *brname,
         return -1;
     }
 
+    if (virNetDevBandwidthNetlinkCanHandle(NULL))
+        return virNetDevBandwidthNetlinkUnplug(brname, id);
+
     class_id = g_strdup_printf("1:%x", id);
     qdisc_id = g_strdup_printf("%x:", id);
 
@@ -691,6 +1592,11 @@ virNetDevBandwidthUpdateRate(const char *ifname,
     char *rate = NULL;
     char *ceil = NULL;
 
+    if (virNetDevBandwidthNetlinkCanHandle(bandwidth->in) &&
+        new_rate <= VIR_NETDEV_BANDWIDTH_NETLINK_MAX_RATE)
+        return virNetDevBandwidthNetlinkUpdateRate(ifname, id,
+                                                   bandwidth, new_rate);
+
     class_id = g_strdup_printf("1:%x", id);
     rate = g_strdup_printf("%llukbps", new_rate);
     ceil = g_strdup_printf("%llukbps", bandwidth->in->peak ?
@@ -741,6 +1647,9 @@ virNetDevBandwidthUpdateFilter(const char *ifname,
     int ret = -1;
     char *class_id = NULL;
 
+    if (virNetDevBandwidthNetlinkCanHandle(NULL))
+        return virNetDevBandwidthNetlinkUpdateFilter(ifname, ifmac_ptr, id);
+
     class_id = g_strdup_printf("1:%x", id);
 
     if (virNetDevBandwidthManipulateFilter(ifname, ifmac_ptr, id,
@@ -29,6 +29,8 @@
 #include "virstring.h"
 #include "virlog.h"
 #include "virjson.h"
+#include "virovsdb.h"
+#include "virthread.h"
 
 #define VIR_FROM_THIS VIR_FROM_NONE
 
@@ -57,6 +59,480 @@ virNetDevOpenvswitchAddTimeout(virCommandPtr cmd)
     virCommandAddArgFormat(cmd, "--timeout=%u", virNetDevOpenvswitchTimeout);
 }
 
+
+/*
+ * Connection to ovsdb-server shared by all callers. Talking to the
+ * database directly saves a fork and exec of ovs-vsctl (and its own
+ * connection setup) for every operation. If the database socket
+ * can't be reached we fall back to running ovs-vsctl.
+ */
+#define VIR_NETDEV_OVS_DB_SOCK LOCALSTATEDIR "/run/openvswitch/db.sock"
+
+static virMutex virNetDevOpenvswitchDBLock = VIR_MUTEX_INITIALIZER;
+static virOVSDBClientPtr virNetDevOpenvswitchDB;
+
+
+/*
+ * Returns a reference to the shared OVSDB client, or NULL (with no error
+ * reported) if the database can't be reached and ovs-vsctl should be
+ * used instead. The client must be released by
+ * virNetDevOpenvswitchDBRelease(). The lock only guards the shared
+ * pointer, the client serializes the communication itself.
+ */
+static virOVSDBClientPtr
+virNetDevOpenvswitchDBAcquire(void)
+{
+#if WITH_YAJL
+    virOVSDBClientPtr client;
+
+    virMutexLock(&virNetDevOpenvswitchDBLock);
+
+    if (!virNetDevOpenvswitchDB &&
+        !(virNetDevOpenvswitchDB = virOVSDBClientNew(VIR_NETDEV_OVS_DB_SOCK,
+                                                     virNetDevOpenvswitchTimeout * 1000))) {
+        VIR_DEBUG("Falling back to %s: %s", OVSVSCTL, virGetLastErrorMessage());
+        virResetLastError();
+        virMutexUnlock(&virNetDevOpenvswitchDBLock);
+        return NULL;
+    }
+
+    client = virObjectRef(virNetDevOpenvswitchDB);
+    virMutexUnlock(&virNetDevOpenvswitchDBLock);
+
+    return client;
+#else /* !WITH_YAJL */
+    /* Without a JSON parser there's no talking to the database */
+    return NULL;
+#endif /* !WITH_YAJL */
+}
+
+
+static void
+virNetDevOpenvswitchDBRelease(virOVSDBClientPtr client)
+{
+    if (!virOVSDBClientIsConnected(client)) {
+        virMutexLock(&virNetDevOpenvswitchDBLock);
+        /* Someone else may have replaced it already */
+        if (virNetDevOpenvswitchDB == client) {
+            virObjectUnref(virNetDevOpenvswitchDB);
+            virNetDevOpenvswitchDB = NULL;
+        }
+        virMutexUnlock(&virNetDevOpenvswitchDBLock);
+    }
+
+    virObjectUnref(client);
+}
+
+
+/* [[@column, @function, @value]] */
+static virJSONValuePtr
+virNetDevOpenvswitchDBWhere(const char *column,
+                            const char *function,
+                            virJSONValuePtr *value)
+{
+    g_autoptr(virJSONValue) where = virJSONValueNewArray();
+    g_autoptr(virJSONValue) clause = NULL;
+
+    if (!(clause = virOVSDBClause(column, function, value)) ||
+        virJSONValueArrayAppend(where, clause) < 0)
+        return NULL;
+    clause = NULL;
+
+    return g_steal_pointer(&where);
+}
+
+
+static virJSONValuePtr
+virNetDevOpenvswitchDBWhereName(const char *name)
+{
+    g_autoptr(virJSONValue) value = virJSONValueNewString(name);
+
+    return virNetDevOpenvswitchDBWhere("name", "==", &value);
+}
+
+
+static virJSONValuePtr
+virNetDevOpenvswitchDBSelect(const char *table,
+                             virJSONValuePtr *where,
+                             const char *column)
+{
+    g_autoptr(virJSONValue) columns = virJSONValueNewArray();
+    virJSONValuePtr ret = NULL;
+
+    if (virJSONValueArrayAppendString(columns, column) < 0)
+        return NULL;
+
+    ignore_value(virJSONValueObjectCreate(&ret,
+                                          "s:op", "select",
+                                          "s:table", table,
+                                          "a:where", where,
+                                          "a:columns", &columns,
+                                          NULL));
+    return ret;
+}
+
+
+/*
+ * Select @column of the first row in @table matching @where. Sets
+ * @value to NULL if there's no such row. Row references are returned
+ * as bare UUIDs.
+ */
+static int
+virNetDevOpenvswitchDBLookup(virOVSDBClientPtr client,
+                             const char *table,
+                             virJSONValuePtr *where,
+                             const char *column,
+                             char **value)
+{
+    g_autoptr(virJSONValue) ops = virJSONValueNewArray();
+    g_autoptr(virJSONValue) op = NULL;
+    g_autoptr(virJSONValue) results = NULL;
+    virJSONValuePtr rows;
+    virJSONValuePtr val;
+
+    *value = NULL;
+
+    if (!(op = virNetDevOpenvswitchDBSelect(table, where, column)) ||
+        virJSONValueArrayAppend(ops, op) < 0)
+        return -1;
+    op = NULL;
+
+    if (virOVSDBClientTransact(client, &ops, &results) < 0)
+        return -1;
+
+    rows = virJSONValueObjectGetArray(virJSONValueArrayGet(results, 0), "rows");
+    if (!(val = virJSONValueObjectGet(virJSONValueArrayGet(rows, 0), column)))
+        return 0;
+
+    /* ["uuid", "..."] */
+    if (virJSONValueIsArray(val))
+        val = virJSONValueArrayGet(val, 1);
+
+    *value = g_strdup(virJSONValueGetString(val));
+    return 0;
+}
+
+
+/*
+ * Look up the UUID of the row in @table named @name. Sets @uuid to
+ * NULL if there's none.
+ */
+static int
+virNetDevOpenvswitchDBFindRow(virOVSDBClientPtr client,
+                              const char *table,
+                              const char *name,
+                              char **uuid)
+{
+    g_autoptr(virJSONValue) where = NULL;
+
+    if (!(where = virNetDevOpenvswitchDBWhereName(name)))
+        return -1;
+
+    return virNetDevOpenvswitchDBLookup(client, table, &where, "_uuid", uuid);
+}
+
+
+/*
+ * Remove the Port row @uuid from whichever bridge has it. Ports
+ * (and their interfaces) are not root rows, so the database deletes
+ * them once no bridge refers to them.
+ */
+static int
+virNetDevOpenvswitchDBDelPort(virJSONValuePtr ops,
+                              const char *uuid)
+{
+    g_autoptr(virJSONValue) elems = virJSONValueNewArray();
+    g_autoptr(virJSONValue) ref = NULL;
+    g_autoptr(virJSONValue) set = NULL;
+    g_autoptr(virJSONValue) mutation = NULL;
+    g_autoptr(virJSONValue) mutations = virJSONValueNewArray();
+    g_autoptr(virJSONValue) where = virJSONValueNewArray();
+    g_autoptr(virJSONValue) op = NULL;
+
+    if (!(ref = virOVSDBValueUUID(uuid)) ||
+        virJSONValueArrayAppend(elems, ref) < 0)
+        return -1;
+    ref = NULL;
+
+    if (!(set = virOVSDBValueSet(&elems)) ||
+        !(mutation = virOVSDBClause("ports", "delete", &set)) ||
+        virJSONValueArrayAppend(mutations, mutation) < 0)
+        return -1;
+    mutation = NULL;
+
+    if (virJSONValueObjectCreate(&op,
+                                 "s:op", "mutate",
+                                 "s:table", "Bridge",
+                                 "a:where", &where,
+                                 "a:mutations", &mutations,
+                                 NULL) < 0 ||
+        virJSONValueArrayAppend(ops, op) < 0)
+        return -1;
+    op = NULL;
+
+    return 0;
+}
+
+
+/*
+ * Set the VLAN related columns of a Port @row according to
+ * @virtVlan, mirroring virNetDevOpenvswitchConstructVlans().
+ */
+static int
+virNetDevOpenvswitchDBVlanColumns(virJSONValuePtr row,
+                                  const virNetDevVlan *virtVlan)
+{
+    long long tag = -1;
+
+    if (!virtVlan || !virtVlan->nTags)
+        return 0;
+
+    switch (virtVlan->nativeMode) {
+    case VIR_NATIVE_VLAN_MODE_TAGGED:
+        if (virJSONValueObjectAppendString(row, "vlan_mode", "native-tagged") < 0)
+            return -1;
+        tag = virtVlan->nativeTag;
+        break;
+    case VIR_NATIVE_VLAN_MODE_UNTAGGED:
+        if (virJSONValueObjectAppendString(row, "vlan_mode", "native-untagged") < 0)
+            return -1;
+        tag = virtVlan->nativeTag;
+        break;
+    case VIR_NATIVE_VLAN_MODE_DEFAULT:
+    default:
+        break;
+    }
+
+    if (virtVlan->trunk) {
+        g_autoptr(virJSONValue) elems = virJSONValueNewArray();
+        g_autoptr(virJSONValue) set = NULL;
+        size_t i;
+
+        for (i = 0; i < virtVlan->nTags; i++) {
+            g_autoptr(virJSONValue) num = virJSONValueNewNumberUint(virtVlan->tag[i]);
+
+            if (virJSONValueArrayAppend(elems, num) < 0)
+                return -1;
+            num = NULL;
+        }
+
+        if (!(set = virOVSDBValueSet(&elems)) ||
+            virJSONValueObjectAppend(row, "trunks", set) < 0)
+            return -1;
+        set = NULL;
+    } else {
+        tag = virtVlan->tag[0];
+    }
+
+    if (tag >= 0 &&
+        virJSONValueObjectAppendNumberLong(row, "tag", tag) < 0)
+        return -1;
+
+    return 0;
+}
+
+
+/*
+ * Append @ops to ask ovs-vswitchd to apply the changes, execute them
+ * and wait until it did. This is what makes the changes visible in
+ * the kernel by the time we return, just like ovs-vsctl does. If
+ * @opsResults is not NULL it's filled with the results of the
+ * transaction, the ones of @ops coming first.
+ */
+static int
+virNetDevOpenvswitchDBCommit(virOVSDBClientPtr client,
+                             virJSONValuePtr *ops,
+                             virJSONValuePtr *opsResults)
+{
+    g_autoptr(virJSONValue) tmp = g_steal_pointer(ops);
+    g_autoptr(virJSONValue) value = virJSONValueNewNumberInt(1);
+    g_autoptr(virJSONValue) mutation = NULL;
+    g_autoptr(virJSONValue) mutations = virJSONValueNewArray();
+    g_autoptr(virJSONValue) where = virJSONValueNewArray();
+    g_autoptr(virJSONValue) op = NULL;
+    g_autoptr(virJSONValue) results = NULL;
+    virJSONValuePtr rows;
+    long long cfg;
+
+    if (!(mutation = virOVSDBClause("next_cfg", "+=", &value)) ||
+        virJSONValueArrayAppend(mutations, mutation) < 0)
+        return -1;
+    mutation = NULL;
+
+    if (virJSONValueObjectCreate(&op,
+                                 "s:op", "mutate",
+                                 "s:table", "Open_vSwitch",
+                                 "a:where", &where,
+                                 "a:mutations", &mutations,
+                                 NULL) < 0 ||
+        virJSONValueArrayAppend(tmp, op) < 0)
+        return -1;
+    op = NULL;
+
+    where = virJSONValueNewArray();
+    if (!(op = virNetDevOpenvswitchDBSelect("Open_vSwitch", &where, "next_cfg")) ||
+        virJSONValueArrayAppend(tmp, op) < 0)
+        return -1;
+    op = NULL;
+
+    if (virOVSDBClientTransact(client, &tmp, &results) < 0)
+        return -1;
+
+    rows = virJSONValueObjectGetArray(virJSONValueArrayGet(results,
+                                                           virJSONValueArraySize(results) - 1),
+                                      "rows");
+    if (virJSONValueObjectGetNumberLong(virJSONValueArrayGet(rows, 0),
+                                        "next_cfg", &cfg) < 0) {
+        virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                       _("Unable to read OVS configuration sequence number"));
+        return -1;
+    }
+
+    if (virOVSDBClientWaitCfg(client, cfg) < 0)
+        return -1;
+
+    if (opsResults)
+        *opsResults = g_steal_pointer(&results);
+
+    return 0;
+}
+
+
+static int
+virNetDevOpenvswitchDBAddPort(virOVSDBClientPtr client,
+                              const char *brname,
+                              const char *ifname,
+                              const char *macaddrstr,
+                              const char *ifuuidstr,
+                              const char *vmuuidstr,
+                              const virNetDevVPortProfile *ovsport,
+                              const virNetDevVlan *virtVlan)
+{
+    const char *ids[][2] = {
+        { "attached-mac", macaddrstr },
+        { "iface-id", ifuuidstr },
+        { "vm-id", vmuuidstr },
+        { "port-profile", ovsport->profileID[0] ? ovsport->profileID : NULL },
+        { "iface-status", "active" },
+    };
+    g_autoptr(virJSONValue) ops = virJSONValueNewArray();
+    g_autoptr(virJSONValue) pairs = virJSONValueNewArray();
+    g_autoptr(virJSONValue) extids = NULL;
+    g_autoptr(virJSONValue) iface = NULL;
+    g_autoptr(virJSONValue) ifaces = NULL;
+    g_autoptr(virJSONValue) port = NULL;
+    g_autoptr(virJSONValue) ports = virJSONValueNewArray();
+    g_autoptr(virJSONValue) ref = NULL;
+    g_autoptr(virJSONValue) set = NULL;
+    g_autoptr(virJSONValue) mutation = NULL;
+    g_autoptr(virJSONValue) mutations = virJSONValueNewArray();
+    g_autoptr(virJSONValue) rows = virJSONValueNewArray();
+    g_autoptr(virJSONValue) bridge = NULL;
+    g_autoptr(virJSONValue) columns = virJSONValueNewArray();
+    g_autoptr(virJSONValue) where = NULL;
+    g_autoptr(virJSONValue) op = NULL;
+    g_autofree char *olduuid = NULL;
+    size_t i;
+
+    if (virNetDevOpenvswitchDBFindRow(client, "Port", ifname, &olduuid) < 0)
+        return -1;
+
+    /* Fail the whole transaction if the bridge doesn't exist */
+    if (virJSONValueObjectCreate(&bridge, "s:name", brname, NULL) < 0 ||
+        virJSONValueArrayAppend(rows, bridge) < 0)
+        return -1;
+    bridge = NULL;
+
+    if (!(where = virNetDevOpenvswitchDBWhereName(brname)) ||
+        virJSONValueArrayAppendString(columns, "name") < 0 ||
+        virJSONValueObjectCreate(&op,
+                                 "s:op", "wait",
+                                 "i:timeout", 0,
+                                 "s:table", "Bridge",
+                                 "a:where", &where,
+                                 "a:columns", &columns,
+                                 "s:until", "==",
+                                 "a:rows", &rows,
+                                 NULL) < 0 ||
+        virJSONValueArrayAppend(ops, op) < 0)
+        return -1;
+    op = NULL;
+
+    if (olduuid && virNetDevOpenvswitchDBDelPort(ops, olduuid) < 0)
+        return -1;
+
+    for (i = 0; i < G_N_ELEMENTS(ids); i++) {
+        g_autoptr(virJSONValue) key = NULL;
+        g_autoptr(virJSONValue) value = NULL;
+        g_autoptr(virJSONValue) pair = NULL;
+
+        if (!ids[i][1])
+            continue;
+
+        key = virJSONValueNewString(ids[i][0]);
+        value = virJSONValueNewString(ids[i][1]);
+        if (!(pair = virOVSDBValuePair(&key, &value)) ||
+            virJSONValueArrayAppend(pairs, pair) < 0)
+            return -1;
+        pair = NULL;
+    }
+
+    if (!(extids = virOVSDBValueMap(&pairs)) ||
+        virJSONValueObjectCreate(&iface,
+                                 "s:name", ifname,
+                                 "a:external_ids", &extids,
+                                 NULL) < 0 ||
+        virJSONValueObjectCreate(&op,
+                                 "s:op", "insert",
+                                 "s:table", "Interface",
+                                 "s:uuid-name", "iface",
+                                 "a:row", &iface,
+                                 NULL) < 0 ||
+        virJSONValueArrayAppend(ops, op) < 0)
+        return -1;
+    op = NULL;
+
+    if (!(ifaces = virOVSDBValueNamedUUID("iface")) ||
+        virJSONValueObjectCreate(&port,
+                                 "s:name", ifname,
+                                 "a:interfaces", &ifaces,
+                                 NULL) < 0 ||
+        virNetDevOpenvswitchDBVlanColumns(port, virtVlan) < 0 ||
+        virJSONValueObjectCreate(&op,
+                                 "s:op", "insert",
+                                 "s:table", "Port",
+                                 "s:uuid-name", "port",
+                                 "a:row", &port,
+                                 NULL) < 0 ||
+        virJSONValueArrayAppend(ops, op) < 0)
+        return -1;
+    op = NULL;
+
+    if (!(ref = virOVSDBValueNamedUUID("port")) ||
+        virJSONValueArrayAppend(ports, ref) < 0)
+        return -1;
+    ref = NULL;
+
+    if (!(set = virOVSDBValueSet(&ports)) ||
+        !(mutation = virOVSDBClause("ports", "insert", &set)) ||
+        virJSONValueArrayAppend(mutations, mutation) < 0)
+        return -1;
+    mutation = NULL;
+
+    if (!(where = virNetDevOpenvswitchDBWhereName(brname)) ||
+        virJSONValueObjectCreate(&op,
+                                 "s:op", "mutate",
+                                 "s:table", "Bridge",
+                                 "a:where", &where,
+                                 "a:mutations", &mutations,
+                                 NULL) < 0 ||
+        virJSONValueArrayAppend(ops, op) < 0)
+        return -1;
+    op = NULL;
+
+    return virNetDevOpenvswitchDBCommit(client, &ops, NULL);
+}
+
 /**
  * virNetDevOpenvswitchConstructVlans:
  * @cmd: command to construct
@@ -138,6 +614,7 @@ int virNetDevOpenvswitchAddPort(const char *brname, const char *ifname,
     char macaddrstr[VIR_MAC_STRING_BUFLEN];
     char ifuuidstr[VIR_UUID_STRING_BUFLEN];
     char vmuuidstr[VIR_UUID_STRING_BUFLEN];
+    virOVSDBClientPtr client;
     g_autoptr(virCommand) cmd = NULL;
     g_autofree char *attachedmac_ex_id = NULL;
     g_autofree char *ifaceid_ex_id = NULL;
@@ -157,6 +634,21 @@ int virNetDevOpenvswitchAddPort(const char *brname, const char *ifname,
                                         ovsport->profileID);
     }
 
+    if ((client = virNetDevOpenvswitchDBAcquire())) {
+        int rc = virNetDevOpenvswitchDBAddPort(client, brname, ifname,
+                                               macaddrstr, ifuuidstr, vmuuidstr,
+                                               ovsport, virtVlan);
+
+        virNetDevOpenvswitchDBRelease(client);
+        if (rc < 0) {
+            virReportError(VIR_ERR_INTERNAL_ERROR,
+                           _("Unable to add port %s to OVS bridge %s"),
+                           ifname, brname);
+            return -1;
+        }
+        return 0;
+    }
+
     cmd = virCommandNew(OVSVSCTL);
     virNetDevOpenvswitchAddTimeout(cmd);
     virCommandAddArgList(cmd, "--", "--if-exists", "del-port",
@@ -194,6 +686,26 @@ int virNetDevOpenvswitchAddPort(const char *brname, const char *ifname,
     return 0;
 }
 
+static int
+virNetDevOpenvswitchDBRemovePort(virOVSDBClientPtr client,
+                                 const char *ifname)
+{
+    g_autoptr(virJSONValue) ops = virJSONValueNewArray();
+    g_autofree char *uuid = NULL;
+
+    if (virNetDevOpenvswitchDBFindRow(client, "Port", ifname, &uuid) < 0)
+        return -1;
+
+    if (!uuid)
+        return 0;
+
+    if (virNetDevOpenvswitchDBDelPort(ops, uuid) < 0)
+        return -1;
+
+    return virNetDevOpenvswitchDBCommit(client, &ops, NULL);
+}
+
+
 /**
  * virNetDevOpenvswitchRemovePort:
  * @ifname: the network interface name
@@ -204,8 +716,21 @@ int virNetDevOpenvswitchAddPort(const char *brname, const char *ifname,
  */
 int virNetDevOpenvswitchRemovePort(const char *brname G_GNUC_UNUSED, const char *ifname)
 {
+    virOVSDBClientPtr client;
     g_autoptr(virCommand) cmd = NULL;
 
+    if ((client = virNetDevOpenvswitchDBAcquire())) {
+        int rc = virNetDevOpenvswitchDBRemovePort(client, ifname);
+
+        virNetDevOpenvswitchDBRelease(client);
+        if (rc < 0) {
+            virReportError(VIR_ERR_INTERNAL_ERROR,
+                           _("Unable to delete port %s from OVS"), ifname);
+            return -1;
+        }
+        return 0;
+    }
+
     cmd = virCommandNew(OVSVSCTL);
     virNetDevOpenvswitchAddTimeout(cmd);
     virCommandAddArgList(cmd, "--", "--if-exists", "del-port", ifname, NULL);
@@ -291,33 +816,24 @@ int virNetDevOpenvswitchSetMigrateData(char *migrate, const char *ifname)
 }
 
 
-/**
- * virNetDevOpenvswitchInterfaceParseStats:
- * @json: Input string in JSON format
- * @stats: parsed stats
- *
- * For given input string @json parse interface statistics and store them into
- * @stats.
- *
- * Returns: 0 on success,
- *         -1 otherwise (with error reported).
+/*
+ * Parse the statistics column of the Interface table, which is an
+ * OVSDB map, e.g. ["map",[["rx_bytes",0],["tx_bytes",12406],...]]
  */
-int
-virNetDevOpenvswitchInterfaceParseStats(const char *json,
-                                        virDomainInterfaceStatsPtr stats)
+static int
+virNetDevOpenvswitchInterfaceParseStatsJSON(virJSONValuePtr jsonStats,
+                                            virDomainInterfaceStatsPtr stats)
 {
-    g_autoptr(virJSONValue) jsonStats = NULL;
     virJSONValuePtr jsonMap = NULL;
     size_t i;
 
     stats->rx_bytes = stats->rx_packets = stats->rx_errs = stats->rx_drop = -1;
     stats->tx_bytes = stats->tx_packets = stats->tx_errs = stats->tx_drop = -1;
 
-    if (!(jsonStats = virJSONValueFromString(json)) ||
-        !virJSONValueIsArray(jsonStats) ||
+    if (!virJSONValueIsArray(jsonStats) ||
         !(jsonMap = virJSONValueArrayGet(jsonStats, 1))) {
         virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
-                       _("Unable to parse ovs-vsctl output"));
+                       _("Unable to parse OVS interface statistics"));
         return -1;
     }
 
@@ -334,7 +850,7 @@ virNetDevOpenvswitchInterfaceParseStats(const char *json,
             (!(key = virJSONValueGetString(jsonKey))) ||
             (virJSONValueGetNumberLong(jsonVal, &val) < 0)) {
             virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
-                           _("Malformed ovs-vsctl output"));
+                           _("Malformed OVS interface statistics"));
             return -1;
         }
 
@@ -357,13 +873,61 @@ virNetDevOpenvswitchInterfaceParseStats(const char *json,
         } else if (STREQ(key, "tx_dropped")) {
             stats->rx_drop = val;
         } else {
-            VIR_DEBUG("Unused ovs-vsctl stat key=%s val=%lld", key, val);
+            VIR_DEBUG("Unused OVS stat key=%s val=%lld", key, val);
         }
     }
 
     return 0;
 }
 
+
+/**
+ * virNetDevOpenvswitchInterfaceParseStats:
+ * @json: Input string in JSON format
+ * @stats: parsed stats
+ *
+ * For given input string @json parse interface statistics and store them into
+ * @stats.
+ *
+ * Returns: 0 on success,
+ *         -1 otherwise (with error reported).
+ */
+int
+virNetDevOpenvswitchInterfaceParseStats(const char *json,
+                                        virDomainInterfaceStatsPtr stats)
+{
+    g_autoptr(virJSONValue) jsonStats = NULL;
+
+    if (!(jsonStats = virJSONValueFromString(json))) {
+        virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                       _("Unable to parse OVS interface statistics"));
+        return -1;
+    }
+
+    return virNetDevOpenvswitchInterfaceParseStatsJSON(jsonStats, stats);
+}
+
+
+static int
+virNetDevOpenvswitchInterfaceStatsCheck(virDomainInterfaceStatsPtr stats)
+{
+    if (stats->rx_bytes == -1 &&
+        stats->rx_packets == -1 &&
+        stats->rx_errs == -1 &&
+        stats->rx_drop == -1 &&
+        stats->tx_bytes == -1 &&
+        stats->tx_packets == -1 &&
+        stats->tx_errs == -1 &&
+        stats->tx_drop == -1) {
+        virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                       _("Interface doesn't have any statistics"));
+        return -1;
+    }
+
+    return 0;
+}
+
+
 /**
  * virNetDevOpenvswitchInterfaceStats:
  * @ifname: the name of the interface
@@ -377,8 +941,30 @@ int
 virNetDevOpenvswitchInterfaceStats(const char *ifname,
                                    virDomainInterfaceStatsPtr stats)
 {
+    virOVSDBClientPtr client;
     g_autoptr(virCommand) cmd = NULL;
     g_autofree char *output = NULL;
+    g_autoptr(virJSONValue) jsonStats = NULL;
+
+    if ((client = virNetDevOpenvswitchDBAcquire())) {
+        /* Served from the monitored copy of the Interface table */
+        int rc = virOVSDBClientGetInterfaceStats(client, ifname, &jsonStats);
+
+        virNetDevOpenvswitchDBRelease(client);
+        if (rc < 0)
+            return -1;
+
+        if (!jsonStats) {
+            virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                           _("Interface not found"));
+            return -1;
+        }
+
+        if (virNetDevOpenvswitchInterfaceParseStatsJSON(jsonStats, stats) < 0)
+            return -1;
+
+        return virNetDevOpenvswitchInterfaceStatsCheck(stats);
+    }
 
     cmd = virCommandNew(OVSVSCTL);
     virNetDevOpenvswitchAddTimeout(cmd);
@@ -406,20 +992,38 @@ virNetDevOpenvswitchInterfaceStats(const char *ifname,
     if (virNetDevOpenvswitchInterfaceParseStats(output, stats) < 0)
         return -1;
 
-    if (stats->rx_bytes == -1 &&
-        stats->rx_packets == -1 &&
-        stats->rx_errs == -1 &&
-        stats->rx_drop == -1 &&
-        stats->tx_bytes == -1 &&
-        stats->tx_packets == -1 &&
-        stats->tx_errs == -1 &&
-        stats->tx_drop == -1) {
-        virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
-                       _("Interface doesn't have any statistics"));
+    return virNetDevOpenvswitchInterfaceStatsCheck(stats);
+}
+
+
+/* Interface -> Port -> Bridge, like ovs-vsctl iface-to-br */
+static int
+virNetDevOpenvswitchDBGetMaster(virOVSDBClientPtr client,
+                                const char *ifname,
+                                char **master)
+{
+    g_autofree char *ifuuid = NULL;
+    g_autofree char *portuuid = NULL;
+    g_autoptr(virJSONValue) ref = NULL;
+    g_autoptr(virJSONValue) where = NULL;
+
+    if (virNetDevOpenvswitchDBFindRow(client, "Interface", ifname, &ifuuid) < 0)
         return -1;
-    }
+    if (!ifuuid)
+        return 0;
 
-    return 0;
+    if (!(ref = virOVSDBValueUUID(ifuuid)) ||
+        !(where = virNetDevOpenvswitchDBWhere("interfaces", "includes", &ref)) ||
+        virNetDevOpenvswitchDBLookup(client, "Port", &where, "_uuid", &portuuid) < 0)
+        return -1;
+    if (!portuuid)
+        return 0;
+
+    if (!(ref = virOVSDBValueUUID(portuuid)) ||
+        !(where = virNetDevOpenvswitchDBWhere("ports", "includes", &ref)))
+        return -1;
+
+    return virNetDevOpenvswitchDBLookup(client, "Bridge", &where, "name", master);
 }
 
 
@@ -441,11 +1045,23 @@ virNetDevOpenvswitchInterfaceStats(const char *ifname,
 int
 virNetDevOpenvswitchInterfaceGetMaster(const char *ifname, char **master)
 {
+    virOVSDBClientPtr client;
     virCommandPtr cmd = NULL;
     int exitstatus;
 
     *master = NULL;
 
+    if ((client = virNetDevOpenvswitchDBAcquire())) {
+        int rc = virNetDevOpenvswitchDBGetMaster(client, ifname, master);
+
+        virNetDevOpenvswitchDBRelease(client);
+        if (rc < 0)
+            return -1;
+
+        VIR_DEBUG("OVS master for %s is %s", ifname, *master ? *master : "(none)");
+        return 0;
+    }
+
     cmd = virCommandNew(OVSVSCTL);
     virNetDevOpenvswitchAddTimeout(cmd);
     virCommandAddArgList(cmd, "iface-to-br", ifname, NULL);
@@ -495,6 +1111,7 @@ virNetDevOpenvswitchGetVhostuserIfname(const char *path,
     size_t ntokens = 0;
     int status;
     int ret = -1;
+    virOVSDBClientPtr client;
     g_autoptr(virCommand) cmd = NULL;
 
     /* Openvswitch vhostuser path are hardcoded to
@@ -510,6 +1127,24 @@ virNetDevOpenvswitchGetVhostuserIfname(const char *path,
     }
 
     tmpIfname++;
+
+    if ((client = virNetDevOpenvswitchDBAcquire())) {
+        g_autofree char *uuid = NULL;
+        int rc = virNetDevOpenvswitchDBFindRow(client, "Interface",
+                                               tmpIfname, &uuid);
+
+        virNetDevOpenvswitchDBRelease(client);
+        if (rc < 0 || !uuid) {
+            /* it's not a openvswitch vhostuser interface. */
+            ret = 0;
+            goto cleanup;
+        }
+
+        *ifname = g_strdup(tmpIfname);
+        ret = 1;
+        goto cleanup;
+    }
+
     cmd = virCommandNew(OVSVSCTL);
     virNetDevOpenvswitchAddTimeout(cmd);
     virCommandAddArgList(cmd, "get", "Interface", tmpIfname, "name", NULL);
@@ -528,6 +1163,65 @@ virNetDevOpenvswitchGetVhostuserIfname(const char *path,
     return ret;
 }
 
+static int
+virNetDevOpenvswitchDBUpdateVlan(virOVSDBClientPtr client,
+                                 const char *ifname,
+                                 const virNetDevVlan *virtVlan)
+{
+    const char *columns[] = { "tag", "trunks", "vlan_mode" };
+    g_autoptr(virJSONValue) ops = virJSONValueNewArray();
+    g_autoptr(virJSONValue) row = virJSONValueNewObject();
+    g_autoptr(virJSONValue) where = NULL;
+    g_autoptr(virJSONValue) op = NULL;
+    g_autoptr(virJSONValue) results = NULL;
+    unsigned int count;
+    size_t i;
+
+    if (virNetDevOpenvswitchDBVlanColumns(row, virtVlan) < 0)
+        return -1;
+
+    /* Clear whatever is not set */
+    for (i = 0; i < G_N_ELEMENTS(columns); i++) {
+        g_autoptr(virJSONValue) elems = NULL;
+        g_autoptr(virJSONValue) set = NULL;
+
+        if (virJSONValueObjectHasKey(row, columns[i]) == 1)
+            continue;
+
+        elems = virJSONValueNewArray();
+        if (!(set = virOVSDBValueSet(&elems)) ||
+            virJSONValueObjectAppend(row, columns[i], set) < 0)
+            return -1;
+        set = NULL;
+    }
+
+    if (!(where = virNetDevOpenvswitchDBWhereName(ifname)) ||
+        virJSONValueObjectCreate(&op,
+                                 "s:op", "update",
+                                 "s:table", "Port",
+                                 "a:where", &where,
+                                 "a:row", &row,
+                                 NULL) < 0 ||
+        virJSONValueArrayAppend(ops, op) < 0)
+        return -1;
+    op = NULL;
+
+    if (virNetDevOpenvswitchDBCommit(client, &ops, &results) < 0)
+        return -1;
+
+    /* An update matching no row is not an error for OVSDB */
+    if (virJSONValueObjectGetNumberUint(virJSONValueArrayGet(results, 0),
+                                        "count", &count) < 0 ||
+        count == 0) {
+        virReportError(VIR_ERR_INTERNAL_ERROR,
+                       _("OVS port %s not found"), ifname);
+        return -1;
+    }
+
+    return 0;
+}
+
+
 /**
  * virNetDevOpenvswitchUpdateVlan:
  * @ifname: the network interface name
@@ -540,8 +1234,22 @@ virNetDevOpenvswitchGetVhostuserIfname(const char *path,
 int virNetDevOpenvswitchUpdateVlan(const char *ifname,
                                    const virNetDevVlan *virtVlan)
 {
+    virOVSDBClientPtr client;
     g_autoptr(virCommand) cmd = NULL;
 
+    if ((client = virNetDevOpenvswitchDBAcquire())) {
+        int rc = virNetDevOpenvswitchDBUpdateVlan(client, ifname, virtVlan);
+
+        virNetDevOpenvswitchDBRelease(client);
+        if (rc < 0) {
+            virReportError(VIR_ERR_INTERNAL_ERROR,
+                           _("Unable to set vlan configuration on port %s"),
+                           ifname);
+            return -1;
+        }
+        return 0;
+    }
+
     cmd = virCommandNew(OVSVSCTL);
     virNetDevOpenvswitchAddTimeout(cmd);
     virCommandAddArgList(cmd,
@@ -29,6 +29,8 @@
 #include "viralloc.h"
 #include "virlog.h"
 #include "virstring.h"
+#include "virhash.h"
+#include "virnetlink.h"
 #include "datatypes.h"
 
 #include <unistd.h>
@@ -733,37 +735,223 @@ int virNetDevTapCreateInBridgePort(const char *brname,
 
 /*-------------------- interface stats --------------------*/
 
+struct _virNetDevTapStatsTable {
+    virHashTablePtr links; /* ifname -> virDomainInterfaceStatsStruct */
+};
+
+
+static void
+virNetDevTapInterfaceStatsCopy(virDomainInterfaceStatsPtr dst,
+                               const virDomainInterfaceStatsStruct *src,
+                               bool swapped)
+{
+    if (swapped) {
+        dst->rx_bytes = src->tx_bytes;
+        dst->rx_packets = src->tx_packets;
+        dst->rx_errs = src->tx_errs;
+        dst->rx_drop = src->tx_drop;
+        dst->tx_bytes = src->rx_bytes;
+        dst->tx_packets = src->rx_packets;
+        dst->tx_errs = src->rx_errs;
+        dst->tx_drop = src->rx_drop;
+    } else {
+        dst->rx_bytes = src->rx_bytes;
+        dst->rx_packets = src->rx_packets;
+        dst->rx_errs = src->rx_errs;
+        dst->rx_drop = src->rx_drop;
+        dst->tx_bytes = src->tx_bytes;
+        dst->tx_packets = src->tx_packets;
+        dst->tx_errs = src->tx_errs;
+        dst->tx_drop = src->tx_drop;
+    }
+}
+
+
+#if defined(__linux__) && defined(HAVE_LIBNL)
+/* Fill @stats from IFLA_STATS64 (or IFLA_STATS on old kernels) of a
+ * RTM_NEWLINK message. The drop counters are computed the same way
+ * /proc/net/dev does it. Returns 0 on success, -1 if there are no
+ * stats in the message. */
+static int
+virNetDevTapInterfaceStatsParse(struct nlattr **tb,
+                                virDomainInterfaceStatsPtr stats)
+{
+    if (tb[IFLA_STATS64] &&
+        nla_len(tb[IFLA_STATS64]) >= (int) sizeof(struct rtnl_link_stats64)) {
+        struct rtnl_link_stats64 s;
+
+        /* The attribute payload is only 4 byte aligned */
+        memcpy(&s, nla_data(tb[IFLA_STATS64]), sizeof(s));
+
+        stats->rx_bytes = s.rx_bytes;
+        stats->rx_packets = s.rx_packets;
+        stats->rx_errs = s.rx_errors;
+        stats->rx_drop = s.rx_dropped + s.rx_missed_errors;
+        stats->tx_bytes = s.tx_bytes;
+        stats->tx_packets = s.tx_packets;
+        stats->tx_errs = s.tx_errors;
+        stats->tx_drop = s.tx_dropped;
+        return 0;
+    }
+
+    if (tb[IFLA_STATS] &&
+        nla_len(tb[IFLA_STATS]) >= (int) sizeof(struct rtnl_link_stats)) {
+        struct rtnl_link_stats s;
+
+        memcpy(&s, nla_data(tb[IFLA_STATS]), sizeof(s));
+
+        stats->rx_bytes = s.rx_bytes;
+        stats->rx_packets = s.rx_packets;
+        stats->rx_errs = s.rx_errors;
+        stats->rx_drop = s.rx_dropped + s.rx_missed_errors;
+        stats->tx_bytes = s.tx_bytes;
+        stats->tx_packets = s.tx_packets;
+        stats->tx_errs = s.tx_errors;
+        stats->tx_drop = s.tx_dropped;
+        return 0;
+    }
+
+    return -1;
+}
+
+
+static int
+virNetDevTapInterfaceStatsNetlink(const char *ifname,
+                                  virDomainInterfaceStatsPtr stats)
+{
+    struct nlattr *tb[IFLA_MAX + 1] = { NULL, };
+    g_autofree void *nlData = NULL;
+
+    if (virNetlinkDumpLink(ifname, -1, &nlData, tb, 0, 0) < 0)
+        return -1;
+
+    if (virNetDevTapInterfaceStatsParse(tb, stats) < 0) {
+        virReportError(VIR_ERR_INTERNAL_ERROR,
+                       _("no statistics reported for interface %s"), ifname);
+        return -1;
+    }
+
+    return 0;
+}
+
+
+static int
+virNetDevTapStatsTableFill(struct nlmsghdr *resp,
+                           void *opaque)
+{
+    virHashTablePtr links = opaque;
+    struct nlattr *tb[IFLA_MAX + 1] = { NULL, };
+    g_autofree virDomainInterfaceStatsPtr stats = NULL;
+
+    if (resp->nlmsg_type != RTM_NEWLINK)
+        return 0;
+
+    if (nlmsg_parse(resp, sizeof(struct ifinfomsg), tb, IFLA_MAX, NULL) < 0 ||
+        !tb[IFLA_IFNAME])
+        return 0;
+
+    stats = g_new0(virDomainInterfaceStatsStruct, 1);
+
+    if (virNetDevTapInterfaceStatsParse(tb, stats) < 0)
+        return 0;
+
+    if (virHashUpdateEntry(links, nla_get_string(tb[IFLA_IFNAME]), stats) < 0)
+        return -1;
+
+    stats = NULL;
+    return 0;
+}
+#endif /* defined(__linux__) && defined(HAVE_LIBNL) */
+
+
 /**
- * virNetDevTapInterfaceStats:
+ * virNetDevTapStatsTableNew:
+ *
+ * Fetch RX/TX statistics of all network interfaces of the host
+ * with a single netlink dump. This is meant for callers that need
+ * statistics of many interfaces at once (e.g. bulk domain stats),
+ * which would otherwise query the kernel once per interface. Look
+ * interfaces up with virNetDevTapStatsTableLookup.
+ *
+ * Returns the table on success, NULL otherwise (with error reported).
+ */
+virNetDevTapStatsTablePtr
+virNetDevTapStatsTableNew(void)
+{
+#if defined(__linux__) && defined(HAVE_LIBNL)
+    g_autoptr(virNetDevTapStatsTable) table = g_new0(virNetDevTapStatsTable, 1);
+
+    if (!(table->links = virHashCreate(64, virHashValueFree)))
+        return NULL;
+
+    if (virNetlinkDumpLinks(virNetDevTapStatsTableFill, table->links) < 0)
+        return NULL;
+
+    VIR_DEBUG("Fetched statistics of %zd interfaces",
+              virHashSize(table->links));
+
+    return g_steal_pointer(&table);
+#else /* !(defined(__linux__) && defined(HAVE_LIBNL)) */
+    virReportSystemError(ENOSYS, "%s",
+                         _("Unable to dump interface statistics on this platform"));
+    return NULL;
+#endif /* !(defined(__linux__) && defined(HAVE_LIBNL)) */
+}
+
+
+void
+virNetDevTapStatsTableFree(virNetDevTapStatsTablePtr table)
+{
+    if (!table)
+        return;
+
+    virHashFree(table->links);
+    g_free(table);
+}
+
+
+/**
+ * virNetDevTapStatsTableLookup:
+ * @table: interface statistics (may be NULL)
  * @ifname: interface
  * @stats: where to store statistics
  * @swapped: whether to swap RX/TX fields
  *
- * Fetch RX/TX statistics for given named interface (@ifname) and
- * store them at @stats. The returned statistics are always from
- * domain POV. Because in some cases this means swapping RX/TX in
- * the stats and in others this means no swapping (consider TAP
- * vs macvtap) caller might choose if the returned stats should
- * be @swapped or not.
+ * Like virNetDevTapInterfaceStats, but look @ifname up in @table
+ * first. If there is no @table or @ifname is not in it (e.g.
+ * because it was created after @table was fetched) the kernel is
+ * queried directly.
  *
  * Returns 0 on success, -1 otherwise (with error reported).
  */
-#ifdef __linux__
 int
-virNetDevTapInterfaceStats(const char *ifname,
-                           virDomainInterfaceStatsPtr stats,
-                           bool swapped)
+virNetDevTapStatsTableLookup(virNetDevTapStatsTablePtr table,
+                             const char *ifname,
+                             virDomainInterfaceStatsPtr stats,
+                             bool swapped)
+{
+    virDomainInterfaceStatsPtr found = NULL;
+
+    if (table && ifname)
+        found = virHashLookup(table->links, ifname);
+
+    if (!found)
+        return virNetDevTapInterfaceStats(ifname, stats, swapped);
+
+    virNetDevTapInterfaceStatsCopy(stats, found, swapped);
+    return 0;
+}
+
+
+#ifdef __linux__
+static int
+virNetDevTapInterfaceStatsProc(const char *ifname,
+                               virDomainInterfaceStatsPtr stats)
 {
     int ifname_len;
     FILE *fp;
     char line[256], *colon;
 
-    if (!ifname) {
-        virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
-                       _("Interface name not provided"));
-        return -1;
-    }
-
     fp = fopen("/proc/net/dev", "r");
     if (!fp) {
         virReportSystemError(errno, "%s",
@@ -775,14 +963,6 @@ virNetDevTapInterfaceStats(const char *ifname,
 
     while (fgets(line, sizeof(line), fp)) {
         long long dummy;
-        long long rx_bytes;
-        long long rx_packets;
-        long long rx_errs;
-        long long rx_drop;
-        long long tx_bytes;
-        long long tx_packets;
-        long long tx_errs;
-        long long tx_drop;
 
         /* The line looks like:
          *   "   eth0:..."
@@ -795,32 +975,14 @@ virNetDevTapInterfaceStats(const char *ifname,
             STREQ(colon-ifname_len, ifname)) {
             if (sscanf(colon+1,
                        "%lld %lld %lld %lld %lld %lld %lld %lld %lld %lld %lld %lld %lld %lld %lld %lld",
-                       &rx_bytes, &rx_packets, &rx_errs, &rx_drop,
+                       &stats->rx_bytes, &stats->rx_packets,
+                       &stats->rx_errs, &stats->rx_drop,
                        &dummy, &dummy, &dummy, &dummy,
-                       &tx_bytes, &tx_packets, &tx_errs, &tx_drop,
+                       &stats->tx_bytes, &stats->tx_packets,
+                       &stats->tx_errs, &stats->tx_drop,
                        &dummy, &dummy, &dummy, &dummy) != 16)
                 continue;
 
-            if (swapped) {
-                stats->rx_bytes = tx_bytes;
-                stats->rx_packets = tx_packets;
-                stats->rx_errs = tx_errs;
-                stats->rx_drop = tx_drop;
-                stats->tx_bytes = rx_bytes;
-                stats->tx_packets = rx_packets;
-                stats->tx_errs = rx_errs;
-                stats->tx_drop = rx_drop;
-            } else {
-                stats->rx_bytes = rx_bytes;
-                stats->rx_packets = rx_packets;
-                stats->rx_errs = rx_errs;
-                stats->rx_drop = rx_drop;
-                stats->tx_bytes = tx_bytes;
-                stats->tx_packets = tx_packets;
-                stats->tx_errs = tx_errs;
-                stats->tx_drop = tx_drop;
-            }
-
             VIR_FORCE_FCLOSE(fp);
             return 0;
         }
@@ -831,6 +993,56 @@ virNetDevTapInterfaceStats(const char *ifname,
                    _("/proc/net/dev: Interface not found"));
     return -1;
 }
+#endif /* __linux__ */
+
+
+/**
+ * virNetDevTapInterfaceStats:
+ * @ifname: interface
+ * @stats: where to store statistics
+ * @swapped: whether to swap RX/TX fields
+ *
+ * Fetch RX/TX statistics for given named interface (@ifname) and
+ * store them at @stats. The returned statistics are always from
+ * domain POV. Because in some cases this means swapping RX/TX in
+ * the stats and in others this means no swapping (consider TAP
+ * vs macvtap) caller might choose if the returned stats should
+ * be @swapped or not.
+ *
+ * On Linux the interface is looked up via netlink, falling back to
+ * parsing /proc/net/dev.
+ *
+ * Returns 0 on success, -1 otherwise (with error reported).
+ */
+#ifdef __linux__
+int
+virNetDevTapInterfaceStats(const char *ifname,
+                           virDomainInterfaceStatsPtr stats,
+                           bool swapped)
+{
+    virDomainInterfaceStatsStruct tmp = { 0 };
+
+    if (!ifname) {
+        virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                       _("Interface name not provided"));
+        return -1;
+    }
+
+# ifdef HAVE_LIBNL
+    if (virNetDevTapInterfaceStatsNetlink(ifname, &tmp) < 0) {
+        VIR_DEBUG("Falling back to /proc/net/dev for interface %s", ifname);
+        virResetLastError();
+        if (virNetDevTapInterfaceStatsProc(ifname, &tmp) < 0)
+            return -1;
+    }
+# else /* !HAVE_LIBNL */
+    if (virNetDevTapInterfaceStatsProc(ifname, &tmp) < 0)
+        return -1;
+# endif /* !HAVE_LIBNL */
+
+    virNetDevTapInterfaceStatsCopy(stats, &tmp, swapped);
+    return 0;
+}
 #elif defined(HAVE_GETIFADDRS) && defined(AF_LINK)
 int
 virNetDevTapInterfaceStats(const char *ifname,
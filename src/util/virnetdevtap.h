@@ -105,3 +105,16 @@ int virNetDevTapInterfaceStats(const char *ifname,
                                virDomainInterfaceStatsPtr stats,
                                bool swapped)
     G_GNUC_WARN_UNUSED_RESULT;
+
+typedef struct _virNetDevTapStatsTable virNetDevTapStatsTable;
+typedef virNetDevTapStatsTable *virNetDevTapStatsTablePtr;
+
+virNetDevTapStatsTablePtr virNetDevTapStatsTableNew(void);
+void virNetDevTapStatsTableFree(virNetDevTapStatsTablePtr table);
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(virNetDevTapStatsTable, virNetDevTapStatsTableFree);
+
+int virNetDevTapStatsTableLookup(virNetDevTapStatsTablePtr table,
+                                 const char *ifname,
+                                 virDomainInterfaceStatsPtr stats,
+                                 bool swapped)
+    G_GNUC_WARN_UNUSED_RESULT;
@@ -34,6 +34,9 @@
 #include "viralloc.h"
 #include "virsocket.h"
 
+#define LIBVIRT_VIRNETLINKPRIV_H_ALLOW
+#include "virnetlinkpriv.h"
+
 #define VIR_FROM_THIS VIR_FROM_NET
 
 VIR_LOG_INIT("util.netlink");
@@ -54,7 +57,6 @@ struct virNetlinkEventHandle {
 # define virNetlinkAlloc nl_socket_alloc
 # define virNetlinkSetBufferSize nl_socket_set_buffer_size
 # define virNetlinkFree nl_socket_free
-typedef struct nl_sock virNetlinkHandle;
 
 G_DEFINE_AUTOPTR_CLEANUP_FUNC(virNetlinkHandle, virNetlinkFree);
 
@@ -90,6 +92,17 @@ static int nextWatch = 1;
 static virNetlinkEventSrvPrivatePtr server[MAX_LINKS] = {NULL};
 static virNetlinkHandle *placeholder_nlhandle;
 
+/* Number of idle sockets kept around for each protocol */
+# define NETLINK_POOL_SIZE 8
+
+/* Sockets used for requests to the kernel are cached so that they
+ * don't have to be created and bound over and over again. Each one
+ * is used by a single thread at a time. */
+static virMutex poolLock = VIR_MUTEX_INITIALIZER;
+static virNetlinkHandle *pool[MAX_LINKS][NETLINK_POOL_SIZE];
+static size_t poolCount[MAX_LINKS];
+static pid_t poolPid;
+
 /* Function definitions */
 
 /**
@@ -130,11 +143,22 @@ virNetlinkStartup(void)
     return 0;
 }
 
+static void
+virNetlinkPoolClear(void)
+{
+    size_t i;
+
+    for (i = 0; i < MAX_LINKS; i++) {
+        while (poolCount[i] > 0)
+            virNetlinkFree(pool[i][--poolCount[i]]);
+    }
+}
+
 /**
  * virNetlinkShutdown:
  *
  * Undo any initialization done by virNetlinkStartup. This currently
- * destroys the placeholder nl_handle.
+ * destroys the placeholder nl_handle. Pooled sockets are closed too.
  */
 void
 virNetlinkShutdown(void)
@@ -143,6 +167,10 @@ virNetlinkShutdown(void)
         virNetlinkFree(placeholder_nlhandle);
         placeholder_nlhandle = NULL;
     }
+
+    virMutexLock(&poolLock);
+    virNetlinkPoolClear();
+    virMutexUnlock(&poolLock);
 }
 
 
@@ -193,10 +221,108 @@ virNetlinkCreateSocket(int protocol)
     return NULL;
 }
 
+/**
+ * virNetlinkAcquireSocket:
+ * @protocol: netlink protocol
+ *
+ * Take an idle socket for @protocol from the pool, or create a new
+ * one if there is none. Sockets inherited from the parent process
+ * are never used as they might belong to a different network
+ * namespace.
+ *
+ * Returns the socket, or NULL on failure.
+ */
+virNetlinkHandle *
+virNetlinkAcquireSocket(unsigned int protocol)
+{
+    virNetlinkHandle *nlhandle = NULL;
+    pid_t pid = getpid();
+
+    virMutexLock(&poolLock);
+    if (poolPid != pid) {
+        virNetlinkPoolClear();
+        poolPid = pid;
+    }
+    if (poolCount[protocol] > 0)
+        nlhandle = pool[protocol][--poolCount[protocol]];
+    virMutexUnlock(&poolLock);
+
+    if (nlhandle)
+        return nlhandle;
+
+    return virNetlinkCreateSocket(protocol);
+}
+
+
+/**
+ * virNetlinkReleaseSocket:
+ * @protocol: netlink protocol
+ * @nlhandle: socket obtained from virNetlinkAcquireSocket
+ * @reuse: whether the socket can be used for another request
+ *
+ * Return @nlhandle to the pool, or free it if the pool is full or
+ * the request didn't complete (and thus the socket might still hold
+ * parts of its response).
+ */
+void
+virNetlinkReleaseSocket(unsigned int protocol,
+                        virNetlinkHandle *nlhandle,
+                        bool reuse)
+{
+    if (!nlhandle)
+        return;
+
+    if (reuse) {
+        virMutexLock(&poolLock);
+        if (poolPid == getpid() &&
+            poolCount[protocol] < NETLINK_POOL_SIZE) {
+            pool[protocol][poolCount[protocol]++] = nlhandle;
+            nlhandle = NULL;
+        }
+        virMutexUnlock(&poolLock);
+    }
+
+    virNetlinkFree(nlhandle);
+}
+
+
+/**
+ * virNetlinkIsResponse:
+ * @nl_msg: request
+ * @resp: received message
+ * @len: length of @resp
+ *
+ * A pooled socket may still have replies to requests that timed out
+ * queued. Those are told apart by their sequence number.
+ */
+bool
+virNetlinkIsResponse(struct nl_msg *nl_msg,
+                     struct nlmsghdr *resp,
+                     int len)
+{
+    if (len < NLMSG_HDRLEN ||
+        resp->nlmsg_seq == nlmsg_hdr(nl_msg)->nlmsg_seq)
+        return true;
+
+    VIR_DEBUG("Discarding stale netlink response seq=%u",
+              resp->nlmsg_seq);
+    return false;
+}
+
+
+/*
+ * virNetlinkSendRequest:
+ *
+ * Send @nl_msg over a new socket, or a pooled one if the request is
+ * for the kernel and no multicast groups are needed (@pooled is set
+ * accordingly). The caller must hand the returned socket over to
+ * virNetlinkReleaseSocket.
+ */
 static virNetlinkHandle *
 virNetlinkSendRequest(struct nl_msg *nl_msg, uint32_t src_pid,
                       struct sockaddr_nl nladdr,
-                      unsigned int protocol, unsigned int groups)
+                      unsigned int protocol, unsigned int groups,
+                      bool *pooled)
 {
     ssize_t nbytes;
     int fd;
@@ -205,14 +331,22 @@ virNetlinkSendRequest(struct nl_msg *nl_msg, uint32_t src_pid,
     struct pollfd fds[1];
     struct nlmsghdr *nlmsg = nlmsg_hdr(nl_msg);
 
+    *pooled = false;
+
     if (protocol >= MAX_LINKS) {
         virReportSystemError(EINVAL,
                              _("invalid protocol argument: %d"), protocol);
         goto error;
     }
 
-    if (!(nlhandle = virNetlinkCreateSocket(protocol)))
-        goto error;
+    if (nladdr.nl_pid == 0 && groups == 0) {
+        if (!(nlhandle = virNetlinkAcquireSocket(protocol)))
+            goto error;
+        *pooled = true;
+    } else {
+        if (!(nlhandle = virNetlinkCreateSocket(protocol)))
+            goto error;
+    }
 
     fd = nl_socket_get_fd(nlhandle);
     if (fd < 0) {
@@ -230,6 +364,7 @@ virNetlinkSendRequest(struct nl_msg *nl_msg, uint32_t src_pid,
     nlmsg_set_dst(nl_msg, &nladdr);
 
     nlmsg->nlmsg_pid = src_pid ? src_pid : getpid();
+    nlmsg->nlmsg_seq = nl_socket_use_seq(nlhandle);
 
     nbytes = nl_send_auto_complete(nlhandle, nl_msg);
     if (nbytes < 0) {
@@ -257,6 +392,7 @@ virNetlinkSendRequest(struct nl_msg *nl_msg, uint32_t src_pid,
 
  error:
     virNetlinkFree(nlhandle);
+    *pooled = false;
     return NULL;
 }
 
@@ -285,31 +421,38 @@ int virNetlinkCommand(struct nl_msg *nl_msg,
             .nl_pid    = dst_pid,
             .nl_groups = 0,
     };
-    struct pollfd fds[1];
     g_autofree struct nlmsghdr *temp_resp = NULL;
-    g_autoptr(virNetlinkHandle) nlhandle = NULL;
+    virNetlinkHandle *nlhandle = NULL;
+    bool pooled;
     int len = 0;
-
-    memset(fds, 0, sizeof(fds));
+    int ret = -1;
 
     if (!(nlhandle = virNetlinkSendRequest(nl_msg, src_pid, nladdr,
-                                           protocol, groups)))
+                                           protocol, groups, &pooled)))
         return -1;
 
-    len = nl_recv(nlhandle, &nladdr, (unsigned char **)&temp_resp, NULL);
-    if (len == 0) {
-        virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
-                       _("nl_recv failed - returned 0 bytes"));
-        return -1;
-    }
-    if (len < 0) {
-        virReportSystemError(errno, "%s", _("nl_recv failed"));
-        return -1;
-    }
+    do {
+        VIR_FREE(temp_resp);
+
+        len = nl_recv(nlhandle, &nladdr, (unsigned char **)&temp_resp, NULL);
+        if (len == 0) {
+            virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                           _("nl_recv failed - returned 0 bytes"));
+            goto cleanup;
+        }
+        if (len < 0) {
+            virReportSystemError(errno, "%s", _("nl_recv failed"));
+            goto cleanup;
+        }
+    } while (pooled && !virNetlinkIsResponse(nl_msg, temp_resp, len));
 
     *resp = g_steal_pointer(&temp_resp);
     *respbuflen = len;
-    return 0;
+    ret = 0;
+
+ cleanup:
+    virNetlinkReleaseSocket(protocol, nlhandle, pooled && ret == 0);
+    return ret;
 }
 
 int
@@ -320,7 +463,9 @@ virNetlinkDumpCommand(struct nl_msg *nl_msg,
                       void *opaque)
 {
     bool end = false;
+    bool pooled;
     int len = 0;
+    int ret = -1;
     struct nlmsghdr *msg = NULL;
 
     struct sockaddr_nl nladdr = {
@@ -328,16 +473,25 @@ virNetlinkDumpCommand(struct nl_msg *nl_msg,
             .nl_pid    = dst_pid,
             .nl_groups = 0,
     };
-    g_autoptr(virNetlinkHandle) nlhandle = NULL;
+    virNetlinkHandle *nlhandle = NULL;
 
     if (!(nlhandle = virNetlinkSendRequest(nl_msg, src_pid, nladdr,
-                                           protocol, groups)))
+                                           protocol, groups, &pooled)))
         return -1;
 
     while (!end) {
         g_autofree struct nlmsghdr *resp = NULL;
 
         len = nl_recv(nlhandle, &nladdr, (unsigned char **)&resp, NULL);
+        if (len <= 0) {
+            virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                           _("nl_recv failed while reading netlink dump"));
+            goto cleanup;
+        }
+
+        if (pooled && !virNetlinkIsResponse(nl_msg, resp, len))
+            continue;
+
         VIR_WARNINGS_NO_CAST_ALIGN
         for (msg = resp; NLMSG_OK(msg, len); msg = NLMSG_NEXT(msg, len)) {
             VIR_WARNINGS_RESET
@@ -345,16 +499,144 @@ virNetlinkDumpCommand(struct nl_msg *nl_msg,
                 end = true;
 
             if (virNetlinkGetErrorCode(msg, len) < 0)
-                return -1;
+                goto cleanup;
 
             if (callback(msg, opaque) < 0)
-                return -1;
+                goto cleanup;
         }
     }
 
-    return 0;
+    ret = 0;
+
+ cleanup:
+    virNetlinkReleaseSocket(protocol, nlhandle, pooled && ret == 0);
+    return ret;
+}
+
+/**
+ * virNetlinkCommandBatch:
+ * @msgs: requests to send
+ * @nmsgs: number of requests
+ * @errors: filled with the result of each request (0 or -errno)
+ *
+ * Send all @msgs to the kernel (NETLINK_ROUTE) in a single datagram
+ * and collect an acknowledgement for each of them. The kernel
+ * processes the requests in order, and one failing doesn't stop the
+ * following ones from being processed, so it's up to the caller to
+ * decide which of @errors are fatal.
+ *
+ * Returns 0 if all requests were acknowledged, -1 if talking to the
+ * kernel failed (with error reported).
+ */
+int
+virNetlinkCommandBatch(struct nl_msg **msgs,
+                       size_t nmsgs,
+                       int *errors)
+{
+    virNetlinkHandle *nlhandle = NULL;
+    g_autofree char *buf = NULL;
+    size_t buflen = 0;
+    size_t acked = 0;
+    size_t i;
+    uint32_t firstSeq = 0;
+    int fd;
+    int ret = -1;
+
+    if (!(nlhandle = virNetlinkAcquireSocket(NETLINK_ROUTE)))
+        return -1;
+
+    if ((fd = nl_socket_get_fd(nlhandle)) < 0) {
+        virReportSystemError(errno,
+                             "%s", _("cannot get netlink socket fd"));
+        goto cleanup;
+    }
+
+    for (i = 0; i < nmsgs; i++)
+        buflen += NLMSG_ALIGN(nlmsg_hdr(msgs[i])->nlmsg_len);
+
+    buf = g_new0(char, buflen);
+    buflen = 0;
+
+    for (i = 0; i < nmsgs; i++) {
+        struct nlmsghdr *hdr = nlmsg_hdr(msgs[i]);
+
+        /* The sequence number identifies the request an ack is for.
+         * The socket hands them out consecutively. */
+        hdr->nlmsg_flags |= NLM_F_REQUEST | NLM_F_ACK;
+        hdr->nlmsg_seq = nl_socket_use_seq(nlhandle);
+        hdr->nlmsg_pid = nl_socket_get_local_port(nlhandle);
+        if (i == 0)
+            firstSeq = hdr->nlmsg_seq;
+
+        memcpy(buf + buflen, hdr, hdr->nlmsg_len);
+        buflen += NLMSG_ALIGN(hdr->nlmsg_len);
+        errors[i] = 0;
+    }
+
+    if (nl_sendto(nlhandle, buf, buflen) < 0) {
+        virReportSystemError(errno,
+                             "%s", _("cannot send to netlink socket"));
+        goto cleanup;
+    }
+
+    while (acked < nmsgs) {
+        struct pollfd fds[] = { { .fd = fd, .events = POLLIN } };
+        struct sockaddr_nl nladdr;
+        g_autofree struct nlmsghdr *resp = NULL;
+        struct nlmsghdr *msg;
+        struct nlmsgerr *err;
+        int len;
+        int n;
+
+        if ((n = poll(fds, G_N_ELEMENTS(fds), NETLINK_ACK_TIMEOUT_S)) < 0) {
+            if (errno == EINTR)
+                continue;
+            virReportSystemError(errno, "%s", _("error in poll call"));
+            goto cleanup;
+        }
+
+        if (n == 0) {
+            virReportSystemError(ETIMEDOUT, "%s",
+                                 _("no valid netlink response was received"));
+            goto cleanup;
+        }
+
+        len = nl_recv(nlhandle, &nladdr, (unsigned char **)&resp, NULL);
+        if (len <= 0) {
+            virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                           _("nl_recv failed while reading netlink acks"));
+            goto cleanup;
+        }
+
+        VIR_WARNINGS_NO_CAST_ALIGN
+        for (msg = resp; NLMSG_OK(msg, len); msg = NLMSG_NEXT(msg, len)) {
+            VIR_WARNINGS_RESET
+            /* Stale replies left on a pooled socket are skipped too */
+            uint32_t idx = msg->nlmsg_seq - firstSeq;
+
+            if (msg->nlmsg_type != NLMSG_ERROR || idx >= nmsgs)
+                continue;
+
+            if (msg->nlmsg_len < NLMSG_LENGTH(sizeof(*err))) {
+                virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                               _("malformed netlink response message"));
+                goto cleanup;
+            }
+
+            err = (struct nlmsgerr *)NLMSG_DATA(msg);
+            errors[idx] = err->error;
+            acked++;
+        }
+    }
+
+    ret = 0;
+
+ cleanup:
+    virNetlinkReleaseSocket(NETLINK_ROUTE, nlhandle, ret == 0);
+    return ret;
 }
 
+
 /**
  * virNetlinkDumpLink:
  *
@@ -471,6 +753,45 @@ virNetlinkDumpLink(const char *ifname, int ifindex,
 }
 
 
+/**
+ * virNetlinkDumpLinks:
+ *
+ * @callback: function called for every message of the dump
+ * @opaque:   data passed to @callback
+ *
+ * Dump information about all network interfaces of the host in a
+ * single RTM_GETLINK request. @callback is called for each message
+ * received, which is RTM_NEWLINK for every interface and NLMSG_DONE
+ * at the end.
+ *
+ * Returns 0 on success, -1 on error (with error reported).
+ */
+int
+virNetlinkDumpLinks(virNetlinkDumpCallback callback,
+                    void *opaque)
+{
+    struct ifinfomsg ifinfo = {
+        .ifi_family = AF_UNSPEC,
+    };
+    g_autoptr(virNetlinkMsg) nl_msg = NULL;
+
+    if (!(nl_msg = nlmsg_alloc_simple(RTM_GETLINK,
+                                      NLM_F_REQUEST | NLM_F_DUMP))) {
+        virReportOOMError();
+        return -1;
+    }
+
+    if (nlmsg_append(nl_msg, &ifinfo, sizeof(ifinfo), NLMSG_ALIGNTO) < 0) {
+        virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                       _("allocated netlink buffer is too small"));
+        return -1;
+    }
+
+    return virNetlinkDumpCommand(nl_msg, callback, 0, 0,
+                                 NETLINK_ROUTE, 0, opaque);
+}
+
+
 /**
  * virNetlinkNewLink:
  *
@@ -1233,6 +1554,29 @@ virNetlinkShutdown(void)
     return;
 }
 
+virNetlinkHandle *
+virNetlinkAcquireSocket(unsigned int protocol G_GNUC_UNUSED)
+{
+    virReportError(VIR_ERR_INTERNAL_ERROR, "%s", _(unsupported));
+    return NULL;
+}
+
+void
+virNetlinkReleaseSocket(unsigned int protocol G_GNUC_UNUSED,
+                        virNetlinkHandle *nlhandle G_GNUC_UNUSED,
+                        bool reuse G_GNUC_UNUSED)
+{
+    return;
+}
+
+bool
+virNetlinkIsResponse(struct nl_msg *nl_msg G_GNUC_UNUSED,
+                     struct nlmsghdr *resp G_GNUC_UNUSED,
+                     int len G_GNUC_UNUSED)
+{
+    return true;
+}
+
 int virNetlinkCommand(struct nl_msg *nl_msg G_GNUC_UNUSED,
                       struct nlmsghdr **resp G_GNUC_UNUSED,
                       unsigned int *respbuflen G_GNUC_UNUSED,
@@ -1258,6 +1602,16 @@ virNetlinkDumpCommand(struct nl_msg *nl_msg G_GNUC_UNUSED,
     return -1;
 }
 
+int
+virNetlinkCommandBatch(struct nl_msg **msgs G_GNUC_UNUSED,
+                       size_t nmsgs G_GNUC_UNUSED,
+                       int *errors G_GNUC_UNUSED)
+{
+    virReportError(VIR_ERR_INTERNAL_ERROR, "%s", _(unsupported));
+    return -1;
+}
+
+
 int
 virNetlinkDumpLink(const char *ifname G_GNUC_UNUSED,
                    int ifindex G_GNUC_UNUSED,
@@ -1272,6 +1626,15 @@ virNetlinkDumpLink(const char *ifname G_GNUC_UNUSED,
 }
 
 
+int
+virNetlinkDumpLinks(virNetlinkDumpCallback callback G_GNUC_UNUSED,
+                    void *opaque G_GNUC_UNUSED)
+{
+    virReportError(VIR_ERR_INTERNAL_ERROR, "%s", _(unsupported));
+    return -1;
+}
+
+
 int
 virNetlinkDelLink(const char *ifname G_GNUC_UNUSED,
                   virNetlinkDelLinkFallback fallback G_GNUC_UNUSED)
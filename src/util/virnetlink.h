@@ -78,6 +78,10 @@ int virNetlinkDumpCommand(struct nl_msg *nl_msg,
                           unsigned int protocol, unsigned int groups,
                           void *opaque);
 
+int virNetlinkCommandBatch(struct nl_msg **msgs,
+                           size_t nmsgs,
+                           int *errors);
+
 typedef struct _virNetlinkNewLinkData virNetlinkNewLinkData;
 typedef virNetlinkNewLinkData *virNetlinkNewLinkDataPtr;
 struct _virNetlinkNewLinkData {
@@ -101,6 +105,10 @@ int virNetlinkDumpLink(const char *ifname, int ifindex,
                        void **nlData, struct nlattr **tb,
                        uint32_t src_pid, uint32_t dst_pid)
     G_GNUC_WARN_UNUSED_RESULT;
+
+int virNetlinkDumpLinks(virNetlinkDumpCallback callback,
+                        void *opaque);
+
 int
 virNetlinkGetNeighbor(void **nlData, uint32_t src_pid, uint32_t dst_pid);
 
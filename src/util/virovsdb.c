@@ -0,0 +1,968 @@
+/*
+ * virovsdb.c: minimal OVSDB JSON-RPC client
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * This implements just enough of RFC 7047 to replace ovs-vsctl for
+ * the operations libvirt needs: transactions against the
+ * Open_vSwitch database and a monitor keeping statistics of all
+ * interfaces (and the cur_cfg counter of ovs-vswitchd) up to date.
+ */
+
+#include <config.h>
+
+#include <poll.h>
+#include <unistd.h>
+#ifndef WIN32
+# include <sys/un.h>
+#endif
+
+#include "virovsdb.h"
+#include "viralloc.h"
+#include "virerror.h"
+#include "virfile.h"
+#include "virhash.h"
+#include "virlog.h"
+#include "virsocket.h"
+#include "virstring.h"
+#include "virtime.h"
+
+#define VIR_FROM_THIS VIR_FROM_NONE
+
+VIR_LOG_INIT("util.ovsdb");
+
+#define VIR_OVSDB_DATABASE "Open_vSwitch"
+#define VIR_OVSDB_MONITOR "libvirt"
+
+/* Refuse to buffer more than this waiting for a message to complete */
+#define VIR_OVSDB_MESSAGE_MAX (32 * 1024 * 1024)
+
+/* Longest wait for an update without checking the state in between */
+#define VIR_OVSDB_WAIT_SLICE 20
+
+/*
+ * The client is locked while talking to the server only. Waiting for
+ * ovs-vswitchd to catch up with the database is done unlocked, in slices
+ * of VIR_OVSDB_WAIT_SLICE milliseconds, so that other threads can run
+ * their transactions in between.
+ */
+struct _virOVSDBClient {
+    virObjectLockable parent;
+
+    int fd;
+    unsigned int timeout; /* in milliseconds */
+    unsigned int serial;
+
+    char *rxbuf;
+    size_t rxlen;
+    size_t rxalloc;
+
+    bool monitored;
+    virHashTablePtr rows; /* Interface row UUID -> name */
+    virHashTablePtr stats; /* Interface name -> statistics column */
+    long long curCfg;
+};
+
+static virClassPtr virOVSDBClientClass;
+
+
+static void
+virOVSDBClientDispose(void *obj)
+{
+    virOVSDBClientPtr client = obj;
+
+    VIR_FORCE_CLOSE(client->fd);
+    g_free(client->rxbuf);
+    virHashFree(client->rows);
+    virHashFree(client->stats);
+}
+
+
+static int
+virOVSDBClientOnceInit(void)
+{
+    if (!VIR_CLASS_NEW(virOVSDBClient, virClassForObjectLockable()))
+        return -1;
+
+    return 0;
+}
+
+
+VIR_ONCE_GLOBAL_INIT(virOVSDBClient);
+
+
+/**
+ * virOVSDBClientNew:
+ * @path: path to the UNIX socket of the OVSDB server
+ * @timeout: timeout for each operation in milliseconds
+ *
+ * Connect to the OVSDB server listening at @path. The client may be
+ * shared by multiple threads.
+ *
+ * Returns the client on success, NULL otherwise (with error reported).
+ */
+#ifndef WIN32
+virOVSDBClientPtr
+virOVSDBClientNew(const char *path,
+                  unsigned int timeout)
+{
+    g_autoptr(virOVSDBClient) client = NULL;
+    struct sockaddr_un sa;
+
+    if (virOVSDBClientInitialize() < 0)
+        return NULL;
+
+    if (!(client = virObjectLockableNew(virOVSDBClientClass)))
+        return NULL;
+
+    client->fd = -1;
+    client->timeout = timeout;
+    client->curCfg = -1;
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sun_family = AF_UNIX;
+    if (virStrcpyStatic(sa.sun_path, path) < 0) {
+        virReportError(VIR_ERR_INTERNAL_ERROR,
+                       _("OVSDB socket path '%s' too long"), path);
+        return NULL;
+    }
+
+    if ((client->fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0) {
+        virReportSystemError(errno, "%s", _("Unable to open UNIX socket"));
+        return NULL;
+    }
+
+    if (virSetCloseExec(client->fd) < 0) {
+        virReportSystemError(errno, "%s",
+                             _("Unable to set close-on-exec flag"));
+        return NULL;
+    }
+
+    if (connect(client->fd, (struct sockaddr *)&sa, sizeof(sa)) < 0) {
+        virReportSystemError(errno,
+                             _("Unable to connect to OVSDB server at '%s'"),
+                             path);
+        return NULL;
+    }
+
+    if (!(client->rows = virHashCreate(32, virHashValueFree)) ||
+        !(client->stats = virHashCreate(32, virJSONValueHashFree)))
+        return NULL;
+
+    return g_steal_pointer(&client);
+}
+#else /* WIN32 */
+virOVSDBClientPtr
+virOVSDBClientNew(const char *path G_GNUC_UNUSED,
+                  unsigned int timeout G_GNUC_UNUSED)
+{
+    virReportSystemError(ENOSYS, "%s",
+                         _("OVSDB is not supported on this platform"));
+    return NULL;
+}
+#endif /* WIN32 */
+
+
+/**
+ * virOVSDBClientIsConnected:
+ * @client: OVSDB client
+ *
+ * Returns false if the connection was lost (or the server sent
+ * something unintelligible) and @client should be thrown away.
+ */
+bool
+virOVSDBClientIsConnected(virOVSDBClientPtr client)
+{
+    bool ret;
+
+    virObjectLock(client);
+    ret = client->fd >= 0;
+    virObjectUnlock(client);
+
+    return ret;
+}
+
+
+static void
+virOVSDBClientClose(virOVSDBClientPtr client)
+{
+    VIR_FORCE_CLOSE(client->fd);
+    client->rxlen = 0;
+}
+
+
+static int
+virOVSDBClientSend(virOVSDBClientPtr client,
+                   virJSONValuePtr msg)
+{
+    g_autofree char *str = NULL;
+
+    if (client->fd < 0) {
+        virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                       _("not connected to OVSDB server"));
+        return -1;
+    }
+
+    if (!(str = virJSONValueToString(msg, false)))
+        return -1;
+
+    VIR_DEBUG("Send: %s", str);
+
+    if (safewrite(client->fd, str, strlen(str)) < 0) {
+        virReportSystemError(errno, "%s",
+                             _("Unable to write to OVSDB server"));
+        virOVSDBClientClose(client);
+        return -1;
+    }
+
+    return 0;
+}
+
+
+/*
+ * Find the end of the first JSON value in @buf. OVSDB messages are
+ * sent back to back without any framing, so the only way to split
+ * them is to track nesting of brackets outside of strings.
+ *
+ * Returns the length of the value (including any leading
+ * whitespace), 0 if it is not complete yet, -1 if @buf doesn't
+ * start with a JSON object or array.
+ */
+static ssize_t
+virOVSDBMessageLength(const char *buf,
+                      size_t len)
+{
+    size_t depth = 0;
+    bool instr = false;
+    bool escape = false;
+    size_t i;
+
+    for (i = 0; i < len; i++) {
+        char c = buf[i];
+
+        if (instr) {
+            if (escape)
+                escape = false;
+            else if (c == '\\')
+                escape = true;
+            else if (c == '"')
+                instr = false;
+            continue;
+        }
+
+        switch (c) {
+        case '"':
+            if (depth == 0)
+                return -1;
+            instr = true;
+            break;
+
+        case '{':
+        case '[':
+            depth++;
+            break;
+
+        case '}':
+        case ']':
+            if (depth == 0)
+                return -1;
+            if (--depth == 0)
+                return i + 1;
+            break;
+
+        default:
+            if (depth == 0 && !g_ascii_isspace(c))
+                return -1;
+            break;
+        }
+    }
+
+    return 0;
+}
+
+
+/*
+ * Read a single message from the server, waiting at most @timeout
+ * milliseconds (-1 meaning the client's timeout) for it to arrive.
+ *
+ * Returns 1 if a message was read, 0 if none arrived in time, -1 on
+ * error.
+ */
+static int
+virOVSDBClientRead(virOVSDBClientPtr client,
+                   int timeout,
+                   virJSONValuePtr *msg)
+{
+    unsigned long long deadline = 0;
+    unsigned long long now;
+
+    if (client->fd < 0) {
+        virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                       _("not connected to OVSDB server"));
+        return -1;
+    }
+
+    if (timeout < 0)
+        timeout = client->timeout;
+
+    if (virTimeMillisNow(&now) < 0)
+        return -1;
+    deadline = now + timeout;
+
+    while (true) {
+        struct pollfd pfd = { .fd = client->fd, .events = POLLIN };
+        g_autofree char *str = NULL;
+        ssize_t len;
+        ssize_t got;
+        int rc;
+
+        if ((len = virOVSDBMessageLength(client->rxbuf, client->rxlen)) > 0) {
+            str = g_strndup(client->rxbuf, len);
+            memmove(client->rxbuf, client->rxbuf + len, client->rxlen - len);
+            client->rxlen -= len;
+
+            VIR_DEBUG("Recv: %s", str);
+
+            if (!(*msg = virJSONValueFromString(str))) {
+                virOVSDBClientClose(client);
+                return -1;
+            }
+            return 1;
+        }
+
+        if (len < 0 || client->rxlen > VIR_OVSDB_MESSAGE_MAX) {
+            virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                           _("malformed message from OVSDB server"));
+            virOVSDBClientClose(client);
+            return -1;
+        }
+
+        if (virTimeMillisNow(&now) < 0)
+            return -1;
+
+        rc = poll(&pfd, 1, deadline > now ? deadline - now : 0);
+        if (rc < 0) {
+            if (errno == EINTR)
+                continue;
+            virReportSystemError(errno, "%s",
+                                 _("Unable to poll OVSDB server connection"));
+            return -1;
+        }
+
+        if (rc == 0)
+            return 0;
+
+        if (VIR_RESIZE_N(client->rxbuf, client->rxalloc,
+                         client->rxlen, 4096) < 0)
+            return -1;
+
+        got = read(client->fd, client->rxbuf + client->rxlen,
+                   client->rxalloc - client->rxlen);
+        if (got < 0) {
+            if (errno == EINTR || errno == EAGAIN)
+                continue;
+            virReportSystemError(errno, "%s",
+                                 _("Unable to read from OVSDB server"));
+            virOVSDBClientClose(client);
+            return -1;
+        }
+
+        if (got == 0) {
+            virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                           _("OVSDB server closed the connection"));
+            virOVSDBClientClose(client);
+            return -1;
+        }
+
+        client->rxlen += got;
+    }
+}
+
+
+static int
+virOVSDBClientUpdateInterface(virOVSDBClientPtr client,
+                              const char *uuid,
+                              virJSONValuePtr row)
+{
+    const char *oldname = virHashLookup(client->rows, uuid);
+    const char *name = NULL;
+    virJSONValuePtr stats = NULL;
+
+    if (!row) {
+        if (oldname)
+            virHashRemoveEntry(client->stats, oldname);
+        virHashRemoveEntry(client->rows, uuid);
+        return 0;
+    }
+
+    /* Modifications may carry only the columns that changed. */
+    if (!(name = virJSONValueObjectGetString(row, "name")))
+        name = oldname;
+    if (!name)
+        return 0;
+
+    if ((stats = virJSONValueObjectGet(row, "statistics")) &&
+        !(stats = virJSONValueCopy(stats)))
+        return -1;
+
+    if (oldname && STRNEQ(oldname, name)) {
+        if (!stats)
+            stats = virHashSteal(client->stats, oldname);
+        virHashRemoveEntry(client->stats, oldname);
+    }
+
+    if (stats && virHashUpdateEntry(client->stats, name, stats) < 0) {
+        virJSONValueFree(stats);
+        return -1;
+    }
+
+    if (name != oldname &&
+        virHashUpdateEntry(client->rows, uuid, g_strdup(name)) < 0)
+        return -1;
+
+    return 0;
+}
+
+
+static int
+virOVSDBClientApplyUpdates(virOVSDBClientPtr client,
+                           virJSONValuePtr updates)
+{
+    virJSONValuePtr table;
+    size_t i;
+
+    if ((table = virJSONValueObjectGetObject(updates, "Interface"))) {
+        for (i = 0; i < virJSONValueObjectKeysNumber(table); i++) {
+            const char *uuid = virJSONValueObjectGetKey(table, i);
+            virJSONValuePtr update = virJSONValueObjectGetValue(table, i);
+
+            if (virOVSDBClientUpdateInterface(client, uuid,
+                                              virJSONValueObjectGetObject(update, "new")) < 0)
+                return -1;
+        }
+    }
+
+    if ((table = virJSONValueObjectGetObject(updates, VIR_OVSDB_DATABASE))) {
+        for (i = 0; i < virJSONValueObjectKeysNumber(table); i++) {
+            virJSONValuePtr update = virJSONValueObjectGetValue(table, i);
+            virJSONValuePtr row = virJSONValueObjectGetObject(update, "new");
+            long long cfg;
+
+            if (row &&
+                virJSONValueObjectGetNumberLong(row, "cur_cfg", &cfg) == 0)
+                client->curCfg = cfg;
+        }
+    }
+
+    return 0;
+}
+
+
+/*
+ * Handle a message the server sent on its own: an echo request
+ * (which must be answered or the server drops the connection) or a
+ * monitor update.
+ *
+ * Returns 1 if @msg was handled, 0 if it is a reply, -1 on error.
+ */
+static int
+virOVSDBClientHandleNotification(virOVSDBClientPtr client,
+                                 virJSONValuePtr msg)
+{
+    const char *method = virJSONValueObjectGetString(msg, "method");
+    virJSONValuePtr params = virJSONValueObjectGet(msg, "params");
+
+    if (!method)
+        return 0;
+
+    if (STREQ(method, "echo")) {
+        g_autoptr(virJSONValue) reply = NULL;
+        g_autoptr(virJSONValue) result = NULL;
+        g_autoptr(virJSONValue) id = NULL;
+
+        if (!params || virJSONValueObjectHasKey(msg, "id") != 1) {
+            VIR_DEBUG("Ignoring malformed OVSDB echo request");
+            return 1;
+        }
+
+        if (!(result = virJSONValueCopy(params)) ||
+            !(id = virJSONValueCopy(virJSONValueObjectGet(msg, "id"))))
+            return -1;
+
+        if (virJSONValueObjectCreate(&reply,
+                                     "a:result", &result,
+                                     "n:error",
+                                     "a:id", &id,
+                                     NULL) < 0)
+            return -1;
+
+        return virOVSDBClientSend(client, reply) < 0 ? -1 : 1;
+    }
+
+    if (STREQ(method, "update")) {
+        virJSONValuePtr updates = virJSONValueArrayGet(params, 1);
+
+        if (updates && virOVSDBClientApplyUpdates(client, updates) < 0)
+            return -1;
+
+        return 1;
+    }
+
+    VIR_DEBUG("Ignoring OVSDB notification '%s'", method);
+    return 1;
+}
+
+
+static int
+virOVSDBClientCall(virOVSDBClientPtr client,
+                   const char *method,
+                   virJSONValuePtr *params,
+                   virJSONValuePtr *result)
+{
+    g_autoptr(virJSONValue) msg = NULL;
+    unsigned int serial = ++client->serial;
+
+    if (virJSONValueObjectCreate(&msg,
+                                 "s:method", method,
+                                 "a:params", params,
+                                 "u:id", serial,
+                                 NULL) < 0)
+        return -1;
+
+    if (virOVSDBClientSend(client, msg) < 0)
+        return -1;
+
+    while (true) {
+        g_autoptr(virJSONValue) reply = NULL;
+        virJSONValuePtr error;
+        unsigned int id;
+        int rc;
+
+        if ((rc = virOVSDBClientRead(client, -1, &reply)) < 0)
+            return -1;
+
+        if (rc == 0) {
+            virReportError(VIR_ERR_OPERATION_TIMEOUT,
+                           _("timed out waiting for OVSDB '%s' reply"),
+                           method);
+            /* A late reply would be taken for the next one's */
+            virOVSDBClientClose(client);
+            return -1;
+        }
+
+        if ((rc = virOVSDBClientHandleNotification(client, reply)) < 0)
+            return -1;
+        if (rc > 0)
+            continue;
+
+        if (virJSONValueObjectGetNumberUint(reply, "id", &id) < 0 ||
+            id != serial) {
+            VIR_DEBUG("Ignoring unexpected OVSDB reply");
+            continue;
+        }
+
+        if ((error = virJSONValueObjectGet(reply, "error")) &&
+            !virJSONValueIsNull(error)) {
+            g_autofree char *str = virJSONValueToString(error, false);
+
+            virReportError(VIR_ERR_INTERNAL_ERROR,
+                           _("OVSDB '%s' failed: %s"),
+                           method, NULLSTR(str));
+            return -1;
+        }
+
+        if (!(*result = virJSONValueObjectSteal(reply, "result"))) {
+            virReportError(VIR_ERR_INTERNAL_ERROR,
+                           _("missing result in OVSDB '%s' reply"), method);
+            return -1;
+        }
+
+        return 0;
+    }
+}
+
+
+/**
+ * virOVSDBClientTransact:
+ * @client: OVSDB client
+ * @ops: JSON array of operations (stolen)
+ * @results: filled with the array of operation results (may be NULL)
+ *
+ * Execute @ops atomically as one transaction against the
+ * Open_vSwitch database. The transaction is considered failed if
+ * any of the operations (or the commit itself) failed.
+ *
+ * Returns 0 on success, -1 otherwise (with error reported).
+ */
+int
+virOVSDBClientTransact(virOVSDBClientPtr client,
+                       virJSONValuePtr *ops,
+                       virJSONValuePtr *results)
+{
+    g_autoptr(virJSONValue) params = virJSONValueNewArray();
+    g_autoptr(virJSONValue) reply = NULL;
+    g_autoptr(virJSONValue) tmp = g_steal_pointer(ops);
+    size_t nops = virJSONValueArraySize(tmp);
+    size_t i;
+    int rc;
+
+    if (virJSONValueArrayAppendString(params, VIR_OVSDB_DATABASE) < 0 ||
+        virJSONValueArrayConcat(params, tmp) < 0)
+        return -1;
+
+    virObjectLock(client);
+    rc = virOVSDBClientCall(client, "transact", &params, &reply);
+    virObjectUnlock(client);
+
+    if (rc < 0)
+        return -1;
+
+    if (!virJSONValueIsArray(reply) ||
+        virJSONValueArraySize(reply) < nops) {
+        virReportError(VIR_ERR_INTERNAL_ERROR, "%s",
+                       _("malformed OVSDB transaction reply"));
+        return -1;
+    }
+
+    /* A failed operation has an error, and if the commit fails there's
+     * an extra element past the operations with one. */
+    for (i = 0; i < virJSONValueArraySize(reply); i++) {
+        virJSONValuePtr res = virJSONValueArrayGet(reply, i);
+        const char *error = virJSONValueObjectGetString(res, "error");
+        const char *details = virJSONValueObjectGetString(res, "details");
+
+        if (error) {
+            virReportError(VIR_ERR_INTERNAL_ERROR,
+                           _("OVSDB transaction failed: %s%s%s"),
+                           error, details ? ": " : "", NULLSTR_EMPTY(details));
+            return -1;
+        }
+    }
+
+    if (results)
+        *results = g_steal_pointer(&reply);
+
+    return 0;
+}
+
+
+static int
+virOVSDBClientMonitorLocked(virOVSDBClientPtr client)
+{
+    g_autoptr(virJSONValue) params = NULL;
+    g_autoptr(virJSONValue) requests = NULL;
+    g_autoptr(virJSONValue) iface = NULL;
+    g_autoptr(virJSONValue) ifaceColumns = virJSONValueNewArray();
+    g_autoptr(virJSONValue) ovs = NULL;
+    g_autoptr(virJSONValue) ovsColumns = virJSONValueNewArray();
+    g_autoptr(virJSONValue) reply = NULL;
+
+    if (client->monitored)
+        return 0;
+
+    if (virJSONValueArrayAppendString(ifaceColumns, "name") < 0 ||
+        virJSONValueArrayAppendString(ifaceColumns, "statistics") < 0 ||
+        virJSONValueArrayAppendString(ovsColumns, "cur_cfg") < 0)
+        return -1;
+
+    if (virJSONValueObjectCreate(&iface, "a:columns", &ifaceColumns, NULL) < 0 ||
+        virJSONValueObjectCreate(&ovs, "a:columns", &ovsColumns, NULL) < 0 ||
+        virJSONValueObjectCreate(&requests,
+                                 "a:Interface", &iface,
+                                 "a:" VIR_OVSDB_DATABASE, &ovs,
+                                 NULL) < 0)
+        return -1;
+
+    params = virJSONValueNewArray();
+    if (virJSONValueArrayAppendString(params, VIR_OVSDB_DATABASE) < 0 ||
+        virJSONValueArrayAppendString(params, VIR_OVSDB_MONITOR) < 0 ||
+        virJSONValueArrayAppend(params, requests) < 0)
+        return -1;
+    requests = NULL;
+
+    if (virOVSDBClientCall(client, "monitor", &params, &reply) < 0)
+        return -1;
+
+    if (virOVSDBClientApplyUpdates(client, reply) < 0)
+        return -1;
+
+    client->monitored = true;
+    return 0;
+}
+
+
+/**
+ * virOVSDBClientMonitor:
+ * @client: OVSDB client
+ *
+ * Start monitoring statistics of all interfaces and the
+ * configuration sequence number of ovs-vswitchd. The server then
+ * keeps sending updates which are processed whenever @client reads
+ * from the connection. Calling this more than once is a no-op.
+ *
+ * Returns 0 on success, -1 otherwise (with error reported).
+ */
+int
+virOVSDBClientMonitor(virOVSDBClientPtr client)
+{
+    int ret;
+
+    virObjectLock(client);
+    ret = virOVSDBClientMonitorLocked(client);
+    virObjectUnlock(client);
+
+    return ret;
+}
+
+
+/* Process whatever the server has sent meanwhile, without waiting. */
+static int
+virOVSDBClientProcessPending(virOVSDBClientPtr client)
+{
+    while (true) {
+        g_autoptr(virJSONValue) msg = NULL;
+        int rc;
+
+        if ((rc = virOVSDBClientRead(client, 0, &msg)) <= 0)
+            return rc;
+
+        if (virOVSDBClientHandleNotification(client, msg) < 0)
+            return -1;
+    }
+}
+
+
+/**
+ * virOVSDBClientWaitCfg:
+ * @client: OVSDB client
+ * @cfg: configuration sequence number
+ *
+ * Wait until ovs-vswitchd applies database contents at least as
+ * new as @cfg, i.e. until cur_cfg reaches @cfg. This is what
+ * ovs-vsctl does after each change unless told not to.
+ *
+ * Returns 0 on success, -1 otherwise (with error reported).
+ */
+int
+virOVSDBClientWaitCfg(virOVSDBClientPtr client,
+                      long long cfg)
+{
+    unsigned long long deadline;
+    unsigned long long now;
+    int ret = -1;
+
+    if (virTimeMillisNow(&now) < 0)
+        return -1;
+    deadline = now + client->timeout;
+
+    virObjectLock(client);
+
+    if (virOVSDBClientMonitorLocked(client) < 0 ||
+        virOVSDBClientProcessPending(client) < 0)
+        goto cleanup;
+
+    while (client->curCfg < cfg) {
+        struct pollfd pfd = { .fd = client->fd, .events = POLLIN };
+
+        if (virTimeMillisNow(&now) < 0)
+            goto cleanup;
+
+        if (now >= deadline) {
+            virReportError(VIR_ERR_OPERATION_TIMEOUT, "%s",
+                           _("timed out waiting for ovs-vswitchd to apply "
+                             "the configuration"));
+            goto cleanup;
+        }
+
+        /* Other threads may talk to the server meanwhile and consume
+         * the update we are waiting for, hence the bounded wait */
+        virObjectUnlock(client);
+        ignore_value(poll(&pfd, 1, MIN(deadline - now, VIR_OVSDB_WAIT_SLICE)));
+        virObjectLock(client);
+
+        if (virOVSDBClientProcessPending(client) < 0)
+            goto cleanup;
+    }
+
+    ret = 0;
+
+ cleanup:
+    virObjectUnlock(client);
+    return ret;
+}
+
+
+/**
+ * virOVSDBClientGetInterfaceStats:
+ * @client: OVSDB client
+ * @ifname: interface name
+ * @stats: filled with a copy of the statistics column of @ifname
+ *
+ * Look up statistics of @ifname in the monitored copy of the
+ * Interface table. The monitor is started on the first call. The
+ * @stats are the OVSDB map as found in the database, and NULL if
+ * there's no @ifname.
+ *
+ * Returns 0 on success, -1 otherwise (with error reported).
+ */
+int
+virOVSDBClientGetInterfaceStats(virOVSDBClientPtr client,
+                                const char *ifname,
+                                virJSONValuePtr *stats)
+{
+    virJSONValuePtr val;
+
+    int ret = -1;
+
+    *stats = NULL;
+
+    virObjectLock(client);
+
+    if (virOVSDBClientMonitorLocked(client) < 0 ||
+        virOVSDBClientProcessPending(client) < 0)
+        goto cleanup;
+
+    if ((val = virHashLookup(client->stats, ifname)) &&
+        !(*stats = virJSONValueCopy(val)))
+        goto cleanup;
+
+    ret = 0;
+
+ cleanup:
+    virObjectUnlock(client);
+    return ret;
+}
+
+
+static virJSONValuePtr
+virOVSDBValueTagged(const char *tag,
+                    virJSONValuePtr *value)
+{
+    g_autoptr(virJSONValue) ret = virJSONValueNewArray();
+
+    if (virJSONValueArrayAppendString(ret, tag) < 0 ||
+        virJSONValueArrayAppend(ret, *value) < 0)
+        return NULL;
+
+    *value = NULL;
+    return g_steal_pointer(&ret);
+}
+
+
+/* ["uuid", @uuid] */
+virJSONValuePtr
+virOVSDBValueUUID(const char *uuid)
+{
+    g_autoptr(virJSONValue) str = virJSONValueNewString(uuid);
+
+    return virOVSDBValueTagged("uuid", &str);
+}
+
+
+/* ["named-uuid", @name] referring to a row inserted by the same
+ * transaction with "uuid-name" @name */
+virJSONValuePtr
+virOVSDBValueNamedUUID(const char *name)
+{
+    g_autoptr(virJSONValue) str = virJSONValueNewString(name);
+
+    return virOVSDBValueTagged("named-uuid", &str);
+}
+
+
+/* ["set", @elems] where @elems is an array (stolen) */
+virJSONValuePtr
+virOVSDBValueSet(virJSONValuePtr *elems)
+{
+    return virOVSDBValueTagged("set", elems);
+}
+
+
+/* ["map", @pairs] where @pairs is an array of pairs (stolen) */
+virJSONValuePtr
+virOVSDBValueMap(virJSONValuePtr *pairs)
+{
+    return virOVSDBValueTagged("map", pairs);
+}
+
+
+/* [@key, @value], both stolen */
+virJSONValuePtr
+virOVSDBValuePair(virJSONValuePtr *key,
+                  virJSONValuePtr *value)
+{
+    g_autoptr(virJSONValue) ret = virJSONValueNewArray();
+
+    if (virJSONValueArrayAppend(ret, *key) < 0)
+        return NULL;
+    *key = NULL;
+
+    if (virJSONValueArrayAppend(ret, *value) < 0)
+        return NULL;
+    *value = NULL;
+
+    return g_steal_pointer(&ret);
+}
+
+
+/**
+ * virOVSDBClause:
+ * @column: column name
+ * @function: condition function (e.g. "==") or mutator (e.g. "+=")
+ * @value: value (stolen)
+ *
+ * Build a condition for a "where" clause or a mutation, which have
+ * the same form.
+ */
+virJSONValuePtr
+virOVSDBClause(const char *column,
+               const char *function,
+               virJSONValuePtr *value)
+{
+    g_autoptr(virJSONValue) ret = virJSONValueNewArray();
+
+    if (virJSONValueArrayAppendString(ret, column) < 0 ||
+        virJSONValueArrayAppendString(ret, function) < 0 ||
+        virJSONValueArrayAppend(ret, *value) < 0)
+        return NULL;
+
+    *value = NULL;
+    return g_steal_pointer(&ret);
+}
+
+
+/**
+ * virOVSDBResultGetUUID:
+ * @results: transaction results
+ * @op: index of a "select" operation in the transaction
+ *
+ * Returns the UUID of the first row selected by @op, or NULL if
+ * it selected none.
+ */
+const char *
+virOVSDBResultGetUUID(virJSONValuePtr results,
+                      size_t op)
+{
+    virJSONValuePtr rows;
+    virJSONValuePtr uuid;
+
+    if (!(rows = virJSONValueObjectGetArray(virJSONValueArrayGet(results, op),
+                                            "rows")) ||
+        !(uuid = virJSONValueObjectGetArray(virJSONValueArrayGet(rows, 0),
+                                            "_uuid")))
+        return NULL;
+
+    return virJSONValueGetString(virJSONValueArrayGet(uuid, 1));
+}
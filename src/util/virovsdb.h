@@ -0,0 +1,67 @@
+/*
+ * virovsdb.h: minimal OVSDB JSON-RPC client
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "internal.h"
+#include "virjson.h"
+#include "virobject.h"
+
+typedef struct _virOVSDBClient virOVSDBClient;
+typedef virOVSDBClient *virOVSDBClientPtr;
+
+virOVSDBClientPtr virOVSDBClientNew(const char *path,
+                                    unsigned int timeout)
+    ATTRIBUTE_NONNULL(1);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(virOVSDBClient, virObjectUnref);
+
+bool virOVSDBClientIsConnected(virOVSDBClientPtr client)
+    ATTRIBUTE_NONNULL(1);
+
+int virOVSDBClientTransact(virOVSDBClientPtr client,
+                           virJSONValuePtr *ops,
+                           virJSONValuePtr *results)
+    ATTRIBUTE_NONNULL(1) ATTRIBUTE_NONNULL(2) G_GNUC_WARN_UNUSED_RESULT;
+
+int virOVSDBClientMonitor(virOVSDBClientPtr client)
+    ATTRIBUTE_NONNULL(1) G_GNUC_WARN_UNUSED_RESULT;
+
+int virOVSDBClientWaitCfg(virOVSDBClientPtr client,
+                          long long cfg)
+    ATTRIBUTE_NONNULL(1) G_GNUC_WARN_UNUSED_RESULT;
+
+int virOVSDBClientGetInterfaceStats(virOVSDBClientPtr client,
+                                    const char *ifname,
+                                    virJSONValuePtr *stats)
+    ATTRIBUTE_NONNULL(1) ATTRIBUTE_NONNULL(2) ATTRIBUTE_NONNULL(3)
+    G_GNUC_WARN_UNUSED_RESULT;
+
+/* Helpers for building transactions */
+virJSONValuePtr virOVSDBValueUUID(const char *uuid);
+virJSONValuePtr virOVSDBValueNamedUUID(const char *name);
+virJSONValuePtr virOVSDBValueSet(virJSONValuePtr *elems);
+virJSONValuePtr virOVSDBValueMap(virJSONValuePtr *pairs);
+virJSONValuePtr virOVSDBValuePair(virJSONValuePtr *key,
+                                  virJSONValuePtr *value);
+virJSONValuePtr virOVSDBClause(const char *column,
+                               const char *function,
+                               virJSONValuePtr *value);
+
+const char *virOVSDBResultGetUUID(virJSONValuePtr results,
+                                  size_t op);
@@ -40,6 +40,10 @@
 #include "virstorageencryption.h"
 #include "virsecret.h"
 #include "virutil.h"
+#include "virthread.h"
+
+#define LIBVIRT_VIRSTORAGEFILEPRIV_H_ALLOW
+#include "virstoragefilepriv.h"
 
 #define VIR_FROM_THIS VIR_FROM_STORAGE
 
@@ -5158,6 +5162,270 @@ virStorageFileReportBrokenChain(int errcode,
 }
 
 
+/*
+ * Daemon wide cache of image headers read while probing backing chains.
+ *
+ * Entries are keyed by everything identifying the image and are only
+ * used while device, inode, size, mtime and ctime of the image still
+ * match, which requires the storage backend to support stat. Images
+ * modified within the last VIR_STORAGE_HEADER_CACHE_SETTLE seconds are
+ * never cached as a rewrite within the same second would go unnoticed.
+ * Block devices are not cached at all as their timestamps don't track
+ * writes. Code rewriting headers (block jobs) should still call
+ * virStorageFileMetadataCacheInvalidate.
+ */
+#define VIR_STORAGE_HEADER_CACHE_MAX 256
+#define VIR_STORAGE_HEADER_CACHE_SETTLE 2
+
+static virMutex virStorageFileHeaderCacheLock = VIR_MUTEX_INITIALIZER;
+static virHashTablePtr virStorageFileHeaderCache;
+
+
+static void
+virStorageFileHeaderCacheEntryFree(void *payload)
+{
+    virStorageFileHeaderCacheEntryPtr entry = payload;
+
+    if (!entry)
+        return;
+
+    VIR_FREE(entry->buf);
+    VIR_FREE(entry);
+}
+
+
+/**
+ * virStorageFileHeaderCacheKey:
+ * @src: storage source
+ *
+ * Returns the header cache key of @src or NULL if its header must not be
+ * cached. Unlike virStorageFileGetUniqueIdentifier this doesn't require
+ * @src to be initialized.
+ */
+char *
+virStorageFileHeaderCacheKey(virStorageSourcePtr src)
+{
+    virStorageType actualType = virStorageSourceGetActualType(src);
+    g_auto(virBuffer) buf = VIR_BUFFER_INITIALIZER;
+    size_t i;
+
+    if (actualType == VIR_STORAGE_TYPE_FILE)
+        return g_strdup_printf("file\n%s", src->path);
+
+    if (actualType != VIR_STORAGE_TYPE_NETWORK)
+        return NULL;
+
+    virBufferAsprintf(&buf, "%s\n",
+                      virStorageNetProtocolTypeToString(src->protocol));
+    virBufferAsprintf(&buf, "volume=%s\n", NULLSTR_EMPTY(src->volume));
+    virBufferAsprintf(&buf, "path=%s\n", NULLSTR_EMPTY(src->path));
+    virBufferAsprintf(&buf, "snapshot=%s\n", NULLSTR_EMPTY(src->snapshot));
+    virBufferAsprintf(&buf, "config=%s\n", NULLSTR_EMPTY(src->configFile));
+
+    for (i = 0; i < src->nhosts; i++) {
+        virStorageNetHostDefPtr host = src->hosts + i;
+
+        virBufferAsprintf(&buf, "host=%s:%s:%u:%s\n",
+                          virStorageNetHostTransportTypeToString(host->transport),
+                          NULLSTR_EMPTY(host->name), host->port,
+                          NULLSTR_EMPTY(host->socket));
+    }
+
+    if (src->auth) {
+        virBufferAsprintf(&buf, "auth=%d:%s:",
+                          src->auth->authType,
+                          NULLSTR_EMPTY(src->auth->username));
+
+        switch ((virSecretLookupType) src->auth->seclookupdef.type) {
+        case VIR_SECRET_LOOKUP_TYPE_UUID: {
+            char uuidstr[VIR_UUID_STRING_BUFLEN];
+
+            virUUIDFormat(src->auth->seclookupdef.u.uuid, uuidstr);
+            virBufferAsprintf(&buf, "uuid:%s", uuidstr);
+            break;
+        }
+        case VIR_SECRET_LOOKUP_TYPE_USAGE:
+            virBufferAsprintf(&buf, "usage:%s",
+                              NULLSTR_EMPTY(src->auth->seclookupdef.u.usage));
+            break;
+        case VIR_SECRET_LOOKUP_TYPE_NONE:
+        case VIR_SECRET_LOOKUP_TYPE_LAST:
+            break;
+        }
+        virBufferAddLit(&buf, "\n");
+    }
+
+    return virBufferContentAndReset(&buf);
+}
+
+
+/*
+ * Fills @entry with the identity of the image @src, returns -1 if
+ * the image's header must not be cached.
+ */
+static int
+virStorageFileHeaderCacheStat(virStorageSourcePtr src,
+                              virStorageFileHeaderCacheEntryPtr entry)
+{
+    struct stat st;
+
+    if (virStorageFileStat(src, &st) < 0)
+        return -1;
+
+    if (!S_ISREG(st.st_mode))
+        return -1;
+
+    entry->valid = true;
+    entry->dev = st.st_dev;
+    entry->ino = st.st_ino;
+    entry->size = st.st_size;
+    entry->mtime = st.st_mtime;
+    entry->ctime = st.st_ctime;
+    return 0;
+}
+
+
+/**
+ * virStorageFileHeaderCacheLookup:
+ * @src: initialized storage source
+ * @key: cache key of @src
+ * @ident: filled with the current identity of @src
+ * @buf: filled with a copy of the cached header
+ * @len: filled with the length of @buf
+ *
+ * Looks up the cached header for @src. Entries whose image changed since
+ * they were stored are dropped. @ident is meant to be passed to
+ * virStorageFileHeaderCacheStore on a miss. No error is reported.
+ *
+ * Returns 1 on a hit, 0 on a miss.
+ */
+int
+virStorageFileHeaderCacheLookup(virStorageSourcePtr src,
+                                const char *key,
+                                virStorageFileHeaderCacheEntryPtr ident,
+                                char **buf,
+                                size_t *len)
+{
+    virStorageFileHeaderCacheEntryPtr entry;
+    int ret = 0;
+
+    if (virStorageFileHeaderCacheStat(src, ident) < 0)
+        return 0;
+
+    virMutexLock(&virStorageFileHeaderCacheLock);
+
+    if (!virStorageFileHeaderCache ||
+        !(entry = virHashLookup(virStorageFileHeaderCache, key)))
+        goto cleanup;
+
+    if (entry->dev != ident->dev ||
+        entry->ino != ident->ino ||
+        entry->size != ident->size ||
+        entry->mtime != ident->mtime ||
+        entry->ctime != ident->ctime) {
+        virHashRemoveEntry(virStorageFileHeaderCache, key);
+        goto cleanup;
+    }
+
+    *buf = g_new0(char, entry->len + 1);
+    memcpy(*buf, entry->buf, entry->len);
+    *len = entry->len;
+    ret = 1;
+
+ cleanup:
+    virMutexUnlock(&virStorageFileHeaderCacheLock);
+    VIR_DEBUG("header cache %s for '%s'", ret ? "hit" : "miss", key);
+    return ret;
+}
+
+
+/**
+ * virStorageFileHeaderCacheStore:
+ * @key: cache key of the image
+ * @ident: identity of the image as filled by virStorageFileHeaderCacheLookup
+ * @buf: header of the image
+ * @len: length of @buf
+ *
+ * Stores a copy of @buf unless the identity of the image is unknown or
+ * the image was modified too recently. No error is reported.
+ */
+void
+virStorageFileHeaderCacheStore(const char *key,
+                               virStorageFileHeaderCacheEntryPtr ident,
+                               const char *buf,
+                               size_t len)
+{
+    virStorageFileHeaderCacheEntryPtr entry;
+    time_t now = time(NULL);
+
+    if (!ident->valid)
+        return;
+
+    if (ident->mtime + VIR_STORAGE_HEADER_CACHE_SETTLE > now ||
+        ident->ctime + VIR_STORAGE_HEADER_CACHE_SETTLE > now)
+        return;
+
+    entry = g_new0(virStorageFileHeaderCacheEntry, 1);
+    *entry = *ident;
+    entry->buf = g_new0(char, len);
+    memcpy(entry->buf, buf, len);
+    entry->len = len;
+
+    virMutexLock(&virStorageFileHeaderCacheLock);
+
+    if (!virStorageFileHeaderCache &&
+        !(virStorageFileHeaderCache =
+          virHashCreate(VIR_STORAGE_HEADER_CACHE_MAX,
+                        virStorageFileHeaderCacheEntryFree))) {
+        virMutexUnlock(&virStorageFileHeaderCacheLock);
+        virResetLastError();
+        virStorageFileHeaderCacheEntryFree(entry);
+        return;
+    }
+
+    /* Keep the cache bounded, simply starting over is good enough
+     * given that the entries are cheap to recreate */
+    if (virHashSize(virStorageFileHeaderCache) >= VIR_STORAGE_HEADER_CACHE_MAX)
+        virHashRemoveAll(virStorageFileHeaderCache);
+
+    if (virHashUpdateEntry(virStorageFileHeaderCache, key, entry) < 0) {
+        virResetLastError();
+        virStorageFileHeaderCacheEntryFree(entry);
+    }
+
+    virMutexUnlock(&virStorageFileHeaderCacheLock);
+}
+
+
+/**
+ * virStorageFileMetadataCacheInvalidate:
+ * @src: storage source
+ *
+ * Drops cached image headers of all layers of the backing chain
+ * starting at @src. Must be called whenever libvirt rewrites image
+ * headers or changes the chain behind the cache's back, e.g. on
+ * completion of block jobs.
+ */
+void
+virStorageFileMetadataCacheInvalidate(virStorageSourcePtr src)
+{
+    virStorageSourcePtr n;
+
+    virMutexLock(&virStorageFileHeaderCacheLock);
+
+    if (virStorageFileHeaderCache) {
+        for (n = src; virStorageSourceIsBacking(n); n = n->backingStore) {
+            g_autofree char *key = virStorageFileHeaderCacheKey(n);
+
+            if (key)
+                virHashRemoveEntry(virStorageFileHeaderCache, key);
+        }
+    }
+
+    virMutexUnlock(&virStorageFileHeaderCacheLock);
+}
+
+
 static int
 virStorageFileGetMetadataRecurseReadHeader(virStorageSourcePtr src,
                                            virStorageSourcePtr parent,
@@ -5170,6 +5438,8 @@ virStorageFileGetMetadataRecurseReadHeader(virStorageSourcePtr src,
     int ret = -1;
     const char *uniqueName;
     ssize_t len;
+    g_autofree char *cacheKey = NULL;
+    virStorageFileHeaderCacheEntry ident = { 0 };
 
     if (virStorageFileInitAs(src, uid, gid) < 0)
         return -1;
@@ -5192,9 +5462,28 @@ virStorageFileGetMetadataRecurseReadHeader(virStorageSourcePtr src,
     if (virHashAddEntry(cycle, uniqueName, NULL) < 0)
         goto cleanup;
 
+    cacheKey = virStorageFileHeaderCacheKey(src);
+
+    if (cacheKey &&
+        virStorageFileHeaderCacheLookup(src, cacheKey, &ident,
+                                        buf, headerLen) == 1) {
+        /* The header may have been cached on behalf of a different
+         * uid/gid, so check the access the read would have required */
+        if (virStorageFileAccess(src, R_OK) == 0) {
+            ret = 0;
+            goto cleanup;
+        }
+
+        /* let the read report the error */
+        VIR_FREE(*buf);
+    }
+
     if ((len = virStorageFileRead(src, 0, VIR_STORAGE_MAX_HEADER, buf)) < 0)
         goto cleanup;
 
+    if (cacheKey)
+        virStorageFileHeaderCacheStore(cacheKey, &ident, *buf, len);
+
     *headerLen = len;
     ret = 0;
 
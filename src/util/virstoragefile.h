@@ -599,6 +599,8 @@ int virStorageFileGetBackingStoreStr(virStorageSourcePtr src,
                                      char **backing)
     ATTRIBUTE_NONNULL(1) ATTRIBUTE_NONNULL(2);
 
+void virStorageFileMetadataCacheInvalidate(virStorageSourcePtr src);
+
 void virStorageFileReportBrokenChain(int errcode,
                                      virStorageSourcePtr src,
                                      virStorageSourcePtr parent);
@@ -0,0 +1,52 @@
+/*
+ * virstoragefilepriv.h: internal functions exposed for the test suite
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LIBVIRT_VIRSTORAGEFILEPRIV_H_ALLOW
+# error "virstoragefilepriv.h may only be included by virstoragefile.c or test suites"
+#endif /* LIBVIRT_VIRSTORAGEFILEPRIV_H_ALLOW */
+
+#pragma once
+
+#include "virstoragefile.h"
+
+typedef struct _virStorageFileHeaderCacheEntry virStorageFileHeaderCacheEntry;
+typedef virStorageFileHeaderCacheEntry *virStorageFileHeaderCacheEntryPtr;
+struct _virStorageFileHeaderCacheEntry {
+    char *buf;
+    size_t len;
+
+    bool valid;
+    dev_t dev;
+    ino_t ino;
+    off_t size;
+    time_t mtime;
+    time_t ctime;
+};
+
+char *virStorageFileHeaderCacheKey(virStorageSourcePtr src);
+
+int virStorageFileHeaderCacheLookup(virStorageSourcePtr src,
+                                    const char *key,
+                                    virStorageFileHeaderCacheEntryPtr ident,
+                                    char **buf,
+                                    size_t *len);
+
+void virStorageFileHeaderCacheStore(const char *key,
+                                    virStorageFileHeaderCacheEntryPtr ident,
+                                    const char *buf,
+                                    size_t len);
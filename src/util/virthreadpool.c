@@ -26,9 +26,18 @@
 #include "viralloc.h"
 #include "virthread.h"
 #include "virerror.h"
+#include "virhash.h"
 
 #define VIR_FROM_THIS VIR_FROM_NONE
 
+/* Upper bounds of the job queue latency histogram buckets, in
+ * microseconds. The last bucket is unbounded. */
+static const unsigned long long virThreadPoolLatencyLimits[] = {
+    100, 1000, 10000, 100000, 1000000, 0,
+};
+
+#define VIR_THREADPOOL_LATENCY_BUCKETS G_N_ELEMENTS(virThreadPoolLatencyLimits)
+
 typedef struct _virThreadPoolJob virThreadPoolJob;
 typedef virThreadPoolJob *virThreadPoolJobPtr;
 
@@ -37,9 +46,23 @@ struct _virThreadPoolJob {
     virThreadPoolJobPtr next;
     unsigned int priority;
 
+    /* Jobs sharing a @key are served round-robin with other keys,
+     * see virThreadPoolJobInsert */
+    const void *key;
+    unsigned long long round;
+    unsigned long long queued;
+
     void *data;
 };
 
+typedef struct _virThreadPoolKey virThreadPoolKey;
+typedef virThreadPoolKey *virThreadPoolKeyPtr;
+
+struct _virThreadPoolKey {
+    size_t njobs;
+    unsigned long long round;
+};
+
 typedef struct _virThreadPoolJobList virThreadPoolJobList;
 typedef virThreadPoolJobList *virThreadPoolJobListPtr;
 
@@ -58,6 +81,9 @@ struct _virThreadPool {
     void *jobOpaque;
     virThreadPoolJobList jobList;
     size_t jobQueueDepth;
+    virHashTablePtr jobKeys;
+    unsigned long long round;
+    unsigned long long latency[VIR_THREADPOOL_LATENCY_BUCKETS];
 
     virMutex mutex;
     virCond cond;
@@ -89,6 +115,137 @@ static inline bool virThreadPoolWorkerQuitHelper(size_t count, size_t limit)
     return count > limit;
 }
 
+static uint32_t
+virThreadPoolKeyCode(const void *name, uint32_t seed)
+{
+    return virHashCodeGen(&name, sizeof(name), seed);
+}
+
+
+static bool
+virThreadPoolKeyEqual(const void *namea, const void *nameb)
+{
+    return namea == nameb;
+}
+
+
+static void *
+virThreadPoolKeyCopy(const void *name)
+{
+    return (void *)name;
+}
+
+
+static char *
+virThreadPoolKeyPrintHuman(const void *name)
+{
+    return g_strdup_printf("%p", name);
+}
+
+
+/*
+ * Jobs are kept sorted by their round. A job without a key is simply
+ * appended. A keyed job is given the round after the last one of its key,
+ * or the one after the round currently being served if the key has no
+ * queued jobs, and is placed after every job of the same or an earlier
+ * round. Keys with jobs pending thus take turns instead of being served in
+ * the order their jobs arrived, so that one key flooding the pool cannot
+ * starve the others.
+ */
+static void
+virThreadPoolJobInsert(virThreadPoolPtr pool,
+                       virThreadPoolJobPtr job)
+{
+    virThreadPoolJobPtr prev = pool->jobList.tail;
+
+    if (job->key) {
+        virThreadPoolKeyPtr key = virHashLookup(pool->jobKeys, job->key);
+
+        if (!key) {
+            key = g_new0(virThreadPoolKey, 1);
+            ignore_value(virHashAddEntry(pool->jobKeys, job->key, key));
+        }
+
+        job->round = MAX(key->round, pool->round) + 1;
+        key->round = job->round;
+        key->njobs++;
+
+        while (prev && prev->round > job->round)
+            prev = prev->prev;
+    } else {
+        job->round = MAX(pool->round, prev ? prev->round : 0);
+    }
+
+    job->prev = prev;
+    if (prev) {
+        job->next = prev->next;
+        prev->next = job;
+    } else {
+        job->next = pool->jobList.head;
+        pool->jobList.head = job;
+    }
+    if (job->next)
+        job->next->prev = job;
+    else
+        pool->jobList.tail = job;
+
+    if (job->priority &&
+        (!pool->jobList.firstPrio ||
+         pool->jobList.firstPrio->round > job->round))
+        pool->jobList.firstPrio = job;
+
+    pool->jobQueueDepth++;
+}
+
+
+static void
+virThreadPoolJobRemove(virThreadPoolPtr pool,
+                       virThreadPoolJobPtr job)
+{
+    unsigned long long latency = g_get_monotonic_time() - job->queued;
+    size_t i;
+
+    if (job == pool->jobList.firstPrio) {
+        virThreadPoolJobPtr tmp = job->next;
+        while (tmp) {
+            if (tmp->priority)
+                break;
+            tmp = tmp->next;
+        }
+        pool->jobList.firstPrio = tmp;
+    }
+
+    if (job->prev)
+        job->prev->next = job->next;
+    else
+        pool->jobList.head = job->next;
+    if (job->next)
+        job->next->prev = job->prev;
+    else
+        pool->jobList.tail = job->prev;
+
+    pool->jobQueueDepth--;
+
+    if (job->key) {
+        virThreadPoolKeyPtr key = virHashLookup(pool->jobKeys, job->key);
+
+        if (key && --key->njobs == 0)
+            virHashRemoveEntry(pool->jobKeys, job->key);
+    }
+
+    /* Priority workers may take jobs out of order, the round being served
+     * is only ever advanced by the head of the queue */
+    if (!job->prev && job->round > pool->round)
+        pool->round = job->round;
+
+    for (i = 0; i < VIR_THREADPOOL_LATENCY_BUCKETS - 1; i++) {
+        if (latency < virThreadPoolLatencyLimits[i])
+            break;
+    }
+    pool->latency[i]++;
+}
+
+
 static void virThreadPoolWorker(void *opaque)
 {
     struct virThreadPoolWorkerData *data = opaque;
@@ -138,26 +295,7 @@ static void virThreadPoolWorker(void *opaque)
             job = pool->jobList.head;
         }
 
-        if (job == pool->jobList.firstPrio) {
-            virThreadPoolJobPtr tmp = job->next;
-            while (tmp) {
-                if (tmp->priority)
-                    break;
-                tmp = tmp->next;
-            }
-            pool->jobList.firstPrio = tmp;
-        }
-
-        if (job->prev)
-            job->prev->next = job->next;
-        else
-            pool->jobList.head = job->next;
-        if (job->next)
-            job->next->prev = job->prev;
-        else
-            pool->jobList.tail = job->prev;
-
-        pool->jobQueueDepth--;
+        virThreadPoolJobRemove(pool, job);
 
         virMutexUnlock(&pool->mutex);
         (pool->jobFunc)(job->data, pool->jobOpaque);
@@ -241,6 +379,14 @@ virThreadPoolNewFull(size_t minWorkers,
     pool->jobName = name;
     pool->jobOpaque = opaque;
 
+    if (!(pool->jobKeys = virHashCreateFull(32, virHashValueFree,
+                                            virThreadPoolKeyCode,
+                                            virThreadPoolKeyEqual,
+                                            virThreadPoolKeyCopy,
+                                            virThreadPoolKeyPrintHuman,
+                                            NULL)))
+        goto error;
+
     if (virMutexInit(&pool->mutex) < 0)
         goto error;
     if (virCondInit(&pool->cond) < 0)
@@ -296,6 +442,7 @@ void virThreadPoolFree(virThreadPoolPtr pool)
         VIR_FREE(job);
     }
 
+    virHashFree(pool->jobKeys);
     VIR_FREE(pool->workers);
     virMutexUnlock(&pool->mutex);
     virMutexDestroy(&pool->mutex);
@@ -375,15 +522,54 @@ size_t virThreadPoolGetJobQueueDepth(virThreadPoolPtr pool)
     return ret;
 }
 
+/**
+ * virThreadPoolGetJobQueueLatency:
+ * @pool: thread pool
+ * @limits: filled with the upper bound of each bucket in microseconds,
+ *          zero for the last, unbounded one
+ * @counts: filled with the number of jobs per bucket
+ *
+ * Reports a histogram of the time jobs spent queued before a worker
+ * picked them up, counted since the pool was created.
+ *
+ * Returns the number of buckets, with @limits and @counts allocated to
+ * hold as many elements.
+ */
+size_t virThreadPoolGetJobQueueLatency(virThreadPoolPtr pool,
+                                       unsigned long long **limits,
+                                       unsigned long long **counts)
+{
+    size_t n = VIR_THREADPOOL_LATENCY_BUCKETS;
+
+    *limits = g_new0(unsigned long long, n);
+    *counts = g_new0(unsigned long long, n);
+
+    memcpy(*limits, virThreadPoolLatencyLimits, sizeof(virThreadPoolLatencyLimits));
+
+    virMutexLock(&pool->mutex);
+    memcpy(*counts, pool->latency, sizeof(pool->latency));
+    virMutexUnlock(&pool->mutex);
+
+    return n;
+}
+
 /*
  * @priority - job priority
+ * @key - jobs with the same non-NULL key are scheduled fairly against
+ *        jobs of other keys rather than in FIFO order
  * Return: 0 on success, -1 otherwise
  */
-int virThreadPoolSendJob(virThreadPoolPtr pool,
-                         unsigned int priority,
-                         void *jobData)
+int virThreadPoolSendJobFull(virThreadPoolPtr pool,
+                             unsigned int priority,
+                             const void *key,
+                             void *jobData)
 {
-    virThreadPoolJobPtr job;
+    g_autofree virThreadPoolJobPtr job = g_new0(virThreadPoolJob, 1);
+
+    job->data = jobData;
+    job->priority = priority;
+    job->key = key;
+    job->queued = g_get_monotonic_time();
 
     virMutexLock(&pool->mutex);
     if (pool->quit)
@@ -394,26 +580,12 @@ int virThreadPoolSendJob(virThreadPoolPtr pool,
         virThreadPoolExpand(pool, 1, false) < 0)
         goto error;
 
-    if (VIR_ALLOC(job) < 0)
-        goto error;
-
-    job->data = jobData;
-    job->priority = priority;
-
-    job->prev = pool->jobList.tail;
-    if (pool->jobList.tail)
-        pool->jobList.tail->next = job;
-    pool->jobList.tail = job;
-
-    if (!pool->jobList.head)
-        pool->jobList.head = job;
-
-    if (priority && !pool->jobList.firstPrio)
-        pool->jobList.firstPrio = job;
-
-    pool->jobQueueDepth++;
+    virThreadPoolJobInsert(pool, g_steal_pointer(&job));
 
-    virCondSignal(&pool->cond);
+    /* Nobody is waiting if all workers are busy, they will pick the job
+     * once they are done */
+    if (pool->freeWorkers > 0)
+        virCondSignal(&pool->cond);
     if (priority)
         virCondSignal(&pool->prioCond);
 
@@ -425,6 +597,13 @@ int virThreadPoolSendJob(virThreadPoolPtr pool,
     return -1;
 }
 
+int virThreadPoolSendJob(virThreadPoolPtr pool,
+                         unsigned int priority,
+                         void *jobData)
+{
+    return virThreadPoolSendJobFull(pool, priority, NULL, jobData);
+}
+
 int
 virThreadPoolSetParameters(virThreadPoolPtr pool,
                            long long int minWorkers,
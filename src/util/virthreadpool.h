@@ -44,6 +44,9 @@ size_t virThreadPoolGetPriorityWorkers(virThreadPoolPtr pool);
 size_t virThreadPoolGetCurrentWorkers(virThreadPoolPtr pool);
 size_t virThreadPoolGetFreeWorkers(virThreadPoolPtr pool);
 size_t virThreadPoolGetJobQueueDepth(virThreadPoolPtr pool);
+size_t virThreadPoolGetJobQueueLatency(virThreadPoolPtr pool,
+                                       unsigned long long **limits,
+                                       unsigned long long **counts);
 
 void virThreadPoolFree(virThreadPoolPtr pool);
 
@@ -52,6 +55,12 @@ int virThreadPoolSendJob(virThreadPoolPtr pool,
                          void *jobdata) ATTRIBUTE_NONNULL(1)
                                         G_GNUC_WARN_UNUSED_RESULT;
 
+int virThreadPoolSendJobFull(virThreadPoolPtr pool,
+                             unsigned int priority,
+                             const void *key,
+                             void *jobdata) ATTRIBUTE_NONNULL(1)
+                                            G_GNUC_WARN_UNUSED_RESULT;
+
 int virThreadPoolSetParameters(virThreadPoolPtr pool,
                                long long int minWorkers,
                                long long int maxWorkers,
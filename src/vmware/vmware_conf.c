@@ -140,6 +140,7 @@ vmwareLoadDomains(struct vmware_driver *driver)
     char *str;
     char *saveptr = NULL;
     virCommandPtr cmd;
+    int pid;
 
     ctx.parseFileName = vmwareCopyVMXFileName;
     ctx.formatFileName = NULL;
@@ -179,12 +180,13 @@ vmwareLoadDomains(struct vmware_driver *driver)
 
         vmwareDomainConfigDisplay(pDomain, vmdef);
 
-        if ((vm->def->id = vmwareExtractPid(vmxPath)) < 0)
+        if ((pid = vmwareExtractPid(vmxPath)) < 0)
             goto cleanup;
+        virDomainObjSetID(vm, pid);
         /* vmrun list only reports running vms */
         virDomainObjSetState(vm, VIR_DOMAIN_RUNNING,
                              VIR_DOMAIN_RUNNING_UNKNOWN);
-        vm->persistent = 1;
+        virDomainObjSetPersistent(vm, true);
 
         virDomainObjEndAPI(&vm);
 
@@ -323,7 +323,7 @@ vmwareUpdateVMStatus(struct vmware_driver *driver, virDomainObjPtr vm)
     }
 
     if (!found) {
-        vm->def->id = -1;
+        virDomainObjSetID(vm, -1);
         newState = VIR_DOMAIN_SHUTOFF;
     }
 
@@ -354,7 +354,7 @@ vmwareStopVM(struct vmware_driver *driver,
     if (virRun(cmd, NULL) < 0)
         return -1;
 
-    vm->def->id = -1;
+    virDomainObjSetID(vm, -1);
     virDomainObjSetState(vm, VIR_DOMAIN_SHUTOFF, reason);
 
     return 0;
@@ -368,6 +368,7 @@ vmwareStartVM(struct vmware_driver *driver, virDomainObjPtr vm)
         PROGRAM_SENTINEL, PROGRAM_SENTINEL, NULL
     };
     const char *vmxPath = ((vmwareDomainPtr) vm->privateData)->vmxPath;
+    int pid;
 
     if (virDomainObjGetState(vm, NULL) != VIR_DOMAIN_SHUTOFF) {
         virReportError(VIR_ERR_OPERATION_INVALID, "%s",
@@ -385,10 +386,11 @@ vmwareStartVM(struct vmware_driver *driver, virDomainObjPtr vm)
     if (virRun(cmd, NULL) < 0)
         return -1;
 
-    if ((vm->def->id = vmwareExtractPid(vmxPath)) < 0) {
+    if ((pid = vmwareExtractPid(vmxPath)) < 0) {
         vmwareStopVM(driver, vm, VIR_DOMAIN_SHUTOFF_FAILED);
         return -1;
     }
+    virDomainObjSetID(vm, pid);
 
     virDomainObjSetState(vm, VIR_DOMAIN_RUNNING, VIR_DOMAIN_RUNNING_BOOTED);
 
@@ -457,7 +459,7 @@ vmwareDomainDefineXMLFlags(virConnectPtr conn, const char *xml, unsigned int fla
     vmwareDomainConfigDisplay(pDomain, vmdef);
 
     vmdef = NULL;
-    vm->persistent = 1;
+    virDomainObjSetPersistent(vm, true);
 
     dom = virGetDomain(conn, vm->def->name, vm->def->uuid, -1);
 
@@ -795,7 +797,7 @@ vmwareDomainUndefineFlags(virDomainPtr dom,
         goto cleanup;
 
     if (virDomainObjIsActive(vm))
-        vm->persistent = 0;
+        virDomainObjSetPersistent(vm, false);
     else
         virDomainObjListRemove(driver->domains, vm);
 
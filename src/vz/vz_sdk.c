@@ -1383,7 +1383,7 @@ prlsdkConvertDomainState(VIRTUAL_MACHINE_STATE domainState,
     case VMS_MOUNTED:
         virDomainObjSetState(dom, VIR_DOMAIN_SHUTOFF,
                              VIR_DOMAIN_SHUTOFF_SHUTDOWN);
-        dom->def->id = -1;
+        virDomainObjSetID(dom, -1);
         break;
     case VMS_STARTING:
     case VMS_COMPACTING:
@@ -1393,60 +1393,60 @@ prlsdkConvertDomainState(VIRTUAL_MACHINE_STATE domainState,
     case VMS_RUNNING:
         virDomainObjSetState(dom, VIR_DOMAIN_RUNNING,
                              VIR_DOMAIN_RUNNING_BOOTED);
-        dom->def->id = envId;
+        virDomainObjSetID(dom, envId);
         break;
     case VMS_PAUSED:
         virDomainObjSetState(dom, VIR_DOMAIN_PAUSED,
                              VIR_DOMAIN_PAUSED_USER);
-        dom->def->id = envId;
+        virDomainObjSetID(dom, envId);
         break;
     case VMS_SUSPENDED:
     case VMS_DELETING_STATE:
     case VMS_SUSPENDING_SYNC:
         virDomainObjSetState(dom, VIR_DOMAIN_SHUTOFF,
                              VIR_DOMAIN_SHUTOFF_SAVED);
-        dom->def->id = -1;
+        virDomainObjSetID(dom, -1);
         break;
     case VMS_STOPPING:
         virDomainObjSetState(dom, VIR_DOMAIN_SHUTDOWN,
                              VIR_DOMAIN_SHUTDOWN_USER);
-        dom->def->id = envId;
+        virDomainObjSetID(dom, envId);
         break;
     case VMS_SNAPSHOTING:
         virDomainObjSetState(dom, VIR_DOMAIN_PAUSED,
                              VIR_DOMAIN_PAUSED_SNAPSHOT);
-        dom->def->id = envId;
+        virDomainObjSetID(dom, envId);
         break;
     case VMS_MIGRATING:
         virDomainObjSetState(dom, VIR_DOMAIN_PAUSED,
                              VIR_DOMAIN_PAUSED_MIGRATION);
-        dom->def->id = envId;
+        virDomainObjSetID(dom, envId);
         break;
     case VMS_SUSPENDING:
         virDomainObjSetState(dom, VIR_DOMAIN_PAUSED,
                              VIR_DOMAIN_PAUSED_SAVE);
-        dom->def->id = envId;
+        virDomainObjSetID(dom, envId);
         break;
     case VMS_RESTORING:
         virDomainObjSetState(dom, VIR_DOMAIN_RUNNING,
                              VIR_DOMAIN_RUNNING_RESTORED);
-        dom->def->id = envId;
+        virDomainObjSetID(dom, envId);
         break;
     case VMS_CONTINUING:
         virDomainObjSetState(dom, VIR_DOMAIN_RUNNING,
                              VIR_DOMAIN_RUNNING_UNPAUSED);
-        dom->def->id = envId;
+        virDomainObjSetID(dom, envId);
         break;
     case VMS_RESUMING:
         virDomainObjSetState(dom, VIR_DOMAIN_RUNNING,
                              VIR_DOMAIN_RUNNING_RESTORED);
-        dom->def->id = envId;
+        virDomainObjSetID(dom, envId);
         break;
     case VMS_UNKNOWN:
     default:
         virDomainObjSetState(dom, VIR_DOMAIN_NOSTATE,
                              VIR_DOMAIN_NOSTATE_UNKNOWN);
-        dom->def->id = -1;
+        virDomainObjSetID(dom, -1);
         break;
     }
 }
@@ -1943,7 +1943,7 @@ prlsdkLoadDomain(vzDriverPtr driver,
         pdom = dom->privateData;
         pdom->sdkdom = sdkdom;
         PrlHandle_AddRef(sdkdom);
-        dom->persistent = 1;
+        virDomainObjSetPersistent(dom, true);
     } else {
         /* assign new virDomainDef without any checks
          * we can't use virDomainObjAssignDef, because it checks
@@ -1958,9 +1958,9 @@ prlsdkLoadDomain(vzDriverPtr driver,
     prlsdkConvertDomainState(domainState, envId, dom);
 
     if (autostart == PAO_VM_START_ON_LOAD)
-        dom->autostart = 1;
+        virDomainObjSetAutostart(dom, true);
     else
-        dom->autostart = 0;
+        virDomainObjSetAutostart(dom, false);
 
     return dom;
 
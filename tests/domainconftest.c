@@ -76,6 +76,77 @@ static int testGetFilesystem(const void *opaque)
     return ret;
 }
 
+static int
+testXMLCache(const void *opaque G_GNUC_UNUSED)
+{
+    g_autofree char *filename = NULL;
+    virDomainDefPtr def = NULL;
+    virDomainDefPtr copy = NULL;
+    const char *cached;
+    unsigned int flags;
+    int ret = -1;
+
+    filename = g_strdup_printf("%s/domainconfdata/getfilesystem.xml",
+                               abs_srcdir);
+
+    if (!(def = virDomainDefParseFile(filename, xmlopt, NULL, 0)))
+        goto cleanup;
+
+    virDomainDefXMLCacheStore(def, 0, "<domain/>");
+    if (!(cached = virDomainDefXMLCacheLookup(def, 0)) ||
+        STRNEQ(cached, "<domain/>")) {
+        VIR_TEST_DEBUG("stored XML not found");
+        goto cleanup;
+    }
+
+    if (virDomainDefXMLCacheLookup(def, 1)) {
+        VIR_TEST_DEBUG("unexpected XML for different flags");
+        goto cleanup;
+    }
+
+    /* the copy is a separate definition with its own cache */
+    if (virDomainDefDeepCopy(def, xmlopt, &copy) < 0)
+        goto cleanup;
+    if (copy && virDomainDefXMLCacheLookup(copy, 0)) {
+        VIR_TEST_DEBUG("cached XML copied along with the definition");
+        goto cleanup;
+    }
+
+    /* saving the definition means it was modified */
+    if (virDomainDefSave(def, xmlopt, NULL) < 0)
+        goto cleanup;
+    if (virDomainDefXMLCacheLookup(def, 0)) {
+        VIR_TEST_DEBUG("cached XML survived virDomainDefSave");
+        goto cleanup;
+    }
+
+    /* the oldest entry is evicted once the cache is full */
+    for (flags = 0; flags <= VIR_DOMAIN_DEF_XML_CACHE_SIZE; flags++)
+        virDomainDefXMLCacheStore(def, flags, "<domain/>");
+
+    if (virDomainDefXMLCacheLookup(def, 0) ||
+        !virDomainDefXMLCacheLookup(def, VIR_DOMAIN_DEF_XML_CACHE_SIZE)) {
+        VIR_TEST_DEBUG("unexpected eviction");
+        goto cleanup;
+    }
+
+    virDomainDefBumpGeneration(def);
+    for (flags = 0; flags <= VIR_DOMAIN_DEF_XML_CACHE_SIZE; flags++) {
+        if (virDomainDefXMLCacheLookup(def, flags)) {
+            VIR_TEST_DEBUG("cached XML survived generation bump");
+            goto cleanup;
+        }
+    }
+
+    ret = 0;
+
+ cleanup:
+    virDomainDefFree(def);
+    virDomainDefFree(copy);
+    return ret;
+}
+
+
 static int
 mymain(void)
 {
@@ -103,6 +174,9 @@ mymain(void)
     DO_TEST_GET_FS("/dev/pts", false);
     DO_TEST_GET_FS("/doesnotexist", false);
 
+    if (virTestRun("XML cache", testXMLCache, NULL) < 0)
+        ret = -1;
+
     virObjectUnref(caps);
     virObjectUnref(xmlopt);
 
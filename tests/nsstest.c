@@ -178,6 +178,10 @@ mymain(void)
     DO_TEST("gentoo", AF_INET6, "2001:1234:dead:beef::2");
     DO_TEST("gentoo", AF_UNSPEC, "192.168.122.254");
     DO_TEST("non-existent", AF_UNSPEC, NULL);
+    DO_TEST("ubuntu", AF_INET, "192.168.122.6");
+    DO_TEST("arch", AF_INET, NULL);
+    DO_TEST("alpine", AF_INET, "192.168.122.7");
+    DO_TEST("centos", AF_INET, NULL);
 # else /* defined(LIBVIRT_NSS_GUEST) */
     DO_TEST("debian", AF_INET, "192.168.122.2");
     DO_TEST("suse", AF_INET, "192.168.122.3");
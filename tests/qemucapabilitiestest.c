@@ -41,9 +41,14 @@ struct _testQemuData {
     const char *version;
     const char *archName;
     const char *suffix;
+    char *tmpdir;
+    unsigned long long xmlLoadTime;
+    unsigned long long binaryLoadTime;
     int ret;
 };
 
+#define TMPDIR_TEMPLATE abs_builddir "/qemucapabilitiestest-XXXXXX"
+
 
 static int
 testQemuDataInit(testQemuDataPtr data)
@@ -53,6 +58,14 @@ testQemuDataInit(testQemuDataPtr data)
 
     data->outputDir = TEST_QEMU_CAPS_PATH;
 
+    data->tmpdir = g_strdup(TMPDIR_TEMPLATE);
+    if (!g_mkdtemp(data->tmpdir)) {
+        VIR_FREE(data->tmpdir);
+        return -1;
+    }
+
+    data->xmlLoadTime = 0;
+    data->binaryLoadTime = 0;
     data->ret = 0;
 
     return 0;
@@ -63,6 +76,10 @@ static void
 testQemuDataReset(testQemuDataPtr data)
 {
     qemuTestDriverFree(&data->driver);
+    if (data->tmpdir) {
+        rmdir(data->tmpdir);
+        VIR_FREE(data->tmpdir);
+    }
 }
 
 
@@ -181,6 +198,61 @@ testQemuCapsCopy(const void *opaque)
 }
 
 
+/* Stores the capabilities in the binary cache format, loads them back and
+ * checks they format to the same XML. Time spent loading the XML and the
+ * binary cache is accumulated to compare the two formats. */
+static int
+testQemuCapsBinary(const void *opaque)
+{
+    testQemuData *data = (void *) opaque;
+    virArch arch = virArchFromString(data->archName);
+    g_autofree char *capsFile = NULL;
+    g_autofree char *binFile = NULL;
+    g_autofree char *actual = NULL;
+    g_autoptr(virQEMUCaps) orig = NULL;
+    g_autoptr(virQEMUCaps) loaded = NULL;
+    unsigned long long start;
+    int ret = -1;
+
+    capsFile = g_strdup_printf("%s/%s_%s.%s.xml",
+                               data->outputDir, data->prefix, data->version,
+                               data->archName);
+    binFile = g_strdup_printf("%s/%s_%s.%s.bin",
+                              data->tmpdir, data->prefix, data->version,
+                              data->archName);
+
+    start = g_get_monotonic_time();
+    if (!(orig = qemuTestParseCapabilitiesArch(arch, capsFile)))
+        return -1;
+    data->xmlLoadTime += g_get_monotonic_time() - start;
+
+    if (virQEMUCapsSaveBinaryCache(orig, binFile) < 0)
+        goto cleanup;
+
+    if (!(loaded = virQEMUCapsNewBinary(virQEMUCapsGetBinary(orig))))
+        goto cleanup;
+
+    start = g_get_monotonic_time();
+    if (virQEMUCapsLoadBinaryCache(arch, loaded, binFile) != 1) {
+        VIR_TEST_DEBUG("binary cache '%s' was not loaded", binFile);
+        goto cleanup;
+    }
+    data->binaryLoadTime += g_get_monotonic_time() - start;
+
+    if (!(actual = virQEMUCapsFormatCache(loaded)))
+        goto cleanup;
+
+    if (virTestCompareToFile(actual, capsFile) < 0)
+        goto cleanup;
+
+    ret = 0;
+
+ cleanup:
+    unlink(binFile);
+    return ret;
+}
+
+
 static int
 doCapsTest(const char *inputDir,
            const char *prefix,
@@ -192,9 +264,11 @@ doCapsTest(const char *inputDir,
     testQemuDataPtr data = (testQemuDataPtr) opaque;
     g_autofree char *title = NULL;
     g_autofree char *copyTitle = NULL;
+    g_autofree char *binaryTitle = NULL;
 
     title = g_strdup_printf("%s (%s)", version, archName);
     copyTitle = g_strdup_printf("copy %s (%s)", version, archName);
+    binaryTitle = g_strdup_printf("binary %s (%s)", version, archName);
 
     data->inputDir = inputDir;
     data->prefix = prefix;
@@ -208,6 +282,9 @@ doCapsTest(const char *inputDir,
     if (virTestRun(copyTitle, testQemuCapsCopy, data) < 0)
         data->ret = -1;
 
+    if (virTestRun(binaryTitle, testQemuCapsBinary, data) < 0)
+        data->ret = -1;
+
     return 0;
 }
 
@@ -241,6 +318,10 @@ mymain(void)
      * file has been added, run "VIR_TEST_REGENERATE_OUTPUT=1 make check".
      */
 
+    VIR_TEST_DEBUG("loading all capabilities took %lluus from XML and "
+                   "%lluus from the binary cache",
+                   data.xmlLoadTime, data.binaryLoadTime);
+
     testQemuDataReset(&data);
 
     return (data.ret == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
@@ -0,0 +1,313 @@
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+
+#include "testutils.h"
+
+#ifdef WITH_QEMU
+
+# include "internal.h"
+# include "virfile.h"
+# include "virstring.h"
+# include "conf/domain_conf.h"
+# include "qemu/qemu_domain.h"
+
+# include "testutilsqemu.h"
+
+# define VIR_FROM_THIS VIR_FROM_QEMU
+
+static virQEMUDriver driver;
+
+
+/* Fills in state a running domain has but which is never formatted
+ * into, or only into the status XML */
+static void
+testDeepCopySetRuntime(virDomainDefPtr def)
+{
+    virStorageSourcePtr n;
+    size_t i;
+
+    def->id = 42;
+
+    for (i = 0; i < def->ndisks; i++) {
+        virDomainDiskDefPtr disk = def->disks[i];
+
+        for (n = disk->src; n; n = n->backingStore) {
+            n->id = i + 1;
+            n->tlsFromConfig = true;
+            n->nodeformat = g_strdup("libvirt-1-format");
+            n->nodestorage = g_strdup("libvirt-1-storage");
+            n->relPath = g_strdup("rel.img");
+            n->backingStoreRaw = g_strdup("base.img");
+            n->backingStoreRawFormat = VIR_STORAGE_FILE_QCOW2;
+            n->capacity = 1024;
+            n->allocation = 512;
+            n->physical = 768;
+            n->tlsAlias = g_strdup("objlibvirt-1-storage_tls0");
+            n->debug = true;
+            n->debugLevel = 4;
+            n->iomode = VIR_DOMAIN_DISK_IO_NATIVE;
+            n->cachemode = VIR_DOMAIN_DISK_CACHE_DISABLE;
+            n->floppyimg = true;
+            n->hostcdrom = true;
+        }
+    }
+}
+
+
+# define TEST_FIELD(a, b, field) \
+    do { \
+        if ((a)->field != (b)->field) { \
+            VIR_TEST_DEBUG("'%s' differs from the XML round trip", #field); \
+            return -1; \
+        } \
+    } while (0)
+
+# define TEST_STR_FIELD(a, b, field) \
+    do { \
+        if (STRNEQ_NULLABLE((a)->field, (b)->field)) { \
+            VIR_TEST_DEBUG("'%s' differs from the XML round trip", #field); \
+            return -1; \
+        } \
+    } while (0)
+
+/* Compares the fields of @copy and @expect which aren't formatted into
+ * the XML and thus can't be compared through it */
+static int
+testDeepCopyCompareRuntime(virDomainDefPtr copy,
+                           virDomainDefPtr expect)
+{
+    size_t i;
+
+    TEST_FIELD(copy, expect, id);
+    TEST_FIELD(copy, expect, genidGenerated);
+    TEST_FIELD(copy, expect, ndisks);
+
+    for (i = 0; i < copy->ndisks; i++) {
+        virDomainDiskDefPtr a = copy->disks[i];
+        virDomainDiskDefPtr b = expect->disks[i];
+        virStorageSourcePtr n = a->src;
+        virStorageSourcePtr m = b->src;
+
+        TEST_FIELD(a, b, info.pciConnectFlags);
+        TEST_FIELD(a, b, info.pciAddrExtFlags);
+        TEST_FIELD(a, b, info.isolationGroup);
+        TEST_FIELD(a, b, info.isolationGroupLocked);
+        TEST_FIELD(a, b, mirrorState);
+        TEST_FIELD(a, b, mirrorJob);
+
+        for (; n && m; n = n->backingStore, m = m->backingStore) {
+            TEST_FIELD(n, m, id);
+            TEST_FIELD(n, m, tlsFromConfig);
+            TEST_STR_FIELD(n, m, nodeformat);
+            TEST_STR_FIELD(n, m, nodestorage);
+            TEST_FIELD(n, m, detected);
+            TEST_STR_FIELD(n, m, relPath);
+            TEST_STR_FIELD(n, m, backingStoreRaw);
+            TEST_FIELD(n, m, backingStoreRawFormat);
+            TEST_STR_FIELD(n, m, externalDataStoreRaw);
+            TEST_FIELD(n, m, capacity);
+            TEST_FIELD(n, m, allocation);
+            TEST_FIELD(n, m, physical);
+            TEST_FIELD(n, m, has_allocation);
+            TEST_STR_FIELD(n, m, tlsAlias);
+            TEST_STR_FIELD(n, m, tlsCertdir);
+            TEST_FIELD(n, m, debug);
+            TEST_FIELD(n, m, debugLevel);
+            TEST_FIELD(n, m, iomode);
+            TEST_FIELD(n, m, cachemode);
+            TEST_FIELD(n, m, discard);
+            TEST_FIELD(n, m, detect_zeroes);
+            TEST_FIELD(n, m, floppyimg);
+            TEST_FIELD(n, m, hostcdrom);
+            TEST_STR_FIELD(n, m, ssh_user);
+
+            if (!!n->externalDataStore != !!m->externalDataStore) {
+                VIR_TEST_DEBUG("external data store differs from the XML round trip");
+                return -1;
+            }
+        }
+
+        if (n || m) {
+            VIR_TEST_DEBUG("backing chain of '%s' differs from the XML round trip",
+                           a->dst);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+# undef TEST_FIELD
+# undef TEST_STR_FIELD
+
+
+/* The structural copy has to match what formatting to XML and parsing
+ * it back with VIR_DOMAIN_DEF_PARSE_INACTIVE would produce */
+static int
+testDeepCopy(const void *opaque)
+{
+    const char *filename = opaque;
+    g_autofree char *path = NULL;
+    g_autofree char *xml = NULL;
+    g_autofree char *expect = NULL;
+    g_autofree char *actual = NULL;
+    virDomainDefPtr def = NULL;
+    virDomainDefPtr copy = NULL;
+    virDomainDefPtr roundtrip = NULL;
+    int ret = -1;
+
+    path = g_strdup_printf("%s/qemuxml2argvdata/%s", abs_srcdir, filename);
+
+    if (!(def = virDomainDefParseFile(path, driver.xmlopt, NULL, 0))) {
+        /* Plenty of the inputs exercise parser failures or need other
+         * capabilities */
+        virResetLastError();
+        ret = EXIT_AM_SKIP;
+        goto cleanup;
+    }
+
+    testDeepCopySetRuntime(def);
+
+    if (virDomainDefDeepCopy(def, driver.xmlopt, &copy) < 0)
+        goto cleanup;
+
+    if (!copy) {
+        VIR_TEST_DEBUG("%s needs the XML round trip", filename);
+        ret = EXIT_AM_SKIP;
+        goto cleanup;
+    }
+
+    if (!(xml = virDomainDefFormat(def, driver.xmlopt,
+                                   VIR_DOMAIN_DEF_FORMAT_SECURE)) ||
+        !(roundtrip = virDomainDefParseString(xml, driver.xmlopt, NULL,
+                                              VIR_DOMAIN_DEF_PARSE_INACTIVE |
+                                              VIR_DOMAIN_DEF_PARSE_SKIP_VALIDATE)))
+        goto cleanup;
+
+    if (!(expect = virDomainDefFormat(roundtrip, driver.xmlopt,
+                                      VIR_DOMAIN_DEF_FORMAT_SECURE)) ||
+        !(actual = virDomainDefFormat(copy, driver.xmlopt,
+                                      VIR_DOMAIN_DEF_FORMAT_SECURE)))
+        goto cleanup;
+
+    if (virTestCompareToString(expect, actual) < 0)
+        goto cleanup;
+
+    if (testDeepCopyCompareRuntime(copy, roundtrip) < 0)
+        goto cleanup;
+
+    ret = 0;
+
+ cleanup:
+    virDomainDefFree(def);
+    virDomainDefFree(copy);
+    virDomainDefFree(roundtrip);
+    return ret;
+}
+
+
+static int
+testDeepCopyAll(void)
+{
+    g_autofree char *dirpath = NULL;
+    DIR *dir = NULL;
+    struct dirent *ent;
+    int ret = 0;
+    int rc;
+
+    dirpath = g_strdup_printf("%s/qemuxml2argvdata", abs_srcdir);
+
+    if (virDirOpen(&dir, dirpath) < 0)
+        return -1;
+
+    while ((rc = virDirRead(dir, &ent, dirpath)) > 0) {
+        g_autofree char *name = NULL;
+
+        if (!virStringHasSuffix(ent->d_name, ".xml"))
+            continue;
+
+        name = g_strdup_printf("Deep copy %s", ent->d_name);
+        if (virTestRun(name, testDeepCopy, ent->d_name) < 0)
+            ret = -1;
+    }
+
+    if (rc < 0)
+        ret = -1;
+
+    VIR_DIR_CLOSE(dir);
+    return ret;
+}
+
+
+# define FAKEROOTDIRTEMPLATE abs_builddir "/fakerootdir-XXXXXX"
+
+static int
+mymain(void)
+{
+    int ret = 0;
+    g_autofree char *fakerootdir = NULL;
+    g_autofree char *capsfile = NULL;
+    virQEMUCapsPtr qemuCaps = NULL;
+
+    fakerootdir = g_strdup(FAKEROOTDIRTEMPLATE);
+
+    if (!g_mkdtemp(fakerootdir)) {
+        fprintf(stderr, "Cannot create fakerootdir");
+        abort();
+    }
+
+    g_setenv("LIBVIRT_FAKE_ROOT_DIR", fakerootdir, TRUE);
+
+    if (qemuTestDriverInit(&driver) < 0)
+        return EXIT_FAILURE;
+
+    if (!(capsfile = testQemuGetLatestCapsForArch("x86_64", "xml")) ||
+        !(qemuCaps = qemuTestParseCapabilitiesArch(VIR_ARCH_X86_64,
+                                                   capsfile)) ||
+        qemuTestCapsCacheInsert(driver.qemuCapsCache, qemuCaps) < 0) {
+        ret = -1;
+        goto cleanup;
+    }
+
+    if (testDeepCopyAll() < 0)
+        ret = -1;
+
+ cleanup:
+    virObjectUnref(qemuCaps);
+
+    if (getenv("LIBVIRT_SKIP_CLEANUP") == NULL)
+        virFileDeleteTree(fakerootdir);
+
+    qemuTestDriverFree(&driver);
+
+    return ret == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+VIR_TEST_MAIN_PRELOAD(mymain,
+                      VIR_TEST_MOCK("virpci"),
+                      VIR_TEST_MOCK("domaincaps"))
+
+#else
+
+int
+main(void)
+{
+    return EXIT_AM_SKIP;
+}
+
+#endif /* WITH_QEMU */
@@ -0,0 +1,442 @@
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "testutils.h"
+#include "virerror.h"
+#include "virfile.h"
+#include "virstring.h"
+#include "virthread.h"
+#include "virtime.h"
+
+#include "security/security_manager.h"
+#include "security/security_util.h"
+
+#define VIR_FROM_THIS VIR_FROM_NONE
+
+#define NFILES 8
+
+
+typedef struct _testRelabelData testRelabelData;
+struct _testRelabelData {
+    virMutex lock;
+    virCond cond;
+    size_t npaths;
+    char **paths;
+    unsigned long long *thread;
+    size_t *seq;
+    size_t nseq;
+    bool lateFailed;
+};
+
+
+static int
+testRelabelDataInit(testRelabelData *data,
+                    size_t npaths)
+{
+    if (virMutexInit(&data->lock) < 0 ||
+        virCondInit(&data->cond) < 0)
+        return -1;
+
+    data->npaths = npaths;
+    data->paths = g_new0(char *, npaths + 1);
+    data->thread = g_new0(unsigned long long, npaths);
+    data->seq = g_new0(size_t, npaths);
+    return 0;
+}
+
+
+static void
+testRelabelDataClear(testRelabelData *data)
+{
+    g_strfreev(data->paths);
+    VIR_FREE(data->thread);
+    VIR_FREE(data->seq);
+    virCondDestroy(&data->cond);
+    virMutexDestroy(&data->lock);
+}
+
+
+static int
+testRelabelRecord(size_t idx,
+                  void *opaque)
+{
+    testRelabelData *data = opaque;
+
+    virMutexLock(&data->lock);
+    data->thread[idx] = virThreadSelfID();
+    data->seq[idx] = data->nseq++;
+    virMutexUnlock(&data->lock);
+
+    return 0;
+}
+
+
+/* Paths aliasing one file must be handled by a single thread in the
+ * order they were queued, as they share the remembered label */
+static int
+testRelabelAliases(const void *opaque)
+{
+    const char *scratchdir = opaque;
+    testRelabelData data = { 0 };
+    g_autofree bool *done = NULL;
+    size_t i;
+    int ret = -1;
+
+    if (testRelabelDataInit(&data, NFILES * 3) < 0)
+        return -1;
+
+    for (i = 0; i < NFILES; i++) {
+        char **file = &data.paths[i];
+        char **hardLink = &data.paths[NFILES + i];
+        char **symLink = &data.paths[2 * NFILES + i];
+
+        *file = g_strdup_printf("%s/alias-file%zu", scratchdir, i);
+        *hardLink = g_strdup_printf("%s/alias-hardlink%zu", scratchdir, i);
+        *symLink = g_strdup_printf("%s/alias-symlink%zu", scratchdir, i);
+
+        if (virFileWriteStr(*file, "", 0600) < 0 ||
+            link(*file, *hardLink) < 0 ||
+            symlink(*file, *symLink) < 0) {
+            VIR_TEST_DEBUG("failed to create '%s' and its aliases", *file);
+            goto cleanup;
+        }
+    }
+
+    done = g_new0(bool, data.npaths);
+
+    if (virSecurityRelabelConcurrent((const char **) data.paths, data.npaths,
+                                     testRelabelRecord, &data, 0, done) < 0)
+        goto cleanup;
+
+    for (i = 0; i < data.npaths; i++) {
+        if (!done[i]) {
+            VIR_TEST_DEBUG("'%s' was not relabelled", data.paths[i]);
+            goto cleanup;
+        }
+    }
+
+    for (i = 0; i < NFILES; i++) {
+        size_t file = i;
+        size_t hardLink = NFILES + i;
+        size_t symLink = 2 * NFILES + i;
+
+        if (data.thread[file] != data.thread[hardLink] ||
+            data.thread[file] != data.thread[symLink]) {
+            VIR_TEST_DEBUG("aliases of '%s' handled by different threads",
+                           data.paths[file]);
+            goto cleanup;
+        }
+
+        if (data.seq[file] > data.seq[hardLink] ||
+            data.seq[hardLink] > data.seq[symLink]) {
+            VIR_TEST_DEBUG("aliases of '%s' handled out of order",
+                           data.paths[file]);
+            goto cleanup;
+        }
+    }
+
+    ret = 0;
+
+ cleanup:
+    testRelabelDataClear(&data);
+    return ret;
+}
+
+
+#define EARLY_ITEM 1
+#define LATE_ITEM 6
+
+static int
+testRelabelFail(size_t idx,
+                void *opaque)
+{
+    testRelabelData *data = opaque;
+    unsigned long long deadline;
+
+    if (idx == LATE_ITEM) {
+        virMutexLock(&data->lock);
+        data->lateFailed = true;
+        virCondBroadcast(&data->cond);
+        virMutexUnlock(&data->lock);
+
+        virReportError(VIR_ERR_INTERNAL_ERROR, "failed item %zu", idx);
+        return -1;
+    }
+
+    if (idx != EARLY_ITEM)
+        return 0;
+
+    /* If the late item runs on another thread, let it fail first. If it
+     * doesn't, it will never run at all. */
+    if (virTimeMillisNow(&deadline) < 0)
+        return -1;
+    deadline += 1000;
+
+    virMutexLock(&data->lock);
+    while (!data->lateFailed) {
+        if (virCondWaitUntil(&data->cond, &data->lock, deadline) < 0)
+            break;
+    }
+    virMutexUnlock(&data->lock);
+
+    virReportError(VIR_ERR_INTERNAL_ERROR, "failed item %zu", idx);
+    return -1;
+}
+
+
+/* The error of the failed item queued first is reported, regardless of
+ * the thread it ran in and the order the failures happened */
+static int
+testRelabelError(const void *opaque)
+{
+    const char *scratchdir = opaque;
+    testRelabelData data = { 0 };
+    g_autofree bool *done = NULL;
+    g_autofree char *expect = NULL;
+    const char *msg;
+    size_t i;
+    int ret = -1;
+
+    if (testRelabelDataInit(&data, NFILES) < 0)
+        return -1;
+
+    for (i = 0; i < NFILES; i++) {
+        data.paths[i] = g_strdup_printf("%s/error-file%zu", scratchdir, i);
+        if (virFileWriteStr(data.paths[i], "", 0600) < 0)
+            goto cleanup;
+    }
+
+    done = g_new0(bool, data.npaths);
+
+    if (virSecurityRelabelConcurrent((const char **) data.paths, data.npaths,
+                                     testRelabelFail, &data, 0, done) == 0) {
+        VIR_TEST_DEBUG("relabel unexpectedly succeeded");
+        goto cleanup;
+    }
+
+    expect = g_strdup_printf("failed item %d", EARLY_ITEM);
+    msg = virGetLastErrorMessage();
+
+    if (!strstr(msg, expect)) {
+        VIR_TEST_DEBUG("expected error '%s', got '%s'", expect, msg);
+        goto cleanup;
+    }
+
+    if (done[EARLY_ITEM] || done[LATE_ITEM]) {
+        VIR_TEST_DEBUG("failed items marked as done");
+        goto cleanup;
+    }
+
+    ret = 0;
+
+ cleanup:
+    virResetLastError();
+    testRelabelDataClear(&data);
+    return ret;
+}
+
+
+/* Locks @paths and checks that the files got locked in the order of
+ * @expect, i.e. that the Nth fd refers to the file at the Nth path */
+static int
+testMetadataLockCheck(const char **paths,
+                      size_t npaths,
+                      const char **expect,
+                      size_t nexpect)
+{
+    virSecurityManagerMetadataLockStatePtr state = NULL;
+    size_t i;
+    int ret = -1;
+
+    if (!(state = virSecurityManagerMetadataLock(NULL, paths, npaths)))
+        return -1;
+
+    /* Without XATTRs there's nothing to lock */
+    if (state->nfds == 0) {
+        ret = EXIT_AM_SKIP;
+        goto cleanup;
+    }
+
+    if (state->nfds != nexpect) {
+        VIR_TEST_DEBUG("locked %zu files, expected %zu",
+                       state->nfds, nexpect);
+        goto cleanup;
+    }
+
+    for (i = 0; i < nexpect; i++) {
+        struct stat fdsb;
+        struct stat sb;
+
+        if (fstat(state->fds[i], &fdsb) < 0 ||
+            stat(expect[i], &sb) < 0)
+            goto cleanup;
+
+        if (fdsb.st_dev != sb.st_dev || fdsb.st_ino != sb.st_ino) {
+            VIR_TEST_DEBUG("file %zu locked isn't '%s'", i, expect[i]);
+            goto cleanup;
+        }
+    }
+
+    for (i = 0; i < npaths; i++) {
+        if (!virSecurityManagerMetadataLockStateHasPath(state, paths[i])) {
+            VIR_TEST_DEBUG("'%s' not reported as locked", paths[i]);
+            goto cleanup;
+        }
+    }
+
+    ret = 0;
+
+ cleanup:
+    virSecurityManagerMetadataUnlock(NULL, &state);
+    return ret;
+}
+
+
+/* Files are locked in the order of their paths, not in the order they
+ * were passed in or were created in */
+static int
+testMetadataLockOrder(const void *opaque)
+{
+    const char *scratchdir = opaque;
+    g_autofree char *a = g_strdup_printf("%s/order-a", scratchdir);
+    g_autofree char *b = g_strdup_printf("%s/order-b", scratchdir);
+    g_autofree char *c = g_strdup_printf("%s/order-c", scratchdir);
+    const char *paths[] = { c, a, b };
+    const char *expect[] = { a, b, c };
+
+    if (virFileWriteStr(c, "", 0600) < 0 ||
+        virFileWriteStr(a, "", 0600) < 0 ||
+        virFileWriteStr(b, "", 0600) < 0)
+        return -1;
+
+    return testMetadataLockCheck(paths, G_N_ELEMENTS(paths),
+                                 expect, G_N_ELEMENTS(expect));
+}
+
+
+/* A file reached through several paths is locked once, under the name
+ * which sorts first, and all the paths are reported as locked */
+static int
+testMetadataLockAliases(const void *opaque)
+{
+    const char *scratchdir = opaque;
+    g_autofree char *file = g_strdup_printf("%s/lockalias-file", scratchdir);
+    g_autofree char *hardLink = g_strdup_printf("%s/lockalias-hardlink",
+                                                scratchdir);
+    g_autofree char *other = g_strdup_printf("%s/lockalias-other", scratchdir);
+    const char *paths[] = { other, file, hardLink, file };
+    const char *expect[] = { file, other };
+
+    if (virFileWriteStr(file, "", 0600) < 0 ||
+        virFileWriteStr(other, "", 0600) < 0 ||
+        link(file, hardLink) < 0)
+        return -1;
+
+    return testMetadataLockCheck(paths, G_N_ELEMENTS(paths),
+                                 expect, G_N_ELEMENTS(expect));
+}
+
+
+/* Only the paths which were actually locked are found */
+static int
+testMetadataLockHasPath(const void *opaque)
+{
+    const char *scratchdir = opaque;
+    g_autofree char *file = g_strdup_printf("%s/haspath-file", scratchdir);
+    g_autofree char *unlisted = g_strdup_printf("%s/haspath-unlisted",
+                                                scratchdir);
+    g_autofree char *missing = g_strdup_printf("%s/haspath-missing",
+                                               scratchdir);
+    const char *paths[] = { file, scratchdir, missing };
+    virSecurityManagerMetadataLockStatePtr state = NULL;
+    int ret = -1;
+
+    if (virFileWriteStr(file, "", 0600) < 0 ||
+        virFileWriteStr(unlisted, "", 0600) < 0)
+        return -1;
+
+    if (virSecurityManagerMetadataLockStateHasPath(NULL, file)) {
+        VIR_TEST_DEBUG("path found without any lock state");
+        return -1;
+    }
+
+    if (!(state = virSecurityManagerMetadataLock(NULL, paths,
+                                                 G_N_ELEMENTS(paths))))
+        return -1;
+
+    if (state->nfds == 0) {
+        ret = EXIT_AM_SKIP;
+        goto cleanup;
+    }
+
+    if (!virSecurityManagerMetadataLockStateHasPath(state, file)) {
+        VIR_TEST_DEBUG("locked file not found");
+        goto cleanup;
+    }
+
+    /* Directories and missing files aren't locked */
+    if (virSecurityManagerMetadataLockStateHasPath(state, scratchdir) ||
+        virSecurityManagerMetadataLockStateHasPath(state, missing) ||
+        virSecurityManagerMetadataLockStateHasPath(state, unlisted) ||
+        virSecurityManagerMetadataLockStateHasPath(state, NULL)) {
+        VIR_TEST_DEBUG("path not locked found");
+        goto cleanup;
+    }
+
+    ret = 0;
+
+ cleanup:
+    virSecurityManagerMetadataUnlock(NULL, &state);
+    return ret;
+}
+
+
+#define SCRATCHDIRTEMPLATE abs_builddir "/securityutildir-XXXXXX"
+
+static int
+mymain(void)
+{
+    int ret = 0;
+    char scratchdir[] = SCRATCHDIRTEMPLATE;
+
+    if (!g_mkdtemp(scratchdir)) {
+        fprintf(stderr, "Cannot create securityutildir");
+        abort();
+    }
+
+    if (virTestRun("relabel aliases", testRelabelAliases, scratchdir) < 0)
+        ret = -1;
+    if (virTestRun("relabel error", testRelabelError, scratchdir) < 0)
+        ret = -1;
+    if (virTestRun("metadata lock order", testMetadataLockOrder, scratchdir) < 0)
+        ret = -1;
+    if (virTestRun("metadata lock aliases", testMetadataLockAliases, scratchdir) < 0)
+        ret = -1;
+    if (virTestRun("metadata lock has path", testMetadataLockHasPath, scratchdir) < 0)
+        ret = -1;
+
+    if (getenv("LIBVIRT_SKIP_CLEANUP") == NULL)
+        virFileDeleteTree(scratchdir);
+
+    return ret == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+VIR_TEST_MAIN(mymain)
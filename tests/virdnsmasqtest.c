@@ -0,0 +1,308 @@
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+
+#include "testutils.h"
+#include "virbuffer.h"
+#include "virdnsmasq.h"
+#include "virfile.h"
+#include "virstring.h"
+
+#define VIR_FROM_THIS VIR_FROM_NONE
+
+/* Matches DNSMASQ_HOSTSDIR_FILES_MAX */
+#define TEST_FILES_MAX 64
+
+#define TEST_NOSKIP ((size_t) -1)
+
+
+/* Creates a context for network @name holding the DHCP hosts 0 to
+ * @nhosts - 1, leaving out host @skip */
+static dnsmasqContext *
+testContext(const char *scratchdir,
+            const char *name,
+            bool hostsdir,
+            size_t nhosts,
+            size_t skip)
+{
+    dnsmasqContext *ctx = dnsmasqContextNew(name, scratchdir);
+    size_t i;
+
+    if (!ctx)
+        return NULL;
+
+    ctx->hostsdir = hostsdir;
+
+    for (i = 0; i < nhosts; i++) {
+        g_autofree char *mac = g_strdup_printf("52:54:00:00:00:%02zx", i);
+        g_autofree char *ipstr = g_strdup_printf("192.168.122.%zu", i + 2);
+        virSocketAddr ip;
+
+        if (i == skip)
+            continue;
+
+        if (virSocketAddrParse(&ip, ipstr, AF_INET) < 0 ||
+            dnsmasqAddDhcpHost(ctx, mac, &ip, NULL, NULL, false) < 0) {
+            dnsmasqContextFree(ctx);
+            return NULL;
+        }
+    }
+
+    return ctx;
+}
+
+
+/* Updates dnsmasq's view of network @name to the hosts of testContext()
+ * and checks whether a reload was asked for */
+static int
+testUpdate(const char *scratchdir,
+           const char *name,
+           bool hostsdir,
+           size_t nhosts,
+           size_t skip,
+           int expect)
+{
+    dnsmasqContext *ctx = testContext(scratchdir, name, hostsdir, nhosts, skip);
+    int rc;
+
+    if (!ctx)
+        return -1;
+
+    rc = dnsmasqUpdate(ctx);
+    dnsmasqContextFree(ctx);
+
+    if (rc != expect) {
+        VIR_TEST_DEBUG("update to %zu hosts returned %d, expected %d",
+                       nhosts, rc, expect);
+        return -1;
+    }
+
+    return 0;
+}
+
+
+/* Checks that the hostsfile of network @name lists the hosts of
+ * testContext() and that @nfiles files wait in its directory */
+static int
+testCheck(const char *scratchdir,
+          const char *name,
+          size_t nhosts,
+          size_t skip,
+          size_t nfiles)
+{
+    g_auto(virBuffer) buf = VIR_BUFFER_INITIALIZER;
+    g_autofree char *path = g_strdup_printf("%s/%s.hostsfile", scratchdir, name);
+    g_autofree char *dir = g_strdup_printf("%s/%s.hostsdir", scratchdir, name);
+    g_autofree char *expect = NULL;
+    g_autofree char *actual = NULL;
+    DIR *dh = NULL;
+    struct dirent *ent;
+    size_t found = 0;
+    size_t i;
+    int rc;
+
+    for (i = 0; i < nhosts; i++) {
+        if (i != skip)
+            virBufferAsprintf(&buf, "52:54:00:00:00:%02zx,192.168.122.%zu\n",
+                              i, i + 2);
+    }
+    expect = virBufferContentAndReset(&buf);
+
+    if (virFileReadAll(path, 1024 * 1024, &actual) < 0)
+        return -1;
+
+    if (STRNEQ(NULLSTR_EMPTY(expect), actual)) {
+        virTestDifference(stderr, NULLSTR_EMPTY(expect), actual);
+        return -1;
+    }
+
+    if ((rc = virDirOpenIfExists(&dh, dir)) < 0)
+        return -1;
+
+    while (rc > 0 && (rc = virDirRead(dh, &ent, dir)) > 0)
+        found++;
+    VIR_DIR_CLOSE(dh);
+
+    if (rc < 0)
+        return -1;
+
+    if (found != nfiles) {
+        VIR_TEST_DEBUG("'%s' holds %zu files, expected %zu",
+                       dir, found, nfiles);
+        return -1;
+    }
+
+    return 0;
+}
+
+
+static int
+testSave(const char *scratchdir,
+         const char *name,
+         bool hostsdir,
+         size_t nhosts)
+{
+    dnsmasqContext *ctx = testContext(scratchdir, name, hostsdir,
+                                      nhosts, TEST_NOSKIP);
+    int ret;
+
+    if (!ctx)
+        return -1;
+
+    ret = dnsmasqSave(ctx);
+    dnsmasqContextFree(ctx);
+    return ret;
+}
+
+
+/* Added hosts go to new files in the watched directory, a removal
+ * merges everything back into the hostsfile and asks for a reload */
+static int
+testAddRemove(const void *opaque)
+{
+    const char *scratchdir = opaque;
+
+    if (testSave(scratchdir, "addremove", true, 2) < 0 ||
+        testCheck(scratchdir, "addremove", 2, TEST_NOSKIP, 0) < 0)
+        return -1;
+
+    /* nothing changed */
+    if (testUpdate(scratchdir, "addremove", true, 2, TEST_NOSKIP, 0) < 0 ||
+        testCheck(scratchdir, "addremove", 2, TEST_NOSKIP, 0) < 0)
+        return -1;
+
+    if (testUpdate(scratchdir, "addremove", true, 3, TEST_NOSKIP, 0) < 0 ||
+        testCheck(scratchdir, "addremove", 2, TEST_NOSKIP, 1) < 0)
+        return -1;
+
+    if (testUpdate(scratchdir, "addremove", true, 4, TEST_NOSKIP, 0) < 0 ||
+        testCheck(scratchdir, "addremove", 2, TEST_NOSKIP, 2) < 0)
+        return -1;
+
+    /* hosts already in the directory count as known */
+    if (testUpdate(scratchdir, "addremove", true, 4, TEST_NOSKIP, 0) < 0 ||
+        testCheck(scratchdir, "addremove", 2, TEST_NOSKIP, 2) < 0)
+        return -1;
+
+    /* removing a host read from the directory */
+    if (testUpdate(scratchdir, "addremove", true, 4, 2, 1) < 0 ||
+        testCheck(scratchdir, "addremove", 4, 2, 0) < 0)
+        return -1;
+
+    /* adding it back works incrementally again */
+    if (testUpdate(scratchdir, "addremove", true, 4, TEST_NOSKIP, 0) < 0 ||
+        testCheck(scratchdir, "addremove", 4, 2, 1) < 0)
+        return -1;
+
+    /* removing a host of the hostsfile */
+    if (testUpdate(scratchdir, "addremove", true, 4, 0, 1) < 0 ||
+        testCheck(scratchdir, "addremove", 4, 0, 0) < 0)
+        return -1;
+
+    return 0;
+}
+
+
+/* Once the directory is full, added hosts are merged into the hostsfile
+ * together with the files dnsmasq already read, without a reload */
+static int
+testMerge(const void *opaque)
+{
+    const char *scratchdir = opaque;
+    size_t i;
+
+    if (testSave(scratchdir, "merge", true, 0) < 0)
+        return -1;
+
+    for (i = 1; i <= TEST_FILES_MAX; i++) {
+        if (testUpdate(scratchdir, "merge", true, i, TEST_NOSKIP, 0) < 0 ||
+            testCheck(scratchdir, "merge", 0, TEST_NOSKIP, i) < 0)
+            return -1;
+    }
+
+    if (testUpdate(scratchdir, "merge", true, i, TEST_NOSKIP, 0) < 0 ||
+        testCheck(scratchdir, "merge", i, TEST_NOSKIP, 0) < 0)
+        return -1;
+
+    if (testUpdate(scratchdir, "merge", true, i + 1, TEST_NOSKIP, 0) < 0 ||
+        testCheck(scratchdir, "merge", i, TEST_NOSKIP, 1) < 0)
+        return -1;
+
+    return 0;
+}
+
+
+/* Without a watched directory any change rewrites the hostsfile */
+static int
+testUnwatched(const void *opaque)
+{
+    const char *scratchdir = opaque;
+
+    if (testSave(scratchdir, "unwatched", false, 2) < 0)
+        return -1;
+
+    if (testUpdate(scratchdir, "unwatched", false, 2, TEST_NOSKIP, 0) < 0 ||
+        testCheck(scratchdir, "unwatched", 2, TEST_NOSKIP, 0) < 0)
+        return -1;
+
+    if (testUpdate(scratchdir, "unwatched", false, 3, TEST_NOSKIP, 1) < 0 ||
+        testCheck(scratchdir, "unwatched", 3, TEST_NOSKIP, 0) < 0)
+        return -1;
+
+    if (testUpdate(scratchdir, "unwatched", false, 3, 1, 1) < 0 ||
+        testCheck(scratchdir, "unwatched", 3, 1, 0) < 0)
+        return -1;
+
+    /* saving with the directories removes them again */
+    if (testSave(scratchdir, "rewatched", true, 2) < 0 ||
+        testUpdate(scratchdir, "rewatched", true, 3, TEST_NOSKIP, 0) < 0 ||
+        testSave(scratchdir, "rewatched", false, 3) < 0 ||
+        testUpdate(scratchdir, "rewatched", false, 4, TEST_NOSKIP, 1) < 0 ||
+        testCheck(scratchdir, "rewatched", 4, TEST_NOSKIP, 0) < 0)
+        return -1;
+
+    return 0;
+}
+
+
+#define SCRATCHDIRTEMPLATE abs_builddir "/dnsmasqdir-XXXXXX"
+
+static int
+mymain(void)
+{
+    int ret = 0;
+    char scratchdir[] = SCRATCHDIRTEMPLATE;
+
+    if (!g_mkdtemp(scratchdir)) {
+        fprintf(stderr, "Cannot create dnsmasqdir");
+        abort();
+    }
+
+    if (virTestRun("hosts add remove", testAddRemove, scratchdir) < 0)
+        ret = -1;
+    if (virTestRun("hosts merge", testMerge, scratchdir) < 0)
+        ret = -1;
+    if (virTestRun("hosts unwatched", testUnwatched, scratchdir) < 0)
+        ret = -1;
+
+    if (getenv("LIBVIRT_SKIP_CLEANUP") == NULL)
+        virFileDeleteTree(scratchdir);
+
+    return ret == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+VIR_TEST_MAIN(mymain)
@@ -0,0 +1,419 @@
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+
+#include "testutils.h"
+#include "virerror.h"
+#include "viralloc.h"
+#include "virlog.h"
+#include "virthread.h"
+#include "viruuid.h"
+
+#include "virdomainobjlist.h"
+
+#define VIR_FROM_THIS VIR_FROM_NONE
+
+VIR_LOG_INIT("tests.virdomainobjlisttest");
+
+#define TEST_NDOMAINS 256
+#define TEST_NTHREADS 64
+#define TEST_NLOOKUPS 2000
+
+static virDomainXMLOptionPtr xmlopt;
+
+struct testDomain {
+    char *name;
+    unsigned char uuid[VIR_UUID_BUFLEN];
+};
+
+static struct testDomain domains[TEST_NDOMAINS];
+
+
+static virDomainObjListPtr
+testDomainObjListInit(void)
+{
+    virDomainObjListPtr doms;
+    size_t i;
+
+    if (!(doms = virDomainObjListNew()))
+        return NULL;
+
+    for (i = 0; i < TEST_NDOMAINS; i++) {
+        virDomainDefPtr def;
+        virDomainObjPtr vm;
+
+        if (!(def = virDomainDefNew()))
+            goto error;
+
+        def->virtType = VIR_DOMAIN_VIRT_QEMU;
+        def->name = g_strdup(domains[i].name);
+        memcpy(def->uuid, domains[i].uuid, VIR_UUID_BUFLEN);
+
+        if (!(vm = virDomainObjListAdd(doms, def, xmlopt, 0, NULL))) {
+            virDomainDefFree(def);
+            goto error;
+        }
+        virDomainObjEndAPI(&vm);
+    }
+
+    return doms;
+
+ error:
+    virObjectUnref(doms);
+    return NULL;
+}
+
+
+static int
+testLookup(const void *opaque G_GNUC_UNUSED)
+{
+    virDomainObjListPtr doms;
+    virDomainObjPtr vm;
+    unsigned char uuid[VIR_UUID_BUFLEN];
+    size_t i;
+    int ret = -1;
+
+    if (!(doms = testDomainObjListInit()))
+        return -1;
+
+    for (i = 0; i < TEST_NDOMAINS; i++) {
+        if (!(vm = virDomainObjListFindByUUID(doms, domains[i].uuid))) {
+            VIR_TEST_DEBUG("domain %s not found by UUID", domains[i].name);
+            goto cleanup;
+        }
+        if (STRNEQ(vm->def->name, domains[i].name)) {
+            VIR_TEST_DEBUG("expected domain %s got %s",
+                           domains[i].name, vm->def->name);
+            virDomainObjEndAPI(&vm);
+            goto cleanup;
+        }
+        virDomainObjEndAPI(&vm);
+
+        if (!(vm = virDomainObjListFindByName(doms, domains[i].name))) {
+            VIR_TEST_DEBUG("domain %s not found by name", domains[i].name);
+            goto cleanup;
+        }
+        if (memcmp(vm->def->uuid, domains[i].uuid, VIR_UUID_BUFLEN) != 0) {
+            VIR_TEST_DEBUG("UUID mismatch for domain %s", domains[i].name);
+            virDomainObjEndAPI(&vm);
+            goto cleanup;
+        }
+        virDomainObjEndAPI(&vm);
+    }
+
+    memset(uuid, 0xff, sizeof(uuid));
+    if ((vm = virDomainObjListFindByUUID(doms, uuid))) {
+        VIR_TEST_DEBUG("unexpected domain %s found", vm->def->name);
+        virDomainObjEndAPI(&vm);
+        goto cleanup;
+    }
+
+    ret = 0;
+ cleanup:
+    virObjectUnref(doms);
+    return ret;
+}
+
+
+static int
+testCollectAfterRemove(const void *opaque G_GNUC_UNUSED)
+{
+    virDomainObjListPtr doms;
+    virDomainObjPtr *vms = NULL;
+    virDomainObjPtr vm;
+    size_t nvms = 0;
+    size_t i;
+    int ret = -1;
+
+    if (!(doms = testDomainObjListInit()))
+        return -1;
+
+    /* Populate the snapshot before changing the list */
+    if (virDomainObjListCollect(doms, NULL, &vms, &nvms, NULL, 0) < 0)
+        goto cleanup;
+
+    if (nvms != TEST_NDOMAINS) {
+        VIR_TEST_DEBUG("expected %d domains, got %zu", TEST_NDOMAINS, nvms);
+        goto cleanup;
+    }
+    virObjectListFreeCount(vms, nvms);
+    vms = NULL;
+
+    if (!(vm = virDomainObjListFindByUUID(doms, domains[0].uuid)))
+        goto cleanup;
+    virDomainObjListRemove(doms, vm);
+    virDomainObjEndAPI(&vm);
+
+    if (virDomainObjListCollect(doms, NULL, &vms, &nvms, NULL, 0) < 0)
+        goto cleanup;
+
+    if (nvms != TEST_NDOMAINS - 1) {
+        VIR_TEST_DEBUG("expected %d domains, got %zu",
+                       TEST_NDOMAINS - 1, nvms);
+        goto cleanup;
+    }
+
+    for (i = 0; i < nvms; i++) {
+        if (STREQ(vms[i]->def->name, domains[0].name)) {
+            VIR_TEST_DEBUG("removed domain %s still listed", domains[0].name);
+            goto cleanup;
+        }
+    }
+
+    ret = 0;
+ cleanup:
+    virObjectListFreeCount(vms, nvms);
+    virObjectUnref(doms);
+    return ret;
+}
+
+
+static int
+testExportFilter(const void *opaque G_GNUC_UNUSED)
+{
+    virDomainObjListPtr doms;
+    virDomainObjPtr vm;
+    int ret = -1;
+    int n;
+
+    if (!(doms = testDomainObjListInit()))
+        return -1;
+
+    if ((n = virDomainObjListExport(doms, NULL, NULL, NULL,
+                                    VIR_CONNECT_LIST_DOMAINS_INACTIVE)) != TEST_NDOMAINS) {
+        VIR_TEST_DEBUG("expected %d inactive domains, got %d", TEST_NDOMAINS, n);
+        goto cleanup;
+    }
+
+    if ((n = virDomainObjListExport(doms, NULL, NULL, NULL,
+                                    VIR_CONNECT_LIST_DOMAINS_PERSISTENT)) != 0) {
+        VIR_TEST_DEBUG("expected no persistent domains, got %d", n);
+        goto cleanup;
+    }
+
+    /* The setters publish the summary right away, i.e. even before the
+     * object is unlocked */
+    if (!(vm = virDomainObjListFindByName(doms, domains[1].name)))
+        goto cleanup;
+    virDomainObjSetPersistent(vm, true);
+    virDomainObjSetAutostart(vm, true);
+    virDomainObjSetID(vm, 1);
+
+    if ((n = virDomainObjListExport(doms, NULL, NULL, NULL,
+                                    VIR_CONNECT_LIST_DOMAINS_PERSISTENT |
+                                    VIR_CONNECT_LIST_DOMAINS_AUTOSTART)) != 1) {
+        VIR_TEST_DEBUG("expected 1 persistent autostart domain, got %d", n);
+        virDomainObjEndAPI(&vm);
+        goto cleanup;
+    }
+
+    if ((n = virDomainObjListNumOfDomains(doms, true, NULL, NULL)) != 1) {
+        VIR_TEST_DEBUG("expected 1 active domain, got %d", n);
+        virDomainObjEndAPI(&vm);
+        goto cleanup;
+    }
+
+    virDomainObjSetID(vm, -1);
+    virDomainObjEndAPI(&vm);
+
+    if ((n = virDomainObjListNumOfDomains(doms, false, NULL, NULL)) != TEST_NDOMAINS) {
+        VIR_TEST_DEBUG("expected %d inactive domains, got %d", TEST_NDOMAINS, n);
+        goto cleanup;
+    }
+
+    ret = 0;
+ cleanup:
+    virObjectUnref(doms);
+    return ret;
+}
+
+
+/* Judges domains by a part of the definition which isn't in the
+ * summary */
+static bool
+testACLFilter(virConnectPtr conn G_GNUC_UNUSED,
+              virDomainDefPtr def)
+{
+    return def->virtType == VIR_DOMAIN_VIRT_KVM;
+}
+
+
+static int
+testExportACL(const void *opaque G_GNUC_UNUSED)
+{
+    virDomainObjListPtr doms;
+    virDomainObjPtr vm;
+    size_t i;
+    int ret = -1;
+    int n;
+
+    if (!(doms = testDomainObjListInit()))
+        return -1;
+
+    for (i = 0; i < TEST_NDOMAINS; i += 2) {
+        if (!(vm = virDomainObjListFindByName(doms, domains[i].name)))
+            goto cleanup;
+        vm->def->virtType = VIR_DOMAIN_VIRT_KVM;
+        virDomainObjEndAPI(&vm);
+    }
+
+    if ((n = virDomainObjListExport(doms, NULL, NULL, testACLFilter,
+                                    0)) != TEST_NDOMAINS / 2) {
+        VIR_TEST_DEBUG("expected %d domains, got %d", TEST_NDOMAINS / 2, n);
+        goto cleanup;
+    }
+
+    if ((n = virDomainObjListNumOfDomains(doms, false, testACLFilter,
+                                          NULL)) != TEST_NDOMAINS / 2) {
+        VIR_TEST_DEBUG("expected %d inactive domains, got %d",
+                       TEST_NDOMAINS / 2, n);
+        goto cleanup;
+    }
+
+    ret = 0;
+ cleanup:
+    virObjectUnref(doms);
+    return ret;
+}
+
+
+struct testThreadData {
+    virDomainObjListPtr doms;
+    size_t seed;
+    size_t failed;
+};
+
+
+static void
+testLookupThread(void *opaque)
+{
+    struct testThreadData *data = opaque;
+    size_t i;
+
+    for (i = 0; i < TEST_NLOOKUPS; i++) {
+        size_t idx = (data->seed + i) % TEST_NDOMAINS;
+        virDomainObjPtr vm;
+
+        if (i % 100 == 0) {
+            virDomainObjPtr *vms = NULL;
+            size_t nvms = 0;
+
+            if (virDomainObjListCollect(data->doms, NULL, &vms, &nvms,
+                                        NULL, 0) < 0 ||
+                nvms != TEST_NDOMAINS)
+                data->failed++;
+            virObjectListFreeCount(vms, nvms);
+            continue;
+        }
+
+        if (i % 2)
+            vm = virDomainObjListFindByUUID(data->doms, domains[idx].uuid);
+        else
+            vm = virDomainObjListFindByName(data->doms, domains[idx].name);
+
+        if (!vm) {
+            data->failed++;
+            continue;
+        }
+        virDomainObjEndAPI(&vm);
+    }
+}
+
+
+static int
+testLookupParallel(const void *opaque G_GNUC_UNUSED)
+{
+    virDomainObjListPtr doms;
+    virThread threads[TEST_NTHREADS];
+    struct testThreadData data[TEST_NTHREADS];
+    unsigned long long start;
+    unsigned long long elapsed;
+    size_t nthreads = 0;
+    size_t i;
+    int ret = -1;
+
+    if (!(doms = testDomainObjListInit()))
+        return -1;
+
+    start = g_get_monotonic_time();
+
+    for (i = 0; i < TEST_NTHREADS; i++) {
+        data[i].doms = doms;
+        data[i].seed = i * 7;
+        data[i].failed = 0;
+
+        if (virThreadCreate(&threads[i], true, testLookupThread, &data[i]) < 0)
+            goto join;
+        nthreads++;
+    }
+
+    ret = 0;
+
+ join:
+    for (i = 0; i < nthreads; i++) {
+        virThreadJoin(&threads[i]);
+        if (data[i].failed) {
+            VIR_TEST_DEBUG("thread %zu: %zu failed lookups", i, data[i].failed);
+            ret = -1;
+        }
+    }
+
+    elapsed = g_get_monotonic_time() - start;
+    VIR_TEST_DEBUG("%zu threads, %llu lookups in %llu us (%llu lookups/s)",
+                   nthreads, (unsigned long long)nthreads * TEST_NLOOKUPS,
+                   elapsed,
+                   elapsed ? nthreads * TEST_NLOOKUPS * 1000000ULL / elapsed : 0);
+
+    virObjectUnref(doms);
+    return ret;
+}
+
+
+static int
+mymain(void)
+{
+    int ret = 0;
+    size_t i;
+
+    if (!(xmlopt = virTestGenericDomainXMLConfInit()))
+        return EXIT_FAILURE;
+
+    for (i = 0; i < TEST_NDOMAINS; i++) {
+        domains[i].name = g_strdup_printf("dom%zu", i);
+        if (virUUIDGenerate(domains[i].uuid) < 0)
+            return EXIT_FAILURE;
+    }
+
+    if (virTestRun("Lookup", testLookup, NULL) < 0)
+        ret = -1;
+    if (virTestRun("Collect after remove", testCollectAfterRemove, NULL) < 0)
+        ret = -1;
+    if (virTestRun("Export filter", testExportFilter, NULL) < 0)
+        ret = -1;
+    if (virTestRun("Export ACL", testExportACL, NULL) < 0)
+        ret = -1;
+    if (virTestRun("Parallel lookup", testLookupParallel, NULL) < 0)
+        ret = -1;
+
+    for (i = 0; i < TEST_NDOMAINS; i++)
+        VIR_FREE(domains[i].name);
+    virObjectUnref(xmlopt);
+
+    return ret == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+VIR_TEST_MAIN(mymain)
@@ -0,0 +1,248 @@
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "testutils.h"
+#include "virbuffer.h"
+#include "virfile.h"
+#include "virlease.h"
+#include "virstring.h"
+
+#define VIR_FROM_THIS VIR_FROM_NONE
+
+#define TEST_LEASE(ip, mac) \
+    "{\"ip-address\":\"" ip "\",\"mac-address\":\"" mac "\"," \
+    "\"expiry-time\":2000000000}"
+
+#define TEST_STATUS \
+    "[" TEST_LEASE("192.168.122.10", "52:54:00:00:00:01") "," \
+    TEST_LEASE("192.168.122.11", "52:54:00:00:00:02") "]"
+
+
+static char *
+testLeaseFile(const char *scratchdir,
+              const char *name)
+{
+    g_autofree char *file = g_strdup_printf("%s/%s.status", scratchdir, name);
+    g_autofree char *journal = g_strdup_printf("%s.journal", file);
+
+    unlink(journal);
+    if (virFileWriteStr(file, TEST_STATUS, 0600) < 0)
+        return NULL;
+
+    return g_steal_pointer(&file);
+}
+
+
+static int
+testLeaseAppend(const char *file,
+                const char *json)
+{
+    g_autoptr(virJSONValue) record = virJSONValueFromString(json);
+
+    if (!record)
+        return -1;
+
+    return virLeaseJournalAppend(file, record);
+}
+
+
+/* Appends @str verbatim, to write a record in more than one go */
+static int
+testLeaseAppendRaw(const char *file,
+                   const char *str)
+{
+    g_autofree char *journal = g_strdup_printf("%s.journal", file);
+    VIR_AUTOCLOSE fd = -1;
+
+    if ((fd = open(journal, O_WRONLY | O_APPEND | O_CREAT, 0600)) < 0 ||
+        safewrite(fd, str, strlen(str)) < 0)
+        return -1;
+
+    return 0;
+}
+
+
+/* Compares the leases in @db, oldest first, with @expect which lists
+ * them as "ip=mac" separated by spaces */
+static int
+testLeaseCheck(virLeaseDBPtr db,
+               const char *expect)
+{
+    g_auto(virBuffer) buf = VIR_BUFFER_INITIALIZER;
+    g_autofree virJSONValuePtr *leases = NULL;
+    g_autofree char *actual = NULL;
+    size_t nleases;
+    size_t i;
+
+    if (virLeaseDBRefresh(db) < 0)
+        return -1;
+
+    leases = virLeaseDBGetLeases(db, &nleases);
+
+    for (i = 0; i < nleases; i++) {
+        virBufferAsprintf(&buf, "%s=%s ",
+                          virJSONValueObjectGetString(leases[i], "ip-address"),
+                          virJSONValueObjectGetString(leases[i], "mac-address"));
+    }
+    virBufferTrim(&buf, " ");
+    actual = virBufferContentAndReset(&buf);
+
+    if (STRNEQ_NULLABLE(expect, actual)) {
+        virTestDifference(stderr, expect, NULLSTR(actual));
+        return -1;
+    }
+
+    return 0;
+}
+
+
+/* Journal records replace and delete leases of the leases file, and
+ * only the records appended since the last refresh are replayed */
+static int
+testLeaseReplay(const void *opaque)
+{
+    const char *scratchdir = opaque;
+    g_autofree char *file = testLeaseFile(scratchdir, "replay");
+    g_autoptr(virLeaseDB) db = NULL;
+
+    if (!file || !(db = virLeaseDBNew(file)))
+        return -1;
+
+    if (testLeaseCheck(db, "192.168.122.10=52:54:00:00:00:01 "
+                           "192.168.122.11=52:54:00:00:00:02") < 0)
+        return -1;
+
+    if (testLeaseAppend(file, TEST_LEASE("192.168.122.10",
+                                         "52:54:00:00:00:03")) < 0 ||
+        virLeaseJournalAppendDelete(file, "192.168.122.11") < 0 ||
+        testLeaseAppend(file, TEST_LEASE("192.168.122.12",
+                                         "52:54:00:00:00:04")) < 0)
+        return -1;
+
+    if (testLeaseCheck(db, "192.168.122.10=52:54:00:00:00:03 "
+                           "192.168.122.12=52:54:00:00:00:04") < 0)
+        return -1;
+
+    /* A record still being written is left for the next refresh */
+    if (testLeaseAppendRaw(file, "{\"ip-address\":") < 0)
+        return -1;
+
+    if (testLeaseCheck(db, "192.168.122.10=52:54:00:00:00:03 "
+                           "192.168.122.12=52:54:00:00:00:04") < 0)
+        return -1;
+
+    if (testLeaseAppendRaw(file, "\"192.168.122.10\"}\n") < 0)
+        return -1;
+
+    if (testLeaseCheck(db, "192.168.122.12=52:54:00:00:00:04") < 0)
+        return -1;
+
+    /* A database created later sees the same leases */
+    g_clear_pointer(&db, virObjectUnref);
+    if (!(db = virLeaseDBNew(file)))
+        return -1;
+
+    return testLeaseCheck(db, "192.168.122.12=52:54:00:00:00:04");
+}
+
+
+/* Compaction folds the journal into the leases file, which databases
+ * that replayed part of the old journal must notice */
+static int
+testLeaseCompact(const void *opaque)
+{
+    const char *scratchdir = opaque;
+    g_autofree char *file = testLeaseFile(scratchdir, "compact");
+    g_autofree char *journal = NULL;
+    g_autofree char *content = NULL;
+    g_autoptr(virLeaseDB) reader = NULL;
+    g_autoptr(virLeaseDB) writer = NULL;
+    g_autofree char *server_duid = NULL;
+
+    if (!file ||
+        !(reader = virLeaseDBNew(file)) ||
+        !(writer = virLeaseDBNew(file)))
+        return -1;
+    journal = g_strdup_printf("%s.journal", file);
+
+    if (virLeaseJournalAppendDelete(file, "192.168.122.10") < 0)
+        return -1;
+
+    if (testLeaseCheck(reader, "192.168.122.11=52:54:00:00:00:02") < 0)
+        return -1;
+
+    if (testLeaseAppend(file, TEST_LEASE("192.168.122.13",
+                                         "52:54:00:00:00:05")) < 0)
+        return -1;
+
+    if (virLeaseDBRefresh(writer) < 0 ||
+        virLeaseDBCompact(writer, &server_duid) < 0)
+        return -1;
+
+    if (virFileReadAll(journal, 1024, &content) < 0)
+        return -1;
+
+    if (*content) {
+        VIR_TEST_DEBUG("journal not emptied: '%s'", content);
+        return -1;
+    }
+
+    if (testLeaseCheck(writer, "192.168.122.11=52:54:00:00:00:02 "
+                               "192.168.122.13=52:54:00:00:00:05") < 0)
+        return -1;
+
+    /* The reader's journal offset points past the end of the new one */
+    if (testLeaseCheck(reader, "192.168.122.11=52:54:00:00:00:02 "
+                               "192.168.122.13=52:54:00:00:00:05") < 0)
+        return -1;
+
+    if (virLeaseJournalAppendDelete(file, "192.168.122.11") < 0)
+        return -1;
+
+    return testLeaseCheck(reader, "192.168.122.13=52:54:00:00:00:05");
+}
+
+
+#define SCRATCHDIRTEMPLATE abs_builddir "/leasedir-XXXXXX"
+
+static int
+mymain(void)
+{
+    int ret = 0;
+    char scratchdir[] = SCRATCHDIRTEMPLATE;
+
+    if (!g_mkdtemp(scratchdir)) {
+        fprintf(stderr, "Cannot create leasedir");
+        abort();
+    }
+
+    if (virTestRun("Lease journal replay", testLeaseReplay, scratchdir) < 0)
+        ret = -1;
+    if (virTestRun("Lease journal compact", testLeaseCompact, scratchdir) < 0)
+        ret = -1;
+
+    if (getenv("LIBVIRT_SKIP_CLEANUP") == NULL)
+        virFileDeleteTree(scratchdir);
+
+    return ret == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+VIR_TEST_MAIN(mymain)
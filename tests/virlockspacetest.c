@@ -337,6 +337,127 @@ static int testLockSpaceResourceLockPath(const void *args G_GNUC_UNUSED)
 }
 
 
+#define OWNER_A 1001
+#define OWNER_B 1002
+
+static int testLockSpaceBatchAcquire(const void *args G_GNUC_UNUSED)
+{
+    virLockSpacePtr lockspace;
+    virLockSpacePtr lockspaces[3];
+    const char *names[] = { "foo", "bar", "baz" };
+    unsigned int flags[] = {
+        VIR_LOCK_SPACE_ACQUIRE_AUTOCREATE,
+        VIR_LOCK_SPACE_ACQUIRE_AUTOCREATE,
+        VIR_LOCK_SPACE_ACQUIRE_AUTOCREATE,
+    };
+    int ret = -1;
+
+    rmdir(LOCKSPACE_DIR);
+
+    if (!(lockspace = virLockSpaceNew(LOCKSPACE_DIR)))
+        goto cleanup;
+
+    lockspaces[0] = lockspaces[1] = lockspaces[2] = lockspace;
+
+    if (virLockSpaceAcquireResource(lockspace, "bar", OWNER_B,
+                                    VIR_LOCK_SPACE_ACQUIRE_AUTOCREATE) < 0)
+        goto cleanup;
+
+    /* One busy resource fails the whole batch ... */
+    if (virLockSpaceAcquireResources(lockspaces, names, flags,
+                                     G_N_ELEMENTS(names), OWNER_A) == 0)
+        goto cleanup;
+
+    if (!strstr(virGetLastErrorMessage(), "'bar'"))
+        goto cleanup;
+    virResetLastError();
+
+    /* ... and rolls back the part acquired before it */
+    if (virFileExists(LOCKSPACE_DIR "/foo"))
+        goto cleanup;
+
+    if (virLockSpaceReleaseResource(lockspace, "foo", OWNER_A) == 0)
+        goto cleanup;
+    virResetLastError();
+
+    /* The resource held by someone else is left alone */
+    if (virLockSpaceReleaseResource(lockspace, "bar", OWNER_B) < 0)
+        goto cleanup;
+
+    if (virLockSpaceAcquireResources(lockspaces, names, flags,
+                                     G_N_ELEMENTS(names), OWNER_A) < 0)
+        goto cleanup;
+
+    if (virLockSpaceAcquireResource(lockspace, "baz", OWNER_B, 0) == 0)
+        goto cleanup;
+    virResetLastError();
+
+    if (virLockSpaceReleaseResources(lockspaces, names,
+                                     G_N_ELEMENTS(names), OWNER_A) < 0)
+        goto cleanup;
+
+    if (virFileExists(LOCKSPACE_DIR "/foo") ||
+        virFileExists(LOCKSPACE_DIR "/bar") ||
+        virFileExists(LOCKSPACE_DIR "/baz"))
+        goto cleanup;
+
+    ret = 0;
+
+ cleanup:
+    virLockSpaceFree(lockspace);
+    rmdir(LOCKSPACE_DIR);
+    return ret;
+}
+
+
+static int testLockSpaceBatchRelease(const void *args G_GNUC_UNUSED)
+{
+    virLockSpacePtr lockspace;
+    virLockSpacePtr lockspaces[4];
+    const char *names[] = { "foo", "bar", "missing", "baz" };
+    int ret = -1;
+
+    rmdir(LOCKSPACE_DIR);
+
+    if (!(lockspace = virLockSpaceNew(LOCKSPACE_DIR)))
+        goto cleanup;
+
+    /* "bar" is not held and "missing" has no lockspace */
+    lockspaces[0] = lockspaces[1] = lockspaces[3] = lockspace;
+    lockspaces[2] = NULL;
+
+    if (virLockSpaceAcquireResource(lockspace, "foo", OWNER_A,
+                                    VIR_LOCK_SPACE_ACQUIRE_AUTOCREATE) < 0 ||
+        virLockSpaceAcquireResource(lockspace, "baz", OWNER_A,
+                                    VIR_LOCK_SPACE_ACQUIRE_AUTOCREATE) < 0)
+        goto cleanup;
+
+    /* Failures don't stop the rest of the batch, the first is reported */
+    if (virLockSpaceReleaseResources(lockspaces, names,
+                                     G_N_ELEMENTS(names), OWNER_A) == 0)
+        goto cleanup;
+
+    if (!strstr(virGetLastErrorMessage(), "'bar'"))
+        goto cleanup;
+    virResetLastError();
+
+    if (virFileExists(LOCKSPACE_DIR "/foo") ||
+        virFileExists(LOCKSPACE_DIR "/baz"))
+        goto cleanup;
+
+    if (virLockSpaceReleaseResource(lockspace, "baz", OWNER_A) == 0)
+        goto cleanup;
+    virResetLastError();
+
+    ret = 0;
+
+ cleanup:
+    virLockSpaceFree(lockspace);
+    rmdir(LOCKSPACE_DIR);
+    return ret;
+}
+
+
 
 static int
 mymain(void)
@@ -368,6 +489,12 @@ mymain(void)
     if (virTestRun("Lockspace res full path", testLockSpaceResourceLockPath, NULL) < 0)
         ret = -1;
 
+    if (virTestRun("Lockspace batch acquire", testLockSpaceBatchAcquire, NULL) < 0)
+        ret = -1;
+
+    if (virTestRun("Lockspace batch release", testLockSpaceBatchRelease, NULL) < 0)
+        ret = -1;
+
     return ret == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
 }
 
@@ -0,0 +1,571 @@
+/*
+ * virnetbench.c: RPC load generator and latency benchmark
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * Starts a daemon (libvirtd or virtproxyd) serving the test driver on a
+ * private UNIX socket, or uses an existing one given by --uri, and
+ * hammers it with a configurable mix of API calls from many concurrent
+ * clients. Reports calls per second and latency percentiles for every
+ * call type, so that changes to the RPC layer, the event loop or the
+ * allocators can be measured without any hypervisor.
+ *
+ *   virnetbench --clients 64 --calls 2000 --mix lookup:4,list:2,xml
+ */
+
+#include <config.h>
+
+#include <getopt.h>
+#include <signal.h>
+
+#include "internal.h"
+#include "viralloc.h"
+#include "vircommand.h"
+#include "virfile.h"
+#include "virenum.h"
+#include "virstring.h"
+#include "virthread.h"
+
+#define VIR_FROM_THIS VIR_FROM_NONE
+
+#define BENCH_DEFAULT_DAEMON abs_top_builddir "/src/libvirtd"
+#define BENCH_DEFAULT_CLIENTS 16
+#define BENCH_DEFAULT_CALLS 1000
+#define BENCH_DEFAULT_MIX "version,lookup,list,xml"
+#define BENCH_DOMAIN "test"
+
+/* How long to wait for a spawned daemon to create its socket */
+#define BENCH_DAEMON_TIMEOUT_MS 30000
+
+#ifndef WIN32
+
+typedef enum {
+    BENCH_OP_VERSION,
+    BENCH_OP_LOOKUP,
+    BENCH_OP_INFO,
+    BENCH_OP_LIST,
+    BENCH_OP_XML,
+    BENCH_OP_STATS,
+    BENCH_OP_CAPS,
+
+    BENCH_OP_LAST
+} benchOp;
+
+VIR_ENUM_DECL(benchOp);
+VIR_ENUM_IMPL(benchOp,
+              BENCH_OP_LAST,
+              "version",
+              "lookup",
+              "info",
+              "list",
+              "xml",
+              "stats",
+              "caps",
+);
+
+typedef struct _benchClient benchClient;
+struct _benchClient {
+    virThread thread;
+    virConnectPtr conn;
+    virDomainPtr dom;
+
+    const benchOp *schedule;
+    size_t nschedule;
+    size_t offset;
+    size_t ncalls;
+
+    /* Latencies in microseconds, per call type */
+    unsigned long long *lat[BENCH_OP_LAST];
+    size_t nlat[BENCH_OP_LAST];
+    size_t nerrors[BENCH_OP_LAST];
+};
+
+
+static int
+benchRunOp(benchClient *client,
+           benchOp op)
+{
+    unsigned long version;
+    virDomainPtr dom;
+    virDomainPtr *doms = NULL;
+    virDomainInfo info;
+    virDomainStatsRecordPtr *records = NULL;
+    char *str = NULL;
+    int n;
+
+    switch (op) {
+    case BENCH_OP_VERSION:
+        return virConnectGetLibVersion(client->conn, &version);
+
+    case BENCH_OP_LOOKUP:
+        if (!(dom = virDomainLookupByName(client->conn, BENCH_DOMAIN)))
+            return -1;
+        virDomainFree(dom);
+        return 0;
+
+    case BENCH_OP_INFO:
+        return virDomainGetInfo(client->dom, &info);
+
+    case BENCH_OP_LIST:
+        if ((n = virConnectListAllDomains(client->conn, &doms, 0)) < 0)
+            return -1;
+        while (n > 0)
+            virDomainFree(doms[--n]);
+        VIR_FREE(doms);
+        return 0;
+
+    case BENCH_OP_XML:
+        if (!(str = virDomainGetXMLDesc(client->dom, 0)))
+            return -1;
+        VIR_FREE(str);
+        return 0;
+
+    case BENCH_OP_STATS:
+        if (virConnectGetAllDomainStats(client->conn, 0, &records, 0) < 0)
+            return -1;
+        virDomainStatsRecordListFree(records);
+        return 0;
+
+    case BENCH_OP_CAPS:
+        if (!(str = virConnectGetCapabilities(client->conn)))
+            return -1;
+        VIR_FREE(str);
+        return 0;
+
+    case BENCH_OP_LAST:
+        break;
+    }
+
+    return -1;
+}
+
+
+static void
+benchClientRun(void *opaque)
+{
+    benchClient *client = opaque;
+    size_t i;
+
+    for (i = 0; i < client->ncalls; i++) {
+        benchOp op = client->schedule[(client->offset + i) % client->nschedule];
+        unsigned long long start = g_get_monotonic_time();
+
+        if (benchRunOp(client, op) < 0) {
+            client->nerrors[op]++;
+            continue;
+        }
+
+        client->lat[op][client->nlat[op]++] = g_get_monotonic_time() - start;
+    }
+}
+
+
+/* Parses "op[:weight],..." into a round robin schedule of calls */
+static int
+benchParseMix(const char *mix,
+              benchOp **schedule,
+              size_t *nschedule)
+{
+    g_auto(GStrv) tokens = NULL;
+    size_t i;
+
+    if (!(tokens = virStringSplit(mix, ",", 0)))
+        return -1;
+
+    for (i = 0; tokens[i]; i++) {
+        char *weightstr = strchr(tokens[i], ':');
+        unsigned int weight = 1;
+        benchOp op;
+        int val;
+
+        if (weightstr) {
+            *weightstr = '\0';
+            if (virStrToLong_ui(weightstr + 1, NULL, 10, &weight) < 0 ||
+                weight == 0 || weight > 1000) {
+                fprintf(stderr, "Invalid weight '%s'\n", weightstr + 1);
+                return -1;
+            }
+        }
+
+        if ((val = benchOpTypeFromString(tokens[i])) < 0) {
+            fprintf(stderr, "Unknown call type '%s'\n", tokens[i]);
+            return -1;
+        }
+        op = val;
+
+        while (weight--) {
+            if (VIR_APPEND_ELEMENT_COPY(*schedule, *nschedule, op) < 0)
+                return -1;
+        }
+    }
+
+    if (*nschedule == 0) {
+        fprintf(stderr, "No calls in mix '%s'\n", mix);
+        return -1;
+    }
+
+    return 0;
+}
+
+
+static int
+benchCompareLatency(const void *a,
+                    const void *b)
+{
+    unsigned long long la = *(const unsigned long long *)a;
+    unsigned long long lb = *(const unsigned long long *)b;
+
+    if (la < lb)
+        return -1;
+    return la > lb;
+}
+
+
+static unsigned long long
+benchPercentile(const unsigned long long *lat,
+                size_t nlat,
+                unsigned int permille)
+{
+    size_t idx;
+
+    if (nlat == 0)
+        return 0;
+
+    idx = (nlat * permille + 999) / 1000;
+    if (idx > 0)
+        idx--;
+
+    return lat[idx];
+}
+
+
+static void
+benchReportLine(const char *name,
+                unsigned long long *lat,
+                size_t nlat,
+                size_t nerrors)
+{
+    qsort(lat, nlat, sizeof(*lat), benchCompareLatency);
+
+    printf("%-8s %10zu %8zu %10llu %10llu %10llu %10llu\n",
+           name, nlat, nerrors,
+           benchPercentile(lat, nlat, 500),
+           benchPercentile(lat, nlat, 990),
+           benchPercentile(lat, nlat, 999),
+           nlat ? lat[nlat - 1] : 0);
+}
+
+
+static void
+benchReport(benchClient *clients,
+            size_t nclients,
+            unsigned long long elapsed)
+{
+    g_autofree unsigned long long *all = NULL;
+    size_t nall = 0;
+    size_t allerrors = 0;
+    size_t i;
+    size_t j;
+
+    printf("%-8s %10s %8s %10s %10s %10s %10s\n",
+           "call", "count", "errors", "p50(us)", "p99(us)", "p999(us)", "max(us)");
+
+    for (i = 0; i < BENCH_OP_LAST; i++) {
+        g_autofree unsigned long long *lat = NULL;
+        size_t nlat = 0;
+        size_t nerrors = 0;
+
+        for (j = 0; j < nclients; j++) {
+            nlat += clients[j].nlat[i];
+            nerrors += clients[j].nerrors[i];
+        }
+
+        if (nlat == 0 && nerrors == 0)
+            continue;
+
+        lat = g_new0(unsigned long long, nlat);
+        nlat = 0;
+        for (j = 0; j < nclients; j++) {
+            memcpy(lat + nlat, clients[j].lat[i],
+                   clients[j].nlat[i] * sizeof(*lat));
+            nlat += clients[j].nlat[i];
+        }
+
+        all = g_renew(unsigned long long, all, nall + nlat);
+        memcpy(all + nall, lat, nlat * sizeof(*lat));
+        nall += nlat;
+        allerrors += nerrors;
+
+        benchReportLine(benchOpTypeToString(i), lat, nlat, nerrors);
+    }
+
+    benchReportLine("total", all, nall, allerrors);
+
+    printf("\n%zu clients, %zu calls in %llu ms, %llu calls/s\n",
+           nclients, nall, elapsed / 1000,
+           elapsed ? nall * 1000000ULL / elapsed : 0);
+}
+
+
+static virCommandPtr
+benchDaemonStart(const char *daemon,
+                 const char *dir,
+                 pid_t *pid,
+                 char **uri)
+{
+    g_autoptr(virCommand) cmd = NULL;
+    g_autofree char *conf = g_strdup_printf("%s/daemon.conf", dir);
+    g_autofree char *pidfile = g_strdup_printf("%s/daemon.pid", dir);
+    g_autofree char *sock = g_strdup_printf("%s/libvirt-sock", dir);
+    g_autofree char *confdata = NULL;
+    size_t i;
+
+    /* Everything the daemon touches lives in the private directory */
+    confdata = g_strdup_printf("unix_sock_dir = \"%s\"\n"
+                               "auth_unix_rw = \"none\"\n"
+                               "log_outputs = \"3:file:%s/daemon.log\"\n",
+                               dir, dir);
+
+    if (virFileWriteStr(conf, confdata, 0600) < 0) {
+        fprintf(stderr, "Unable to write %s\n", conf);
+        return NULL;
+    }
+
+    cmd = virCommandNewArgList(daemon, "--config", conf,
+                               "--pid-file", pidfile, NULL);
+    virCommandAddEnvPassCommon(cmd);
+    virCommandAddEnvPair(cmd, "XDG_CONFIG_HOME", dir);
+    virCommandAddEnvPair(cmd, "XDG_CACHE_HOME", dir);
+    virCommandAddEnvPair(cmd, "XDG_RUNTIME_DIR", dir);
+    virCommandSetErrorFD(cmd, NULL);
+
+    if (virCommandRunAsync(cmd, pid) < 0) {
+        fprintf(stderr, "Unable to start %s: %s\n",
+                daemon, virGetLastErrorMessage());
+        return NULL;
+    }
+
+    for (i = 0; i < BENCH_DAEMON_TIMEOUT_MS / 10; i++) {
+        if (virFileExists(sock))
+            break;
+        g_usleep(10 * 1000);
+    }
+
+    if (!virFileExists(sock)) {
+        fprintf(stderr, "%s did not create %s, see %s/daemon.log\n",
+                daemon, sock, dir);
+        virCommandAbort(cmd);
+        return NULL;
+    }
+
+    *uri = g_strdup_printf("test+unix:///default?socket=%s", sock);
+
+    return g_steal_pointer(&cmd);
+}
+
+
+static void
+benchDaemonStop(virCommandPtr cmd,
+                pid_t pid)
+{
+    kill(pid, SIGTERM);
+    ignore_value(virCommandWait(cmd, NULL));
+    virCommandFree(cmd);
+}
+
+
+static void
+benchUsage(const char *argv0)
+{
+    fprintf(stderr,
+            "Usage: %s [OPTIONS]\n"
+            "\n"
+            "  -d, --daemon PATH    daemon to start (default %s)\n"
+            "  -u, --uri URI        use an already running daemon instead\n"
+            "  -c, --clients NUM    concurrent client connections (default %d)\n"
+            "  -n, --calls NUM      calls made by each client (default %d)\n"
+            "  -m, --mix LIST       comma separated call[:weight] list\n"
+            "                       (default %s)\n"
+            "  -h, --help           print this help\n"
+            "\n"
+            "Call types: version lookup info list xml stats caps\n",
+            argv0, BENCH_DEFAULT_DAEMON, BENCH_DEFAULT_CLIENTS,
+            BENCH_DEFAULT_CALLS, BENCH_DEFAULT_MIX);
+}
+
+
+int
+main(int argc, char **argv)
+{
+    const char *daemon = BENCH_DEFAULT_DAEMON;
+    const char *mix = BENCH_DEFAULT_MIX;
+    g_autofree char *uri = NULL;
+    g_autofree char *dir = NULL;
+    g_autofree benchOp *schedule = NULL;
+    size_t nschedule = 0;
+    unsigned int nclients = BENCH_DEFAULT_CLIENTS;
+    unsigned int ncalls = BENCH_DEFAULT_CALLS;
+    benchClient *clients = NULL;
+    size_t nstarted = 0;
+    virCommandPtr cmd = NULL;
+    pid_t pid = -1;
+    unsigned long long start;
+    size_t i;
+    size_t j;
+    int ret = EXIT_FAILURE;
+    int c;
+    struct option opts[] = {
+        { "daemon", required_argument, NULL, 'd' },
+        { "uri", required_argument, NULL, 'u' },
+        { "clients", required_argument, NULL, 'c' },
+        { "calls", required_argument, NULL, 'n' },
+        { "mix", required_argument, NULL, 'm' },
+        { "help", no_argument, NULL, 'h' },
+        { NULL, 0, NULL, 0 },
+    };
+
+    while ((c = getopt_long(argc, argv, "d:u:c:n:m:h", opts, NULL)) != -1) {
+        switch (c) {
+        case 'd':
+            daemon = optarg;
+            break;
+        case 'u':
+            g_free(uri);
+            uri = g_strdup(optarg);
+            break;
+        case 'c':
+            if (virStrToLong_ui(optarg, NULL, 10, &nclients) < 0 ||
+                nclients == 0) {
+                fprintf(stderr, "Invalid number of clients '%s'\n", optarg);
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'n':
+            if (virStrToLong_ui(optarg, NULL, 10, &ncalls) < 0 ||
+                ncalls == 0) {
+                fprintf(stderr, "Invalid number of calls '%s'\n", optarg);
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'm':
+            mix = optarg;
+            break;
+        case 'h':
+            benchUsage(argv[0]);
+            return EXIT_SUCCESS;
+        default:
+            benchUsage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (optind != argc) {
+        benchUsage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    if (benchParseMix(mix, &schedule, &nschedule) < 0)
+        return EXIT_FAILURE;
+
+    if (virInitialize() < 0) {
+        fprintf(stderr, "Failed to initialize libvirt\n");
+        return EXIT_FAILURE;
+    }
+
+    if (!uri) {
+        dir = g_strdup("/tmp/virnetbench-XXXXXX");
+        if (!g_mkdtemp(dir)) {
+            fprintf(stderr, "Unable to create temporary directory\n");
+            return EXIT_FAILURE;
+        }
+
+        if (!(cmd = benchDaemonStart(daemon, dir, &pid, &uri)))
+            goto cleanup;
+    }
+
+    clients = g_new0(benchClient, nclients);
+
+    /* Connect everyone up front so that only the calls are measured */
+    for (i = 0; i < nclients; i++) {
+        benchClient *client = &clients[i];
+
+        if (!(client->conn = virConnectOpen(uri))) {
+            fprintf(stderr, "Unable to connect to %s: %s\n",
+                    uri, virGetLastErrorMessage());
+            goto cleanup;
+        }
+
+        if (!(client->dom = virDomainLookupByName(client->conn, BENCH_DOMAIN))) {
+            fprintf(stderr, "Unable to find domain '%s': %s\n",
+                    BENCH_DOMAIN, virGetLastErrorMessage());
+            goto cleanup;
+        }
+
+        client->schedule = schedule;
+        client->nschedule = nschedule;
+        client->offset = i;
+        client->ncalls = ncalls;
+        for (j = 0; j < BENCH_OP_LAST; j++)
+            client->lat[j] = g_new0(unsigned long long, ncalls);
+    }
+
+    start = g_get_monotonic_time();
+
+    for (i = 0; i < nclients; i++) {
+        if (virThreadCreate(&clients[i].thread, true,
+                            benchClientRun, &clients[i]) < 0) {
+            fprintf(stderr, "Unable to create client thread\n");
+            break;
+        }
+        nstarted++;
+    }
+
+    for (i = 0; i < nstarted; i++)
+        virThreadJoin(&clients[i].thread);
+
+    if (nstarted == nclients) {
+        benchReport(clients, nclients, g_get_monotonic_time() - start);
+        ret = EXIT_SUCCESS;
+    }
+
+ cleanup:
+    for (i = 0; clients && i < nclients; i++) {
+        if (clients[i].dom)
+            virDomainFree(clients[i].dom);
+        if (clients[i].conn)
+            virConnectClose(clients[i].conn);
+        for (j = 0; j < BENCH_OP_LAST; j++)
+            g_free(clients[i].lat[j]);
+    }
+    g_free(clients);
+
+    if (cmd)
+        benchDaemonStop(cmd, pid);
+    if (dir && ret == EXIT_SUCCESS)
+        virFileDeleteTree(dir);
+
+    return ret;
+}
+
+#else /* WIN32 */
+
+int
+main(void)
+{
+    fprintf(stderr, "virnetbench is not supported on this platform\n");
+    return EXIT_FAILURE;
+}
+
+#endif /* WIN32 */
@@ -0,0 +1,209 @@
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+
+#include "testutils.h"
+
+#if defined(__linux__) && defined(HAVE_LIBNL)
+
+# include <sched.h>
+# include <unistd.h>
+
+# include "vircommand.h"
+# include "virfile.h"
+# include "virmacaddr.h"
+# include "virnetlink.h"
+# define LIBVIRT_VIRNETDEVBANDWIDTHPRIV_H_ALLOW
+# include "virnetdevbandwidthpriv.h"
+
+# define VIR_FROM_THIS VIR_FROM_NONE
+
+/* This test programs QoS on a dummy interface both by running tc and
+ * over netlink and checks that the kernel ends up in the same state.
+ * It needs root and VIR_TEST_EXPENSIVE=1 and is skipped otherwise. The
+ * interface is created in a private network namespace so that the host
+ * is left alone. */
+
+# define TEST_IFNAME "vir-bwtest0"
+# define TEST_ID 3
+
+struct testData {
+    const char *name;
+    virNetDevBandwidthRate in;
+    virNetDevBandwidthRate out;
+    bool hierarchical_class;
+};
+
+
+static int
+testCaptureState(virBufferPtr buf)
+{
+    const char *const cmds[][9] = {
+        { TC, "-d", "qdisc", "show", "dev", TEST_IFNAME, NULL },
+        { TC, "-d", "class", "show", "dev", TEST_IFNAME, NULL },
+        { TC, "-d", "filter", "show", "dev", TEST_IFNAME, NULL },
+        { TC, "-d", "filter", "show", "dev", TEST_IFNAME,
+          "parent", "ffff:", NULL },
+    };
+    size_t i;
+
+    for (i = 0; i < G_N_ELEMENTS(cmds); i++) {
+        g_autoptr(virCommand) cmd = virCommandNewArgs(cmds[i]);
+        g_autofree char *output = NULL;
+
+        virCommandSetOutputBuffer(cmd, &output);
+        if (virCommandRun(cmd, NULL) < 0)
+            return -1;
+
+        virBufferAdd(buf, output, -1);
+    }
+
+    return 0;
+}
+
+
+static int
+testApply(const struct testData *data,
+          bool useNetlink,
+          char **state)
+{
+    virBuffer buf = VIR_BUFFER_INITIALIZER;
+    virNetDevBandwidth band = {
+        .in = data->in.average ? (virNetDevBandwidthRatePtr) &data->in : NULL,
+        .out = data->out.average ? (virNetDevBandwidthRatePtr) &data->out : NULL,
+    };
+    virNetDevBandwidthRate floor = { .floor = 1000 };
+    virNetDevBandwidth plug = { .in = &floor };
+    virMacAddr mac;
+    g_autoptr(GRegex) regex = NULL;
+    g_autofree char *raw = NULL;
+
+    virNetDevBandwidthSetUseNetlink(useNetlink);
+
+    if (virNetDevBandwidthClear(TEST_IFNAME) < 0 ||
+        virNetDevBandwidthSet(TEST_IFNAME, &band,
+                              data->hierarchical_class, true) < 0 ||
+        testCaptureState(&buf) < 0)
+        goto error;
+
+    if (data->hierarchical_class) {
+        if (virMacAddrParse("52:54:00:12:34:56", &mac) < 0 ||
+            virNetDevBandwidthPlug(TEST_IFNAME, &band, &mac, &plug, TEST_ID) < 0 ||
+            virNetDevBandwidthUpdateRate(TEST_IFNAME, 2, &band,
+                                         data->in.average - floor.floor) < 0 ||
+            testCaptureState(&buf) < 0)
+            goto error;
+
+        if (virMacAddrParse("52:54:00:65:43:21", &mac) < 0 ||
+            virNetDevBandwidthUpdateFilter(TEST_IFNAME, &mac, TEST_ID) < 0 ||
+            testCaptureState(&buf) < 0)
+            goto error;
+
+        if (virNetDevBandwidthUnplug(TEST_IFNAME, TEST_ID) < 0 ||
+            testCaptureState(&buf) < 0)
+            goto error;
+    }
+
+    if (virNetDevBandwidthClear(TEST_IFNAME) < 0 ||
+        testCaptureState(&buf) < 0)
+        goto error;
+
+    /* Police actions are numbered globally */
+    raw = virBufferContentAndReset(&buf);
+    regex = g_regex_new("police 0x[0-9a-f]+", 0, 0, NULL);
+    *state = g_regex_replace_literal(regex, raw, -1, 0, "police", 0, NULL);
+    return 0;
+
+ error:
+    virBufferFreeAndReset(&buf);
+    return -1;
+}
+
+
+static int
+testCompare(const void *opaque)
+{
+    const struct testData *data = opaque;
+    g_autofree char *expected = NULL;
+    g_autofree char *actual = NULL;
+
+    if (testApply(data, false, &expected) < 0 ||
+        testApply(data, true, &actual) < 0)
+        return -1;
+
+    return virTestCompareToString(expected, actual);
+}
+
+
+static int
+mymain(void)
+{
+    int ret = 0;
+    int error = 0;
+
+    if (virTestGetExpensive() == 0 ||
+        geteuid() != 0 || !virFileIsExecutable(TC))
+        return EXIT_AM_SKIP;
+
+    if (unshare(CLONE_NEWNET) < 0) {
+        VIR_TEST_DEBUG("unable to create network namespace: %s",
+                       g_strerror(errno));
+        return EXIT_AM_SKIP;
+    }
+
+    if (virNetlinkNewLink(TEST_IFNAME, "dummy", NULL, &error) < 0)
+        return EXIT_AM_SKIP;
+
+# define DO_TEST(Name, ...) \
+    do { \
+        struct testData data = { .name = Name, __VA_ARGS__ }; \
+        if (virTestRun("Netlink equivalence " Name, testCompare, &data) < 0) \
+            ret = -1; \
+    } while (0)
+
+    DO_TEST("inbound",
+            .in = { .average = 1000 });
+    DO_TEST("inbound peak burst",
+            .in = { .average = 1000, .peak = 5000, .burst = 1024 });
+    DO_TEST("outbound",
+            .out = { .average = 800 });
+    DO_TEST("outbound burst",
+            .out = { .average = 800, .burst = 64 });
+    DO_TEST("both",
+            .in = { .average = 123456, .peak = 234567, .burst = 4096 },
+            .out = { .average = 100, .peak = 200, .burst = 1 });
+    DO_TEST("hierarchical",
+            .in = { .average = 10000, .peak = 20000 },
+            .hierarchical_class = true);
+    DO_TEST("hierarchical both",
+            .in = { .average = 100000 },
+            .out = { .average = 5000, .burst = 128 },
+            .hierarchical_class = true);
+
+    ignore_value(virNetlinkDelLink(TEST_IFNAME, NULL));
+
+    return ret == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+VIR_TEST_MAIN(mymain)
+#else
+int
+main(void)
+{
+    return EXIT_AM_SKIP;
+}
+#endif
@@ -21,7 +21,8 @@
 #include "testutils.h"
 #define LIBVIRT_VIRCOMMANDPRIV_H_ALLOW
 #include "vircommandpriv.h"
-#include "virnetdevbandwidth.h"
+#define LIBVIRT_VIRNETDEVBANDWIDTHPRIV_H_ALLOW
+#include "virnetdevbandwidthpriv.h"
 #include "netdev_bandwidth_conf.c"
 
 #define VIR_FROM_THIS VIR_FROM_NONE
@@ -109,6 +110,9 @@ mymain(void)
 {
     int ret = 0;
 
+    /* The expected output is tc command lines */
+    virNetDevBandwidthSetUseNetlink(false);
+
 #define DO_TEST_SET(Band, Exp_cmd, ...) \
     do { \
         struct testSetStruct data = {.band = Band, \
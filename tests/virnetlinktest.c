@@ -0,0 +1,277 @@
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+
+#include "testutils.h"
+
+#if defined(__linux__) && defined(HAVE_LIBNL)
+
+# include <sys/wait.h>
+# include <unistd.h>
+
+# include "virnetlink.h"
+# define LIBVIRT_VIRNETLINKPRIV_H_ALLOW
+# include "virnetlinkpriv.h"
+
+# define VIR_FROM_THIS VIR_FROM_NONE
+
+/* These tests only talk to the kernel about the loopback interface of
+ * the network namespace they run in, which needs no privileges. */
+
+/* Matches NETLINK_POOL_SIZE */
+# define TEST_POOL_SIZE 8
+
+
+/* Idle sockets are reused most recently released first, up to the
+ * size of the pool and only for the protocol they were created for */
+static int
+testPool(const void *opaque G_GNUC_UNUSED)
+{
+    virNetlinkHandle *socks[TEST_POOL_SIZE + 1] = { NULL };
+    virNetlinkHandle *released[TEST_POOL_SIZE];
+    virNetlinkHandle *nlhandle = NULL;
+    size_t i;
+    int ret = -1;
+
+    for (i = 0; i < G_N_ELEMENTS(socks); i++) {
+        if (!(socks[i] = virNetlinkAcquireSocket(NETLINK_ROUTE)))
+            goto cleanup;
+    }
+
+    /* The last one doesn't fit into the pool any more */
+    for (i = 0; i < G_N_ELEMENTS(socks); i++) {
+        if (i < TEST_POOL_SIZE)
+            released[i] = socks[i];
+        virNetlinkReleaseSocket(NETLINK_ROUTE, g_steal_pointer(&socks[i]), true);
+    }
+
+    for (i = TEST_POOL_SIZE; i > 0; i--) {
+        if (!(socks[i - 1] = virNetlinkAcquireSocket(NETLINK_ROUTE)))
+            goto cleanup;
+
+        if (socks[i - 1] != released[i - 1]) {
+            VIR_TEST_DEBUG("socket %zu not taken from the pool", i - 1);
+            goto cleanup;
+        }
+    }
+
+    /* A socket which can't be reused is closed instead of pooled */
+    virNetlinkReleaseSocket(NETLINK_ROUTE, g_steal_pointer(&socks[1]), true);
+    virNetlinkReleaseSocket(NETLINK_ROUTE, g_steal_pointer(&socks[0]), false);
+
+    if (!(socks[0] = virNetlinkAcquireSocket(NETLINK_ROUTE)))
+        goto cleanup;
+
+    if (socks[0] != released[1]) {
+        VIR_TEST_DEBUG("unusable socket returned to the pool");
+        goto cleanup;
+    }
+
+    /* Pooled sockets stay with their protocol */
+    virNetlinkReleaseSocket(NETLINK_ROUTE, g_steal_pointer(&socks[0]), true);
+
+    if (!(nlhandle = virNetlinkAcquireSocket(NETLINK_GENERIC)))
+        goto cleanup;
+
+    if (nlhandle == released[1]) {
+        VIR_TEST_DEBUG("socket reused for a different protocol");
+        goto cleanup;
+    }
+
+    ret = 0;
+
+ cleanup:
+    virNetlinkReleaseSocket(NETLINK_GENERIC, nlhandle, true);
+    for (i = 0; i < G_N_ELEMENTS(socks); i++)
+        virNetlinkReleaseSocket(NETLINK_ROUTE, socks[i], true);
+    return ret;
+}
+
+
+/* A child doesn't use the sockets pooled by its parent, which might
+ * belong to another network namespace, and leaves the parent's pool
+ * alone */
+static int
+testFork(const void *opaque G_GNUC_UNUSED)
+{
+    virNetlinkHandle *nlhandle = NULL;
+    virNetlinkHandle *parent = NULL;
+    uint32_t port;
+    pid_t pid;
+    int status;
+
+    if (!(parent = virNetlinkAcquireSocket(NETLINK_ROUTE)))
+        return -1;
+
+    port = nl_socket_get_local_port(parent);
+    virNetlinkReleaseSocket(NETLINK_ROUTE, parent, true);
+
+    if ((pid = fork()) < 0)
+        return -1;
+
+    if (pid == 0) {
+        /* The parent keeps its socket bound, so a socket created by the
+         * child can't have the same port */
+        nlhandle = virNetlinkAcquireSocket(NETLINK_ROUTE);
+        if (!nlhandle || nl_socket_get_local_port(nlhandle) == port)
+            _exit(EXIT_FAILURE);
+        _exit(EXIT_SUCCESS);
+    }
+
+    if (waitpid(pid, &status, 0) < 0 ||
+        !WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS) {
+        VIR_TEST_DEBUG("child used a socket pooled by its parent");
+        return -1;
+    }
+
+    if (!(nlhandle = virNetlinkAcquireSocket(NETLINK_ROUTE)))
+        return -1;
+
+    virNetlinkReleaseSocket(NETLINK_ROUTE, nlhandle, true);
+
+    if (nlhandle != parent) {
+        VIR_TEST_DEBUG("parent lost its pooled socket");
+        return -1;
+    }
+
+    return 0;
+}
+
+
+/* Replies are told apart from stale ones by their sequence number */
+static int
+testSequence(const void *opaque G_GNUC_UNUSED)
+{
+    g_autoptr(virNetlinkMsg) msg = nlmsg_alloc_simple(RTM_GETLINK,
+                                                       NLM_F_REQUEST);
+    struct nlmsghdr resp = { .nlmsg_len = NLMSG_HDRLEN, .nlmsg_seq = 42 };
+
+    if (!msg)
+        return -1;
+
+    nlmsg_hdr(msg)->nlmsg_seq = 42;
+
+    if (!virNetlinkIsResponse(msg, &resp, sizeof(resp))) {
+        VIR_TEST_DEBUG("response with matching sequence number discarded");
+        return -1;
+    }
+
+    resp.nlmsg_seq = 41;
+    if (virNetlinkIsResponse(msg, &resp, sizeof(resp))) {
+        VIR_TEST_DEBUG("response with stale sequence number accepted");
+        return -1;
+    }
+
+    /* Truncated messages are left to the caller to reject */
+    if (!virNetlinkIsResponse(msg, &resp, NLMSG_HDRLEN - 1)) {
+        VIR_TEST_DEBUG("truncated response discarded");
+        return -1;
+    }
+
+    return 0;
+}
+
+
+/* The reply to a request which was never read is skipped by the next
+ * request made on the same pooled socket */
+static int
+testStaleReply(const void *opaque G_GNUC_UNUSED)
+{
+    g_autoptr(virNetlinkMsg) msg = NULL;
+    g_autofree void *nlData = NULL;
+    struct nlattr *tb[IFLA_MAX + 1] = { NULL, };
+    struct ifinfomsg ifinfo = {
+        .ifi_family = AF_UNSPEC,
+        .ifi_index = INT_MAX,
+    };
+    virNetlinkHandle *nlhandle = NULL;
+    virNetlinkHandle *stale = NULL;
+
+    if (!(stale = virNetlinkAcquireSocket(NETLINK_ROUTE)))
+        return -1;
+
+    /* There's no such interface, so taking the reply for the answer to
+     * the next request would fail it */
+    if (!(msg = nlmsg_alloc_simple(RTM_GETLINK, NLM_F_REQUEST)) ||
+        nlmsg_append(msg, &ifinfo, sizeof(ifinfo), NLMSG_ALIGNTO) < 0 ||
+        nl_send_auto_complete(stale, msg) < 0) {
+        virNetlinkReleaseSocket(NETLINK_ROUTE, stale, false);
+        return -1;
+    }
+
+    virNetlinkReleaseSocket(NETLINK_ROUTE, stale, true);
+
+    if (virNetlinkDumpLink("lo", -1, &nlData, tb, 0, 0) < 0)
+        return -1;
+
+    if (!tb[IFLA_IFNAME] || STRNEQ(nla_get_string(tb[IFLA_IFNAME]), "lo")) {
+        VIR_TEST_DEBUG("unexpected reply to dumping 'lo'");
+        return -1;
+    }
+
+    if (!(nlhandle = virNetlinkAcquireSocket(NETLINK_ROUTE)))
+        return -1;
+
+    virNetlinkReleaseSocket(NETLINK_ROUTE, nlhandle, true);
+
+    if (nlhandle != stale) {
+        VIR_TEST_DEBUG("socket not returned to the pool");
+        return -1;
+    }
+
+    return 0;
+}
+
+
+static int
+mymain(void)
+{
+    virNetlinkHandle *nlhandle;
+    int ret = 0;
+
+    if (virNetlinkStartup() < 0)
+        return EXIT_FAILURE;
+
+    /* Netlink may not be usable in the environment the tests run in */
+    if (!(nlhandle = virNetlinkAcquireSocket(NETLINK_ROUTE))) {
+        virNetlinkShutdown();
+        return EXIT_AM_SKIP;
+    }
+    virNetlinkReleaseSocket(NETLINK_ROUTE, nlhandle, true);
+
+    if (virTestRun("pool", testPool, NULL) < 0)
+        ret = -1;
+    if (virTestRun("fork", testFork, NULL) < 0)
+        ret = -1;
+    if (virTestRun("sequence", testSequence, NULL) < 0)
+        ret = -1;
+    if (virTestRun("stale reply", testStaleReply, NULL) < 0)
+        ret = -1;
+
+    virNetlinkShutdown();
+
+    return ret == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+VIR_TEST_MAIN(mymain)
+#else
+int
+main(void)
+{
+    return EXIT_AM_SKIP;
+}
+#endif
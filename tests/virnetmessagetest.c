@@ -289,6 +289,96 @@ static int testMessagePayloadEncode(const void *args G_GNUC_UNUSED)
     return ret;
 }
 
+static int testMessagePayloadEncodeLarge(const void *args G_GNUC_UNUSED)
+{
+    virNetMessageError err;
+    virNetMessageError got;
+    virNetMessagePtr msg = virNetMessageNew(true);
+    unsigned int encoded, reencoded, resized;
+    unsigned int newencoded, newreencoded, newresized;
+    char *message = NULL;
+    size_t len = VIR_NET_MESSAGE_INITIAL * 5 + 13;
+    int ret = -1;
+
+    if (!msg)
+        return -1;
+
+    memset(&err, 0, sizeof(err));
+    memset(&got, 0, sizeof(got));
+
+    /* Way too big for the initial buffer */
+    message = g_new0(char, len + 1);
+    memset(message, 'x', len);
+
+    err.code = VIR_ERR_INTERNAL_ERROR;
+    err.domain = VIR_FROM_RPC;
+    err.level = VIR_ERR_ERROR;
+    err.message = &message;
+
+    msg->header.prog = 0x11223344;
+    msg->header.vers = 0x01;
+    msg->header.proc = 0x666;
+    msg->header.type = VIR_NET_MESSAGE;
+    msg->header.serial = 0x99;
+    msg->header.status = VIR_NET_ERROR;
+
+    virNetMessageGetEncodeStats(&encoded, &reencoded, &resized);
+
+    if (virNetMessageEncodeHeader(msg) < 0)
+        goto cleanup;
+
+    if (virNetMessageEncodePayload(msg, (xdrproc_t)xdr_virNetMessageError, &err) < 0)
+        goto cleanup;
+
+    virNetMessageGetEncodeStats(&newencoded, &newreencoded, &newresized);
+
+    if (newencoded - encoded != 1) {
+        VIR_TEST_DEBUG("Expected 1 encoded payload got %u",
+                       newencoded - encoded);
+        goto cleanup;
+    }
+
+#ifdef HAVE_XDR_SIZEOF
+    /* The payload is sized up front after the first attempt fails */
+    if (newreencoded - reencoded != 1 ||
+        newresized - resized != 1) {
+        VIR_TEST_DEBUG("Expected 1 re-encode and 1 resize got %u and %u",
+                       newreencoded - reencoded, newresized - resized);
+        goto cleanup;
+    }
+#else /* !HAVE_XDR_SIZEOF */
+    if (newreencoded == reencoded) {
+        VIR_TEST_DEBUG("Expected payload to be re-encoded");
+        goto cleanup;
+    }
+#endif /* !HAVE_XDR_SIZEOF */
+
+    /* Now feed the message back and check it survived */
+    msg->bufferLength = VIR_NET_MESSAGE_LEN_MAX;
+    msg->bufferOffset = 0;
+
+    if (virNetMessageDecodeLength(msg) < 0)
+        goto cleanup;
+
+    if (virNetMessageDecodeHeader(msg) < 0)
+        goto cleanup;
+
+    if (virNetMessageDecodePayload(msg, (xdrproc_t)xdr_virNetMessageError, &got) < 0)
+        goto cleanup;
+
+    if (!got.message || STRNEQ(*got.message, message)) {
+        VIR_TEST_DEBUG("Large error message did not round trip");
+        goto cleanup;
+    }
+
+    ret = 0;
+ cleanup:
+    xdr_free((xdrproc_t)xdr_virNetMessageError, (void*)&got);
+    VIR_FREE(message);
+    virNetMessageFree(msg);
+    return ret;
+}
+
 static int testMessagePayloadDecode(const void *args G_GNUC_UNUSED)
 {
     virNetMessageError err;
@@ -538,6 +628,9 @@ mymain(void)
     if (virTestRun("Message Payload Encode", testMessagePayloadEncode, NULL) < 0)
         ret = -1;
 
+    if (virTestRun("Message Payload Encode Large", testMessagePayloadEncodeLarge, NULL) < 0)
+        ret = -1;
+
     if (virTestRun("Message Payload Decode", testMessagePayloadDecode, NULL) < 0)
         ret = -1;
 
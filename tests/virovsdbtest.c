@@ -0,0 +1,492 @@
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+
+#include <unistd.h>
+#ifndef WIN32
+# include <sys/socket.h>
+# include <sys/un.h>
+#endif
+
+#include "testutils.h"
+#include "virerror.h"
+#include "virfile.h"
+#include "virlog.h"
+#include "virovsdb.h"
+#include "virstring.h"
+#include "virthread.h"
+
+#define VIR_FROM_THIS VIR_FROM_NONE
+
+VIR_LOG_INIT("tests.virovsdbtest");
+
+#ifndef WIN32
+
+# define TEST_IFACE_UUID "6a1ee5e5-0d4f-4b43-a0ab-44de2c3a9b57"
+# define TEST_PORT_UUID "1b5c6b8e-7e0b-4e4a-8f53-1d0b8a3f7e21"
+
+/*
+ * A tiny stand-in for ovsdb-server. It answers transactions selecting
+ * from any table but "Fail" with a single row and pings the client
+ * before every reply. Once the monitor is set up, each transaction is
+ * followed by an update bumping the statistics of vnet0 together with
+ * cur_cfg.
+ */
+struct testServer {
+    char *tmpdir;
+    char *path;
+    int listenfd;
+    virThread thread;
+    bool monitored;
+    bool failed;
+};
+
+
+static virJSONValuePtr
+testServerRead(int fd)
+{
+    virBuffer buf = VIR_BUFFER_INITIALIZER;
+    g_autofree char *str = NULL;
+    size_t depth = 0;
+    bool instr = false;
+    bool escape = false;
+    char c;
+
+    do {
+        if (saferead(fd, &c, 1) != 1) {
+            virBufferFreeAndReset(&buf);
+            return NULL;
+        }
+
+        virBufferAddChar(&buf, c);
+
+        if (instr) {
+            if (escape)
+                escape = false;
+            else if (c == '\\')
+                escape = true;
+            else if (c == '"')
+                instr = false;
+        } else if (c == '"') {
+            instr = true;
+        } else if (c == '{' || c == '[') {
+            depth++;
+        } else if (c == '}' || c == ']') {
+            depth--;
+        }
+    } while (depth > 0 || instr || (c != '}' && c != ']'));
+
+    str = virBufferContentAndReset(&buf);
+    return virJSONValueFromString(str);
+}
+
+
+static int
+testServerWrite(int fd,
+                const char *str)
+{
+    return safewrite(fd, str, strlen(str)) < 0 ? -1 : 0;
+}
+
+
+static int
+testServerEcho(int fd)
+{
+    g_autoptr(virJSONValue) reply = NULL;
+    virJSONValuePtr result;
+
+    if (testServerWrite(fd, "{\"method\":\"echo\",\"params\":[\"ping\"],"
+                            "\"id\":\"echo\"}") < 0)
+        return -1;
+
+    if (!(reply = testServerRead(fd)) ||
+        STRNEQ_NULLABLE(virJSONValueObjectGetString(reply, "id"), "echo") ||
+        !(result = virJSONValueObjectGetArray(reply, "result")) ||
+        STRNEQ_NULLABLE(virJSONValueGetString(virJSONValueArrayGet(result, 0)),
+                        "ping")) {
+        VIR_TEST_DEBUG("client didn't answer echo");
+        return -1;
+    }
+
+    return 0;
+}
+
+
+static int
+testServerHandle(struct testServer *srv,
+                 int fd,
+                 virJSONValuePtr msg)
+{
+    const char *method = virJSONValueObjectGetString(msg, "method");
+    virJSONValuePtr params = virJSONValueObjectGetArray(msg, "params");
+    unsigned int id;
+    g_autofree char *reply = NULL;
+
+    if (!method || !params ||
+        virJSONValueObjectGetNumberUint(msg, "id", &id) < 0 ||
+        STRNEQ_NULLABLE(virJSONValueGetString(virJSONValueArrayGet(params, 0)),
+                        "Open_vSwitch")) {
+        VIR_TEST_DEBUG("malformed request");
+        return -1;
+    }
+
+    if (testServerEcho(fd) < 0)
+        return -1;
+
+    if (STREQ(method, "transact")) {
+        virJSONValuePtr op = virJSONValueArrayGet(params, 1);
+        const char *table = virJSONValueObjectGetString(op, "table");
+
+        if (STREQ_NULLABLE(table, "Fail")) {
+            reply = g_strdup_printf("{\"id\":%u,\"error\":null,\"result\":"
+                                    "[{\"error\":\"constraint violation\","
+                                    "\"details\":\"no such row\"}]}", id);
+        } else {
+            reply = g_strdup_printf("{\"id\":%u,\"error\":null,\"result\":"
+                                    "[{\"rows\":[{\"_uuid\":[\"uuid\",\"%s\"]}]}]}",
+                                    id, TEST_PORT_UUID);
+        }
+
+        if (testServerWrite(fd, reply) < 0)
+            return -1;
+
+        if (!srv->monitored)
+            return 0;
+
+        /* Only the changed column is sent for modified rows */
+        return testServerWrite(fd,
+            "{\"method\":\"update\",\"id\":null,\"params\":[\"libvirt\",{"
+            "\"Interface\":{\"" TEST_IFACE_UUID "\":{"
+            "\"old\":{\"statistics\":[\"map\",[[\"rx_bytes\",10],[\"tx_bytes\",20]]]},"
+            "\"new\":{\"statistics\":[\"map\",[[\"rx_bytes\",30],[\"tx_bytes\",40]]]}}},"
+            "\"Open_vSwitch\":{\"" TEST_PORT_UUID "\":{\"new\":{\"cur_cfg\":2}}}"
+            "}]}");
+    }
+
+    if (STREQ(method, "monitor")) {
+        reply = g_strdup_printf(
+            "{\"id\":%u,\"error\":null,\"result\":{"
+            "\"Interface\":{\"" TEST_IFACE_UUID "\":{\"new\":{"
+            "\"name\":\"vnet0\",\"statistics\":"
+            "[\"map\",[[\"rx_bytes\",10],[\"tx_bytes\",20]]]}}},"
+            "\"Open_vSwitch\":{\"" TEST_PORT_UUID "\":{\"new\":{\"cur_cfg\":1}}}"
+            "}}", id);
+
+        srv->monitored = true;
+        return testServerWrite(fd, reply);
+    }
+
+    VIR_TEST_DEBUG("unexpected method %s", method);
+    return -1;
+}
+
+
+static void
+testServerThread(void *opaque)
+{
+    struct testServer *srv = opaque;
+    VIR_AUTOCLOSE fd = -1;
+
+    if ((fd = accept(srv->listenfd, NULL, NULL)) < 0) {
+        srv->failed = true;
+        return;
+    }
+
+    while (true) {
+        g_autoptr(virJSONValue) msg = NULL;
+
+        /* The client closing the connection ends the conversation */
+        if (!(msg = testServerRead(fd)))
+            return;
+
+        if (testServerHandle(srv, fd, msg) < 0) {
+            srv->failed = true;
+            return;
+        }
+    }
+}
+
+
+static void
+testServerFree(struct testServer *srv)
+{
+    VIR_FORCE_CLOSE(srv->listenfd);
+    if (srv->path)
+        unlink(srv->path);
+    if (srv->tmpdir)
+        rmdir(srv->tmpdir);
+    g_free(srv->path);
+    g_free(srv->tmpdir);
+}
+
+
+static virOVSDBClientPtr
+testServerStart(struct testServer *srv)
+{
+    struct sockaddr_un sa;
+    virOVSDBClientPtr client = NULL;
+
+    memset(srv, 0, sizeof(*srv));
+    srv->listenfd = -1;
+
+    if (!(srv->tmpdir = g_mkdtemp(g_strdup("/tmp/libvirt_XXXXXX"))))
+        return NULL;
+    srv->path = g_strdup_printf("%s/db.sock", srv->tmpdir);
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sun_family = AF_UNIX;
+    if (virStrcpyStatic(sa.sun_path, srv->path) < 0)
+        return NULL;
+
+    if ((srv->listenfd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0 ||
+        bind(srv->listenfd, (struct sockaddr *)&sa, sizeof(sa)) < 0 ||
+        listen(srv->listenfd, 1) < 0)
+        return NULL;
+
+    if (virThreadCreate(&srv->thread, true, testServerThread, srv) < 0)
+        return NULL;
+
+    if (!(client = virOVSDBClientNew(srv->path, 5000))) {
+        /* Unblock the server waiting in accept() */
+        shutdown(srv->listenfd, SHUT_RDWR);
+        virThreadJoin(&srv->thread);
+    }
+
+    return client;
+}
+
+
+static int
+testServerStop(struct testServer *srv,
+               virOVSDBClientPtr client)
+{
+    virObjectUnref(client);
+    virThreadJoin(&srv->thread);
+    testServerFree(srv);
+
+    return srv->failed ? -1 : 0;
+}
+
+
+static int
+testTransact(const void *opaque G_GNUC_UNUSED)
+{
+    struct testServer srv;
+    virOVSDBClientPtr client;
+    g_autoptr(virJSONValue) ops = virJSONValueNewArray();
+    g_autoptr(virJSONValue) op = NULL;
+    g_autoptr(virJSONValue) value = virJSONValueNewString("vnet0");
+    g_autoptr(virJSONValue) clause = NULL;
+    g_autoptr(virJSONValue) where = virJSONValueNewArray();
+    g_autoptr(virJSONValue) results = NULL;
+    const char *uuid;
+    int ret = -1;
+
+    if (!(client = testServerStart(&srv))) {
+        testServerFree(&srv);
+        return -1;
+    }
+
+    if (!(clause = virOVSDBClause("name", "==", &value)) ||
+        virJSONValueArrayAppend(where, clause) < 0)
+        goto cleanup;
+    clause = NULL;
+
+    if (virJSONValueObjectCreate(&op,
+                                 "s:op", "select",
+                                 "s:table", "Port",
+                                 "a:where", &where,
+                                 NULL) < 0 ||
+        virJSONValueArrayAppend(ops, op) < 0)
+        goto cleanup;
+    op = NULL;
+
+    if (virOVSDBClientTransact(client, &ops, &results) < 0)
+        goto cleanup;
+
+    if (STRNEQ_NULLABLE((uuid = virOVSDBResultGetUUID(results, 0)),
+                        TEST_PORT_UUID)) {
+        VIR_TEST_DEBUG("expected UUID %s got %s", TEST_PORT_UUID, NULLSTR(uuid));
+        goto cleanup;
+    }
+
+    if (!virOVSDBClientIsConnected(client))
+        goto cleanup;
+
+    ret = 0;
+ cleanup:
+    if (testServerStop(&srv, client) < 0)
+        ret = -1;
+    return ret;
+}
+
+
+static int
+testTransactError(const void *opaque G_GNUC_UNUSED)
+{
+    struct testServer srv;
+    virOVSDBClientPtr client;
+    g_autoptr(virJSONValue) ops = virJSONValueNewArray();
+    g_autoptr(virJSONValue) op = NULL;
+    g_autoptr(virJSONValue) results = NULL;
+    int ret = -1;
+
+    if (!(client = testServerStart(&srv))) {
+        testServerFree(&srv);
+        return -1;
+    }
+
+    if (virJSONValueObjectCreate(&op,
+                                 "s:op", "select",
+                                 "s:table", "Fail",
+                                 NULL) < 0 ||
+        virJSONValueArrayAppend(ops, op) < 0)
+        goto cleanup;
+    op = NULL;
+
+    if (virOVSDBClientTransact(client, &ops, &results) == 0) {
+        VIR_TEST_DEBUG("failed transaction reported success");
+        goto cleanup;
+    }
+
+    /* A failed operation doesn't break the connection */
+    if (!virOVSDBClientIsConnected(client))
+        goto cleanup;
+
+    ret = 0;
+ cleanup:
+    if (testServerStop(&srv, client) < 0)
+        ret = -1;
+    return ret;
+}
+
+
+static int
+testCheckStats(virOVSDBClientPtr client,
+               const char *ifname,
+               long long rx,
+               long long tx)
+{
+    g_autoptr(virJSONValue) stats = NULL;
+    virJSONValuePtr map;
+    long long val[2];
+    size_t i;
+
+    if (virOVSDBClientGetInterfaceStats(client, ifname, &stats) < 0)
+        return -1;
+
+    if (rx < 0) {
+        if (stats) {
+            VIR_TEST_DEBUG("unexpected stats for %s", ifname);
+            return -1;
+        }
+        return 0;
+    }
+
+    if (!(map = virJSONValueArrayGet(stats, 1)) ||
+        virJSONValueArraySize(map) != 2) {
+        VIR_TEST_DEBUG("missing stats for %s", ifname);
+        return -1;
+    }
+
+    for (i = 0; i < 2; i++) {
+        virJSONValuePtr pair = virJSONValueArrayGet(map, i);
+
+        if (virJSONValueGetNumberLong(virJSONValueArrayGet(pair, 1), &val[i]) < 0)
+            return -1;
+    }
+
+    if (val[0] != rx || val[1] != tx) {
+        VIR_TEST_DEBUG("expected rx=%lld tx=%lld got rx=%lld tx=%lld",
+                       rx, tx, val[0], val[1]);
+        return -1;
+    }
+
+    return 0;
+}
+
+
+static int
+testMonitor(const void *opaque G_GNUC_UNUSED)
+{
+    struct testServer srv;
+    virOVSDBClientPtr client;
+    g_autoptr(virJSONValue) ops = virJSONValueNewArray();
+    g_autoptr(virJSONValue) op = NULL;
+    int ret = -1;
+
+    if (!(client = testServerStart(&srv))) {
+        testServerFree(&srv);
+        return -1;
+    }
+
+    /* Sets up the monitor and reports its initial contents */
+    if (testCheckStats(client, "vnet0", 10, 20) < 0)
+        goto cleanup;
+
+    /* The server follows this one with an update changing the
+     * statistics together with cur_cfg */
+    if (virJSONValueObjectCreate(&op,
+                                 "s:op", "select",
+                                 "s:table", "Port",
+                                 NULL) < 0 ||
+        virJSONValueArrayAppend(ops, op) < 0)
+        goto cleanup;
+    op = NULL;
+
+    if (virOVSDBClientTransact(client, &ops, NULL) < 0 ||
+        virOVSDBClientWaitCfg(client, 2) < 0)
+        goto cleanup;
+
+    if (testCheckStats(client, "vnet0", 30, 40) < 0 ||
+        testCheckStats(client, "vnet1", -1, -1) < 0)
+        goto cleanup;
+
+    ret = 0;
+ cleanup:
+    if (testServerStop(&srv, client) < 0)
+        ret = -1;
+    return ret;
+}
+
+
+static int
+mymain(void)
+{
+    int ret = 0;
+
+    if (virTestRun("Transact", testTransact, NULL) < 0)
+        ret = -1;
+    if (virTestRun("Transact error", testTransactError, NULL) < 0)
+        ret = -1;
+    if (virTestRun("Monitor", testMonitor, NULL) < 0)
+        ret = -1;
+
+    return ret == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+#else /* WIN32 */
+
+static int
+mymain(void)
+{
+    return EXIT_AM_SKIP;
+}
+
+#endif /* WIN32 */
+
+VIR_TEST_MAIN(mymain)
@@ -0,0 +1,373 @@
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+
+#include <unistd.h>
+
+#include "testutils.h"
+#include "virfile.h"
+#include "virstring.h"
+#include "viruuid.h"
+
+#define LIBVIRT_VIRSTORAGEFILEPRIV_H_ALLOW
+#include "virstoragefilepriv.h"
+
+#include "storage/storage_driver.h"
+
+#define VIR_FROM_THIS VIR_FROM_NONE
+
+#define TEST_HEADER "fake image header"
+
+
+static virStorageSourcePtr
+testKeySource(void)
+{
+    virStorageSourcePtr src = virStorageSourceNew();
+
+    src->type = VIR_STORAGE_TYPE_NETWORK;
+    src->protocol = VIR_STORAGE_NET_PROTOCOL_GLUSTER;
+    src->volume = g_strdup("vol");
+    src->path = g_strdup("dir/image.qcow2");
+    src->nhosts = 1;
+    src->hosts = g_new0(virStorageNetHostDef, 1);
+    src->hosts[0].name = g_strdup("host1");
+    src->hosts[0].port = 24007;
+    src->hosts[0].transport = VIR_STORAGE_NET_HOST_TRANS_TCP;
+    src->auth = g_new0(virStorageAuthDef, 1);
+    src->auth->username = g_strdup("admin");
+
+    return src;
+}
+
+
+static void
+testKeyVolume(virStorageSourcePtr src)
+{
+    VIR_FREE(src->volume);
+    src->volume = g_strdup("vol2");
+}
+
+
+static void
+testKeySnapshot(virStorageSourcePtr src)
+{
+    src->snapshot = g_strdup("snap");
+}
+
+
+static void
+testKeyConfigFile(virStorageSourcePtr src)
+{
+    src->configFile = g_strdup("/etc/ceph/other.conf");
+}
+
+
+static void
+testKeyProtocol(virStorageSourcePtr src)
+{
+    src->protocol = VIR_STORAGE_NET_PROTOCOL_RBD;
+}
+
+
+static void
+testKeyPort(virStorageSourcePtr src)
+{
+    src->hosts[0].port = 24008;
+}
+
+
+static void
+testKeyTransport(virStorageSourcePtr src)
+{
+    src->hosts[0].transport = VIR_STORAGE_NET_HOST_TRANS_RDMA;
+}
+
+
+static void
+testKeySecondHost(virStorageSourcePtr src)
+{
+    virStorageNetHostDef host = { .name = g_strdup("host2") };
+
+    ignore_value(VIR_APPEND_ELEMENT(src->hosts, src->nhosts, host));
+}
+
+
+static void
+testKeyAuthUser(virStorageSourcePtr src)
+{
+    VIR_FREE(src->auth->username);
+    src->auth->username = g_strdup("other");
+}
+
+
+static void
+testKeyAuthSecret(virStorageSourcePtr src)
+{
+    src->auth->seclookupdef.type = VIR_SECRET_LOOKUP_TYPE_UUID;
+    ignore_value(virUUIDParse("c3a34b5d-4f0a-4fa9-9b53-5b0a4e7f3e1a",
+                              src->auth->seclookupdef.u.uuid));
+}
+
+
+typedef void (*testKeyModify)(virStorageSourcePtr src);
+
+static int
+testKeyDiffers(const void *opaque)
+{
+    testKeyModify modify = opaque;
+    g_autoptr(virStorageSource) a = testKeySource();
+    g_autoptr(virStorageSource) b = testKeySource();
+    g_autofree char *keya = virStorageFileHeaderCacheKey(a);
+    g_autofree char *keyb = virStorageFileHeaderCacheKey(b);
+    g_autofree char *keymod = NULL;
+
+    if (!keya || !keyb) {
+        VIR_TEST_DEBUG("no key for a network source");
+        return -1;
+    }
+
+    if (STRNEQ(keya, keyb)) {
+        VIR_TEST_DEBUG("keys of identical sources differ: '%s' '%s'",
+                       keya, keyb);
+        return -1;
+    }
+
+    if (!modify)
+        return 0;
+
+    modify(b);
+
+    if (!(keymod = virStorageFileHeaderCacheKey(b)))
+        return -1;
+
+    if (STREQ(keya, keymod)) {
+        VIR_TEST_DEBUG("key '%s' doesn't identify the source", keya);
+        return -1;
+    }
+
+    return 0;
+}
+
+
+static int
+testKeyBlock(const void *opaque G_GNUC_UNUSED)
+{
+    g_autoptr(virStorageSource) src = virStorageSourceNew();
+    g_autofree char *key = NULL;
+
+    src->type = VIR_STORAGE_TYPE_BLOCK;
+    src->path = g_strdup("/dev/sda");
+
+    if ((key = virStorageFileHeaderCacheKey(src))) {
+        VIR_TEST_DEBUG("block device got key '%s'", key);
+        return -1;
+    }
+
+    return 0;
+}
+
+
+static int
+testLookup(virStorageSourcePtr src,
+           const char *key,
+           virStorageFileHeaderCacheEntryPtr ident,
+           bool expectHit)
+{
+    g_autofree char *buf = NULL;
+    size_t len = 0;
+    int rc;
+
+    memset(ident, 0, sizeof(*ident));
+    rc = virStorageFileHeaderCacheLookup(src, key, ident, &buf, &len);
+
+    if (rc != (expectHit ? 1 : 0)) {
+        VIR_TEST_DEBUG("expected cache %s for '%s'",
+                       expectHit ? "hit" : "miss", key);
+        return -1;
+    }
+
+    if (expectHit &&
+        (len != strlen(TEST_HEADER) || memcmp(buf, TEST_HEADER, len) != 0)) {
+        VIR_TEST_DEBUG("cached header doesn't match");
+        return -1;
+    }
+
+    return 0;
+}
+
+
+static int
+testInvalidate(const void *opaque G_GNUC_UNUSED)
+{
+    g_autoptr(virStorageSource) src = virStorageSourceNew();
+    g_autofree char *key = NULL;
+    virStorageFileHeaderCacheEntry ident;
+    virStorageFileHeaderCacheEntry stale;
+    struct stat st;
+    int ret = -1;
+
+    /* Entries are only stored for images which weren't modified in the
+     * last few seconds, the test source itself is old enough */
+    src->type = VIR_STORAGE_TYPE_FILE;
+    src->path = g_strdup(abs_srcdir "/virstorageheadercachetest.c");
+
+    if (stat(src->path, &st) < 0)
+        return -1;
+
+    if (st.st_mtime + 2 > time(NULL) || st.st_ctime + 2 > time(NULL))
+        return EXIT_AM_SKIP;
+
+    if (virStorageFileInit(src) < 0 ||
+        !(key = virStorageFileHeaderCacheKey(src)))
+        return -1;
+
+    if (testLookup(src, key, &ident, false) < 0)
+        goto cleanup;
+
+    if (!ident.valid) {
+        VIR_TEST_DEBUG("identity of '%s' not filled", src->path);
+        goto cleanup;
+    }
+
+    virStorageFileHeaderCacheStore(key, &ident,
+                                   TEST_HEADER, strlen(TEST_HEADER));
+
+    if (testLookup(src, key, &ident, true) < 0)
+        goto cleanup;
+
+    /* explicit invalidation */
+    virStorageFileMetadataCacheInvalidate(src);
+
+    if (testLookup(src, key, &ident, false) < 0)
+        goto cleanup;
+
+    /* an entry stored for a different file identity is dropped */
+    stale = ident;
+    stale.size++;
+    virStorageFileHeaderCacheStore(key, &stale,
+                                   TEST_HEADER, strlen(TEST_HEADER));
+
+    if (testLookup(src, key, &ident, false) < 0)
+        goto cleanup;
+
+    stale = ident;
+    stale.ino++;
+    virStorageFileHeaderCacheStore(key, &stale,
+                                   TEST_HEADER, strlen(TEST_HEADER));
+
+    if (testLookup(src, key, &ident, false) < 0)
+        goto cleanup;
+
+    /* a stale entry must not come back once it was dropped */
+    if (testLookup(src, key, &ident, false) < 0)
+        goto cleanup;
+
+    ret = 0;
+
+ cleanup:
+    virStorageFileMetadataCacheInvalidate(src);
+    virStorageFileDeinit(src);
+    return ret;
+}
+
+
+static int
+testRecent(const void *opaque)
+{
+    const char *scratchdir = opaque;
+    g_autoptr(virStorageSource) src = virStorageSourceNew();
+    g_autofree char *key = NULL;
+    virStorageFileHeaderCacheEntry ident;
+    int ret = -1;
+
+    src->type = VIR_STORAGE_TYPE_FILE;
+    src->path = g_strdup_printf("%s/recent.img", scratchdir);
+
+    if (virFileWriteStr(src->path, TEST_HEADER, 0600) < 0)
+        return -1;
+
+    if (virStorageFileInit(src) < 0 ||
+        !(key = virStorageFileHeaderCacheKey(src)))
+        return -1;
+
+    if (testLookup(src, key, &ident, false) < 0)
+        goto cleanup;
+
+    virStorageFileHeaderCacheStore(key, &ident,
+                                   TEST_HEADER, strlen(TEST_HEADER));
+
+    /* a rewrite within the timestamp granularity would go unnoticed */
+    if (testLookup(src, key, &ident, false) < 0)
+        goto cleanup;
+
+    ret = 0;
+
+ cleanup:
+    virStorageFileDeinit(src);
+    return ret;
+}
+
+
+#define SCRATCHDIRTEMPLATE abs_builddir "/storageheadercachedir-XXXXXX"
+
+static int
+mymain(void)
+{
+    int ret = 0;
+    char scratchdir[] = SCRATCHDIRTEMPLATE;
+
+    if (storageRegisterAll() < 0)
+        return EXIT_FAILURE;
+
+    if (!g_mkdtemp(scratchdir)) {
+        fprintf(stderr, "Cannot create storageheadercachedir");
+        abort();
+    }
+
+#define DO_TEST_KEY(name, modify) \
+    do { \
+        if (virTestRun("key " name, testKeyDiffers, modify) < 0) \
+            ret = -1; \
+    } while (0)
+
+    DO_TEST_KEY("identical", NULL);
+    DO_TEST_KEY("volume", testKeyVolume);
+    DO_TEST_KEY("snapshot", testKeySnapshot);
+    DO_TEST_KEY("config file", testKeyConfigFile);
+    DO_TEST_KEY("protocol", testKeyProtocol);
+    DO_TEST_KEY("port", testKeyPort);
+    DO_TEST_KEY("transport", testKeyTransport);
+    DO_TEST_KEY("second host", testKeySecondHost);
+    DO_TEST_KEY("auth user", testKeyAuthUser);
+    DO_TEST_KEY("auth secret", testKeyAuthSecret);
+
+#undef DO_TEST_KEY
+
+    if (virTestRun("key block", testKeyBlock, NULL) < 0)
+        ret = -1;
+    if (virTestRun("invalidate", testInvalidate, NULL) < 0)
+        ret = -1;
+    if (virTestRun("recently modified", testRecent, scratchdir) < 0)
+        ret = -1;
+
+    if (getenv("LIBVIRT_SKIP_CLEANUP") == NULL)
+        virFileDeleteTree(scratchdir);
+
+    return ret == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+VIR_TEST_MAIN(mymain)
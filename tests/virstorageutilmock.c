@@ -0,0 +1,110 @@
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "internal.h"
+#include "virmock.h"
+
+/*
+ * copy_file_range() copying through userspace, so that the result
+ * does not depend on the kernel and filesystem the tests run on.
+ *
+ * LIBVIRT_COPY_RANGE_END: fail with EXDEV for input offsets from this
+ *   one on, as if the rest of the file could not be copied this way
+ * LIBVIRT_COPY_RANGE_FORBID: fail with EIO on any call
+ *
+ * A call which starts in a hole of the input fails with EIO too, as
+ * only the data sections are expected to be copied.
+ */
+
+#if HAVE_COPY_FILE_RANGE
+ssize_t
+copy_file_range(int fd_in, loff_t *off_in,
+                int fd_out, loff_t *off_out,
+                size_t len, unsigned int flags G_GNUC_UNUSED)
+{
+    const char *endstr = getenv("LIBVIRT_COPY_RANGE_END");
+    char buf[64 * 1024];
+    ssize_t ret = 0;
+
+    if (getenv("LIBVIRT_COPY_RANGE_FORBID") ||
+        lseek(fd_in, *off_in, SEEK_DATA) != *off_in) {
+        errno = EIO;
+        return -1;
+    }
+
+    if (endstr) {
+        loff_t end = strtoll(endstr, NULL, 10);
+
+        if (*off_in >= end) {
+            errno = EXDEV;
+            return -1;
+        }
+        len = MIN(len, end - *off_in);
+    }
+
+    while (len > 0) {
+        ssize_t got = pread(fd_in, buf, MIN(len, sizeof(buf)), *off_in);
+
+        if (got < 0)
+            return -1;
+        if (got == 0)
+            break;
+        if (pwrite(fd_out, buf, got, *off_out) != got)
+            return -1;
+
+        *off_in += got;
+        *off_out += got;
+        len -= got;
+        ret += got;
+    }
+
+    return ret;
+}
+#endif /* HAVE_COPY_FILE_RANGE */
+
+
+/*
+ * LIBVIRT_WIPE_NO_OFFLOAD: fail fallocate() requests to zero or punch
+ *   a range with EOPNOTSUPP, so that wiping has to write the zeroes
+ */
+
+#if HAVE_FALLOCATE && defined(FALLOC_FL_PUNCH_HOLE)
+static int (*real_fallocate)(int fd, int mode, off_t offset, off_t len);
+
+int
+fallocate(int fd, int mode, off_t offset, off_t len)
+{
+    int offload = FALLOC_FL_PUNCH_HOLE;
+
+# ifdef FALLOC_FL_ZERO_RANGE
+    offload |= FALLOC_FL_ZERO_RANGE;
+# endif
+
+    VIR_MOCK_REAL_INIT(fallocate);
+
+    if ((mode & offload) && getenv("LIBVIRT_WIPE_NO_OFFLOAD")) {
+        errno = EOPNOTSUPP;
+        return -1;
+    }
+
+    return real_fallocate(fd, mode, offset, len);
+}
+#endif /* HAVE_FALLOCATE && FALLOC_FL_PUNCH_HOLE */
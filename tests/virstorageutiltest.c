@@ -16,8 +16,11 @@
 
 #include <config.h>
 
+#include <fcntl.h>
+#include <unistd.h>
 
 #include "testutils.h"
+#include "vircommand.h"
 #include "virerror.h"
 #include "virfile.h"
 #include "virlog.h"
@@ -70,10 +73,321 @@ testGlusterExtractPoolSources(const void *opaque)
 }
 
 
+struct testWipeData {
+    const char *dir;
+    const char *name;
+    off_t size;
+    bool sparse;
+    bool loop;
+    bool nooffload;
+    off_t ends;
+};
+
+
+static int
+testWipeFill(const char *path,
+             const struct testWipeData *data)
+{
+    VIR_AUTOCLOSE fd = -1;
+    char buf[64 * 1024];
+    off_t start = 0;
+    off_t end = data->size;
+
+    memset(buf, 0xaa, sizeof(buf));
+
+    if ((fd = open(path, O_CREAT | O_TRUNC | O_WRONLY, 0600)) < 0 ||
+        ftruncate(fd, data->size) < 0)
+        return -1;
+
+    if (data->sparse) {
+        start = data->size / 2;
+        end = start + sizeof(buf);
+    }
+
+    while (start < end) {
+        size_t len = MIN(sizeof(buf), end - start);
+
+        if (pwrite(fd, buf, len, start) != (ssize_t) len)
+            return -1;
+        start += len;
+    }
+
+    return 0;
+}
+
+
+/*
+ * Check that @path has @size bytes, all zero, or if @ends is non-zero
+ * only the first and last @ends bytes are zero and the rest was kept
+ */
+static int
+testWipeCheck(const char *path,
+              off_t size,
+              off_t ends)
+{
+    VIR_AUTOCLOSE fd = -1;
+    char buf[64 * 1024];
+    off_t total = 0;
+    ssize_t got;
+    size_t i;
+
+    if ((fd = open(path, O_RDONLY)) < 0)
+        return -1;
+
+    while ((got = read(fd, buf, sizeof(buf))) > 0) {
+        for (i = 0; i < (size_t) got; i++) {
+            off_t pos = total + i;
+            unsigned char actual = buf[i];
+            unsigned char expect = 0;
+
+            if (ends && pos >= ends && pos < size - ends)
+                expect = 0xaa;
+
+            if (actual != expect) {
+                VIR_TEST_DEBUG("unexpected byte 0x%02x at offset %lld",
+                               actual, (long long) pos);
+                return -1;
+            }
+        }
+        total += got;
+    }
+
+    if (got < 0 || total != size) {
+        VIR_TEST_DEBUG("expected %lld bytes, got %lld",
+                       (long long) size, (long long) total);
+        return -1;
+    }
+
+    return 0;
+}
+
+
+static int
+testWipe(const void *opaque)
+{
+    const struct testWipeData *data = opaque;
+    g_autofree char *path = g_strdup_printf("%s/%s", data->dir, data->name);
+    g_autofree char *losetup = NULL;
+    g_autofree char *loopdev = NULL;
+    virStorageVolDef vol = { 0 };
+    int ret = -1;
+
+    /* Attaching a loop device changes the host, only do it on request */
+    if (data->loop &&
+        (!virTestGetExpensive() || geteuid() != 0 ||
+         !(losetup = virFindFileInPath("losetup"))))
+        return EXIT_AM_SKIP;
+
+    if (testWipeFill(path, data) < 0) {
+        VIR_TEST_DEBUG("cannot fill '%s'", path);
+        return -1;
+    }
+
+    if (data->loop) {
+        g_autoptr(virCommand) cmd = NULL;
+
+        cmd = virCommandNewArgList(losetup, "--find", "--show", path, NULL);
+        virCommandSetOutputBuffer(cmd, &loopdev);
+        if (virCommandRun(cmd, NULL) < 0)
+            return EXIT_AM_SKIP;
+        virStringTrimOptionalNewline(loopdev);
+    }
+
+    vol.target.path = loopdev ? loopdev : path;
+    vol.target.format = VIR_STORAGE_FILE_RAW;
+    vol.target.allocation = data->size;
+
+    if (data->nooffload)
+        g_setenv("LIBVIRT_WIPE_NO_OFFLOAD", "1", TRUE);
+
+    if (data->ends) {
+        if (virStorageBackendZeroPartitionTable(vol.target.path,
+                                                data->ends) < 0)
+            goto cleanup;
+    } else {
+        if (virStorageBackendVolWipeLocal(NULL, &vol,
+                                          VIR_STORAGE_VOL_WIPE_ALG_ZERO, 0) < 0)
+            goto cleanup;
+    }
+
+    if (testWipeCheck(vol.target.path, data->size, data->ends) < 0)
+        goto cleanup;
+
+    ret = 0;
+
+ cleanup:
+    g_unsetenv("LIBVIRT_WIPE_NO_OFFLOAD");
+    if (loopdev) {
+        g_autoptr(virCommand) cmd = NULL;
+
+        cmd = virCommandNewArgList(losetup, "--detach", loopdev, NULL);
+        ignore_value(virCommandRun(cmd, NULL));
+    }
+    unlink(path);
+    return ret;
+}
+
+
+#define COPY_SIZE (8 * 1024 * 1024)
+#define COPY_DATA1_END (1024 * 1024)
+#define COPY_DATA2_START (4 * 1024 * 1024)
+#define COPY_DATA2_END (COPY_DATA2_START + 64 * 1024)
+
+struct testCopyData {
+    const char *dir;
+    const char *name;
+    bool sparse;
+    const char *end;
+};
+
+
+/* A raw image with two data sections separated and followed by holes */
+static int
+testCopyFill(const char *path)
+{
+    VIR_AUTOCLOSE fd = -1;
+    char buf[64 * 1024];
+    off_t ranges[][2] = {
+        { 0, COPY_DATA1_END },
+        { COPY_DATA2_START, COPY_DATA2_END },
+    };
+    size_t i;
+    size_t j;
+
+    if ((fd = open(path, O_CREAT | O_TRUNC | O_WRONLY, 0600)) < 0 ||
+        ftruncate(fd, COPY_SIZE) < 0)
+        return -1;
+
+    for (i = 0; i < G_N_ELEMENTS(ranges); i++) {
+        off_t pos;
+
+        for (pos = ranges[i][0]; pos < ranges[i][1]; pos += sizeof(buf)) {
+            for (j = 0; j < sizeof(buf); j++)
+                buf[j] = (pos + j) % 251 + 1;
+
+            if (pwrite(fd, buf, sizeof(buf), pos) != (ssize_t) sizeof(buf))
+                return -1;
+        }
+    }
+
+    return 0;
+}
+
+
+static int
+testCopyCompare(const char *expect,
+                const char *actual)
+{
+    VIR_AUTOCLOSE efd = -1;
+    VIR_AUTOCLOSE afd = -1;
+    char ebuf[64 * 1024];
+    char abuf[64 * 1024];
+    off_t total = 0;
+    ssize_t egot;
+    ssize_t agot;
+
+    if ((efd = open(expect, O_RDONLY)) < 0 ||
+        (afd = open(actual, O_RDONLY)) < 0)
+        return -1;
+
+    do {
+        if ((egot = saferead(efd, ebuf, sizeof(ebuf))) < 0 ||
+            (agot = saferead(afd, abuf, sizeof(abuf))) < 0)
+            return -1;
+
+        if (egot != agot || memcmp(ebuf, abuf, egot) != 0) {
+            VIR_TEST_DEBUG("copy differs after offset %lld",
+                           (long long) total);
+            return -1;
+        }
+        total += egot;
+    } while (egot > 0);
+
+    return 0;
+}
+
+
+/*
+ * The copy is done with the copy_file_range() of virstorageutilmock,
+ * which fails the test if it's asked to copy a hole, or if it's used
+ * at all for a fully allocated copy. If it gives up in the middle of
+ * the file, the rest is copied by reading and writing.
+ */
+static int
+testCopy(const void *opaque)
+{
+    const struct testCopyData *data = opaque;
+    g_autofree char *srcpath = g_strdup_printf("%s/%s-src", data->dir,
+                                               data->name);
+    g_autofree char *dstpath = g_strdup_printf("%s/%s-dst", data->dir,
+                                               data->name);
+    virStoragePerms perms = { .mode = 0600, .uid = -1, .gid = -1 };
+    virStorageVolDef vol = { 0 };
+    virStorageVolDef inputvol = { 0 };
+    virStoragePoolObjPtr pool = NULL;
+    virStoragePoolDefPtr def = NULL;
+    virStorageBackendBuildVolFrom build;
+    int ret = -1;
+
+    if (testCopyFill(srcpath) < 0) {
+        VIR_TEST_DEBUG("cannot fill '%s'", srcpath);
+        return -1;
+    }
+
+    inputvol.type = VIR_STORAGE_VOL_FILE;
+    inputvol.target.path = srcpath;
+    inputvol.target.format = VIR_STORAGE_FILE_RAW;
+    inputvol.target.capacity = COPY_SIZE;
+
+    vol.type = VIR_STORAGE_VOL_FILE;
+    vol.target.path = dstpath;
+    vol.target.format = VIR_STORAGE_FILE_RAW;
+    vol.target.capacity = COPY_SIZE;
+    vol.target.allocation = data->sparse ? 0 : COPY_SIZE;
+    vol.target.perms = &perms;
+
+    if (!(pool = virStoragePoolObjNew()))
+        goto cleanup;
+    def = g_new0(virStoragePoolDef, 1);
+    def->type = VIR_STORAGE_POOL_DIR;
+    virStoragePoolObjSetDef(pool, def);
+
+    if (data->end)
+        g_setenv("LIBVIRT_COPY_RANGE_END", data->end, TRUE);
+    if (!data->sparse)
+        g_setenv("LIBVIRT_COPY_RANGE_FORBID", "1", TRUE);
+
+    build = virStorageBackendGetBuildVolFromFunction(&vol, &inputvol);
+    if (build(pool, &vol, &inputvol, 0) < 0)
+        goto cleanup;
+
+    if (testCopyCompare(srcpath, dstpath) < 0)
+        goto cleanup;
+
+    ret = 0;
+
+ cleanup:
+    g_unsetenv("LIBVIRT_COPY_RANGE_END");
+    g_unsetenv("LIBVIRT_COPY_RANGE_FORBID");
+    virStoragePoolObjEndAPI(&pool);
+    unlink(srcpath);
+    unlink(dstpath);
+    return ret;
+}
+
+
+#define SCRATCHDIRTEMPLATE abs_builddir "/storageutildir-XXXXXX"
+
 static int
 mymain(void)
 {
     int ret = 0;
+    char scratchdir[] = SCRATCHDIRTEMPLATE;
+
+    if (!g_mkdtemp(scratchdir)) {
+        fprintf(stderr, "Cannot create storageutildir");
+        abort();
+    }
 
 #define DO_TEST_GLUSTER_EXTRACT_POOL_SOURCES_FULL(testname, sffx, pooltype) \
     do { \
@@ -104,7 +418,52 @@ mymain(void)
 #undef DO_TEST_GLUSTER_EXTRACT_POOL_SOURCES_NETFS
 #undef DO_TEST_GLUSTER_EXTRACT_POOL_SOURCES_FULL
 
+#define DO_TEST_WIPE(testname, ...) \
+    do { \
+        struct testWipeData data = { scratchdir, testname, __VA_ARGS__ }; \
+        if (virTestRun("wipe-" testname, testWipe, &data) < 0) \
+            ret = -1; \
+    } while (0)
+
+    /* Sizes are chosen so that the wiped range does not start or end on
+     * the alignment used for O_DIRECT writes */
+    DO_TEST_WIPE("file", .size = 4 * 1024 * 1024 + 1234);
+    DO_TEST_WIPE("file-small", .size = 4000);
+    DO_TEST_WIPE("file-sparse", .size = 64 * 1024 * 1024 + 512,
+                 .sparse = true);
+    /* Without fallocate() the zeroes are written, the aligned middle
+     * with O_DIRECT and the head and tail through the page cache */
+    DO_TEST_WIPE("file-write", .size = 4 * 1024 * 1024 + 1234,
+                 .nooffload = true);
+    /* Zeroing the end of the volume starts at an unaligned offset */
+    DO_TEST_WIPE("ends", .size = 8 * 1024 * 1024 + 4567,
+                 .ends = 1024 * 1024 + 1234);
+    DO_TEST_WIPE("ends-write", .size = 8 * 1024 * 1024 + 4567,
+                 .ends = 1024 * 1024 + 1234, .nooffload = true);
+    DO_TEST_WIPE("loop", .size = 16 * 1024 * 1024, .loop = true);
+
+#undef DO_TEST_WIPE
+
+#define DO_TEST_COPY(testname, ...) \
+    do { \
+        struct testCopyData data = { scratchdir, testname, __VA_ARGS__ }; \
+        if (virTestRun("copy-" testname, testCopy, &data) < 0) \
+            ret = -1; \
+    } while (0)
+
+    DO_TEST_COPY("sparse", .sparse = true);
+    /* copy_file_range() gives up in the middle of a data section ... */
+    DO_TEST_COPY("resume-data", .sparse = true, .end = "100000");
+    /* ... or right after a hole it skipped */
+    DO_TEST_COPY("resume-hole", .sparse = true, .end = "1048576");
+    DO_TEST_COPY("full", .sparse = false);
+
+#undef DO_TEST_COPY
+
+    if (getenv("LIBVIRT_SKIP_CLEANUP") == NULL)
+        virFileDeleteTree(scratchdir);
+
     return ret == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
 }
 
-VIR_TEST_MAIN(mymain)
+VIR_TEST_MAIN_PRELOAD(mymain, VIR_TEST_MOCK("virstorageutil"))
@@ -0,0 +1,235 @@
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ */
+
+#include <config.h>
+
+#include "testutils.h"
+#include "virbuffer.h"
+#include "virthread.h"
+#include "virthreadpool.h"
+
+#define VIR_FROM_THIS VIR_FROM_NONE
+
+/* Jobs record their name in the order they are run. A job named
+ * "block" does not finish until the test lets it, which keeps its
+ * worker busy while the following jobs are queued. Blocking jobs are
+ * let go in the reverse order they started. */
+
+typedef struct _testPoolState testPoolState;
+struct _testPoolState {
+    virMutex lock;
+    virCond cond;
+    virBuffer order;
+    size_t started;
+    size_t done;
+    size_t released;
+};
+
+typedef struct _testPoolJob testPoolJob;
+struct _testPoolJob {
+    const char *name;
+    const void *key;
+    unsigned int priority;
+};
+
+/* The pool compares keys by address */
+static int keyA;
+static int keyB;
+static int keyC;
+
+
+static void
+testPoolJobFunc(void *jobdata,
+                void *opaque)
+{
+    testPoolJob *job = jobdata;
+    testPoolState *state = opaque;
+
+    virMutexLock(&state->lock);
+
+    if (STREQ(job->name, "block")) {
+        size_t nth = state->started++;
+
+        virCondBroadcast(&state->cond);
+        while (state->released + nth < state->started)
+            ignore_value(virCondWait(&state->cond, &state->lock));
+    } else {
+        virBufferAsprintf(&state->order, "%s ", job->name);
+    }
+
+    state->done++;
+    virCondBroadcast(&state->cond);
+    virMutexUnlock(&state->lock);
+}
+
+
+static void
+testPoolWait(testPoolState *state,
+             size_t *counter,
+             size_t value)
+{
+    virMutexLock(&state->lock);
+    while (*counter < value)
+        ignore_value(virCondWait(&state->cond, &state->lock));
+    virMutexUnlock(&state->lock);
+}
+
+
+static void
+testPoolRelease(testPoolState *state)
+{
+    virMutexLock(&state->lock);
+    state->released++;
+    virCondBroadcast(&state->cond);
+    virMutexUnlock(&state->lock);
+}
+
+
+struct testPoolData {
+    size_t prioWorkers;
+    const testPoolJob *jobs;
+    size_t njobs;
+    const char *expect;
+};
+
+
+static int
+testPoolOrder(const void *opaque)
+{
+    const struct testPoolData *data = opaque;
+    testPoolState state = { .order = VIR_BUFFER_INITIALIZER };
+    testPoolJob normalBlock = { "block", NULL, 0 };
+    testPoolJob prioBlock = { "block", NULL, 1 };
+    virThreadPoolPtr pool = NULL;
+    g_autofree char *actual = NULL;
+    size_t nblocks = data->prioWorkers ? 2 : 1;
+    size_t i;
+    int ret = -1;
+
+    if (virMutexInit(&state.lock) < 0 ||
+        virCondInit(&state.cond) < 0)
+        return -1;
+
+    if (!(pool = virThreadPoolNewFull(1, 1, data->prioWorkers,
+                                      testPoolJobFunc, "test", &state)))
+        goto cleanup;
+
+    /* Occupy the only ordinary worker ... */
+    if (virThreadPoolSendJob(pool, 0, &normalBlock) < 0)
+        goto cleanup;
+    testPoolWait(&state, &state.started, 1);
+
+    /* ... and the priority worker, which is the only one left for it */
+    if (data->prioWorkers) {
+        if (virThreadPoolSendJob(pool, 1, &prioBlock) < 0)
+            goto cleanup;
+        testPoolWait(&state, &state.started, 2);
+    }
+
+    for (i = 0; i < data->njobs; i++) {
+        if (virThreadPoolSendJobFull(pool, data->jobs[i].priority,
+                                     data->jobs[i].key,
+                                     (void *) &data->jobs[i]) < 0)
+            goto cleanup;
+    }
+
+    /* Let the priority worker drain the priority jobs first so that the
+     * order does not depend on scheduling */
+    if (data->prioWorkers) {
+        size_t nprio = 0;
+
+        for (i = 0; i < data->njobs; i++) {
+            if (data->jobs[i].priority)
+                nprio++;
+        }
+
+        testPoolRelease(&state);
+        testPoolWait(&state, &state.done, 1 + nprio);
+        virBufferAddLit(&state.order, "| ");
+    }
+
+    testPoolRelease(&state);
+    testPoolWait(&state, &state.done, nblocks + data->njobs);
+
+    virBufferTrim(&state.order, " ");
+    actual = virBufferContentAndReset(&state.order);
+
+    if (STRNEQ_NULLABLE(actual, data->expect)) {
+        virTestDifference(stderr, data->expect, actual);
+        goto cleanup;
+    }
+
+    ret = 0;
+
+ cleanup:
+    /* Don't leave the blocking jobs waiting on error */
+    virMutexLock(&state.lock);
+    state.released = nblocks;
+    virCondBroadcast(&state.cond);
+    virMutexUnlock(&state.lock);
+
+    virThreadPoolFree(pool);
+    virBufferFreeAndReset(&state.order);
+    virCondDestroy(&state.cond);
+    virMutexDestroy(&state.lock);
+    return ret;
+}
+
+
+static int
+mymain(void)
+{
+    int ret = 0;
+
+#define DO_TEST(name, prio, expectstr, ...) \
+    do { \
+        const testPoolJob jobs[] = { __VA_ARGS__ }; \
+        struct testPoolData data = { \
+            .prioWorkers = prio, .jobs = jobs, \
+            .njobs = G_N_ELEMENTS(jobs), .expect = expectstr, \
+        }; \
+        if (virTestRun("Thread pool " name, testPoolOrder, &data) < 0) \
+            ret = -1; \
+    } while (0)
+
+    DO_TEST("fifo", 0, "j1 j2 j3",
+            { "j1", NULL, 0 }, { "j2", NULL, 0 }, { "j3", NULL, 0 });
+
+    /* A key which queued several jobs takes turns with keys that
+     * arrived later */
+    DO_TEST("fair", 0, "a1 b1 c1 a2 b2 a3",
+            { "a1", &keyA, 0 }, { "a2", &keyA, 0 }, { "a3", &keyA, 0 },
+            { "b1", &keyB, 0 }, { "b2", &keyB, 0 }, { "c1", &keyC, 0 });
+
+    /* Unkeyed jobs are appended after everything queued so far */
+    DO_TEST("fair unkeyed", 0, "a1 b1 a2 u1 b2",
+            { "a1", &keyA, 0 }, { "a2", &keyA, 0 }, { "u1", NULL, 0 },
+            { "b1", &keyB, 0 }, { "b2", &keyB, 0 });
+
+    /* The priority worker picks the first priority job in the fair
+     * order, even if it was queued after a later priority job */
+    DO_TEST("fair priority", 1, "b1 a3 | a1 a2",
+            { "a1", &keyA, 0 }, { "a2", &keyA, 0 }, { "a3", &keyA, 1 },
+            { "b1", &keyB, 1 });
+
+    DO_TEST("fair priority order", 1, "a1 b1 a2 a3 |",
+            { "a1", &keyA, 1 }, { "a2", &keyA, 1 }, { "a3", &keyA, 1 },
+            { "b1", &keyB, 1 });
+
+    return ret == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+VIR_TEST_MAIN(mymain)
@@ -21,10 +21,13 @@
 #include <config.h>
 
 #include <unistd.h>
+#include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
 #include <stdbool.h>
 #include <fcntl.h>
+#include <errno.h>
+#include <sys/stat.h>
 
 #include <yajl/yajl_gen.h>
 #include <yajl/yajl_parse.h>
@@ -32,6 +35,10 @@
 #include "libvirt_nss_leases.h"
 #include "libvirt_nss.h"
 
+/* Keep in sync with VIR_LEASE_JOURNAL_SUFFIX */
+#define LEASES_JOURNAL_SUFFIX ".journal"
+#define LEASES_JOURNAL_RETRIES 3
+
 enum {
     FIND_LEASES_STATE_START,
     FIND_LEASES_STATE_LIST,
@@ -45,11 +52,14 @@ typedef struct {
     size_t nmacs;
     int state;
     unsigned long long now;
-    int af;
-    bool *found;
     leaseAddress **addrs;
     size_t *naddrs;
 
+    /* Parsing a lease journal, whose records may override addresses
+     * found since @base */
+    bool journal;
+    size_t base;
+
     char *key;
     struct {
         unsigned long long expiry;
@@ -61,15 +71,10 @@ typedef struct {
 
 
 static int
-appendAddr(const char *name __attribute__((unused)),
-           leaseAddress **tmpAddress,
-           size_t *ntmpAddress,
-           const char *ipAddr,
-           long long expirytime,
-           int af)
+parseAddr(const char *ipAddr,
+          int *family,
+          unsigned char *addr)
 {
-    int family;
-    size_t i;
     struct addrinfo hints = {0};
     struct addrinfo *res = NULL;
     union {
@@ -77,11 +82,7 @@ appendAddr(const char *name __attribute__((unused)),
         struct sockaddr_in sin;
         struct sockaddr_in6 sin6;
     } sa;
-    unsigned char addr[16];
     int err;
-    leaseAddress *newAddr;
-
-    DEBUG("IP address: %s", ipAddr);
 
     hints.ai_family = AF_UNSPEC;
     hints.ai_flags = AI_NUMERICHOST;
@@ -96,15 +97,45 @@ appendAddr(const char *name __attribute__((unused)),
         ERROR("No resolved address for '%s'", ipAddr);
         return -1;
     }
-    family = res->ai_family;
+    *family = res->ai_family;
     memcpy(&sa, res->ai_addr, res->ai_addrlen);
     freeaddrinfo(res);
 
-    if (family == AF_INET) {
+    if (*family == AF_INET)
         memcpy(addr, &sa.sin.sin_addr, sizeof(sa.sin.sin_addr));
-    } else if (family == AF_INET6) {
+    else if (*family == AF_INET6)
         memcpy(addr, &sa.sin6.sin6_addr, sizeof(sa.sin6.sin6_addr));
-    } else {
+
+    return 0;
+}
+
+
+static size_t
+addrLen(int family)
+{
+    return family == AF_INET ? sizeof(struct in_addr) : sizeof(struct in6_addr);
+}
+
+
+static int
+appendAddr(const char *name __attribute__((unused)),
+           leaseAddress **tmpAddress,
+           size_t *ntmpAddress,
+           const char *ipAddr,
+           long long expirytime,
+           int af)
+{
+    int family;
+    size_t i;
+    unsigned char addr[16];
+    leaseAddress *newAddr;
+
+    DEBUG("IP address: %s", ipAddr);
+
+    if (parseAddr(ipAddr, &family, addr) < 0)
+        return -1;
+
+    if (family != AF_INET && family != AF_INET6) {
         DEBUG("Skipping unexpected family %d", family);
         return 0;
     }
@@ -115,22 +146,10 @@ appendAddr(const char *name __attribute__((unused)),
     }
 
     for (i = 0; i < *ntmpAddress; i++) {
-        if (family == AF_INET) {
-            if ((*tmpAddress)[i].af == AF_INET &&
-                memcmp((*tmpAddress)[i].addr,
-                       &sa.sin.sin_addr,
-                       sizeof(sa.sin.sin_addr)) == 0) {
-                DEBUG("IP address already in the list");
-                return 0;
-            }
-        } else {
-            if ((*tmpAddress)[i].af == AF_INET6 &&
-                memcmp((*tmpAddress)[i].addr,
-                       &sa.sin6.sin6_addr,
-                       sizeof(sa.sin6.sin6_addr)) == 0) {
-                DEBUG("IP address already in the list");
-                return 0;
-            }
+        if ((*tmpAddress)[i].af == family &&
+            memcmp((*tmpAddress)[i].addr, addr, addrLen(family)) == 0) {
+            DEBUG("IP address already in the list");
+            return 0;
         }
     }
 
@@ -143,19 +162,71 @@ appendAddr(const char *name __attribute__((unused)),
 
     (*tmpAddress)[*ntmpAddress].expirytime = expirytime;
     (*tmpAddress)[*ntmpAddress].af = family;
-    if (family == AF_INET)
-        memcpy((*tmpAddress)[*ntmpAddress].addr,
-               &sa.sin.sin_addr,
-               sizeof(sa.sin.sin_addr));
-    else
-        memcpy((*tmpAddress)[*ntmpAddress].addr,
-               &sa.sin6.sin6_addr,
-               sizeof(sa.sin6.sin6_addr));
+    memcpy((*tmpAddress)[*ntmpAddress].addr, addr, addrLen(family));
     (*ntmpAddress)++;
     return 0;
 }
 
 
+/* Drop @ipAddr from the addresses found since @base, because a journal
+ * record superseded the lease it came from */
+static int
+removeAddr(leaseAddress *tmpAddress,
+           size_t *ntmpAddress,
+           size_t base,
+           const char *ipAddr)
+{
+    int family;
+    size_t i;
+    unsigned char addr[16];
+
+    if (parseAddr(ipAddr, &family, addr) < 0)
+        return -1;
+
+    if (family != AF_INET && family != AF_INET6)
+        return 0;
+
+    for (i = base; i < *ntmpAddress; i++) {
+        if (tmpAddress[i].af == family &&
+            memcmp(tmpAddress[i].addr, addr, addrLen(family)) == 0) {
+            DEBUG("Removing superseded IP address %s", ipAddr);
+            memmove(tmpAddress + i, tmpAddress + i + 1,
+                    sizeof(*tmpAddress) * (*ntmpAddress - i - 1));
+            (*ntmpAddress)--;
+            break;
+        }
+    }
+
+    return 0;
+}
+
+
+/* Drop the addresses found since @base which are not of family @af */
+static void
+filterAddr(leaseAddress *tmpAddress,
+           size_t *ntmpAddress,
+           size_t base,
+           int af)
+{
+    size_t i;
+    size_t j = base;
+
+    if (af == AF_UNSPEC)
+        return;
+
+    for (i = base; i < *ntmpAddress; i++) {
+        if (tmpAddress[i].af != af) {
+            DEBUG("Skipping address which family is %d, %d requested",
+                  tmpAddress[i].af, af);
+            continue;
+        }
+        tmpAddress[j++] = tmpAddress[i];
+    }
+
+    *ntmpAddress = j;
+}
+
+
 static int
 findLeasesParserInteger(void *ctx,
                         long long val)
@@ -257,11 +328,19 @@ findLeasesParserEndMap(void *ctx)
 
     DEBUG("Parse end map state=%d", parser->state);
 
-    if (parser->entry.macaddr == NULL)
+    if (parser->state != FIND_LEASES_STATE_ENTRY)
         return 0;
 
-    if (parser->state != FIND_LEASES_STATE_ENTRY)
+    if (parser->journal) {
+        /* Later records replace earlier leases for the same address, and
+         * a record without MAC address just deletes it */
+        if (parser->entry.ipaddr &&
+            removeAddr(*parser->addrs, parser->naddrs, parser->base,
+                       parser->entry.ipaddr) < 0)
+            return 0;
+    } else if (parser->entry.macaddr == NULL) {
         return 0;
+    }
 
     if (parser->nmacs) {
         DEBUG("Check %zu macs", parser->nmacs);
@@ -281,19 +360,18 @@ findLeasesParserEndMap(void *ctx)
               parser->entry.expiry, parser->now);
         found = false;
     }
-    if (!parser->entry.ipaddr)
+    if (!parser->entry.ipaddr || !parser->entry.macaddr)
         found = false;
 
-    if (found) {
-        *parser->found = true;
-
-        if (appendAddr(parser->name,
-                       parser->addrs, parser->naddrs,
-                       parser->entry.ipaddr,
-                       parser->entry.expiry,
-                       parser->af) < 0)
-            return 0;
-    }
+    /* Addresses of all families are collected, as a later journal
+     * record may still drop them. They are filtered in findLeases. */
+    if (found &&
+        appendAddr(parser->name,
+                   parser->addrs, parser->naddrs,
+                   parser->entry.ipaddr,
+                   parser->entry.expiry,
+                   AF_UNSPEC) < 0)
+        return 0;
 
     free(parser->entry.macaddr);
     free(parser->entry.ipaddr);
@@ -341,18 +419,18 @@ findLeasesParserEndArray(void *ctx)
 }
 
 
-int
-findLeases(const char *file,
-           const char *name,
-           char **macs,
-           size_t nmacs,
-           int af,
-           time_t now,
-           leaseAddress **addrs,
-           size_t *naddrs,
-           bool *found)
+static int
+findLeasesFD(int fd,
+             const char *file,
+             bool journal,
+             const char *name,
+             char **macs,
+             size_t nmacs,
+             time_t now,
+             leaseAddress **addrs,
+             size_t *naddrs,
+             size_t base)
 {
-    int fd = -1;
     int ret = -1;
     const yajl_callbacks parserCallbacks = {
         NULL, /* null */
@@ -371,28 +449,28 @@ findLeases(const char *file,
         .name = name,
         .macs = macs,
         .nmacs = nmacs,
-        .af = af,
         .now = now,
-        .found = found,
         .addrs = addrs,
         .naddrs = naddrs,
+        .journal = journal,
+        .base = base,
+        /* A journal is a sequence of lease objects, not a list */
+        .state = journal ? FIND_LEASES_STATE_LIST : FIND_LEASES_STATE_START,
     };
     yajl_handle parser = NULL;
     char line[1024];
     ssize_t nreadTotal = 0;
     int rv;
 
-    if ((fd = open(file, O_RDONLY)) < 0) {
-        ERROR("Cannot open %s", file);
-        goto cleanup;
-    }
-
     parser = yajl_alloc(&parserCallbacks, NULL, &parserState);
     if (!parser) {
         ERROR("Unable to create JSON parser");
         goto cleanup;
     }
 
+    if (journal)
+        yajl_config(parser, yajl_allow_multiple_values, 1);
+
     while (1) {
         rv = read(fd, line, sizeof(line));
         if (rv < 0)
@@ -411,11 +489,17 @@ findLeases(const char *file,
         }
     }
 
+    /* The last record of a journal may still be being written, it only
+     * takes effect once it is complete */
     if (nreadTotal > 0 &&
         yajl_complete_parse(parser) != yajl_status_ok) {
-        ERROR("Parse failed %s",
-              yajl_get_error(parser, 1, NULL, 0));
-        goto cleanup;
+        if (journal) {
+            DEBUG("Ignoring incomplete record at the end of %s", file);
+        } else {
+            ERROR("Parse failed %s",
+                  yajl_get_error(parser, 1, NULL, 0));
+            goto cleanup;
+        }
     }
 
     ret = 0;
@@ -431,7 +515,110 @@ findLeases(const char *file,
     free(parserState.entry.macaddr);
     free(parserState.entry.hostname);
     free(parserState.key);
+    return ret;
+}
+
+
+/* Returns true if @journal no longer refers to the file open as @fd */
+static bool
+journalRotated(const char *journal,
+               int fd)
+{
+    struct stat sb;
+    struct stat csb;
+    bool ret = true;
+    int check;
+
+    if ((check = open(journal, O_RDONLY)) < 0)
+        return true;
+
+    if (fstat(fd, &sb) == 0 &&
+        fstat(check, &csb) == 0 &&
+        sb.st_dev == csb.st_dev &&
+        sb.st_ino == csb.st_ino)
+        ret = false;
+
+    close(check);
+    return ret;
+}
+
+
+int
+findLeases(const char *file,
+           const char *name,
+           char **macs,
+           size_t nmacs,
+           int af,
+           time_t now,
+           leaseAddress **addrs,
+           size_t *naddrs,
+           bool *found)
+{
+    size_t base = *naddrs;
+    char *journal = NULL;
+    int fd = -1;
+    int jfd = -1;
+    int attempt;
+    int ret = -1;
+
+    if (asprintf(&journal, "%s%s", file, LEASES_JOURNAL_SUFFIX) < 0) {
+        journal = NULL;
+        goto cleanup;
+    }
+
+    /* The leases helper appends lease changes to a journal which it
+     * periodically folds into the leases file. The journal has to be
+     * opened before the leases file is read, and if it got replaced by
+     * the time we're done, the leases file may be newer than it. */
+    for (attempt = 0; attempt < LEASES_JOURNAL_RETRIES; attempt++) {
+        *naddrs = base;
+
+        if ((jfd = open(journal, O_RDONLY)) < 0 && errno != ENOENT) {
+            ERROR("Cannot open %s", journal);
+            goto cleanup;
+        }
+
+        if ((fd = open(file, O_RDONLY)) < 0) {
+            ERROR("Cannot open %s", file);
+            goto cleanup;
+        }
+
+        if (findLeasesFD(fd, file, false, name, macs, nmacs,
+                         now, addrs, naddrs, base) < 0)
+            goto cleanup;
+
+        close(fd);
+        fd = -1;
+
+        if (jfd == -1)
+            break;
+
+        if (findLeasesFD(jfd, journal, true, name, macs, nmacs,
+                         now, addrs, naddrs, base) < 0)
+            goto cleanup;
+
+        if (!journalRotated(journal, jfd))
+            break;
+
+        DEBUG("Journal %s was rotated, retrying", journal);
+        close(jfd);
+        jfd = -1;
+    }
+
+    /* Should the journal keep getting rotated, go with what we have.
+     * The name was found if any of its leases survived the journal,
+     * even if none of them has an address of the requested family. */
+    if (*naddrs > base)
+        *found = true;
+    filterAddr(*addrs, naddrs, base, af);
+
+    ret = 0;
+
+ cleanup:
     if (fd != -1)
         close(fd);
+    if (jfd != -1)
+        close(jfd);
+    free(journal);
     return ret;
 }